@@ -13,10 +13,18 @@ LOCAL_SRC_FILES := \
 	src/rtsp_auth.c \
 	src/rtsp_base64.c \
 	src/rtsp_client.c \
+	src/rtsp_client_cache.c \
+	src/rtsp_client_playback.c \
 	src/rtsp_client_session.c \
+	src/rtsp_map.c \
+	src/rtsp_mpsc.c \
 	src/rtsp_server.c \
+	src/rtsp_server_conn.c \
+	src/rtsp_server_group.c \
+	src/rtsp_server_reply.c \
 	src/rtsp_server_request.c \
 	src/rtsp_server_session.c \
+	src/rtsp_twheel.c \
 	src/rtsp_url.c \
 	src/rtsp_url.cpp
 LOCAL_LIBRARIES := \
@@ -97,13 +105,21 @@ LOCAL_EXPORT_CXXFLAGS := -std=c++11
 LOCAL_SRC_FILES := \
 	tests/rtsp_test_auth.c \
 	tests/rtsp_test_base64.c \
+	tests/rtsp_test_client.c \
+	tests/rtsp_test_map.c \
+	tests/rtsp_test_mpsc.c \
+	tests/rtsp_test_parser.c \
+	tests/rtsp_test_server.c \
+	tests/rtsp_test_twheel.c \
 	tests/rtsp_test_url.c \
 	tests/rtsp_test_url.cpp \
 	tests/rtsp_test.c
 LOCAL_LIBRARIES := \
 	libcunit \
 	libfutils \
+	libpomp \
 	librtsp
+LOCAL_LDLIBS := -lpthread
 
 include $(BUILD_EXECUTABLE)
 
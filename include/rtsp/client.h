@@ -64,6 +64,38 @@ enum rtsp_client_req_status {
 };
 
 
+/* Parameters of rtsp_client_start_playback() */
+struct rtsp_client_playback_params {
+	/* Path of the stream, relative to the URL given to
+	 * rtsp_client_connect() (can be NULL) */
+	const char *path;
+	enum rtsp_lower_transport lower_transport;
+	/* UDP only: client ports of the first media; media i uses
+	 * udp_port + 2 * i (stream) and udp_port + 2 * i + 1 (control) */
+	uint16_t udp_port;
+	/* PLAY range (from now to the end if NULL) and scale */
+	const struct rtsp_range *range;
+	float scale;
+	/* Timeout of each request */
+	unsigned int timeout_ms;
+};
+
+
+/* Result of the SETUP of a media in rtsp_client_start_playback() */
+struct rtsp_client_playback_media {
+	/* SDP media type (e.g. "video") */
+	const char *type;
+	/* SDP control URL (NULL for the aggregate control URL) */
+	const char *control_url;
+	/* 0 on success, negative errno otherwise */
+	int status;
+	uint16_t src_stream_port;
+	uint16_t src_control_port;
+	int ssrc_valid;
+	uint32_t ssrc;
+};
+
+
 struct rtsp_client_cbs {
 	void (*socket_cb)(int fd, void *userdata);
 
@@ -182,6 +214,30 @@ struct rtsp_client_cbs {
 			 const struct rtsp_header_ext *ext,
 			 size_t ext_count,
 			 void *userdata);
+
+	/* Called only for lower transport RTSP_LOWER_TRANSPORT_TCP; if set,
+	 * called instead of interleaved_data_cb with all the complete
+	 * interleaved packets received at once; the packets data is only
+	 * valid during the call */
+	void (*interleaved_batch_cb)(struct rtsp_client *client,
+				     const struct rtsp_interleaved_info *pkts,
+				     size_t count,
+				     void *userdata);
+
+	/* Completion of rtsp_client_start_playback(): req_status and status
+	 * are those of the first request that failed, or of the PLAY
+	 * request; session_id is NULL if no media was set up */
+	void (*playback_resp)(struct rtsp_client *client,
+			      const char *session_id,
+			      enum rtsp_client_req_status req_status,
+			      int status,
+			      const char *content_base,
+			      const char *sdp,
+			      const struct rtsp_client_playback_media *medias,
+			      size_t media_count,
+			      const struct rtsp_range *range,
+			      void *userdata,
+			      void *req_userdata);
 };
 
 
@@ -195,6 +251,9 @@ RTSP_API int rtsp_client_new(struct pomp_loop *loop,
 RTSP_API int rtsp_client_destroy(struct rtsp_client *client);
 
 
+/* When the host name resolves to several addresses, connection attempts
+ * are raced (RFC 8305): the next address, alternating IPv6 and IPv4, is
+ * tried 250ms after the previous one, and the first connection wins */
 RTSP_API int rtsp_client_connect(struct rtsp_client *client, const char *url);
 
 
@@ -205,6 +264,10 @@ RTSP_API const struct rtsp_url *
 rtsp_client_get_remote_url(const struct rtsp_client *client);
 
 
+/* The requests can be pipelined: a request can be sent before the
+ * responses to the previous ones are received (up to 8 requests in flight,
+ * -EBUSY is returned beyond); the responses are matched by CSeq and each
+ * request has its own timeout */
 RTSP_API int rtsp_client_options(struct rtsp_client *client,
 				 const struct rtsp_header_ext *ext,
 				 size_t ext_count,
@@ -272,12 +335,36 @@ RTSP_API int rtsp_client_record(struct rtsp_client *client,
 				unsigned int timeout_ms);
 
 
+/* Start the playback of a stream in a single call: OPTIONS (only if the
+ * server methods are not known yet) and DESCRIBE, then a SETUP per media
+ * of the session description and PLAY; after the first SETUP has created
+ * the session, the other SETUP requests and PLAY are pipelined. Only one
+ * playback start can be in progress; the playback_resp callback is
+ * called once, and the session is then handled as usual (keep-alive,
+ * rtsp_client_teardown()...) */
+RTSP_API int
+rtsp_client_start_playback(struct rtsp_client *client,
+			   const struct rtsp_client_playback_params *params,
+			   void *req_userdata);
+
+
 RTSP_API int rtsp_client_send_interleaved(struct rtsp_client *client,
 					  uint8_t channel,
 					  const uint8_t *data,
 					  size_t len);
 
 
+/* Send several interleaved packets (e.g. all the RTP packets of a frame)
+ * with gathered writes; returns the number of packets sent (the first
+ * ones of the array), which can be less than count if the socket is busy,
+ * or a negative errno (-EAGAIN if no packet could be sent); the caller
+ * can resume from the first unsent packet on ready_to_send_cb */
+RTSP_API int
+rtsp_client_send_interleaved_batch(struct rtsp_client *client,
+				   const struct rtsp_interleaved_info *pkts,
+				   size_t count);
+
+
 RTSP_API int rtsp_client_teardown(struct rtsp_client *client,
 				  const char *resource_url,
 				  const char *session_id,
@@ -291,6 +378,7 @@ RTSP_API int rtsp_client_remove_session(struct rtsp_client *client,
 					const char *session_id);
 
 
+/* Cancel all the requests in flight */
 RTSP_API int rtsp_client_cancel(struct rtsp_client *client);
 
 
@@ -305,6 +393,35 @@ RTSP_API int rtsp_client_set_socket_txbuf_size(struct rtsp_client *client,
 RTSP_API int rtsp_client_set_socket_class_selector(struct rtsp_client *client,
 						   uint32_t class_selector);
 
+
+/* Keep the results of the OPTIONS and DESCRIBE requests for ttl_ms
+ * milliseconds, across reconnections; rtsp_client_start_playback() then
+ * goes straight to SETUP with a cached session description (dropped and
+ * requested again if the first SETUP fails). 0 (default) disables the
+ * cache and empties it */
+RTSP_API int rtsp_client_set_cache_ttl(struct rtsp_client *client,
+				       unsigned int ttl_ms);
+
+
+/* Reconnect after a network disconnection with attempts spaced by an
+ * exponential backoff from min_delay_ms to max_delay_ms (0 for the
+ * default of 8s), with a random jitter, instead of the transport fixed
+ * delay; each attempt is abandoned when the next one starts. Once
+ * reconnected, the playing sessions are resumed with a PLAY request
+ * without range, which also re-attaches the interleaved channels to the
+ * new connection, and the others are kept alive; the sessions are kept
+ * until their timeout. min_delay_ms = 0 (default) disables it */
+RTSP_API int rtsp_client_set_reconnect_backoff(struct rtsp_client *client,
+					       unsigned int min_delay_ms,
+					       unsigned int max_delay_ms);
+
+
+/* Set the maximum size of the messages sent by the client (requests with
+ * their session description, replies); the default is
+ * RTSP_DEFAULT_MAX_MSG_SIZE */
+RTSP_API int rtsp_client_set_max_msg_size(struct rtsp_client *client,
+					  size_t size);
+
 RTSP_API const char *
 rtsp_client_conn_state_str(enum rtsp_client_conn_state val);
 
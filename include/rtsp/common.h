@@ -83,6 +83,10 @@ enum rtsp_method_type {
 
 #define RTSP_SESSION_DESCRIPTION_MAX_LEN (UINT16_MAX)
 
+/* Default maximum size of the messages sent by the client and the server,
+ * enough for a session description of RTSP_SESSION_DESCRIPTION_MAX_LEN */
+#define RTSP_DEFAULT_MAX_MSG_SIZE (RTSP_SESSION_DESCRIPTION_MAX_LEN + 4096)
+
 
 /**
  * Transport definitions
@@ -169,6 +173,19 @@ struct rtsp_header_ext {
 #define RTSP_HEADER_EXT_PARROT_LINK_TYPE "X-com-parrot-link-type"
 
 
+/**
+ * RTP/RTCP interleaved packet (see RFC 2326 chapter 10.12)
+ */
+
+#define RTSP_INTERLEAVED_HEADER_LEN 4
+
+struct rtsp_interleaved_info {
+	uint8_t channel;
+	const uint8_t *data;
+	uint16_t len;
+};
+
+
 RTSP_API const char *rtsp_url_scheme_str(enum rtsp_url_scheme val);
 
 
@@ -44,6 +44,7 @@ enum rtsp_server_teardown_reason {
 
 
 struct rtsp_server;
+struct rtsp_server_group;
 
 
 struct rtsp_server_cbs {
@@ -108,9 +109,28 @@ struct rtsp_server_cbs {
 				void *request_ctx,
 				enum rtsp_method_type method,
 				void *userdata);
+
+	/* Called only for lower transport RTSP_LOWER_TRANSPORT_TCP, for data
+	 * received on the interleaved channels of a media (optional) */
+	void (*interleaved_data)(struct rtsp_server *server,
+				 const char *session_id,
+				 uint8_t channel,
+				 const uint8_t *data,
+				 size_t len,
+				 void *stream_userdata,
+				 void *userdata);
+
+	/* Called when interleaved data can be sent again on a media after
+	 * rtsp_server_send_interleaved() returned -EAGAIN (optional) */
+	void (*ready_to_send)(struct rtsp_server *server,
+			      const char *session_id,
+			      void *stream_userdata,
+			      void *userdata);
 };
 
 
+/* The server listens on all the IPv6 and IPv4 addresses (dual-stack),
+ * or on the IPv4 ones only if IPv6 is not available */
 RTSP_API int rtsp_server_new(const char *software_name,
 			     uint16_t port,
 			     int reply_timeout_ms,
@@ -176,6 +196,65 @@ RTSP_API int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 					   size_t ext_count);
 
 
+/* Thread-safe variants of the rtsp_server_reply_to_*() functions: the
+ * arguments are copied and the reply is sent from the server loop, where
+ * all the replies posted since the last wakeup are processed together.
+ * A return value of 0 means that the reply was queued; errors when
+ * sending it are only logged. */
+RTSP_API int
+rtsp_server_post_reply_to_describe(struct rtsp_server *server,
+				   void *request_ctx,
+				   int status,
+				   const struct rtsp_header_ext *ext,
+				   size_t ext_count,
+				   const char *session_description);
+
+
+RTSP_API int rtsp_server_post_reply_to_setup(struct rtsp_server *server,
+					     void *request_ctx,
+					     void *media_ctx,
+					     int status,
+					     uint16_t src_stream_port,
+					     uint16_t src_control_port,
+					     int ssrc_valid,
+					     uint32_t ssrc,
+					     const struct rtsp_header_ext *ext,
+					     size_t ext_count,
+					     void *stream_userdata);
+
+
+RTSP_API int rtsp_server_post_reply_to_play(struct rtsp_server *server,
+					    void *request_ctx,
+					    void *media_ctx,
+					    int status,
+					    const struct rtsp_range *range,
+					    float scale,
+					    int seq_valid,
+					    uint16_t seq,
+					    int rtptime_valid,
+					    uint32_t rtptime,
+					    const struct rtsp_header_ext *ext,
+					    size_t ext_count);
+
+
+RTSP_API int rtsp_server_post_reply_to_pause(struct rtsp_server *server,
+					     void *request_ctx,
+					     void *media_ctx,
+					     int status,
+					     const struct rtsp_range *range,
+					     const struct rtsp_header_ext *ext,
+					     size_t ext_count);
+
+
+RTSP_API int
+rtsp_server_post_reply_to_teardown(struct rtsp_server *server,
+				   void *request_ctx,
+				   void *media_ctx,
+				   int status,
+				   const struct rtsp_header_ext *ext,
+				   size_t ext_count);
+
+
 RTSP_API int rtsp_server_announce(struct rtsp_server *server,
 				  char *uri,
 				  const struct rtsp_header_ext *ext,
@@ -190,6 +269,74 @@ RTSP_API int rtsp_server_force_teardown(struct rtsp_server *server,
 					size_t ext_count);
 
 
+/* Server group: one server (shard) per loop, all listening on the same port
+ * (SO_REUSEPORT), so that the kernel spreads the connections over the loops.
+ * The application runs each loop in its own thread; the loops must not be
+ * running while the group is created or destroyed. Each shard calls the
+ * callbacks on its own loop with its own struct rtsp_server, on which the
+ * rtsp_server_reply_to_*() functions must be called from that loop. The
+ * session identifiers carry the index of their shard. */
+RTSP_API int rtsp_server_group_new(const char *software_name,
+				   uint16_t port,
+				   int reply_timeout_ms,
+				   int session_timeout_ms,
+				   struct pomp_loop *const *loops,
+				   unsigned int loop_count,
+				   const struct rtsp_server_cbs *cbs,
+				   void *userdata,
+				   struct rtsp_server_group **ret_obj);
+
+
+RTSP_API int rtsp_server_group_destroy(struct rtsp_server_group *group);
+
+
+RTSP_API unsigned int
+rtsp_server_group_get_shard_count(const struct rtsp_server_group *group);
+
+
+RTSP_API struct rtsp_server *
+rtsp_server_group_get_shard(const struct rtsp_server_group *group,
+			    unsigned int index);
+
+
+/* Thread-safe: the teardown is run on the loop of the shard owning the
+ * session; errors on that loop are only logged */
+RTSP_API int rtsp_server_group_force_teardown(struct rtsp_server_group *group,
+					      const char *session_id,
+					      const char *path,
+					      const struct rtsp_header_ext *ext,
+					      size_t ext_count);
+
+
+/* Thread-safe: the announce is run on the loop of every shard */
+RTSP_API int rtsp_server_group_announce(struct rtsp_server_group *group,
+					const char *uri,
+					const struct rtsp_header_ext *ext,
+					size_t ext_count,
+					const char *session_description);
+
+
+/* Set the maximum size of the messages sent by the server (replies with
+ * their session description, ANNOUNCE requests); the default is
+ * RTSP_DEFAULT_MAX_MSG_SIZE */
+RTSP_API int rtsp_server_set_max_msg_size(struct rtsp_server *server,
+					  size_t size);
+
+
+/* Send RTP/RTCP data on an interleaved channel of a session set up with
+ * lower transport RTSP_LOWER_TRANSPORT_TCP; the buffer data must start
+ * with RTSP_INTERLEAVED_HEADER_LEN bytes of headroom, where the framing
+ * header is written, followed by the payload; the buffer is queued
+ * without copy (with a new reference) and must not be modified after
+ * the call; returns -EAGAIN if the connection write queue is full, in
+ * which case the ready_to_send callback is called once it has been
+ * drained */
+RTSP_API int rtsp_server_send_interleaved(struct rtsp_server *server,
+					  const char *session_id,
+					  uint8_t channel,
+					  struct pomp_buffer *buf);
+
+
 RTSP_API const char *
 rtsp_server_teardown_reason_str(enum rtsp_server_teardown_reason val);
 
@@ -275,13 +275,21 @@ struct rtsp_authorization_header {
 #define RTSP_METHOD_RECORD "RECORD"
 
 struct rtsp_request_header {
+	/* If non-zero, the strings point into the parsed data and are not
+	 * owned by the header (see rtsp_get_next_message()) */
+	int is_view;
+
 	/* Request line */
 	enum rtsp_method_type method;
 	char *uri;
 
 	/* General header */
 	int cseq;
+	/* Date to write (seconds since the Epoch); the received 'Date' value
+	 * is only kept as a string and parsed on demand, see
+	 * rtsp_*_header_get_date() */
 	uint64_t date;
+	char *date_str;
 	char *session_id;
 	unsigned int session_timeout;
 	struct rtsp_transport_header *transport[RTSP_TRANSPORT_MAX_COUNT];
@@ -415,13 +423,21 @@ struct rtsp_request_header {
 #define RTSP_STATUS_STRING_OPTION_NOT_SUPPORTED "Option Not Supported"
 
 struct rtsp_response_header {
+	/* If non-zero, the strings point into the parsed data and are not
+	 * owned by the header (see rtsp_get_next_message()) */
+	int is_view;
+
 	/* Status line */
 	int status_code;
 	char *status_string;
 
 	/* General header */
 	int cseq;
+	/* Date to write (seconds since the Epoch); the received 'Date' value
+	 * is only kept as a string and parsed on demand, see
+	 * rtsp_*_header_get_date() */
 	uint64_t date;
+	char *date_str;
 	char *session_id;
 	unsigned int session_timeout;
 	struct rtsp_transport_header *transport;
@@ -450,13 +466,6 @@ struct rtsp_response_header {
 };
 
 
-struct rtsp_interleaved_info {
-	uint8_t channel;
-	const uint8_t *data;
-	uint16_t len;
-};
-
-
 /**
  * RTSP message
  */
@@ -485,8 +494,22 @@ struct rtsp_message {
 };
 
 struct rtsp_message_parser_ctx {
-	struct rtsp_message msg;
+	/* Offset of the first unconsumed byte in the data buffer */
+	size_t head;
+
+	/* Length of the current message header and body, once the end of
+	 * the header has been found (0 otherwise) */
 	size_t header_len;
+	size_t body_len;
+
+	/* End of header search state, to resume the search when the
+	 * header is received in several pieces */
+	size_t scan_offset;
+	unsigned int scan_state;
+
+	/* Header extensions storage, reused from one message to the next */
+	struct rtsp_header_ext *ext;
+	size_t ext_capacity;
 };
 
 
@@ -494,6 +517,32 @@ struct rtsp_string {
 	char *str;
 	size_t len;
 	size_t max_len;
+
+	/* Optional backing buffer of str: if set, the string grows up to
+	 * limit bytes instead of failing with -ENOBUFS when full */
+	struct pomp_buffer *buf;
+	size_t limit;
+};
+
+
+/* Pre-serialized header line, including the trailing CRLF */
+struct rtsp_header_line {
+	char *str;
+	size_t len;
+};
+
+
+/* Pre-serialized lines of a response, spliced verbatim instead of being
+ * formatted from the corresponding header fields; NULL lines are
+ * formatted from the header fields as usual */
+struct rtsp_response_lines {
+	const struct rtsp_header_line *status;
+	const struct rtsp_header_line *date;
+	const struct rtsp_header_line *session;
+	const struct rtsp_header_line *content_type;
+	const struct rtsp_header_line *public_methods;
+	const struct rtsp_header_line *server;
+	const struct rtsp_header_line *content_base;
 };
 
 
@@ -502,6 +551,36 @@ RTSP_API int rtsp_get_next_message(const struct pomp_buffer *data,
 				   struct rtsp_message_parser_ctx *ctx);
 
 
+RTSP_API int
+rtsp_get_next_interleaved(const struct pomp_buffer *data,
+			  const struct rtsp_message_parser_ctx *ctx,
+			  size_t off,
+			  struct rtsp_interleaved_info *info,
+			  size_t *pkt_len);
+
+
+RTSP_API void
+rtsp_message_parser_ctx_clear(struct rtsp_message_parser_ctx *ctx);
+
+
+RTSP_API int
+rtsp_message_parser_append_data(struct rtsp_message_parser_ctx *ctx,
+				struct pomp_buffer *buffer,
+				const void *data,
+				size_t len);
+
+
+RTSP_API void rtsp_message_parser_consume(struct rtsp_message_parser_ctx *ctx,
+					  struct pomp_buffer *buffer,
+					  size_t count);
+
+
+RTSP_API void
+rtsp_interleaved_header_write(uint8_t channel,
+			      uint16_t len,
+			      uint8_t header[RTSP_INTERLEAVED_HEADER_LEN]);
+
+
 RTSP_API int rtsp_build_interleaved(const struct rtsp_interleaved_info *info,
 				    struct pomp_buffer **ret_obj);
 
@@ -517,11 +596,27 @@ RTSP_API int rtsp_request_header_write(const struct rtsp_request_header *header,
 				       struct rtsp_string *str);
 
 
+RTSP_API int
+rtsp_request_header_get_date(const struct rtsp_request_header *header,
+			     uint64_t *date);
+
+
 RTSP_API int
 rtsp_response_header_write(const struct rtsp_response_header *header,
 			   struct rtsp_string *str);
 
 
+RTSP_API int
+rtsp_response_header_write_lines(const struct rtsp_response_header *header,
+				 const struct rtsp_response_lines *lines,
+				 struct rtsp_string *str);
+
+
+RTSP_API int
+rtsp_response_header_get_date(const struct rtsp_response_header *header,
+			      uint64_t *date);
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -39,12 +39,6 @@ ULOG_DECLARE_TAG(rtsp);
 	case _prefix##_name:                                                   \
 		return #_name
 
-#define RTSP_REV_ENUM_CASE(_val, _str_prefix, _enum_prefix, _name)             \
-	do {                                                                   \
-		if (strcmp(_val, _str_prefix##_name) == 0)                     \
-			return _enum_prefix##_name;                            \
-	} while (0)
-
 /* codecheck_ignore[MULTISTATEMENT_MACRO_USE_DO_WHILE] */
 #define RTSP_STATUS_ENUM_CASE(_name, _status_code, _status_string)             \
 	case RTSP_STATUS_CODE(_name):                                          \
@@ -115,24 +109,96 @@ const char *rtsp_method_type_str(enum rtsp_method_type val)
 }
 
 
+/* Methods table, indexed by enum rtsp_method_type */
+#define RTSP_METHOD_DESC(_name)                                                \
+	[RTSP_METHOD_TYPE_##_name] = {                                         \
+		RTSP_METHOD_##_name,                                           \
+		sizeof(RTSP_METHOD_##_name) - 1,                               \
+		RTSP_METHOD_FLAG_##_name,                                      \
+	}
+
+static const struct {
+	const char *name;
+	size_t len;
+	uint32_t flag;
+} s_methods[] = {
+	RTSP_METHOD_DESC(OPTIONS),
+	RTSP_METHOD_DESC(DESCRIBE),
+	RTSP_METHOD_DESC(ANNOUNCE),
+	RTSP_METHOD_DESC(SETUP),
+	RTSP_METHOD_DESC(PLAY),
+	RTSP_METHOD_DESC(PAUSE),
+	RTSP_METHOD_DESC(TEARDOWN),
+	RTSP_METHOD_DESC(GET_PARAMETER),
+	RTSP_METHOD_DESC(SET_PARAMETER),
+	RTSP_METHOD_DESC(REDIRECT),
+	RTSP_METHOD_DESC(RECORD),
+};
+
+
+/* The length and first character of a method name select a single
+ * candidate, which is then compared once */
+#define RTSP_METHOD_KEY(_len, _c) (((_len) << 8) | (uint8_t)(_c))
+
+
+static enum rtsp_method_type rtsp_method_lookup(const char *val, size_t len)
+{
+	enum rtsp_method_type type;
+
+	if (len == 0)
+		return RTSP_METHOD_TYPE_UNKNOWN;
+
+	switch (RTSP_METHOD_KEY(len, val[0])) {
+	case RTSP_METHOD_KEY(4, 'P'):
+		type = RTSP_METHOD_TYPE_PLAY;
+		break;
+	case RTSP_METHOD_KEY(5, 'P'):
+		type = RTSP_METHOD_TYPE_PAUSE;
+		break;
+	case RTSP_METHOD_KEY(5, 'S'):
+		type = RTSP_METHOD_TYPE_SETUP;
+		break;
+	case RTSP_METHOD_KEY(6, 'R'):
+		type = RTSP_METHOD_TYPE_RECORD;
+		break;
+	case RTSP_METHOD_KEY(7, 'O'):
+		type = RTSP_METHOD_TYPE_OPTIONS;
+		break;
+	case RTSP_METHOD_KEY(8, 'A'):
+		type = RTSP_METHOD_TYPE_ANNOUNCE;
+		break;
+	case RTSP_METHOD_KEY(8, 'D'):
+		type = RTSP_METHOD_TYPE_DESCRIBE;
+		break;
+	case RTSP_METHOD_KEY(8, 'R'):
+		type = RTSP_METHOD_TYPE_REDIRECT;
+		break;
+	case RTSP_METHOD_KEY(8, 'T'):
+		type = RTSP_METHOD_TYPE_TEARDOWN;
+		break;
+	case RTSP_METHOD_KEY(13, 'G'):
+		type = RTSP_METHOD_TYPE_GET_PARAMETER;
+		break;
+	case RTSP_METHOD_KEY(13, 'S'):
+		type = RTSP_METHOD_TYPE_SET_PARAMETER;
+		break;
+	default:
+		return RTSP_METHOD_TYPE_UNKNOWN;
+	}
+
+	if (memcmp(val, s_methods[type].name, len) != 0)
+		return RTSP_METHOD_TYPE_UNKNOWN;
+
+	return type;
+}
+
+
 static enum rtsp_method_type rtsp_method_type_enum(const char *val)
 {
 	if (val == NULL)
 		return RTSP_METHOD_TYPE_UNKNOWN;
 
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, OPTIONS);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, DESCRIBE);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, ANNOUNCE);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, SETUP);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, PLAY);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, PAUSE);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, TEARDOWN);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, GET_PARAMETER);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, SET_PARAMETER);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, REDIRECT);
-	RTSP_REV_ENUM_CASE(val, RTSP_METHOD_, RTSP_METHOD_TYPE_, RECORD);
-
-	return RTSP_METHOD_TYPE_UNKNOWN;
+	return rtsp_method_lookup(val, strlen(val));
 }
 
 
@@ -305,66 +371,124 @@ const char *rtsp_client_req_status_str(enum rtsp_client_req_status val)
 }
 
 
-static char *rtsp_strnstr(const char *s, const char *find, size_t slen)
-{
-	char c;
-	char sc;
-	size_t len;
-
-	c = *find;
-	if (c == '\0')
-		return (char *)s;
-
-	find++;
-	len = strnlen(find, slen);
-	if (len >= slen)
-		return NULL;
+/* End of header scanner state: relevant suffix of the current run of
+ * CR/LF characters (all header terminators only contain CR and LF) */
+enum header_scan_state {
+	HEADER_SCAN_NONE = 0,
+	HEADER_SCAN_CR,
+	HEADER_SCAN_LF,
+	HEADER_SCAN_CRLF,
+	HEADER_SCAN_LFCR,
+	HEADER_SCAN_CRLFCR,
+	HEADER_SCAN_LFCRLF,
+};
+
+
+/* Next state on CR and LF; a negative value is the length of the
+ * double line terminator that has been found */
+/* clang-format off */
+static const int8_t header_scan_next_cr[] = {
+	[HEADER_SCAN_NONE] = HEADER_SCAN_CR,
+	[HEADER_SCAN_CR] = -2,		/* "\r\r" */
+	[HEADER_SCAN_LF] = HEADER_SCAN_LFCR,
+	[HEADER_SCAN_CRLF] = HEADER_SCAN_CRLFCR,
+	[HEADER_SCAN_LFCR] = -2,	/* "\r\r" */
+	[HEADER_SCAN_CRLFCR] = -2,	/* "\r\r" */
+	[HEADER_SCAN_LFCRLF] = -4,	/* "\n\r\n\r" */
+};
+static const int8_t header_scan_next_lf[] = {
+	[HEADER_SCAN_NONE] = HEADER_SCAN_LF,
+	[HEADER_SCAN_CR] = HEADER_SCAN_CRLF,
+	[HEADER_SCAN_LF] = -2,		/* "\n\n" */
+	[HEADER_SCAN_CRLF] = -2,	/* "\n\n" */
+	[HEADER_SCAN_LFCR] = HEADER_SCAN_LFCRLF,
+	[HEADER_SCAN_CRLFCR] = -4,	/* "\r\n\r\n" */
+	[HEADER_SCAN_LFCRLF] = -2,	/* "\n\n" */
+};
+/* clang-format on */
 
-	while (slen > len) {
-		sc = *s++;
-		slen--;
 
-		if ((sc == c) && (strncmp(s, find, len) == 0))
-			return (char *)(s - 1);
+/**
+ * Incremental search of the end of header (first double line terminator).
+ * The search resumes at *offset in the given state, so that data received
+ * in several pieces is only scanned once. On success, returns true and
+ * sets header_len (including the terminator) and found_len (terminator
+ * length); otherwise *offset and *state are updated for the next call.
+ */
+static bool header_end_scan(const char *s,
+			    size_t slen,
+			    size_t *offset,
+			    unsigned int *state,
+			    size_t *header_len,
+			    size_t *found_len)
+{
+	size_t i = *offset;
+	unsigned int st = *state;
+	const char *lf;
+	const char *cr;
+	size_t lf_pos;
+	int next;
+
+	while (i < slen) {
+		if (st == HEADER_SCAN_NONE) {
+			/* Fast path: jump to the next CR or LF; the CR
+			 * search is bounded by the next LF */
+			lf = memchr(s + i, '\n', slen - i);
+			lf_pos = (lf != NULL) ? (size_t)(lf - s) : slen;
+			cr = memchr(s + i, '\r', lf_pos - i);
+			if (cr != NULL) {
+				i = cr - s;
+			} else if (lf != NULL) {
+				i = lf_pos;
+			} else {
+				i = slen;
+				break;
+			}
+		}
 
-		if (sc == '\0')
-			break;
+		if (s[i] == '\r')
+			next = header_scan_next_cr[st];
+		else if (s[i] == '\n')
+			next = header_scan_next_lf[st];
+		else
+			next = HEADER_SCAN_NONE;
+		i++;
+
+		if (next < 0) {
+			*offset = 0;
+			*state = HEADER_SCAN_NONE;
+			if (header_len)
+				*header_len = i;
+			if (found_len)
+				*found_len = -next;
+			return true;
+		}
+		st = next;
 	}
 
-	return NULL;
+	*offset = i;
+	*state = st;
+	return false;
 }
 
 
 static char *find_double_newline(const char *s, size_t slen, size_t *found_len)
 {
+	size_t offset = 0;
+	unsigned int state = HEADER_SCAN_NONE;
+	size_t header_len = 0;
 	size_t len = 0;
-	char *r;
 
-	r = rtsp_strnstr(s, "\r\n\r\n", slen);
-	if (r) {
-		len = 4;
-		goto exit;
-	}
-	r = rtsp_strnstr(s, "\n\r\n\r", slen);
-	if (r) {
-		len = 4;
-		goto exit;
-	}
-	r = rtsp_strnstr(s, "\n\n", slen);
-	if (r) {
-		len = 2;
-		goto exit;
-	}
-	r = rtsp_strnstr(s, "\r\r", slen);
-	if (r) {
-		len = 2;
-		goto exit;
+	if (!header_end_scan(
+		    s, slen, &offset, &state, &header_len, &len)) {
+		if (found_len)
+			*found_len = 0;
+		return NULL;
 	}
 
-exit:
 	if (found_len)
 		*found_len = len;
-	return r;
+	return (char *)s + header_len - len;
 }
 
 
@@ -495,6 +619,26 @@ static int rtsp_time_read(const char *str, struct rtsp_time *time)
 }
 
 
+/* Pre-serialized lists of common method sets */
+static const struct {
+	uint32_t methods;
+	const char *str;
+	size_t len;
+} s_method_sets[] = {
+	{
+		RTSP_METHOD_FLAGS_PLAYBACK,
+		RTSP_METHOD_FLAGS_PLAYBACK_STR,
+		sizeof(RTSP_METHOD_FLAGS_PLAYBACK_STR) - 1,
+	},
+	{
+		RTSP_METHOD_FLAG_OPTIONS | RTSP_METHOD_FLAGS_PLAYBACK,
+		RTSP_METHOD_OPTIONS "," RTSP_METHOD_FLAGS_PLAYBACK_STR,
+		sizeof(RTSP_METHOD_OPTIONS "," RTSP_METHOD_FLAGS_PLAYBACK_STR) -
+			1,
+	},
+};
+
+
 static int rtsp_methods_write(uint32_t methods, struct rtsp_string *str)
 {
 	int ret = 0;
@@ -503,104 +647,36 @@ static int rtsp_methods_write(uint32_t methods, struct rtsp_string *str)
 	ULOG_ERRNO_RETURN_ERR_IF(methods == 0, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
 
-	if (methods & RTSP_METHOD_FLAG_OPTIONS) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_OPTIONS,
-			   "");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_DESCRIBE) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_DESCRIBE,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_ANNOUNCE) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_ANNOUNCE,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_SETUP) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_SETUP,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_PLAY) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_PLAY,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_PAUSE) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_PAUSE,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_TEARDOWN) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_TEARDOWN,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_GET_PARAMETER) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_GET_PARAMETER,
-			   (first) ? "" : ",");
-		first = 0;
-	}
-	if (methods & RTSP_METHOD_FLAG_SET_PARAMETER) {
-		CHECK_FUNC(rtsp_sprintf,
+	for (size_t i = 0; i < SIZEOF_ARRAY(s_method_sets); i++) {
+		if (methods != s_method_sets[i].methods)
+			continue;
+		CHECK_FUNC(rtsp_string_append,
 			   ret,
 			   return ret,
 			   str,
-			   "%s" RTSP_METHOD_SET_PARAMETER,
-			   (first) ? "" : ",");
-		first = 0;
+			   s_method_sets[i].str,
+			   s_method_sets[i].len);
+		return 0;
 	}
-	if (methods & RTSP_METHOD_FLAG_REDIRECT) {
-		CHECK_FUNC(rtsp_sprintf,
+
+	for (size_t i = 0; i < SIZEOF_ARRAY(s_methods); i++) {
+		if ((s_methods[i].flag == 0) ||
+		    ((methods & s_methods[i].flag) == 0))
+			continue;
+		if (!first)
+			CHECK_FUNC(rtsp_string_append_lit,
+				   ret,
+				   return ret,
+				   str,
+				   ",");
+		CHECK_FUNC(rtsp_string_append,
 			   ret,
 			   return ret,
 			   str,
-			   "%s" RTSP_METHOD_REDIRECT,
-			   (first) ? "" : ",");
+			   s_methods[i].name,
+			   s_methods[i].len);
 		first = 0;
 	}
-	if (methods & RTSP_METHOD_FLAG_RECORD) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   "%s" RTSP_METHOD_RECORD,
-			   (first) ? "" : ",");
-	}
 
 	return ret;
 }
@@ -608,8 +684,10 @@ static int rtsp_methods_write(uint32_t methods, struct rtsp_string *str)
 
 static int rtsp_methods_read(char *str, uint32_t *methods)
 {
-	const char *method;
+	char *method;
 	char *temp;
+	size_t len;
+	enum rtsp_method_type type;
 	uint32_t _methods = 0;
 
 	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
@@ -619,28 +697,12 @@ static int rtsp_methods_read(char *str, uint32_t *methods)
 	while (method) {
 		while (*method == ' ')
 			method++;
-		if (strcmp(method, RTSP_METHOD_OPTIONS) == 0)
-			_methods |= RTSP_METHOD_FLAG_OPTIONS;
-		else if (strcmp(method, RTSP_METHOD_DESCRIBE) == 0)
-			_methods |= RTSP_METHOD_FLAG_DESCRIBE;
-		else if (strcmp(method, RTSP_METHOD_ANNOUNCE) == 0)
-			_methods |= RTSP_METHOD_FLAG_ANNOUNCE;
-		else if (strcmp(method, RTSP_METHOD_SETUP) == 0)
-			_methods |= RTSP_METHOD_FLAG_SETUP;
-		else if (strcmp(method, RTSP_METHOD_PLAY) == 0)
-			_methods |= RTSP_METHOD_FLAG_PLAY;
-		else if (strcmp(method, RTSP_METHOD_PAUSE) == 0)
-			_methods |= RTSP_METHOD_FLAG_PAUSE;
-		else if (strcmp(method, RTSP_METHOD_TEARDOWN) == 0)
-			_methods |= RTSP_METHOD_FLAG_TEARDOWN;
-		else if (strcmp(method, RTSP_METHOD_GET_PARAMETER) == 0)
-			_methods |= RTSP_METHOD_FLAG_GET_PARAMETER;
-		else if (strcmp(method, RTSP_METHOD_SET_PARAMETER) == 0)
-			_methods |= RTSP_METHOD_FLAG_SET_PARAMETER;
-		else if (strcmp(method, RTSP_METHOD_REDIRECT) == 0)
-			_methods |= RTSP_METHOD_FLAG_REDIRECT;
-		else if (strcmp(method, RTSP_METHOD_RECORD) == 0)
-			_methods |= RTSP_METHOD_FLAG_RECORD;
+		len = strlen(method);
+		while ((len > 0) && (method[len - 1] == ' '))
+			len--;
+		type = rtsp_method_lookup(method, len);
+		if (type != RTSP_METHOD_TYPE_UNKNOWN)
+			_methods |= s_methods[type].flag;
 		method = strtok_r(NULL, ",", &temp);
 	}
 
@@ -649,6 +711,278 @@ static int rtsp_methods_read(char *str, uint32_t *methods)
 }
 
 
+/**
+ * Growable strings
+ */
+int rtsp_string_init(struct rtsp_string *str,
+		     struct pomp_buffer *buf,
+		     size_t limit)
+{
+	int ret;
+	void *data;
+	size_t capacity;
+
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(limit == 0, EINVAL);
+
+	ret = pomp_buffer_get_data(buf, &data, NULL, &capacity);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_get_data", -ret);
+		return ret;
+	}
+
+	str->str = data;
+	str->len = 0;
+	str->max_len = (capacity < limit) ? capacity : limit;
+	str->buf = buf;
+	str->limit = limit;
+
+	return 0;
+}
+
+
+int rtsp_string_grow(struct rtsp_string *str, size_t size)
+{
+	int ret;
+	void *data;
+	size_t capacity;
+
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+
+	if (size <= str->max_len)
+		return 0;
+	if (str->buf == NULL || size > str->limit)
+		return -ENOBUFS;
+
+	/* Geometric growth, bounded by the limit */
+	capacity = (str->max_len > 0) ? str->max_len : size;
+	while (capacity < size)
+		capacity *= 2;
+	if (capacity > str->limit)
+		capacity = str->limit;
+
+	ret = pomp_buffer_ensure_capacity(str->buf, capacity);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_ensure_capacity", -ret);
+		return ret;
+	}
+	ret = pomp_buffer_get_data(str->buf, &data, NULL, &capacity);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_get_data", -ret);
+		return ret;
+	}
+
+	str->str = data;
+	str->max_len = (capacity < str->limit) ? capacity : str->limit;
+
+	return 0;
+}
+
+
+/**
+ * String writer
+ */
+static const char s_digits[] = "0001020304050607080910111213141516171819"
+			       "2021222324252627282930313233343536373839"
+			       "4041424344454647484950515253545556575859"
+			       "6061626364656667686970717273747576777879"
+			       "8081828384858687888990919293949596979899";
+
+
+int rtsp_string_append_int(struct rtsp_string *str, int64_t val)
+{
+	char tmp[21];
+	char *p = tmp + sizeof(tmp);
+	uint64_t v = (val < 0) ? -(uint64_t)val : (uint64_t)val;
+
+	/* Digits are written backwards, two at a time */
+	while (v >= 10) {
+		unsigned int d = (v % 100) * 2;
+		v /= 100;
+		*--p = s_digits[d + 1];
+		*--p = s_digits[d];
+	}
+	if (v > 0 || p == tmp + sizeof(tmp))
+		*--p = '0' + v;
+	if (val < 0)
+		*--p = '-';
+
+	return rtsp_string_append(str, p, tmp + sizeof(tmp) - p);
+}
+
+
+int rtsp_string_append_field(struct rtsp_string *str,
+			     const char *name,
+			     size_t name_len,
+			     const char *value,
+			     size_t value_len)
+{
+	int ret;
+	char *p;
+	size_t len = name_len + 2 + value_len + 2;
+
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+
+	/* Single room check for the whole line */
+	if (str->len + len >= str->max_len) {
+		ret = rtsp_string_grow(str, str->len + len + 1);
+		if (ret < 0)
+			return ret;
+	}
+
+	p = str->str + str->len;
+	memcpy(p, name, name_len);
+	p += name_len;
+	*p++ = ':';
+	*p++ = ' ';
+	memcpy(p, value, value_len);
+	p += value_len;
+	*p++ = '\r';
+	*p++ = '\n';
+	*p = '\0';
+	str->len += len;
+
+	return 0;
+}
+
+
+int rtsp_string_append_field_int(struct rtsp_string *str,
+				 const char *name,
+				 size_t name_len,
+				 int64_t value)
+{
+	int ret;
+
+	ret = rtsp_string_append(str, name, name_len);
+	if (ret < 0)
+		return ret;
+	ret = rtsp_string_append(str, ": ", 2);
+	if (ret < 0)
+		return ret;
+	ret = rtsp_string_append_int(str, value);
+	if (ret < 0)
+		return ret;
+	return rtsp_string_append(str, RTSP_CRLF, 2);
+}
+
+
+int rtsp_header_line_set(struct rtsp_header_line *line,
+			 const struct rtsp_string *src)
+{
+	char *s;
+
+	ULOG_ERRNO_RETURN_ERR_IF(line == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(src == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(src->str == NULL, EINVAL);
+
+	s = realloc(line->str, src->len + 1);
+	if (s == NULL)
+		return -ENOMEM;
+	memcpy(s, src->str, src->len);
+	s[src->len] = '\0';
+	line->str = s;
+	line->len = src->len;
+
+	return 0;
+}
+
+
+void rtsp_header_line_clear(struct rtsp_header_line *line)
+{
+	if (line == NULL)
+		return;
+
+	free(line->str);
+	line->str = NULL;
+	line->len = 0;
+}
+
+
+int rtsp_header_ext_array_copy(const struct rtsp_header_ext *src,
+			       size_t count,
+			       struct rtsp_header_ext **dst)
+{
+	struct rtsp_header_ext *ext;
+
+	ULOG_ERRNO_RETURN_ERR_IF(src == NULL && count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst == NULL, EINVAL);
+
+	*dst = NULL;
+	if (count == 0)
+		return 0;
+
+	ext = calloc(count, sizeof(*ext));
+	if (ext == NULL)
+		return -ENOMEM;
+	for (size_t i = 0; i < count; i++) {
+		ext[i].key = xstrdup(src[i].key);
+		ext[i].value = xstrdup(src[i].value);
+		if ((src[i].key != NULL && ext[i].key == NULL) ||
+		    (src[i].value != NULL && ext[i].value == NULL)) {
+			rtsp_header_ext_array_free(ext, count);
+			return -ENOMEM;
+		}
+	}
+
+	*dst = ext;
+	return 0;
+}
+
+
+void rtsp_header_ext_array_free(struct rtsp_header_ext *ext, size_t count)
+{
+	if (ext == NULL)
+		return;
+
+	for (size_t i = 0; i < count; i++) {
+		xfree((void **)&ext[i].key);
+		xfree((void **)&ext[i].value);
+	}
+	free(ext);
+}
+
+
+int rtsp_sockaddr_to_str(const struct sockaddr *addr,
+			 uint32_t addrlen,
+			 char *str,
+			 size_t len)
+{
+	const struct sockaddr_in *addr_in;
+	const struct sockaddr_in6 *addr_in6;
+	const void *src;
+	int family;
+
+	ULOG_ERRNO_RETURN_ERR_IF(addr == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+
+	if ((addr->sa_family == AF_INET) &&
+	    (addrlen >= sizeof(struct sockaddr_in))) {
+		addr_in = (const struct sockaddr_in *)addr;
+		family = AF_INET;
+		src = &addr_in->sin_addr;
+	} else if ((addr->sa_family == AF_INET6) &&
+		   (addrlen >= sizeof(struct sockaddr_in6))) {
+		addr_in6 = (const struct sockaddr_in6 *)addr;
+		if (IN6_IS_ADDR_V4MAPPED(&addr_in6->sin6_addr)) {
+			/* IPv4 peer of a dual-stack socket */
+			family = AF_INET;
+			src = &addr_in6->sin6_addr.s6_addr[12];
+		} else {
+			family = AF_INET6;
+			src = &addr_in6->sin6_addr;
+		}
+	} else {
+		return -EAFNOSUPPORT;
+	}
+
+	if (inet_ntop(family, src, str, len) == NULL)
+		return -errno;
+
+	return 0;
+}
+
+
 /**
  * RTSP Allow header
  * see RFC 2326 chapter 12.4
@@ -660,13 +994,17 @@ int rtsp_allow_header_write(uint32_t methods, struct rtsp_string *str)
 	ULOG_ERRNO_RETURN_ERR_IF(methods == 0, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_HEADER_ALLOW ": ");
+	CHECK_FUNC(rtsp_string_append_lit,
+		   ret,
+		   return ret,
+		   str,
+		   RTSP_HEADER_ALLOW ": ");
 
 	ret = rtsp_methods_write(methods, str);
 	if (ret < 0)
 		return ret;
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_CRLF);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, RTSP_CRLF);
 
 	return ret;
 }
@@ -693,13 +1031,17 @@ int rtsp_public_header_write(uint32_t methods, struct rtsp_string *str)
 	ULOG_ERRNO_RETURN_ERR_IF(methods == 0, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_HEADER_PUBLIC ": ");
+	CHECK_FUNC(rtsp_string_append_lit,
+		   ret,
+		   return ret,
+		   str,
+		   RTSP_HEADER_PUBLIC ": ");
 
 	ret = rtsp_methods_write(methods, str);
 	if (ret < 0)
 		return ret;
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_CRLF);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, RTSP_CRLF);
 
 	return ret;
 }
@@ -937,40 +1279,37 @@ int rtsp_session_header_write(char *session_id,
 	ULOG_ERRNO_RETURN_ERR_IF(session_id[0] == '\0', EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
 
-	CHECK_FUNC(rtsp_sprintf,
+	CHECK_FUNC(rtsp_string_append_lit,
 		   ret,
 		   return ret,
 		   str,
-		   RTSP_HEADER_SESSION ": %s",
-		   session_id);
+		   RTSP_HEADER_SESSION ": ");
+	CHECK_FUNC(rtsp_string_append_str, ret, return ret, str, session_id);
 
 	if (session_timeout > 0) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_string_append_lit,
+			   ret,
+			   return ret,
+			   str,
+			   ";" RTSP_SESSION_TIMEOUT "=");
+		CHECK_FUNC(rtsp_string_append_int,
 			   ret,
 			   return ret,
 			   str,
-			   ";" RTSP_SESSION_TIMEOUT "=%d",
 			   session_timeout);
 	}
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_CRLF);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, RTSP_CRLF);
 
 	return ret;
 }
 
 
-/**
- * RTSP Session header
- * see RFC 2326 chapter 12.37
- */
-int rtsp_session_header_read(const char *str,
-			     char **session_id,
-			     unsigned int *session_timeout)
+static int session_header_read(char *str,
+			       char **session_id,
+			       unsigned int *session_timeout,
+			       bool view)
 {
-	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(session_id == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(session_timeout == NULL, EINVAL);
-
 	char *p3 = strchr(str, ';');
 	const char *timeout_str = NULL;
 
@@ -987,11 +1326,28 @@ int rtsp_session_header_read(const char *str,
 			*session_timeout = atoi(p4 + 1);
 	}
 
-	*session_id = strdup(str);
+	*session_id = view ? str : strdup(str);
 	return 0;
 }
 
 
+/**
+ * RTSP Session header
+ * see RFC 2326 chapter 12.37
+ */
+int rtsp_session_header_read(const char *str,
+			     char **session_id,
+			     unsigned int *session_timeout)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(session_id == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(session_timeout == NULL, EINVAL);
+
+	return session_header_read(
+		(char *)str, session_id, session_timeout, false);
+}
+
+
 /**
  * RTSP RTP-Info header
  * see RFC 2326 chapter 12.33
@@ -1284,6 +1640,30 @@ int rtsp_transport_header_copy(const struct rtsp_transport_header *src,
 }
 
 
+/* IPv6 addresses in the 'destination' and 'source' parameters are
+ * enclosed in brackets (RFC 2732 host syntax) */
+static const char *transport_addr_open(const char *addr)
+{
+	return ((addr[0] != '[') && (strchr(addr, ':') != NULL)) ? "[" : "";
+}
+
+
+static const char *transport_addr_close(const char *addr)
+{
+	return ((addr[0] != '[') && (strchr(addr, ':') != NULL)) ? "]" : "";
+}
+
+
+static char *transport_addr_dup(const char *addr)
+{
+	size_t len = strlen(addr);
+
+	if ((len >= 2) && (addr[0] == '[') && (addr[len - 1] == ']'))
+		return strndup(addr + 1, len - 2);
+	return strdup(addr);
+}
+
+
 /**
  * RTSP Transport header
  * see RFC 2326 chapter 12.39
@@ -1346,8 +1726,10 @@ int rtsp_transport_header_write(struct rtsp_transport_header *const *transport,
 				   ret,
 				   return ret,
 				   str,
-				   ";" RTSP_TRANSPORT_DESTINATION "=%s",
-				   trsp->destination);
+				   ";" RTSP_TRANSPORT_DESTINATION "=%s%s%s",
+				   transport_addr_open(trsp->destination),
+				   trsp->destination,
+				   transport_addr_close(trsp->destination));
 		}
 
 		/* 'source' */
@@ -1356,8 +1738,10 @@ int rtsp_transport_header_write(struct rtsp_transport_header *const *transport,
 				   ret,
 				   return ret,
 				   str,
-				   ";" RTSP_TRANSPORT_SOURCE "=%s",
-				   trsp->source);
+				   ";" RTSP_TRANSPORT_SOURCE "=%s%s%s",
+				   transport_addr_open(trsp->source),
+				   trsp->source,
+				   transport_addr_close(trsp->source));
 		}
 
 		/* 'append' */
@@ -1526,14 +1910,14 @@ static void process_transport_key_val(struct rtsp_transport_header *trsp,
 	/* 'destination' */
 	if (strcmp(key, RTSP_TRANSPORT_DESTINATION) == 0) {
 		if (val)
-			trsp->destination = strdup(val);
+			trsp->destination = transport_addr_dup(val);
 		goto out;
 	}
 
 	/* 'source' */
 	if (strcmp(key, RTSP_TRANSPORT_SOURCE) == 0) {
 		if (val)
-			trsp->source = strdup(val);
+			trsp->source = transport_addr_dup(val);
 		goto out;
 	}
 
@@ -2187,6 +2571,225 @@ error:
 }
 
 
+/* Header fields known by the parser */
+enum header_field {
+	HEADER_FIELD_UNKNOWN = 0,
+	HEADER_FIELD_ACCEPT,
+	HEADER_FIELD_ALLOW,
+	HEADER_FIELD_AUTHENTICATE,
+	HEADER_FIELD_AUTHORIZATION,
+	HEADER_FIELD_CONTENT_BASE,
+	HEADER_FIELD_CONTENT_ENCODING,
+	HEADER_FIELD_CONTENT_LANGUAGE,
+	HEADER_FIELD_CONTENT_LENGTH,
+	HEADER_FIELD_CONTENT_LOCATION,
+	HEADER_FIELD_CONTENT_TYPE,
+	HEADER_FIELD_CSEQ,
+	HEADER_FIELD_DATE,
+	HEADER_FIELD_PUBLIC,
+	HEADER_FIELD_RANGE,
+	HEADER_FIELD_RTP_INFO,
+	HEADER_FIELD_SCALE,
+	HEADER_FIELD_SERVER,
+	HEADER_FIELD_SESSION,
+	HEADER_FIELD_TRANSPORT,
+	HEADER_FIELD_USER_AGENT,
+	HEADER_FIELD_EXT,
+};
+
+
+static const char *const s_header_field_names[] = {
+	[HEADER_FIELD_ACCEPT] = RTSP_HEADER_ACCEPT,
+	[HEADER_FIELD_ALLOW] = RTSP_HEADER_ALLOW,
+	[HEADER_FIELD_AUTHENTICATE] = RTSP_HEADER_AUTHENTICATE,
+	[HEADER_FIELD_AUTHORIZATION] = RTSP_HEADER_AUTHORIZATION,
+	[HEADER_FIELD_CONTENT_BASE] = RTSP_HEADER_CONTENT_BASE,
+	[HEADER_FIELD_CONTENT_ENCODING] = RTSP_HEADER_CONTENT_ENCODING,
+	[HEADER_FIELD_CONTENT_LANGUAGE] = RTSP_HEADER_CONTENT_LANGUAGE,
+	[HEADER_FIELD_CONTENT_LENGTH] = RTSP_HEADER_CONTENT_LENGTH,
+	[HEADER_FIELD_CONTENT_LOCATION] = RTSP_HEADER_CONTENT_LOCATION,
+	[HEADER_FIELD_CONTENT_TYPE] = RTSP_HEADER_CONTENT_TYPE,
+	[HEADER_FIELD_CSEQ] = RTSP_HEADER_CSEQ,
+	[HEADER_FIELD_DATE] = RTSP_HEADER_DATE,
+	[HEADER_FIELD_PUBLIC] = RTSP_HEADER_PUBLIC,
+	[HEADER_FIELD_RANGE] = RTSP_HEADER_RANGE,
+	[HEADER_FIELD_RTP_INFO] = RTSP_HEADER_RTP_INFO,
+	[HEADER_FIELD_SCALE] = RTSP_HEADER_SCALE,
+	[HEADER_FIELD_SERVER] = RTSP_HEADER_SERVER,
+	[HEADER_FIELD_SESSION] = RTSP_HEADER_SESSION,
+	[HEADER_FIELD_TRANSPORT] = RTSP_HEADER_TRANSPORT,
+	[HEADER_FIELD_USER_AGENT] = RTSP_HEADER_USER_AGENT,
+};
+
+
+/* Identify a header field name (case-insensitive, exact match): the
+ * candidate is selected by the name length and one or two characters,
+ * then the whole name is compared once */
+static enum header_field header_field_lookup(const char *name, size_t len)
+{
+	enum header_field field = HEADER_FIELD_UNKNOWN;
+	int c;
+
+	if (len == 0)
+		return HEADER_FIELD_UNKNOWN;
+	c = tolower((unsigned char)name[0]);
+
+	switch (len) {
+	case 4:
+		if (c == 'c')
+			field = HEADER_FIELD_CSEQ;
+		else if (c == 'd')
+			field = HEADER_FIELD_DATE;
+		break;
+	case 5:
+		if (c == 'a')
+			field = HEADER_FIELD_ALLOW;
+		else if (c == 'r')
+			field = HEADER_FIELD_RANGE;
+		else if (c == 's')
+			field = HEADER_FIELD_SCALE;
+		break;
+	case 6:
+		if (c == 'a')
+			field = HEADER_FIELD_ACCEPT;
+		else if (c == 'p')
+			field = HEADER_FIELD_PUBLIC;
+		else if (c == 's')
+			field = HEADER_FIELD_SERVER;
+		break;
+	case 7:
+		if (c == 's')
+			field = HEADER_FIELD_SESSION;
+		break;
+	case 8:
+		field = HEADER_FIELD_RTP_INFO;
+		break;
+	case 9:
+		field = HEADER_FIELD_TRANSPORT;
+		break;
+	case 10:
+		if (c == 'u')
+			field = HEADER_FIELD_USER_AGENT;
+		break;
+	case 12:
+		/* 'Content-Base', 'Content-Type' */
+		if (tolower((unsigned char)name[8]) == 'b')
+			field = HEADER_FIELD_CONTENT_BASE;
+		else if (tolower((unsigned char)name[8]) == 't')
+			field = HEADER_FIELD_CONTENT_TYPE;
+		break;
+	case 13:
+		if (c == 'a')
+			field = HEADER_FIELD_AUTHORIZATION;
+		break;
+	case 14:
+		field = HEADER_FIELD_CONTENT_LENGTH;
+		break;
+	case 16:
+		/* 'WWW-Authenticate', 'Content-Encoding', 'Content-Language',
+		 * 'Content-Location' */
+		if (c == 'w')
+			field = HEADER_FIELD_AUTHENTICATE;
+		else if (tolower((unsigned char)name[9]) == 'n')
+			field = HEADER_FIELD_CONTENT_ENCODING;
+		else if (tolower((unsigned char)name[9]) == 'a')
+			field = HEADER_FIELD_CONTENT_LANGUAGE;
+		else if (tolower((unsigned char)name[9]) == 'o')
+			field = HEADER_FIELD_CONTENT_LOCATION;
+		break;
+	default:
+		break;
+	}
+
+	if ((field != HEADER_FIELD_UNKNOWN) &&
+	    (strncasecmp(name, s_header_field_names[field], len) == 0))
+		return field;
+
+	/* 'X-*' header extension */
+	if ((len > strlen(RTSP_HEADER_EXT)) &&
+	    (strncasecmp(name, RTSP_HEADER_EXT, strlen(RTSP_HEADER_EXT)) == 0))
+		return HEADER_FIELD_EXT;
+
+	return HEADER_FIELD_UNKNOWN;
+}
+
+
+/* Split a header line into its field name (with its length, without
+ * trailing whitespace) and value; returns false if there is no ':' */
+static bool header_line_split(char *line,
+			      char **field,
+			      size_t *field_len,
+			      char **value)
+{
+	char *sep;
+	size_t len;
+
+	sep = strchr(line, ':');
+	if (sep == NULL)
+		return false;
+
+	*sep = '\0';
+	len = sep - line;
+	while ((len > 0) && ((line[len - 1] == ' ') || (line[len - 1] == '\t')))
+		line[--len] = '\0';
+	*field = line;
+	*field_len = len;
+	*value = sep + 1;
+	if (**value == ' ')
+		(*value)++;
+
+	return true;
+}
+
+
+/* In view mode, string fields point into the parsed data (which is
+ * modified in place) instead of being duplicated */
+static inline char *header_field_value(char *value, bool view)
+{
+	return view ? value : strdup(value);
+}
+
+
+/* Add an 'X-*' header extension; in view mode, the array storage is owned
+ * by the parser context and reused from one message to the next */
+static int header_ext_add(struct rtsp_header_ext **ext,
+			  size_t *ext_count,
+			  char *key,
+			  char *value,
+			  struct rtsp_message_parser_ctx *view)
+{
+	struct rtsp_header_ext *tmp;
+
+	if (view == NULL) {
+		tmp = realloc(*ext,
+			      (*ext_count + 1) *
+				      sizeof(struct rtsp_header_ext));
+		if (tmp == NULL)
+			return -ENOMEM;
+		*ext = tmp;
+		(*ext)[*ext_count].key = strdup(key);
+		(*ext)[*ext_count].value = strdup(value);
+		*ext_count += 1;
+		return 0;
+	}
+
+	if (*ext_count >= view->ext_capacity) {
+		size_t capacity =
+			(view->ext_capacity == 0) ? 4 : view->ext_capacity * 2;
+		tmp = realloc(view->ext, capacity * sizeof(*tmp));
+		if (tmp == NULL)
+			return -ENOMEM;
+		view->ext = tmp;
+		view->ext_capacity = capacity;
+	}
+	*ext = view->ext;
+	(*ext)[*ext_count].key = key;
+	(*ext)[*ext_count].value = value;
+	*ext_count += 1;
+	return 0;
+}
+
+
 /**
  * RTSP Request
  * see RFC 2326 chapter 6
@@ -2195,7 +2798,17 @@ int rtsp_request_header_clear(struct rtsp_request_header *header)
 {
 	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
 
+	if (header->is_view) {
+		/* Only the sub-headers are owned */
+		for (unsigned int i = 0; i < header->transport_count; i++)
+			rtsp_transport_header_free(&header->transport[i]);
+		rtsp_authorization_header_free(&header->authorization);
+		memset(header, 0, sizeof(*header));
+		return 0;
+	}
+
 	xfree((void **)&header->uri);
+	xfree((void **)&header->date_str);
 	xfree((void **)&header->session_id);
 	for (unsigned int i = 0; i < header->transport_count; i++)
 		rtsp_transport_header_free(&header->transport[i]);
@@ -2231,6 +2844,7 @@ int rtsp_request_header_copy(const struct rtsp_request_header *src,
 	dst->uri = xstrdup(src->uri);
 	dst->cseq = src->cseq;
 	dst->date = src->date;
+	dst->date_str = xstrdup(src->date_str);
 	dst->session_id = xstrdup(src->session_id);
 	dst->session_timeout = src->session_timeout;
 	for (unsigned int i = 0; i < src->transport_count; i++) {
@@ -2311,21 +2925,22 @@ int rtsp_request_header_write(const struct rtsp_request_header *header,
 	ULOG_ERRNO_RETURN_ERR_IF(strcmp(method, "UNKNOWN") == 0, EINVAL);
 
 	/* Request line */
-	CHECK_FUNC(rtsp_sprintf,
+	CHECK_FUNC(rtsp_string_append_str, ret, return ret, str, method);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, " ");
+	CHECK_FUNC(rtsp_string_append_str, ret, return ret, str, header->uri);
+	CHECK_FUNC(rtsp_string_append_lit,
 		   ret,
 		   return ret,
 		   str,
-		   "%s %s " RTSP_VERSION RTSP_CRLF,
-		   method,
-		   header->uri);
+		   " " RTSP_VERSION RTSP_CRLF);
 
 	/* 'CSeq' */
 	if (header->cseq >= 0) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_int,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CSEQ ": %d" RTSP_CRLF,
+			   RTSP_HEADER_CSEQ,
 			   header->cseq);
 	}
 
@@ -2341,11 +2956,11 @@ int rtsp_request_header_write(const struct rtsp_request_header *header,
 			ULOG_ERRNO("time_local_format", -ret);
 			return ret;
 		}
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_DATE ": %s" RTSP_CRLF,
+			   RTSP_HEADER_DATE,
 			   time_str);
 	}
 
@@ -2376,11 +2991,11 @@ int rtsp_request_header_write(const struct rtsp_request_header *header,
 	/* 'Content-Type' */
 	if ((header->content_type != NULL) &&
 	    (header->content_type[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_TYPE ": %s" RTSP_CRLF,
+			   RTSP_HEADER_CONTENT_TYPE,
 			   header->content_type);
 	}
 
@@ -2396,31 +3011,31 @@ int rtsp_request_header_write(const struct rtsp_request_header *header,
 
 	/* 'User-Agent' */
 	if ((header->user_agent != NULL) && (header->user_agent[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_USER_AGENT ": %s" RTSP_CRLF,
+			   RTSP_HEADER_USER_AGENT,
 			   header->user_agent);
 	}
 
 	/* 'Server' */
 	if ((header->server != NULL) && (header->server[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_SERVER ": %s" RTSP_CRLF,
+			   RTSP_HEADER_SERVER,
 			   header->server);
 	}
 
 	/* 'Accept' */
 	if ((header->accept != NULL) && (header->accept[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_ACCEPT ": %s" RTSP_CRLF,
+			   RTSP_HEADER_ACCEPT,
 			   header->accept);
 	}
 
@@ -2433,39 +3048,37 @@ int rtsp_request_header_write(const struct rtsp_request_header *header,
 
 	/* 'Content-Length' */
 	if (header->content_length > 0) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_int,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_LENGTH ": %d" RTSP_CRLF,
+			   RTSP_HEADER_CONTENT_LENGTH,
 			   header->content_length);
 	}
 
 	/* Header extensions */
 	for (size_t i = 0; i < header->ext_count; i++) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_string_append_field,
 			   ret,
 			   return ret,
 			   str,
-			   "%s: %s" RTSP_CRLF,
 			   header->ext[i].key,
-			   header->ext[i].value);
+			   strlen(header->ext[i].key),
+			   header->ext[i].value,
+			   strlen(header->ext[i].value));
 	}
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_CRLF);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, RTSP_CRLF);
 
 	return ret;
 }
 
 
-/**
- * RTSP Request
- * see RFC 2326 chapter 6
- */
-int rtsp_request_header_read(char *str,
-			     size_t len,
-			     struct rtsp_request_header *header,
-			     char **body)
+static int request_header_read(char *str,
+			       size_t len,
+			       struct rtsp_request_header *header,
+			       char **body,
+			       struct rtsp_message_parser_ctx *view)
 {
 	int ret;
 	char *p;
@@ -2476,10 +3089,8 @@ int rtsp_request_header_read(char *str,
 	const char *version;
 	size_t nl_len;
 
-	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
-
 	rtsp_request_header_clear(header);
+	header->is_view = (view != NULL);
 
 	/* Find the body (double line terminator) */
 	if (body)
@@ -2516,7 +3127,7 @@ int rtsp_request_header_read(char *str,
 		ULOGE("%s: invalid URI", __func__);
 		return -EPROTO;
 	}
-	header->uri = strdup(uri);
+	header->uri = header_field_value((char *)uri, header->is_view);
 
 	if ((version == NULL) || (strcmp(version, RTSP_VERSION) != 0)) {
 		ULOGE("%s: invalid RTSP protocol version", __func__);
@@ -2525,141 +3136,103 @@ int rtsp_request_header_read(char *str,
 
 	p = strtok_r(NULL, RTSP_CRLF, &temp);
 	while (p) {
-		const char *field;
+		char *field;
+		size_t field_len;
 		char *value;
-		char *p2;
-
-		p2 = strchr(p, ':');
-		if (p2) {
-			*p2 = '\0';
-			field = p;
-			value = p2 + 1;
-			if (*value == ' ')
-				value++;
-
-			if (!strncasecmp(field,
-					 RTSP_HEADER_CSEQ,
-					 strlen(RTSP_HEADER_CSEQ))) {
-				/* 'CSeq' */
-				header->cseq = atoi(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_DATE,
-						strlen(RTSP_HEADER_DATE))) {
-				/* 'Date' */
-				uint64_t epoch_sec = 0;
-				int32_t utc_offset_sec = 0;
-				ret = time_local_parse(
-					value, &epoch_sec, &utc_offset_sec);
-				if (ret < 0) {
-					ULOG_ERRNO("time_local_parse", -ret);
-					return ret;
-				}
-				header->date = epoch_sec;
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_SESSION,
-						strlen(RTSP_HEADER_SESSION))) {
-				/* 'Session' */
-				ret = rtsp_session_header_read(
-					value,
-					&header->session_id,
-					&header->session_timeout);
-				if (ret < 0)
-					return ret;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_TRANSPORT,
-					   strlen(RTSP_HEADER_TRANSPORT))) {
-				/* 'Transport' */
-				ret = rtsp_transport_header_read(
-					value,
-					header->transport,
-					RTSP_TRANSPORT_MAX_COUNT,
-					&header->transport_count);
-				if ((ret < 0) || (header->transport_count == 0))
-					return ret;
+		if (!header_line_split(p, &field, &field_len, &value))
+			goto next;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_CONTENT_TYPE,
-					   strlen(RTSP_HEADER_CONTENT_TYPE))) {
-				/* 'Content-Type' */
-				header->content_type = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_SCALE,
-						strlen(RTSP_HEADER_SCALE))) {
-				/* 'Scale' */
-				header->scale = atof(value);
+		switch (header_field_lookup(field, field_len)) {
+		case HEADER_FIELD_CSEQ:
+			header->cseq = atoi(value);
+			break;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_AUTHORIZATION,
-					   strlen(RTSP_HEADER_AUTHORIZATION))) {
-				/* 'Authorization' */
-				ret = rtsp_authorization_header_read(
-					str, &header->authorization);
-				if (ret < 0)
-					return ret;
+		case HEADER_FIELD_DATE:
+			/* Parsed on demand */
+			if (!header->is_view)
+				free(header->date_str);
+			header->date_str =
+				header_field_value(value, header->is_view);
+			break;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_USER_AGENT,
-					   strlen(RTSP_HEADER_USER_AGENT))) {
-				/* 'User-Agent' */
+		case HEADER_FIELD_SESSION:
+			ret = session_header_read(value,
+						  &header->session_id,
+						  &header->session_timeout,
+						  header->is_view);
+			if (ret < 0)
+				return ret;
+			break;
+
+		case HEADER_FIELD_TRANSPORT:
+			ret = rtsp_transport_header_read(
+				value,
+				header->transport,
+				RTSP_TRANSPORT_MAX_COUNT,
+				&header->transport_count);
+			if ((ret < 0) || (header->transport_count == 0))
+				return ret;
+			break;
+
+		case HEADER_FIELD_CONTENT_TYPE:
+			header->content_type =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_SCALE:
+			header->scale = atof(value);
+			break;
+
+		case HEADER_FIELD_AUTHORIZATION:
+			ret = rtsp_authorization_header_read(
+				str, &header->authorization);
+			if (ret < 0)
+				return ret;
+			break;
+
+		case HEADER_FIELD_USER_AGENT:
+			if (!header->is_view)
 				free(header->user_agent);
-				header->user_agent = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_SERVER,
-						strlen(RTSP_HEADER_SERVER))) {
-				/* 'Server' */
-				header->server = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_ACCEPT,
-						strlen(RTSP_HEADER_ACCEPT))) {
-				/* 'Accept' */
-				header->accept = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_RANGE,
-						strlen(RTSP_HEADER_RANGE))) {
-				/* 'Range' */
-				ret = rtsp_range_header_read(value,
-							     &header->range);
-				if (ret < 0)
-					return ret;
+			header->user_agent =
+				header_field_value(value, header->is_view);
+			break;
 
-			} else if (
-				!strncasecmp(
-					field,
-					RTSP_HEADER_CONTENT_LENGTH,
-					strlen(RTSP_HEADER_CONTENT_LENGTH))) {
-				/* 'Content-Length' */
-				header->content_length = atoi(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_EXT,
-						strlen(RTSP_HEADER_EXT))) {
-				/* 'X-*' header extension */
-				struct rtsp_header_ext *tmp = realloc(
-					header->ext,
-					(header->ext_count + 1) *
-						sizeof(struct rtsp_header_ext));
-				if (tmp == NULL)
-					return -ENOMEM;
-				header->ext = tmp;
-				header->ext[header->ext_count].key =
-					strdup(field);
-				header->ext[header->ext_count].value =
-					strdup(value);
-				header->ext_count += 1;
-			}
+		case HEADER_FIELD_SERVER:
+			header->server =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_ACCEPT:
+			header->accept =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_RANGE:
+			ret = rtsp_range_header_read(value, &header->range);
+			if (ret < 0)
+				return ret;
+			break;
+
+		case HEADER_FIELD_CONTENT_LENGTH:
+			header->content_length = atoi(value);
+			break;
+
+		case HEADER_FIELD_EXT:
+			ret = header_ext_add(&header->ext,
+					     &header->ext_count,
+					     field,
+					     value,
+					     view);
+			if (ret < 0)
+				return ret;
+			break;
+
+		default:
+			break;
 		}
 
+next:
 		p = strtok_r(NULL, RTSP_CRLF, &temp);
 	}
 
@@ -2667,6 +3240,58 @@ int rtsp_request_header_read(char *str,
 }
 
 
+/**
+ * RTSP Request
+ * see RFC 2326 chapter 6
+ */
+int rtsp_request_header_read(char *str,
+			     size_t len,
+			     struct rtsp_request_header *header,
+			     char **body)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+
+	return request_header_read(str, len, header, body, NULL);
+}
+
+
+/* Get the date of a header: the date to write if set, otherwise the
+ * received 'Date' value, which is only parsed here */
+static int header_date_get(uint64_t date, const char *date_str, uint64_t *ret)
+{
+	int err;
+	uint64_t epoch_sec = 0;
+	int32_t utc_offset_sec = 0;
+
+	if (date > 0) {
+		*ret = date;
+		return 0;
+	}
+	if ((date_str == NULL) || (date_str[0] == '\0'))
+		return -ENOENT;
+
+	err = time_local_parse(date_str, &epoch_sec, &utc_offset_sec);
+	if (err < 0) {
+		ULOG_ERRNO("time_local_parse", -err);
+		return err;
+	}
+	*ret = epoch_sec;
+
+	return 0;
+}
+
+
+int rtsp_request_header_get_date(const struct rtsp_request_header *header,
+				 uint64_t *date)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(date == NULL, EINVAL);
+
+	return header_date_get(header->date, header->date_str, date);
+}
+
+
 /**
  * RTSP Response
  * see RFC 2326 chapter 7
@@ -2675,7 +3300,18 @@ int rtsp_response_header_clear(struct rtsp_response_header *header)
 {
 	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
 
+	if (header->is_view) {
+		/* Only the sub-headers are owned */
+		rtsp_transport_header_free(&header->transport);
+		rtsp_authorization_header_free(&header->authenticate);
+		for (unsigned int i = 0; i < header->rtp_info_count; i++)
+			rtsp_rtp_info_header_free(&header->rtp_info[i]);
+		memset(header, 0, sizeof(*header));
+		return 0;
+	}
+
 	xfree((void **)&header->status_string);
+	xfree((void **)&header->date_str);
 	xfree((void **)&header->session_id);
 	rtsp_transport_header_free(&header->transport);
 	rtsp_authorization_header_free(&header->authenticate);
@@ -2714,6 +3350,7 @@ int rtsp_response_header_copy(const struct rtsp_response_header *src,
 	dst->status_string = xstrdup(src->status_string);
 	dst->cseq = src->cseq;
 	dst->date = src->date;
+	dst->date_str = xstrdup(src->date_str);
 	dst->session_id = xstrdup(src->session_id);
 	dst->session_timeout = src->session_timeout;
 	if (src->transport) {
@@ -2788,82 +3425,223 @@ int rtsp_response_header_copy_ext(struct rtsp_response_header *header,
 
 
 /**
- * RTSP Response
- * see RFC 2326 chapter 7
+ * RTSP Status line
+ * see RFC 2326 chapter 7.1
  */
-int rtsp_response_header_write(const struct rtsp_response_header *header,
-			       struct rtsp_string *str)
+int rtsp_status_line_write(int status_code,
+			   const char *status_string,
+			   struct rtsp_string *str)
 {
 	int ret;
 
-	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(status_code == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(status_string == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(status_string[0] == '\0', EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(header->status_code == 0, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(header->status_string == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(header->status_string[0] == '\0', EINVAL);
 
-	/* Status line */
-	CHECK_FUNC(rtsp_sprintf,
+	CHECK_FUNC(rtsp_string_append_lit,
 		   ret,
 		   return ret,
 		   str,
-		   RTSP_VERSION " %d %s" RTSP_CRLF,
-		   header->status_code,
-		   header->status_string);
+		   RTSP_VERSION " ");
+	CHECK_FUNC(rtsp_string_append_int, ret, return ret, str, status_code);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, " ");
+	CHECK_FUNC(
+		rtsp_string_append_str, ret, return ret, str, status_string);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, RTSP_CRLF);
 
-	/* 'CSeq' */
-	if (header->cseq >= 0) {
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   RTSP_HEADER_CSEQ ": %d" RTSP_CRLF,
-			   header->cseq);
-	}
+	return 0;
+}
 
-	/* 'Date' */
-	if (header->date > 0) {
-		char time_str[32];
-		ret = time_local_format(header->date,
-					0,
-					TIME_FMT_RFC1123,
-					time_str,
-					sizeof(time_str));
-		if (ret < 0) {
-			ULOG_ERRNO("time_local_format", -ret);
-			return ret;
-		}
-		CHECK_FUNC(rtsp_sprintf,
-			   ret,
-			   return ret,
-			   str,
-			   RTSP_HEADER_DATE ": %s" RTSP_CRLF,
-			   time_str);
-	}
 
-	/* 'Session' */
-	if ((header->session_id != NULL) && (header->session_id[0] != '\0')) {
-		ret = rtsp_session_header_write(
-			header->session_id, header->session_timeout, str);
-		if (ret < 0)
-			return ret;
-	}
+/**
+ * RTSP Date header
+ * see RFC 2326 chapter 12.18
+ */
+int rtsp_date_header_write(uint64_t date, struct rtsp_string *str)
+{
+	int ret;
+	char time_str[32];
 
-	/* 'Transport' */
-	if (header->transport != NULL) {
-		ret = rtsp_transport_header_write(&header->transport, 1, str);
-		if (ret < 0)
-			return ret;
-	}
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
 
-	/* 'Content-Type' */
-	if ((header->content_type != NULL) &&
-	    (header->content_type[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+	ret = time_local_format(
+		date, 0, TIME_FMT_RFC1123, time_str, sizeof(time_str));
+	if (ret < 0) {
+		ULOG_ERRNO("time_local_format", -ret);
+		return ret;
+	}
+	CHECK_FUNC(rtsp_header_field_write_str,
+		   ret,
+		   return ret,
+		   str,
+		   RTSP_HEADER_DATE,
+		   time_str);
+
+	return 0;
+}
+
+
+uint64_t rtsp_date_cache_now(struct rtsp_date_cache *cache)
+{
+	int ret;
+	uint64_t date = 0;
+	int32_t utc_offset_sec = 0;
+	char data[64];
+	struct rtsp_string str;
+
+	ULOG_ERRNO_RETURN_VAL_IF(cache == NULL, EINVAL, 0);
+
+	ret = time_local_get(&date, &utc_offset_sec);
+	if (ret < 0) {
+		ULOG_ERRNO("time_local_get", -ret);
+		return 0;
+	}
+
+	if ((date == cache->date) && (cache->line.str != NULL))
+		return date;
+
+	/* New second: render the line again; on failure the 'Date' header
+	 * is formatted from the date when writing the message */
+	memset(&str, 0, sizeof(str));
+	str.str = data;
+	str.max_len = sizeof(data);
+	ret = rtsp_date_header_write(date, &str);
+	if (ret < 0)
+		return date;
+	ret = rtsp_header_line_set(&cache->line, &str);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_header_line_set", -ret);
+		return date;
+	}
+	cache->date = date;
+
+	return date;
+}
+
+
+const struct rtsp_header_line *
+rtsp_date_cache_line(const struct rtsp_date_cache *cache, uint64_t date)
+{
+	if ((cache == NULL) || (date == 0) || (date != cache->date) ||
+	    (cache->line.str == NULL))
+		return NULL;
+
+	return &cache->line;
+}
+
+
+void rtsp_date_cache_clear(struct rtsp_date_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	rtsp_header_line_clear(&cache->line);
+	cache->date = 0;
+}
+
+
+/**
+ * RTSP Response
+ * see RFC 2326 chapter 7
+ */
+int rtsp_response_header_write(const struct rtsp_response_header *header,
+			       struct rtsp_string *str)
+{
+	return rtsp_response_header_write_lines(header, NULL, str);
+}
+
+
+int rtsp_response_header_write_lines(const struct rtsp_response_header *header,
+				     const struct rtsp_response_lines *lines,
+				     struct rtsp_string *str)
+{
+	int ret;
+	static const struct rtsp_response_lines no_lines;
+
+	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+
+	if (lines == NULL)
+		lines = &no_lines;
+
+	/* Status line */
+	if (lines->status != NULL) {
+		CHECK_FUNC(rtsp_string_append,
+			   ret,
+			   return ret,
+			   str,
+			   lines->status->str,
+			   lines->status->len);
+	} else {
+		ret = rtsp_status_line_write(
+			header->status_code, header->status_string, str);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* 'CSeq' */
+	if (header->cseq >= 0) {
+		CHECK_FUNC(rtsp_header_field_write_int,
+			   ret,
+			   return ret,
+			   str,
+			   RTSP_HEADER_CSEQ,
+			   header->cseq);
+	}
+
+	/* 'Date' */
+	if (lines->date != NULL) {
+		CHECK_FUNC(rtsp_string_append,
+			   ret,
+			   return ret,
+			   str,
+			   lines->date->str,
+			   lines->date->len);
+	} else if (header->date > 0) {
+		ret = rtsp_date_header_write(header->date, str);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* 'Session' */
+	if (lines->session != NULL) {
+		CHECK_FUNC(rtsp_string_append,
+			   ret,
+			   return ret,
+			   str,
+			   lines->session->str,
+			   lines->session->len);
+	} else if ((header->session_id != NULL) &&
+		   (header->session_id[0] != '\0')) {
+		ret = rtsp_session_header_write(
+			header->session_id, header->session_timeout, str);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* 'Transport' */
+	if (header->transport != NULL) {
+		ret = rtsp_transport_header_write(&header->transport, 1, str);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* 'Content-Type' */
+	if (lines->content_type != NULL) {
+		CHECK_FUNC(rtsp_string_append,
+			   ret,
+			   return ret,
+			   str,
+			   lines->content_type->str,
+			   lines->content_type->len);
+	} else if ((header->content_type != NULL) &&
+		   (header->content_type[0] != '\0')) {
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_TYPE ": %s" RTSP_CRLF,
+			   RTSP_HEADER_CONTENT_TYPE,
 			   header->content_type);
 	}
 
@@ -2878,7 +3656,14 @@ int rtsp_response_header_write(const struct rtsp_response_header *header,
 	}
 
 	/* 'Public' */
-	if (header->public_methods > 0) {
+	if (lines->public_methods != NULL) {
+		CHECK_FUNC(rtsp_string_append,
+			   ret,
+			   return ret,
+			   str,
+			   lines->public_methods->str,
+			   lines->public_methods->len);
+	} else if (header->public_methods > 0) {
 		ret = rtsp_public_header_write(header->public_methods, str);
 		if (ret < 0)
 			return ret;
@@ -2900,12 +3685,19 @@ int rtsp_response_header_write(const struct rtsp_response_header *header,
 	}
 
 	/* 'Server' */
-	if ((header->server != NULL) && (header->server[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+	if (lines->server != NULL) {
+		CHECK_FUNC(rtsp_string_append,
+			   ret,
+			   return ret,
+			   str,
+			   lines->server->str,
+			   lines->server->len);
+	} else if ((header->server != NULL) && (header->server[0] != '\0')) {
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_SERVER ": %s" RTSP_CRLF,
+			   RTSP_HEADER_SERVER,
 			   header->server);
 	}
 
@@ -2917,82 +3709,87 @@ int rtsp_response_header_write(const struct rtsp_response_header *header,
 	}
 
 	/* 'Content-Length' */
-	CHECK_FUNC(rtsp_sprintf,
+	CHECK_FUNC(rtsp_header_field_write_int,
 		   ret,
 		   return ret,
 		   str,
-		   RTSP_HEADER_CONTENT_LENGTH ": %d" RTSP_CRLF,
+		   RTSP_HEADER_CONTENT_LENGTH,
 		   header->content_length);
 
 	/* 'Content-Encoding' */
 	if ((header->content_encoding != NULL) &&
 	    (header->content_encoding[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_ENCODING ": %s" RTSP_CRLF,
+			   RTSP_HEADER_CONTENT_ENCODING,
 			   header->content_encoding);
 	}
 
 	/* 'Content-Language' */
 	if ((header->content_language != NULL) &&
 	    (header->content_language[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_LANGUAGE ": %s" RTSP_CRLF,
+			   RTSP_HEADER_CONTENT_LANGUAGE,
 			   header->content_language);
 	}
 
 	/* 'Content-Base' */
-	if ((header->content_base != NULL) &&
-	    (header->content_base[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+	if (lines->content_base != NULL) {
+		CHECK_FUNC(rtsp_string_append,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_BASE ": %s" RTSP_CRLF,
+			   lines->content_base->str,
+			   lines->content_base->len);
+	} else if ((header->content_base != NULL) &&
+		   (header->content_base[0] != '\0')) {
+		CHECK_FUNC(rtsp_header_field_write_str,
+			   ret,
+			   return ret,
+			   str,
+			   RTSP_HEADER_CONTENT_BASE,
 			   header->content_base);
 	}
 
 	/* 'Content-Location' */
 	if ((header->content_location != NULL) &&
 	    (header->content_location[0] != '\0')) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_header_field_write_str,
 			   ret,
 			   return ret,
 			   str,
-			   RTSP_HEADER_CONTENT_LOCATION ": %s" RTSP_CRLF,
+			   RTSP_HEADER_CONTENT_LOCATION,
 			   header->content_location);
 	}
 
 	/* Header extensions */
 	for (size_t i = 0; i < header->ext_count; i++) {
-		CHECK_FUNC(rtsp_sprintf,
+		CHECK_FUNC(rtsp_string_append_field,
 			   ret,
 			   return ret,
 			   str,
-			   "%s: %s" RTSP_CRLF,
 			   header->ext[i].key,
-			   header->ext[i].value);
+			   strlen(header->ext[i].key),
+			   header->ext[i].value,
+			   strlen(header->ext[i].value));
 	}
 
-	CHECK_FUNC(rtsp_sprintf, ret, return ret, str, RTSP_CRLF);
+	CHECK_FUNC(rtsp_string_append_lit, ret, return ret, str, RTSP_CRLF);
 
 	return ret;
 }
 
 
-/**
- * RTSP Response
- * see RFC 2326 chapter 7
- */
-int rtsp_response_header_read(char *msg,
-			      size_t len,
-			      struct rtsp_response_header *header,
-			      char **body)
+static int response_header_read(char *msg,
+				size_t len,
+				struct rtsp_response_header *header,
+				char **body,
+				struct rtsp_message_parser_ctx *view)
 {
 	int ret;
 	char *p;
@@ -3003,10 +3800,8 @@ int rtsp_response_header_read(char *msg,
 	const char *status_string;
 	size_t nl_len;
 
-	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
-
 	rtsp_response_header_clear(header);
+	header->is_view = (view != NULL);
 
 	/* Find the body (double line terminator) */
 	if (body)
@@ -3042,193 +3837,139 @@ int rtsp_response_header_read(char *msg,
 		return -EPROTO;
 	}
 	header->status_code = atoi(status_code_str);
-	header->status_string = strdup(status_string);
+	header->status_string =
+		header_field_value((char *)status_string, header->is_view);
 
 	p = strtok_r(NULL, RTSP_CRLF, &temp);
 	while (p) {
-		const char *field;
+		char *field;
+		size_t field_len;
 		char *value;
-		char *p2;
-
-		p2 = strchr(p, ':');
-		if (p2) {
-			*p2 = '\0';
-			field = p;
-			value = p2 + 1;
-			if (*value == ' ')
-				value++;
-
-			if (!strncasecmp(field,
-					 RTSP_HEADER_CSEQ,
-					 strlen(RTSP_HEADER_CSEQ))) {
-				/* 'CSeq' */
-				header->cseq = atoi(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_DATE,
-						strlen(RTSP_HEADER_DATE))) {
-				/* 'Date' */
-				uint64_t epoch_sec = 0;
-				int32_t utc_offset_sec = 0;
-				ret = time_local_parse(
-					value, &epoch_sec, &utc_offset_sec);
-				if (ret < 0) {
-					ULOG_ERRNO("time_local_parse", -ret);
-					return ret;
-				}
-				header->date = epoch_sec;
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_SESSION,
-						strlen(RTSP_HEADER_SESSION))) {
-				/* 'Session' */
-				ret = rtsp_session_header_read(
-					value,
-					&header->session_id,
-					&header->session_timeout);
-				if (ret < 0)
-					return ret;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_TRANSPORT,
-					   strlen(RTSP_HEADER_TRANSPORT))) {
-				/* 'Transport' */
-				unsigned int transport_count = 0;
-				ret = rtsp_transport_header_read(
-					value,
-					&header->transport,
-					1,
-					&transport_count);
-				if ((ret < 0) || (transport_count == 0))
-					return ret;
+		if (!header_line_split(p, &field, &field_len, &value))
+			goto next;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_AUTHENTICATE,
-					   strlen(RTSP_HEADER_AUTHENTICATE))) {
-				/* 'WWW-Authenticate' */
-				ret = rtsp_authorization_header_read(
-					value, &header->authenticate);
-				if (ret < 0)
-					return ret;
+		switch (header_field_lookup(field, field_len)) {
+		case HEADER_FIELD_CSEQ:
+			header->cseq = atoi(value);
+			break;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_CONTENT_TYPE,
-					   strlen(RTSP_HEADER_CONTENT_TYPE))) {
-				/* 'Content-Type' */
-				header->content_type = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_SCALE,
-						strlen(RTSP_HEADER_SCALE))) {
-				/* 'Scale' */
-				header->scale = atof(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_PUBLIC,
-						strlen(RTSP_HEADER_PUBLIC))) {
-				/* 'Public' */
-				ret = rtsp_public_header_read(
-					value, &header->public_methods);
-				if (ret < 0)
-					return ret;
+		case HEADER_FIELD_DATE:
+			/* Parsed on demand */
+			if (!header->is_view)
+				free(header->date_str);
+			header->date_str =
+				header_field_value(value, header->is_view);
+			break;
 
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_ALLOW,
-						strlen(RTSP_HEADER_ALLOW))) {
-				/* 'Allow' */
-				ret = rtsp_allow_header_read(
-					value, &header->allowed_methods);
-				if (ret < 0)
-					return ret;
+		case HEADER_FIELD_SESSION:
+			ret = session_header_read(value,
+						  &header->session_id,
+						  &header->session_timeout,
+						  header->is_view);
+			if (ret < 0)
+				return ret;
+			break;
 
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_RTP_INFO,
-						strlen(RTSP_HEADER_RTP_INFO))) {
-				/* 'RTP-Info' */
-				ret = rtsp_rtp_info_header_read(
-					value,
-					header->rtp_info,
-					1,
-					&header->rtp_info_count);
-				if ((ret < 0) || (header->rtp_info_count == 0))
-					return ret;
+		case HEADER_FIELD_TRANSPORT: {
+			unsigned int transport_count = 0;
+			ret = rtsp_transport_header_read(
+				value, &header->transport, 1, &transport_count);
+			if ((ret < 0) || (transport_count == 0))
+				return ret;
+			break;
+		}
 
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_SERVER,
-						strlen(RTSP_HEADER_SERVER))) {
-				/* 'Server' */
-				header->server = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_RANGE,
-						strlen(RTSP_HEADER_RANGE))) {
-				/* 'Range' */
-				ret = rtsp_range_header_read(value,
-							     &header->range);
-				if (ret < 0)
-					return ret;
+		case HEADER_FIELD_AUTHENTICATE:
+			ret = rtsp_authorization_header_read(
+				value, &header->authenticate);
+			if (ret < 0)
+				return ret;
+			break;
 
-			} else if (
-				!strncasecmp(
-					field,
-					RTSP_HEADER_CONTENT_LENGTH,
-					strlen(RTSP_HEADER_CONTENT_LENGTH))) {
-				/* 'Content-Length' */
-				header->content_length = atoi(value);
-
-			} else if (
-				!strncasecmp(
-					field,
-					RTSP_HEADER_CONTENT_ENCODING,
-					strlen(RTSP_HEADER_CONTENT_ENCODING))) {
-				/* 'Content-Encoding' */
-				header->content_encoding = strdup(value);
-
-			} else if (
-				!strncasecmp(
-					field,
-					RTSP_HEADER_CONTENT_LANGUAGE,
-					strlen(RTSP_HEADER_CONTENT_LANGUAGE))) {
-				/* 'Content-Language' */
-				header->content_language = strdup(value);
+		case HEADER_FIELD_CONTENT_TYPE:
+			header->content_type =
+				header_field_value(value, header->is_view);
+			break;
 
-			} else if (!strncasecmp(
-					   field,
-					   RTSP_HEADER_CONTENT_BASE,
-					   strlen(RTSP_HEADER_CONTENT_BASE))) {
-				/* 'Content-Base' */
-				header->content_base = strdup(value);
-
-			} else if (
-				!strncasecmp(
-					field,
-					RTSP_HEADER_CONTENT_LOCATION,
-					strlen(RTSP_HEADER_CONTENT_LOCATION))) {
-				/* 'Content-Location' */
-				header->content_location = strdup(value);
-
-			} else if (!strncasecmp(field,
-						RTSP_HEADER_EXT,
-						strlen(RTSP_HEADER_EXT))) {
-				/* 'X-*' header extension */
-				struct rtsp_header_ext *tmp = realloc(
-					header->ext,
-					(header->ext_count + 1) *
-						sizeof(struct rtsp_header_ext));
-				if (tmp == NULL)
-					return -ENOMEM;
-				header->ext = tmp;
-				header->ext[header->ext_count].key =
-					strdup(field);
-				header->ext[header->ext_count].value =
-					strdup(value);
-				header->ext_count += 1;
-			}
+		case HEADER_FIELD_SCALE:
+			header->scale = atof(value);
+			break;
+
+		case HEADER_FIELD_PUBLIC:
+			ret = rtsp_public_header_read(value,
+						      &header->public_methods);
+			if (ret < 0)
+				return ret;
+			break;
+
+		case HEADER_FIELD_ALLOW:
+			ret = rtsp_allow_header_read(value,
+						     &header->allowed_methods);
+			if (ret < 0)
+				return ret;
+			break;
+
+		case HEADER_FIELD_RTP_INFO:
+			ret = rtsp_rtp_info_header_read(
+				value,
+				header->rtp_info,
+				1,
+				&header->rtp_info_count);
+			if ((ret < 0) || (header->rtp_info_count == 0))
+				return ret;
+			break;
+
+		case HEADER_FIELD_SERVER:
+			header->server =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_RANGE:
+			ret = rtsp_range_header_read(value, &header->range);
+			if (ret < 0)
+				return ret;
+			break;
+
+		case HEADER_FIELD_CONTENT_LENGTH:
+			header->content_length = atoi(value);
+			break;
+
+		case HEADER_FIELD_CONTENT_ENCODING:
+			header->content_encoding =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_CONTENT_LANGUAGE:
+			header->content_language =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_CONTENT_BASE:
+			header->content_base =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_CONTENT_LOCATION:
+			header->content_location =
+				header_field_value(value, header->is_view);
+			break;
+
+		case HEADER_FIELD_EXT:
+			ret = header_ext_add(&header->ext,
+					     &header->ext_count,
+					     field,
+					     value,
+					     view);
+			if (ret < 0)
+				return ret;
+			break;
+
+		default:
+			break;
 		}
 
+next:
 		p = strtok_r(NULL, RTSP_CRLF, &temp);
 	}
 
@@ -3236,6 +3977,32 @@ int rtsp_response_header_read(char *msg,
 }
 
 
+/**
+ * RTSP Response
+ * see RFC 2326 chapter 7
+ */
+int rtsp_response_header_read(char *msg,
+			      size_t len,
+			      struct rtsp_response_header *header,
+			      char **body)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+
+	return response_header_read(msg, len, header, body, NULL);
+}
+
+
+int rtsp_response_header_get_date(const struct rtsp_response_header *header,
+				  uint64_t *date)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(date == NULL, EINVAL);
+
+	return header_date_get(header->date, header->date_str, date);
+}
+
+
 void rtsp_buffer_remove_first_bytes(struct pomp_buffer *buffer, size_t count)
 {
 	int ret;
@@ -3292,33 +4059,113 @@ void rtsp_message_clear(struct rtsp_message *msg)
 }
 
 
-static int rtsp_parse_interleaved(const void *raw_data,
-				  size_t len,
-				  struct rtsp_message *msg)
+static int interleaved_parse(const void *raw_data,
+			     size_t len,
+			     struct rtsp_interleaved_info *info,
+			     size_t *total_len)
 {
 	const uint8_t *p = raw_data;
 	uint16_t pkt_len;
 
-	if (len < 4 || p[0] != 0x24)
+	if (len == 0 || p[0] != 0x24)
 		return -EINVAL;
 
+	/* The header itself may be received in several pieces */
+	if (len < 4)
+		return -EAGAIN;
+
 	memcpy(&pkt_len, p + 2, sizeof(pkt_len));
 	pkt_len = ntohs(pkt_len);
 
 	if (len < 4U + pkt_len)
 		return -EAGAIN;
 
-	msg->type = RTSP_MESSAGE_TYPE_INTERLEAVED;
-	msg->interleaved.channel = p[1];
-	msg->interleaved.data = p + 4;
-	msg->interleaved.len = pkt_len;
+	info->channel = p[1];
+	info->data = p + 4;
+	info->len = pkt_len;
+
+	*total_len = 4U + pkt_len;
+
+	return 0;
+}
+
 
-	msg->total_len = 4U + pkt_len;
+static int rtsp_parse_interleaved(const void *raw_data,
+				  size_t len,
+				  struct rtsp_message *msg)
+{
+	int ret;
+
+	ret = interleaved_parse(
+		raw_data, len, &msg->interleaved, &msg->total_len);
+	if (ret < 0)
+		return ret;
+
+	msg->type = RTSP_MESSAGE_TYPE_INTERLEAVED;
 
 	return 0;
 }
 
 
+/**
+ * Fast path for RTP/RTCP interleaved data: gets the interleaved packet
+ * starting off bytes after the parser head, without running the RTSP
+ * message parser. Returns -EINVAL if the data at this offset is not an
+ * interleaved packet (e.g. an RTSP message, to be read with
+ * rtsp_get_next_message()) and -EAGAIN if the packet is not complete.
+ * On success, pkt_len is the size of the packet including its header.
+ * The packet data points into the buffer and is valid until the bytes
+ * are consumed.
+ */
+int rtsp_get_next_interleaved(const struct pomp_buffer *data,
+			      const struct rtsp_message_parser_ctx *ctx,
+			      size_t off,
+			      struct rtsp_interleaved_info *info,
+			      size_t *pkt_len)
+{
+	int ret;
+	const uint8_t *raw_data;
+	size_t len;
+
+	ULOG_ERRNO_RETURN_ERR_IF(data == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(info == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(pkt_len == NULL, EINVAL);
+
+	/* An RTSP message is being received */
+	if (ctx->header_len != 0 || ctx->scan_offset != 0)
+		return -EINVAL;
+
+	ret = pomp_buffer_get_cdata(data, (const void **)&raw_data, &len, NULL);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_get_cdata", -ret);
+		return ret;
+	}
+	if (ctx->head + off > len)
+		return -EINVAL;
+
+	return interleaved_parse(raw_data + ctx->head + off,
+				 len - ctx->head - off,
+				 info,
+				 pkt_len);
+}
+
+
+/**
+ * Write the 4-byte RTSP interleaved header:
+ *   0x24 | channel | payload length (big-endian 16-bit)
+ */
+void rtsp_interleaved_header_write(uint8_t channel,
+				   uint16_t len,
+				   uint8_t header[RTSP_INTERLEAVED_HEADER_LEN])
+{
+	header[0] = 0x24;
+	header[1] = channel;
+	header[2] = (uint8_t)(len >> 8);
+	header[3] = (uint8_t)(len & 0xff);
+}
+
+
 /**
  * Build an RTSP interleaved packet in a pomp_buffer.
  *
@@ -3339,9 +4186,8 @@ int rtsp_build_interleaved(const struct rtsp_interleaved_info *info,
 	int res;
 	uint8_t *buf_data;
 	uint16_t total_len;
-	uint16_t nlen;
 	struct pomp_buffer *pomp_buf = NULL;
-	uint8_t header[4] = {};
+	uint8_t header[RTSP_INTERLEAVED_HEADER_LEN] = {};
 
 	ULOG_ERRNO_RETURN_ERR_IF(info == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(info->channel > UINT8_MAX, EINVAL);
@@ -3365,13 +4211,8 @@ int rtsp_build_interleaved(const struct rtsp_interleaved_info *info,
 		goto error;
 	}
 
-	nlen = htons(info->len);
-
 	/* Build header */
-	header[0] = 0x24;
-	header[1] = info->channel;
-	header[2] = ((uint8_t *)&nlen)[0];
-	header[3] = ((uint8_t *)&nlen)[1];
+	rtsp_interleaved_header_write(info->channel, info->len, header);
 
 	/* Copy payload */
 	memcpy(buf_data, header, sizeof(header));
@@ -3393,6 +4234,150 @@ error:
 }
 
 
+/* Find the 'Content-Length' value in a complete header without modifying
+ * it, so that the header is parsed only once the whole message (including
+ * the body) has been received */
+static int content_length_scan(const char *s, size_t len, size_t *body_len)
+{
+	const size_t name_len = strlen(RTSP_HEADER_CONTENT_LENGTH);
+	const char *end = s + len;
+	const char *line = s;
+	int value = 0;
+
+	while (line < end) {
+		const char *eol = memchr(line, '\n', end - line);
+		const char *cr = memchr(line, '\r', (eol ? eol : end) - line);
+		const char *p;
+		if (cr != NULL)
+			eol = cr;
+		else if (eol == NULL)
+			eol = end;
+
+		if ((size_t)(eol - line) > name_len &&
+		    strncasecmp(line, RTSP_HEADER_CONTENT_LENGTH, name_len) ==
+			    0) {
+			/* Exact field name, as in header_field_lookup() */
+			p = line + name_len;
+			while (p < eol && (*p == ' ' || *p == '\t'))
+				p++;
+			if (p < eol && *p == ':') {
+				p++;
+				while (p < eol && (*p == ' ' || *p == '\t'))
+					p++;
+				value = 0;
+				while (p < eol && *p >= '0' && *p <= '9') {
+					if (value > (INT_MAX - 9) / 10)
+						return -EPROTO;
+					value = value * 10 + (*p - '0');
+					p++;
+				}
+			}
+		}
+		line = eol + 1;
+	}
+
+	*body_len = value;
+	return 0;
+}
+
+
+int rtsp_message_parser_append_data(struct rtsp_message_parser_ctx *ctx,
+				    struct pomp_buffer *buffer,
+				    const void *data,
+				    size_t len)
+{
+	int ret;
+	uint8_t *buf_data;
+	size_t buf_len, capacity, rem;
+
+	ULOG_ERRNO_RETURN_ERR_IF(ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buffer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(data == NULL && len > 0, EINVAL);
+
+	ret = pomp_buffer_get_data(
+		buffer, (void **)&buf_data, &buf_len, &capacity);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_get_data", -ret);
+		return ret;
+	}
+
+	/* Move the unconsumed bytes to the front of the buffer only when
+	 * there is not enough room left at the end for the new data */
+	if (ctx->head > 0 && capacity - buf_len < len) {
+		rem = buf_len - ctx->head;
+		if (rem > 0)
+			memmove(buf_data, &buf_data[ctx->head], rem);
+		ret = pomp_buffer_set_len(buffer, rem);
+		if (ret < 0) {
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+			return ret;
+		}
+		ctx->head = 0;
+	}
+
+	ret = pomp_buffer_append_data(buffer, data, len);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_append_data", -ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+
+void rtsp_message_parser_consume(struct rtsp_message_parser_ctx *ctx,
+				 struct pomp_buffer *buffer,
+				 size_t count)
+{
+	int ret;
+	size_t len;
+
+	ULOG_ERRNO_RETURN_IF(ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(buffer == NULL, EINVAL);
+
+	if (count == 0)
+		return;
+
+	ret = pomp_buffer_get_cdata(buffer, NULL, &len, NULL);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_get_cdata", -ret);
+		return;
+	}
+
+	if (count > len - ctx->head) {
+		ULOGE("%s: trying to consume %zu bytes from a "
+		      "buffer containing only %zu bytes",
+		      __func__,
+		      count,
+		      len - ctx->head);
+		count = len - ctx->head;
+	}
+
+	/* Only advance the head; the buffer is reset for free once all
+	 * the data has been consumed. The end of header search restarts
+	 * at the new head. */
+	ctx->head += count;
+	ctx->scan_offset = 0;
+	ctx->scan_state = 0;
+	if (ctx->head == len) {
+		ret = pomp_buffer_set_len(buffer, 0);
+		if (ret < 0)
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+		ctx->head = 0;
+	}
+}
+
+
+void rtsp_message_parser_ctx_clear(struct rtsp_message_parser_ctx *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	free(ctx->ext);
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+
 /**
  * Reads the next header (+optional body) from data
  * If no header is found, or if the body is not complete, returns -EAGAIN.
@@ -3401,6 +4386,13 @@ error:
  * return code. This can be used to skip a bad header.
  * If the return code is zero, then msg contains information about a
  * complete request/response, depending on its "type" field.
+ * The header is parsed in place: the string fields of msg point into the
+ * data buffer (which is modified) and are only valid until the message
+ * bytes are removed from the buffer or the next call; use
+ * rtsp_request_header_copy() or rtsp_response_header_copy() to keep them.
+ * Parsing starts at the parser head: the bytes of a message should be
+ * removed with rtsp_message_parser_consume() and new data added with
+ * rtsp_message_parser_append_data().
  */
 int rtsp_get_next_message(const struct pomp_buffer *data,
 			  struct rtsp_message *msg,
@@ -3408,9 +4400,8 @@ int rtsp_get_next_message(const struct pomp_buffer *data,
 {
 	int ret;
 	void *raw_data;
-	const char *header_end;
 	size_t len;
-	size_t nl_len;
+	size_t header_len;
 
 	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
 	rtsp_message_clear(msg);
@@ -3425,6 +4416,14 @@ int rtsp_get_next_message(const struct pomp_buffer *data,
 		return ret;
 	}
 
+	/* Skip the bytes already consumed (see rtsp_message_parser_consume) */
+	if (ctx->head > len) {
+		ULOGE("%s: invalid parser head", __func__);
+		return -EPROTO;
+	}
+	raw_data = (uint8_t *)raw_data + ctx->head;
+	len -= ctx->head;
+
 	/* Detect RTP/RTCP interleaved packet (RFC 2326, section 10.12) */
 	ret = rtsp_parse_interleaved(raw_data, len, msg);
 	if (ret == 0)
@@ -3447,64 +4446,60 @@ int rtsp_get_next_message(const struct pomp_buffer *data,
 	 * DESCRIBE, etc.). We reset ret to 0 to avoid propagating -EINVAL. */
 	ret = 0;
 
-	if (ctx->msg.type == RTSP_MESSAGE_TYPE_UNKNOWN) {
-		/* Search for first double newline: end of header */
-		header_end = find_double_newline(raw_data, len, &nl_len);
-		if (!header_end)
+	if (ctx->header_len == 0) {
+		/* Search for first double newline: end of header; the
+		 * search resumes where the previous call stopped */
+		if (!header_end_scan(raw_data,
+				     len,
+				     &ctx->scan_offset,
+				     &ctx->scan_state,
+				     &ctx->header_len,
+				     NULL))
 			return -EAGAIN;
 
-		ctx->header_len = header_end - (char *)raw_data + nl_len;
-
-		/* Check if it is a request or a response */
-		if (ctx->header_len >= strlen(RTSP_VERSION) &&
-		    strncmp(raw_data, RTSP_VERSION, strlen(RTSP_VERSION)) == 0)
-			ctx->msg.type = RTSP_MESSAGE_TYPE_RESPONSE;
-		else
-			ctx->msg.type = RTSP_MESSAGE_TYPE_REQUEST;
-
-		/* Try to parse the request or response */
-		if (ctx->msg.type == RTSP_MESSAGE_TYPE_REQUEST) {
-			ret = rtsp_request_header_read(raw_data,
-						       ctx->header_len,
-						       &ctx->msg.header.req,
-						       NULL);
-			if (ret < 0)
-				ULOG_ERRNO("rtsp_request_header_read", -ret);
-			ctx->msg.body_len = ctx->msg.header.req.content_length;
-		} else {
-			ret = rtsp_response_header_read(raw_data,
-							ctx->header_len,
-							&ctx->msg.header.resp,
-							NULL);
-			if (ret < 0)
-				ULOG_ERRNO("rtsp_response_header_read", -ret);
-			ctx->msg.body_len = ctx->msg.header.resp.content_length;
-		}
+		ret = content_length_scan(
+			raw_data, ctx->header_len, &ctx->body_len);
 		if (ret < 0) {
-			rtsp_message_clear(&ctx->msg);
+			ULOGE("%s: invalid content length", __func__);
 			msg->total_len = ctx->header_len;
+			ctx->header_len = 0;
 			return ret;
 		}
 	}
 
-	ctx->msg.total_len = ctx->msg.body_len + ctx->header_len;
-	if (len < ctx->msg.total_len)
+	if (len < ctx->header_len + ctx->body_len)
 		return -EAGAIN;
 
-	if (ctx->msg.type == RTSP_MESSAGE_TYPE_REQUEST)
-		rtsp_request_header_copy(&ctx->msg.header.req,
-					 &msg->header.req);
-	else
-		rtsp_response_header_copy(&ctx->msg.header.resp,
-					  &msg->header.resp);
-	msg->type = ctx->msg.type;
-	/* Pointer to the pomp_buffer must be set only when the message is
-	 * complete to avoid pointer invalidation due to pomp_buffer realloc */
-	msg->body = (char *)raw_data + ctx->header_len;
-	msg->body_len = ctx->msg.body_len;
-	msg->total_len = ctx->msg.total_len;
-
-	rtsp_message_clear(&ctx->msg);
+	/* The message is complete: parse it in place, only once */
+	header_len = ctx->header_len;
+	msg->total_len = header_len + ctx->body_len;
+	ctx->header_len = 0;
+	ctx->body_len = 0;
+
+	/* Check if it is a request or a response */
+	if (header_len >= strlen(RTSP_VERSION) &&
+	    strncmp(raw_data, RTSP_VERSION, strlen(RTSP_VERSION)) == 0) {
+		msg->type = RTSP_MESSAGE_TYPE_RESPONSE;
+		ret = response_header_read(
+			raw_data, header_len, &msg->header.resp, NULL, ctx);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_response_header_read", -ret);
+	} else {
+		msg->type = RTSP_MESSAGE_TYPE_REQUEST;
+		ret = request_header_read(
+			raw_data, header_len, &msg->header.req, NULL, ctx);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_request_header_read", -ret);
+	}
+	if (ret < 0) {
+		size_t total_len = msg->total_len;
+		rtsp_message_clear(msg);
+		msg->total_len = total_len;
+		return ret;
+	}
+
+	msg->body = (char *)raw_data + header_len;
+	msg->body_len = msg->total_len - header_len;
 
 	return 0;
 }
@@ -164,7 +164,7 @@ tskt_client_socket_upgrade_cb(struct tskt_client *ctx,
 }
 
 
-static char *make_uri(struct rtsp_client *client, const char *path)
+char *rtsp_client_make_uri(struct rtsp_client *client, const char *path)
 {
 	char *tmp;
 	int ret;
@@ -277,35 +277,228 @@ static void set_connection_state(struct rtsp_client *client,
 }
 
 
+/* Keep the unsent part of the data (starting at offset off) to send it
+ * before anything else when the socket becomes writable again */
+static int tx_pending_add(struct rtsp_client *client,
+			  const struct iovec *iov,
+			  size_t iov_count,
+			  size_t off)
+{
+	int res;
+
+	if (client->tx.pending == NULL) {
+		client->tx.pending = pomp_buffer_new(PIPE_BUF - 1);
+		if (client->tx.pending == NULL) {
+			res = -ENOMEM;
+			ULOG_ERRNO("pomp_buffer_new", -res);
+			return res;
+		}
+	}
+
+	for (size_t i = 0; i < iov_count; i++) {
+		if (off >= iov[i].iov_len) {
+			off -= iov[i].iov_len;
+			continue;
+		}
+		res = pomp_buffer_append_data(client->tx.pending,
+					      (const uint8_t *)iov[i].iov_base +
+						      off,
+					      iov[i].iov_len - off);
+		if (res < 0) {
+			ULOG_ERRNO("pomp_buffer_append_data", -res);
+			return res;
+		}
+		off = 0;
+	}
+
+	res = tskt_socket_update_events(client->sock, POMP_FD_EVENT_OUT, 0);
+	if (res < 0)
+		ULOG_ERRNO("tskt_socket_update_events", -res);
+
+	return 0;
+}
+
+
+static inline bool tx_pending_is_empty(struct rtsp_client *client)
+{
+	size_t len = 0;
+
+	if (client->tx.pending == NULL)
+		return true;
+	(void)pomp_buffer_get_cdata(client->tx.pending, NULL, &len, NULL);
+	return (len == 0);
+}
+
+
+/* Write data to the socket in a single gathered write; if the data is
+ * only partially written, the rest is kept and sent first on the next
+ * writable event, so the caller never has to deal with partial messages.
+ * Returns the number of bytes accepted (always either 0 or the total
+ * length) or -EAGAIN if nothing could be written */
+static ssize_t tx_writev(struct rtsp_client *client,
+			 const struct iovec *iov,
+			 size_t iov_count,
+			 size_t total_len)
+{
+	int res;
+	ssize_t written;
+
+	if (!tx_pending_is_empty(client))
+		return -EAGAIN;
+
+	written = tskt_socket_writev(client->sock, iov, iov_count);
+	if (written == -EAGAIN) {
+		res = tskt_socket_update_events(
+			client->sock, POMP_FD_EVENT_OUT, 0);
+		if (res < 0)
+			ULOG_ERRNO("tskt_socket_update_events", -res);
+		return -EAGAIN;
+	} else if (written < 0) {
+		ULOG_ERRNO("tskt_socket_writev", (int)-written);
+		return written;
+	}
+
+	if ((size_t)written < total_len) {
+		res = tx_pending_add(client, iov, iov_count, written);
+		if (res < 0)
+			return res;
+	}
+
+	return total_len;
+}
+
+
+/* Flush the data kept after a partial write; returns -EAGAIN if the
+ * data could not be fully written */
+static int tx_flush(struct rtsp_client *client)
+{
+	int res;
+	ssize_t written;
+	const uint8_t *data;
+	size_t len;
+
+	if (tx_pending_is_empty(client) || client->sock == NULL)
+		return 0;
+
+	res = pomp_buffer_get_cdata(
+		client->tx.pending, (const void **)&data, &len, NULL);
+	if (res < 0) {
+		ULOG_ERRNO("pomp_buffer_get_cdata", -res);
+		return res;
+	}
+
+	written = tskt_socket_write(client->sock,
+				    data + client->tx.pending_off,
+				    len - client->tx.pending_off);
+	if (written < 0) {
+		if (written != -EAGAIN)
+			ULOG_ERRNO("tskt_socket_write", (int)-written);
+		else
+			(void)tskt_socket_update_events(
+				client->sock, POMP_FD_EVENT_OUT, 0);
+		return written;
+	}
+
+	client->tx.pending_off += written;
+	if (client->tx.pending_off < len) {
+		(void)tskt_socket_update_events(
+			client->sock, POMP_FD_EVENT_OUT, 0);
+		return -EAGAIN;
+	}
+
+	client->tx.pending_off = 0;
+	res = pomp_buffer_set_len(client->tx.pending, 0);
+	if (res < 0)
+		ULOG_ERRNO("pomp_buffer_set_len", -res);
+	return 0;
+}
+
+
+static void tx_reset(struct rtsp_client *client)
+{
+	client->tx.pending_off = 0;
+	if (client->tx.pending != NULL)
+		(void)pomp_buffer_set_len(client->tx.pending, 0);
+}
+
+
 static int send_raw_buf(struct rtsp_client *client, struct pomp_buffer *buf)
 {
 	int res;
-	struct tpkt_packet *pkt = NULL;
+	ssize_t written;
+	const void *data;
+	size_t len;
+	struct iovec iov;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(client->sock == NULL, EPROTO);
 
-	res = tpkt_new_from_buffer(buf, &pkt);
+	res = pomp_buffer_get_cdata(buf, &data, &len, NULL);
 	if (res < 0) {
-		ULOG_ERRNO("tpkt_new_from_buffer", -res);
+		ULOG_ERRNO("pomp_buffer_get_cdata", -res);
 		return res;
 	}
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+
+	/* Send the message; RTSP messages are never dropped: if the socket
+	 * is busy, they are queued behind the pending data */
+	written = tx_writev(client, &iov, 1, len);
+	if (written == -EAGAIN)
+		return tx_pending_add(client, &iov, 1, 0);
+	else if (written < 0)
+		return written;
 
-	/* Send the request */
-	res = tskt_client_send_pkt(client->tclient, pkt);
-	if (res < 0) {
-		(void)tpkt_unref(pkt);
-		if (res != -EAGAIN)
-			ULOG_ERRNO("tskt_client_send_pkt", -res);
-		return res;
-	}
-	(void)tpkt_unref(pkt);
 	return 0;
 }
 
 
+/* Get the in-flight table entry of the next CSeq, or NULL if the
+ * request still using it has not completed yet */
+static struct rtsp_client_request *request_slot_get(struct rtsp_client *client)
+{
+	struct rtsp_client_request *req;
+
+	req = &client->request.slots[client->cseq % RTSP_CLIENT_MAX_INFLIGHT];
+	if (req->is_pending)
+		return NULL;
+
+	rtsp_request_header_clear(&req->header);
+	xfree((void **)&req->content_base);
+	req->cbs = NULL;
+	req->userdata = NULL;
+	req->is_internal = 0;
+	req->header.cseq = client->cseq;
+	return req;
+}
+
+
+/* Mark a request as in flight, once sent by send_request() */
+static void request_commit(struct rtsp_client *client,
+			   struct rtsp_client_request *req)
+{
+	req->is_pending = 1;
+	client->request.count++;
+	client->cseq++;
+}
+
+
+static struct rtsp_client_request *request_find(struct rtsp_client *client,
+						unsigned int cseq)
+{
+	struct rtsp_client_request *req;
+
+	req = &client->request.slots[cseq % RTSP_CLIENT_MAX_INFLIGHT];
+	if (!req->is_pending || ((unsigned int)req->header.cseq != cseq))
+		return NULL;
+
+	return req;
+}
+
+
 static int send_request(struct rtsp_client *client,
+			struct rtsp_client_request *req,
 			const char *content,
 			unsigned int timeout_ms)
 {
@@ -313,24 +506,22 @@ static int send_request(struct rtsp_client *client,
 	struct rtsp_string request = {};
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(req == NULL, EINVAL);
 
 	ULOGI("send RTSP request %s: cseq=%d session=%s",
-	      rtsp_method_type_str(client->request.header.method),
-	      client->request.header.cseq,
-	      client->request.header.session_id
-		      ? client->request.header.session_id
-		      : "-");
-
-	res = pomp_buffer_get_data(client->request.buf,
-				   (void **)&request.str,
-				   NULL,
-				   &request.max_len);
+	      rtsp_method_type_str(req->header.method),
+	      req->header.cseq,
+	      req->header.session_id ? req->header.session_id : "-");
+
+	/* The request buffer grows as needed up to max_msg_size */
+	res = rtsp_string_init(
+		&request, client->request.buf, client->max_msg_size);
 	if (res < 0) {
-		ULOG_ERRNO("pomp_buffer_get_data", -res);
+		ULOG_ERRNO("rtsp_string_init", -res);
 		return res;
 	}
 
-	res = rtsp_request_header_write(&client->request.header, &request);
+	res = rtsp_request_header_write(&req->header, &request);
 	if (res < 0) {
 		ULOG_ERRNO("rtsp_request_header_write", -res);
 		return res;
@@ -359,39 +550,20 @@ static int send_request(struct rtsp_client *client,
 		return res;
 	}
 
+	/* The request is on the wire: its CSeq must not be reused, even if
+	 * the response timeout cannot be armed */
+	request_commit(client, req);
+
 	/* Set a timer for response timeout */
 	if (timeout_ms > 0) {
-		res = pomp_timer_set(client->request.timer, timeout_ms);
-		if (res < 0) {
+		res = pomp_timer_set(req->timer, timeout_ms);
+		if (res < 0)
 			ULOG_ERRNO("pomp_timer_set", -res);
-			return res;
-		}
 	}
 
 	return 0;
 }
 
-static int clear_pending_keep_alive_timer(struct rtsp_client *client)
-{
-	const struct rtsp_client_session *session;
-
-	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
-
-	list_walk_entry_forward(&client->sessions, session, node)
-	{
-		if (!session->keep_alive_in_progress)
-			continue;
-
-		/* Clear the response timeout timer related to
-		 * keep alive */
-		int err = pomp_timer_clear(client->request.timer);
-		if (err < 0)
-			ULOG_ERRNO("pomp_timer_clear", -err);
-		return 1;
-	}
-
-	return 0;
-}
 
 static int reset_keep_alive_timer(struct rtsp_client_session *session,
 				  int timer_msec)
@@ -417,7 +589,8 @@ static int reset_keep_alive_timer(struct rtsp_client_session *session,
 }
 
 
-static int generate_authorization_header(struct rtsp_client *client)
+static int generate_authorization_header(struct rtsp_client *client,
+					 struct rtsp_request_header *header)
 {
 	int ret;
 	const char *pass = NULL;
@@ -431,8 +604,7 @@ static int generate_authorization_header(struct rtsp_client *client)
 	    client->auth->nonce == NULL)
 		return -EAGAIN;
 
-	ULOG_ERRNO_RETURN_ERR_IF(client->request.header.authorization != NULL,
-				 EEXIST);
+	ULOG_ERRNO_RETURN_ERR_IF(header->authorization != NULL, EEXIST);
 
 	pass = rtsp_url_get_pass(client->remote.url);
 	if (!pass)
@@ -457,9 +629,9 @@ static int generate_authorization_header(struct rtsp_client *client)
 		}
 		break;
 	case RTSP_AUTH_TYPE_DIGEST:
-		dup_field(&auth->uri, client->request.header.uri);
+		dup_field(&auth->uri, header->uri);
 		ret = rtsp_auth_generate_digest_response(
-			auth, pass, client->request.header.method);
+			auth, pass, header->method);
 		if (ret < 0) {
 			ULOG_ERRNO("rtsp_auth_generate_digest_response", -ret);
 			goto error;
@@ -476,7 +648,7 @@ static int generate_authorization_header(struct rtsp_client *client)
 	/* Update client->auth fields like nc, cnonce, etc. */
 	rtsp_authorization_header_copy_client_fields(auth, client->auth);
 
-	client->request.header.authorization = auth;
+	header->authorization = auth;
 	return 0;
 
 error:
@@ -490,6 +662,7 @@ static int send_keep_alive(struct rtsp_client *client,
 			   unsigned int timeout_ms)
 {
 	int res = 0;
+	struct rtsp_client_request *req;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(session == NULL, EINVAL);
@@ -525,33 +698,30 @@ static int send_keep_alive(struct rtsp_client *client,
 	if (session->keep_alive_in_progress)
 		return -EBUSY;
 
-	/* Another request is pending, retry later */
-	if (client->request.is_pending) {
+	/* Too many requests in flight, retry later */
+	req = request_slot_get(client);
+	if (req == NULL) {
 		reset_keep_alive_timer(session, session->timeout_ms / 2);
 		return -EBUSY;
 	}
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.header.method = RTSP_METHOD_TYPE_GET_PARAMETER;
-	client->request.header.uri = xstrdup(session->content_base);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	req->header.method = RTSP_METHOD_TYPE_GET_PARAMETER;
+	req->header.uri = xstrdup(session->content_base);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.session_id = xstrdup(session->id);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.session_id = xstrdup(session->id);
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
 	session->keep_alive_in_progress = 1;
-	client->request.is_pending = 1;
-	client->cseq++;
 
 	return 0;
 }
@@ -583,7 +753,7 @@ static int send_teardown(struct rtsp_client *client,
 			 int internal)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 	struct rtsp_client_session *session;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
@@ -596,13 +766,9 @@ static int send_teardown(struct rtsp_client *client,
 
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	/* If there is a pending request that is not a keep alive, remain in
-	 * busy state */
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Make sure that we know the session */
@@ -613,43 +779,38 @@ static int send_teardown(struct rtsp_client *client,
 	}
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_TEARDOWN;
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_TEARDOWN;
 
 	if (resource_url != NULL) {
 		res = format_request_uri(client,
 					 session->content_base,
 					 resource_url,
-					 &client->request.header.uri);
+					 &req->header.uri);
 		if (res < 0)
 			return res;
 	} else {
-		client->request.header.uri = xstrdup(session->content_base);
+		req->header.uri = xstrdup(session->content_base);
 	}
 
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.session_id = xstrdup(session_id);
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.session_id = xstrdup(session_id);
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
 	session->internal_teardown = internal;
-	client->request.is_internal = internal;
-	client->request.is_pending = 1;
-	client->cseq++;
+	req->is_internal = internal;
 	return 0;
 }
 
@@ -709,6 +870,7 @@ update_interleaved_channels(struct rtsp_client *client,
 
 
 static void setup_request_complete(struct rtsp_client *client,
+				   const struct rtsp_client_cbs *cbs,
 				   struct rtsp_client_session *session,
 				   const char *session_id,
 				   const char *req_uri,
@@ -738,7 +900,7 @@ static void setup_request_complete(struct rtsp_client *client,
 			update_interleaved_channels(
 				client, req_channels, &ret_channels);
 		}
-		(*client->cbs.setup_resp)(
+		(*cbs->setup_resp)(
 			client,
 			session_id,
 			status,
@@ -768,7 +930,7 @@ static void setup_request_complete(struct rtsp_client *client,
 			set_channel_pair_used(
 				client->channel_used, req_channels, false);
 		}
-		(*client->cbs.setup_resp)(
+		(*cbs->setup_resp)(
 			client,
 			session_id,
 			status,
@@ -789,6 +951,7 @@ out:
 
 
 static void play_request_complete(struct rtsp_client *client,
+				  const struct rtsp_client_cbs *cbs,
 				  const char *session_id,
 				  enum rtsp_client_req_status status,
 				  int status_code,
@@ -805,49 +968,51 @@ static void play_request_complete(struct rtsp_client *client,
 	const struct rtsp_rtp_info_header *rtp_info;
 
 	if (status != RTSP_CLIENT_REQ_STATUS_OK) {
-		(*client->cbs.play_resp)(client,
-					 session_id,
-					 status,
-					 rtsp_status_to_errno(status_code),
-					 NULL,
-					 0.0,
-					 0,
-					 0,
-					 0,
-					 0,
-					 NULL,
-					 0,
-					 client->cbs_userdata,
-					 req_userdata);
+		(*cbs->play_resp)(client,
+				  session_id,
+				  status,
+				  rtsp_status_to_errno(status_code),
+				  NULL,
+				  0.0,
+				  0,
+				  0,
+				  0,
+				  0,
+				  NULL,
+				  0,
+				  client->cbs_userdata,
+				  req_userdata);
 		return;
 	}
 
 	rtp_info = (resp_h->rtp_info_count == 0) ? &rtp_info_default
 						 : resp_h->rtp_info[0];
-	(*client->cbs.play_resp)(client,
-				 session_id,
-				 status,
-				 rtsp_status_to_errno(status_code),
-				 &resp_h->range,
-				 resp_h->scale,
-				 rtp_info->seq_valid,
-				 rtp_info->seq,
-				 rtp_info->rtptime_valid,
-				 rtp_info->rtptime,
-				 resp_h->ext,
-				 resp_h->ext_count,
-				 client->cbs_userdata,
-				 req_userdata);
+	(*cbs->play_resp)(client,
+			  session_id,
+			  status,
+			  rtsp_status_to_errno(status_code),
+			  &resp_h->range,
+			  resp_h->scale,
+			  rtp_info->seq_valid,
+			  rtp_info->seq,
+			  rtp_info->rtptime_valid,
+			  rtp_info->rtptime,
+			  resp_h->ext,
+			  resp_h->ext_count,
+			  client->cbs_userdata,
+			  req_userdata);
 }
 
 
 static void teardown_request_complete(struct rtsp_client *client,
+				      const struct rtsp_client_cbs *cbs,
 				      struct rtsp_client_session *session,
 				      const char *session_id,
 				      const char *req_uri,
 				      enum rtsp_client_req_status status,
 				      const struct rtsp_response_header *resp_h,
 				      void *req_userdata,
+				      int req_internal,
 				      int *session_removed)
 {
 	int err;
@@ -880,7 +1045,7 @@ static void teardown_request_complete(struct rtsp_client *client,
 	}
 
 	if (!session->internal_teardown) {
-		(*client->cbs.teardown_resp)(
+		(*cbs->teardown_resp)(
 			client,
 			session->id,
 			status,
@@ -890,7 +1055,6 @@ static void teardown_request_complete(struct rtsp_client *client,
 			client->cbs_userdata,
 			req_userdata);
 		session->internal_teardown = 0;
-		client->request.is_internal = 0;
 	}
 
 	if (media != NULL) {
@@ -910,8 +1074,8 @@ static void teardown_request_complete(struct rtsp_client *client,
 	goto out;
 
 error:
-	if (!client->request.is_internal) {
-		(*client->cbs.teardown_resp)(
+	if (!req_internal) {
+		(*cbs->teardown_resp)(
 			client,
 			session_id,
 			status,
@@ -920,7 +1084,6 @@ error:
 			resp_h->ext_count,
 			client->cbs_userdata,
 			req_userdata);
-		client->request.is_internal = 0;
 	}
 
 out:
@@ -961,6 +1124,7 @@ update_auth_from_server(struct rtsp_client *client,
 
 
 static int request_complete(struct rtsp_client *client,
+			    struct rtsp_client_request *req,
 			    const struct rtsp_response_header *resp_h,
 			    const char *body,
 			    size_t body_len,
@@ -973,7 +1137,10 @@ static int request_complete(struct rtsp_client *client,
 	enum rtsp_method_type method;
 	char *req_uri;
 	char *req_session_id;
+	char *req_content_base;
+	int req_internal;
 	const char *content_base;
+	const struct rtsp_client_cbs *cbs;
 	void *req_userdata;
 	struct rtsp_channel_pair req_pair = {};
 	const char *method_str;
@@ -986,10 +1153,10 @@ static int request_complete(struct rtsp_client *client,
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 
-	if (!client->request.is_pending)
+	if ((req == NULL) || !req->is_pending)
 		return 0;
 
-	req_session_id = xstrdup(client->request.header.session_id);
+	req_session_id = xstrdup(req->header.session_id);
 
 	if (!resp_h) {
 		memset(&dummy, 0, sizeof(dummy));
@@ -1000,34 +1167,37 @@ static int request_complete(struct rtsp_client *client,
 	}
 
 	/* Save current request info */
-	method = client->request.header.method;
+	method = req->header.method;
 	if (method == RTSP_METHOD_TYPE_SETUP &&
-	    client->request.header.transport_count > 0 &&
-	    client->request.header.transport[0]->lower_transport ==
+	    req->header.transport_count > 0 &&
+	    req->header.transport[0]->lower_transport ==
 		    RTSP_LOWER_TRANSPORT_TCP &&
-	    client->request.header.transport[0]->interleaved_count > 0) {
-		req_pair.rtp =
-			client->request.header.transport[0]->interleaved[0].rtp;
-		req_pair.rtcp = client->request.header.transport[0]
-					->interleaved[0]
-					.rtcp;
+	    req->header.transport[0]->interleaved_count > 0) {
+		req_pair.rtp = req->header.transport[0]->interleaved[0].rtp;
+		req_pair.rtcp = req->header.transport[0]->interleaved[0].rtcp;
 	}
 	err = update_auth_from_server(client, resp_h->authenticate);
 	if (err < 0)
 		ULOG_ERRNO("update_auth_from_server", -err);
 
-	req_userdata = client->request.userdata;
-
-	/* Reset request/response buffer */
-	req_uri = xstrdup(client->request.header.uri);
-	rtsp_request_header_clear(&client->request.header);
-	client->request.is_pending = 0;
-	free(client->request.uri);
-	client->request.uri = NULL;
-	client->request.userdata = NULL;
+	cbs = (req->cbs != NULL) ? req->cbs : &client->cbs;
+	req_userdata = req->userdata;
+	req_internal = req->is_internal;
+	req_content_base = req->content_base;
+	req->content_base = NULL;
+
+	/* Release the in-flight entry before calling back the user, who
+	 * can send new requests */
+	req_uri = xstrdup(req->header.uri);
+	rtsp_request_header_clear(&req->header);
+	req->is_pending = 0;
+	req->is_internal = 0;
+	req->cbs = NULL;
+	req->userdata = NULL;
+	client->request.count--;
 
 	/* Clear the response timeout timer */
-	err = pomp_timer_clear(client->request.timer);
+	err = pomp_timer_clear(req->timer);
 	if (err < 0)
 		ULOG_ERRNO("pomp_timer_clear", -err);
 
@@ -1096,7 +1266,8 @@ static int request_complete(struct rtsp_client *client,
 			}
 			goto no_session;
 		}
-		session->keep_alive_in_progress = 0;
+		if (method == RTSP_METHOD_TYPE_GET_PARAMETER)
+			session->keep_alive_in_progress = 0;
 
 		/* Ensure our keep alive probes are received before the server
 		   times out by sending a probe at 80% of server's timeout,
@@ -1118,17 +1289,20 @@ static int request_complete(struct rtsp_client *client,
 			ULOG_ERRNO("reset_keep_alive_timer", -err);
 
 		/* Save content base to session if given */
-		if (client->request.content_base && !session->content_base)
-			session->content_base =
-				xstrdup(client->request.content_base);
-		xfree((void **)&client->request.content_base);
+		if (req_content_base && !session->content_base) {
+			session->content_base = req_content_base;
+			req_content_base = NULL;
+		}
 	}
 
 no_session:
 	switch (method) {
 	case RTSP_METHOD_TYPE_OPTIONS:
 		client->methods_allowed = resp_h->public_methods;
-		(*client->cbs.options_resp)(
+		if (status == RTSP_CLIENT_REQ_STATUS_OK)
+			rtsp_client_cache_set_methods(client,
+						      client->methods_allowed);
+		(*cbs->options_resp)(
 			client,
 			status,
 			rtsp_status_to_errno(resp_h->status_code),
@@ -1151,7 +1325,11 @@ no_session:
 			content_base = resp_h->content_location;
 		else
 			content_base = req_uri;
-		(*client->cbs.describe_resp)(
+		if (status == RTSP_CLIENT_REQ_STATUS_OK) {
+			rtsp_client_cache_set_description(
+				client, req_uri, content_base, body_with_null);
+		}
+		(*cbs->describe_resp)(
 			client,
 			status,
 			rtsp_status_to_errno(resp_h->status_code),
@@ -1164,7 +1342,7 @@ no_session:
 		free(body_with_null);
 		break;
 	case RTSP_METHOD_TYPE_ANNOUNCE:
-		(*client->cbs.announce_resp)(
+		(*cbs->announce_resp)(
 			client,
 			status,
 			rtsp_status_to_errno(resp_h->status_code),
@@ -1175,6 +1353,7 @@ no_session:
 		break;
 	case RTSP_METHOD_TYPE_SETUP:
 		setup_request_complete(client,
+				       cbs,
 				       session,
 				       session_id,
 				       req_uri,
@@ -1184,7 +1363,10 @@ no_session:
 				       req_userdata);
 		break;
 	case RTSP_METHOD_TYPE_PLAY:
+		if ((session != NULL) && (status == RTSP_CLIENT_REQ_STATUS_OK))
+			session->playing = 1;
 		play_request_complete(client,
+				      cbs,
 				      session_id,
 				      status,
 				      resp_h->status_code,
@@ -1192,8 +1374,10 @@ no_session:
 				      req_userdata);
 		break;
 	case RTSP_METHOD_TYPE_PAUSE:
+		if ((session != NULL) && (status == RTSP_CLIENT_REQ_STATUS_OK))
+			session->playing = 0;
 		if (status == RTSP_CLIENT_REQ_STATUS_OK) {
-			(*client->cbs.pause_resp)(
+			(*cbs->pause_resp)(
 				client,
 				session_id,
 				status,
@@ -1204,7 +1388,7 @@ no_session:
 				client->cbs_userdata,
 				req_userdata);
 		} else {
-			(*client->cbs.pause_resp)(
+			(*cbs->pause_resp)(
 				client,
 				session_id,
 				status,
@@ -1217,7 +1401,7 @@ no_session:
 		}
 		break;
 	case RTSP_METHOD_TYPE_RECORD:
-		(*client->cbs.record_resp)(
+		(*cbs->record_resp)(
 			client,
 			session_id,
 			status,
@@ -1229,12 +1413,14 @@ no_session:
 		break;
 	case RTSP_METHOD_TYPE_TEARDOWN:
 		teardown_request_complete(client,
+					  cbs,
 					  session,
 					  session_id,
 					  req_uri,
 					  status,
 					  resp_h,
 					  req_userdata,
+					  req_internal,
 					  &session_removed);
 		break;
 	case RTSP_METHOD_TYPE_GET_PARAMETER:
@@ -1327,155 +1513,465 @@ no_session:
 exit:
 	free(req_session_id);
 	free(req_uri);
+	free(req_content_base);
 	return res;
 }
 
 
-static void tskt_client_event_cb(struct tskt_client *self,
-				 enum tskt_client_event event,
-				 struct tskt_socket *sock,
-				 void *userdata)
+/* Complete all the requests in flight, oldest first; the requests sent
+ * from the callbacks are not completed */
+static void request_complete_all(struct rtsp_client *client,
+				 enum rtsp_client_req_status status)
 {
-	UNUSED(self);
+	int err;
+	unsigned int end = client->cseq;
+	unsigned int cseq = end - RTSP_CLIENT_MAX_INFLIGHT;
+	struct rtsp_client_request *req;
 
-	int res;
-	struct rtsp_client *client = userdata;
-	struct rtsp_client_session *session;
+	for (; cseq != end; cseq++) {
+		req = request_find(client, cseq);
+		if (req == NULL)
+			continue;
+		err = request_complete(client, req, NULL, NULL, 0, status);
+		if (err < 0)
+			ULOG_ERRNO("request_complete", -err);
+	}
+}
 
-	ULOG_ERRNO_RETURN_IF(client == NULL, EINVAL);
 
-	switch (event) {
-	case TSKT_CLIENT_EVENT_CONNECTED:
-		client->sock = sock;
-		ULOGI("client connected");
-		set_connection_state(client, RTSP_CLIENT_CONN_STATE_CONNECTED);
+static uint64_t get_time_us(void)
+{
+	struct timespec ts = {0, 0};
+	uint64_t time_us = 0;
 
-		/* If a session already exists, send a keep-alive
-		 * right away; this allows quickly seeing if a
-		 * session timeout has occurred on the server side
-		 * during the time disconnected */
-		list_walk_entry_forward(&client->sessions, session, node)
-		{
-			res = send_keep_alive(
-				session->client,
-				session,
-				RTSP_CLIENT_DEFAULT_RESP_TIMEOUT_MS);
-			if (res < 0)
-				ULOG_ERRNO("send_keep_alive", -res);
-		}
-		break;
+	time_get_monotonic(&ts);
+	time_timespec_to_us(&ts, &time_us);
 
-	case TSKT_CLIENT_EVENT_DISCONNECTED:
-		client->sock = NULL;
-		if (client->conn_state ==
-		    RTSP_CLIENT_CONN_STATE_DISCONNECTING) {
-			/* Disconnetion initiated by the user */
-			ULOGI("client disconnected");
+	return time_us;
+}
 
-			clear_remote_info(client);
-			res = request_complete(client,
-					       NULL,
-					       NULL,
-					       0,
-					       RTSP_CLIENT_REQ_STATUS_ABORTED);
-			if (res < 0)
-				ULOG_ERRNO("request_complete", -res);
 
-			set_connection_state(
-				client, RTSP_CLIENT_CONN_STATE_DISCONNECTED);
-		} else if (client->conn_state ==
-			   RTSP_CLIENT_CONN_STATE_CONNECTED) {
-			/* Disconnetion by the network, auto reconnect*/
-			ULOGI("client disconnected, waiting for reconnection");
+/* The jitter prevents clients dropped together from reconnecting
+ * together */
+unsigned int rtsp_client_reconnect_delay(struct rtsp_client *client)
+{
+	int err;
+	uint32_t rnd = 0;
+	unsigned int delay_ms;
 
-			res = request_complete(client,
-					       NULL,
-					       NULL,
-					       0,
-					       RTSP_CLIENT_REQ_STATUS_ABORTED);
-			if (res < 0)
-				ULOG_ERRNO("request_complete", -res);
+	ULOG_ERRNO_RETURN_VAL_IF(client == NULL, EINVAL, 0);
 
-			set_connection_state(client,
-					     RTSP_CLIENT_CONN_STATE_CONNECTING);
-		}
+	delay_ms = client->reconnect.delay_ms;
+	err = futils_random32(&rnd);
+	if (err < 0)
+		ULOG_ERRNO("futils_random32", -err);
+	delay_ms -= rnd % (delay_ms / 2 + 1);
 
-		break;
+	if (client->reconnect.delay_ms < client->reconnect.max_delay_ms / 2)
+		client->reconnect.delay_ms *= 2;
+	else
+		client->reconnect.delay_ms = client->reconnect.max_delay_ms;
 
-	case TSKT_CLIENT_EVENT_READY_TO_SEND:
-		/* Notify client */
-		if (client->cbs.ready_to_send_cb) {
-			(*client->cbs.ready_to_send_cb)(client,
-							client->cbs_userdata);
-		}
-		break;
+	return delay_ms;
+}
 
-	default:
-		break;
-	}
+
+/* Arm the next reconnection attempt */
+static void reconnect_schedule(struct rtsp_client *client)
+{
+	int err;
+
+	err = pomp_timer_set(client->reconnect.timer,
+			     rtsp_client_reconnect_delay(client));
+	if (err < 0)
+		ULOG_ERRNO("pomp_timer_set", -err);
 }
 
 
-static int teardown_request_process(struct rtsp_client *client,
-				    struct rtsp_message *msg,
-				    int *status_code,
-				    const char **status_string)
+static void reconnect_timer_cb(struct pomp_timer *timer, void *userdata)
 {
-	int ret;
+	UNUSED(timer);
+
 	int err;
-	int session_removed = 0;
-	char *uri = xstrdup(msg->header.req.uri);
-	char *path = NULL;
-	struct rtsp_client_session *session = NULL;
-	struct rtsp_client_session_media *media = NULL;
+	struct rtsp_client *client = userdata;
 
-	*status_code = RTSP_STATUS_CODE_OK;
-	*status_string = RTSP_STATUS_STRING_OK;
+	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTING)
+		return;
 
-	session =
-		rtsp_client_get_session(client, msg->header.req.session_id, 0);
-	if (session == NULL) {
-		ret = -ENOENT;
-		ULOGW("%s: session not found", __func__);
-		*status_code = RTSP_STATUS_CODE_SESSION_NOT_FOUND;
-		goto out;
-	}
+	/* Abort the previous attempt, if any, and try again */
+	client->reconnect.attempts++;
+	ULOGI("reconnection attempt %u to %s",
+	      client->reconnect.attempts,
+	      client->remote.url_str);
+	err = tskt_client_stop(client->tclient);
+	if (err < 0)
+		ULOG_ERRNO("tskt_client_stop", -err);
+	err = tskt_client_connect(
+		client->tclient,
+		NULL,
+		0,
+		rtsp_url_get_resolved_host(client->remote.url),
+		rtsp_url_get_port(client->remote.url));
+	if (err < 0)
+		ULOG_ERRNO("tskt_client_connect", -err);
 
-	ret = rtsp_url_parse_path(uri, &path);
-	if (ret < 0) {
-		ULOG_ERRNO(
-			"rtsp_url_parse_path(%s)", -ret, msg->header.req.uri);
-		goto out;
-	} else if (path == NULL) {
-		ret = -EINVAL;
-		ULOGE("invalid RTSP URL: '%s', path is missing",
-		      msg->header.req.uri);
-		goto out;
-	} else if (strcmp(msg->header.req.uri, session->content_base) != 0) {
-		media = rtsp_client_session_media_find(client, session, path);
-		if (media == NULL)
-			ULOGW("%s: media not found", __func__);
-	}
+	reconnect_schedule(client);
+}
 
-	(*client->cbs.teardown)(client,
-				media ? media->path : path,
-				msg->header.req.session_id,
-				msg->header.req.ext,
-				msg->header.req.ext_count,
-				client->cbs_userdata);
 
-	if (media != NULL) {
-		if (is_channel_pair_valid(&media->channel_pair)) {
-			set_channel_pair_used(client->channel_used,
-					      &media->channel_pair,
-					      false);
-		}
-		err = rtsp_client_session_media_remove(client, session, media);
-		if (err < 0)
-			ULOG_ERRNO("rtsp_client_session_media_remove", -err);
-		session_removed = (session->media_count == 0);
+static void resume_play_resp(struct rtsp_client *client,
+			     const char *session_id,
+			     enum rtsp_client_req_status req_status,
+			     int status,
+			     const struct rtsp_range *range,
+			     float scale,
+			     int seq_valid,
+			     uint16_t seq,
+			     int rtptime_valid,
+			     uint32_t rtptime,
+			     const struct rtsp_header_ext *ext,
+			     size_t ext_count,
+			     void *userdata,
+			     void *req_userdata)
+{
+	UNUSED(range);
+	UNUSED(scale);
+	UNUSED(seq_valid);
+	UNUSED(seq);
+	UNUSED(rtptime_valid);
+	UNUSED(rtptime);
+	UNUSED(ext);
+	UNUSED(ext_count);
+	UNUSED(userdata);
+	UNUSED(req_userdata);
+
+	/* On '454 Session Not Found' the session has already been removed */
+	if (req_status != RTSP_CLIENT_REQ_STATUS_OK) {
+		ULOGW("session %s not resumed: %s (%d)",
+		      session_id,
+		      rtsp_client_req_status_str(req_status),
+		      status);
+		return;
 	}
-	if (media == NULL || session_removed) {
+
+	ULOGI("session %s resumed %" PRIu64 "ms after the disconnection",
+	      session_id,
+	      (get_time_us() - client->reconnect.disconnect_us) / 1000);
+}
+
+
+static const struct rtsp_client_cbs s_resume_cbs = {
+	.play_resp = &resume_play_resp,
+};
+
+
+/* Re-attach to the sessions after a reconnection: a playing session
+ * is resumed by a PLAY request without range (which also moves the
+ * interleaved channels to the new connection), the others are only
+ * kept alive */
+static void resume_sessions(struct rtsp_client *client)
+{
+	int res;
+	struct rtsp_client_session *session;
+	const struct rtsp_range range = {0};
+
+	list_walk_entry_forward(&client->sessions, session, node)
+	{
+		if ((client->reconnect.min_delay_ms != 0) &&
+		    session->playing) {
+			res = rtsp_client_send_play(
+				client,
+				&s_resume_cbs,
+				session->id,
+				&range,
+				0.,
+				NULL,
+				0,
+				NULL,
+				RTSP_CLIENT_DEFAULT_RESP_TIMEOUT_MS);
+			if (res == 0)
+				continue;
+			ULOG_ERRNO("rtsp_client_send_play", -res);
+		}
+
+		/* Send a keep-alive right away; this allows quickly seeing
+		 * if a session timeout has occurred on the server side
+		 * during the time disconnected */
+		res = send_keep_alive(
+			client, session, RTSP_CLIENT_DEFAULT_RESP_TIMEOUT_MS);
+		if (res < 0)
+			ULOG_ERRNO("send_keep_alive", -res);
+	}
+}
+
+
+/* Stop the connection race; the winner (if any) becomes the transport
+ * client and the other attempts are abandoned */
+static void race_finish(struct rtsp_client *client, struct tskt_client *winner)
+{
+	int err;
+	struct tskt_client *tclient;
+
+	if (client->race.count == 0)
+		return;
+
+	err = pomp_timer_clear(client->race.timer);
+	if (err < 0)
+		ULOG_ERRNO("pomp_timer_clear", -err);
+
+	for (unsigned int i = 0; i < client->race.count; i++) {
+		tclient = (i == 0) ? client->tclient
+				   : client->race.tclients[i];
+		if ((winner != NULL) && (tclient == winner)) {
+			ULOGI("connection race won by %s",
+			      client->race.addrs[i]);
+			err = rtsp_url_set_resolved_host(client->remote.url,
+							 client->race.addrs[i]);
+			if (err < 0)
+				ULOG_ERRNO("rtsp_url_set_resolved_host", -err);
+		} else if ((i > 0) && (tclient != NULL)) {
+			err = tskt_client_stop(tclient);
+			if (err < 0)
+				ULOG_ERRNO("tskt_client_stop", -err);
+			err = tskt_client_destroy(tclient);
+			if (err < 0)
+				ULOG_ERRNO("tskt_client_destroy", -err);
+		}
+		client->race.tclients[i] = NULL;
+		xfree((void **)&client->race.addrs[i]);
+	}
+	client->race.count = 0;
+	client->race.started = 0;
+	client->race.failed = 0;
+
+	if ((winner == NULL) || (winner == client->tclient))
+		return;
+
+	/* The first attempt lost */
+	err = tskt_client_stop(client->tclient);
+	if (err < 0)
+		ULOG_ERRNO("tskt_client_stop", -err);
+	err = tskt_client_destroy(client->tclient);
+	if (err < 0)
+		ULOG_ERRNO("tskt_client_destroy", -err);
+	client->tclient = winner;
+}
+
+
+/* Index of a connection attempt of the race, other than the first one
+ * (which uses tclient); 0 if not found */
+static unsigned int race_attempt_index(struct rtsp_client *client,
+				       struct tskt_client *tclient)
+{
+	for (unsigned int i = 1; i < client->race.started; i++) {
+		if (client->race.tclients[i] == tclient)
+			return i;
+	}
+	return 0;
+}
+
+
+/* A connection attempt of the race failed: start the next one without
+ * waiting for the attempt delay (RFC 8305 chapter 5), from the loop
+ * rather than from the transport callback. The other attempts are
+ * stopped so that they do not retry on their own; the first one keeps
+ * retrying, in case all the others fail too. */
+static void race_attempt_failed(struct rtsp_client *client, unsigned int i)
+{
+	int err;
+
+	if (client->race.failed & (1U << i))
+		return;
+	client->race.failed |= 1U << i;
+	ULOGI("connection attempt %u to %s failed",
+	      i + 1,
+	      client->race.addrs[i]);
+
+	if (i > 0) {
+		err = tskt_client_stop(client->race.tclients[i]);
+		if (err < 0)
+			ULOG_ERRNO("tskt_client_stop", -err);
+	}
+
+	if (client->race.started < client->race.count) {
+		err = pomp_timer_set(client->race.timer, 1);
+		if (err < 0)
+			ULOG_ERRNO("pomp_timer_set", -err);
+	}
+}
+
+
+static void tskt_client_event_cb(struct tskt_client *self,
+				 enum tskt_client_event event,
+				 struct tskt_socket *sock,
+				 void *userdata)
+{
+	int res;
+	unsigned int attempt;
+	struct rtsp_client *client = userdata;
+
+	ULOG_ERRNO_RETURN_IF(client == NULL, EINVAL);
+
+	if (self != client->tclient) {
+		/* Another connection attempt of the race: only its
+		 * connection or its failure matters */
+		attempt = race_attempt_index(client, self);
+		if (attempt == 0)
+			return;
+		if ((event == TSKT_CLIENT_EVENT_DISCONNECTED) &&
+		    (client->conn_state == RTSP_CLIENT_CONN_STATE_CONNECTING))
+			race_attempt_failed(client, attempt);
+		if (event != TSKT_CLIENT_EVENT_CONNECTED)
+			return;
+	}
+
+	switch (event) {
+	case TSKT_CLIENT_EVENT_CONNECTED:
+		race_finish(client, self);
+		client->sock = sock;
+		if (client->reconnect.attempts > 0) {
+			ULOGI("client reconnected after %u attempt(s)",
+			      client->reconnect.attempts);
+		} else {
+			ULOGI("client connected");
+		}
+		res = pomp_timer_clear(client->reconnect.timer);
+		if (res < 0)
+			ULOG_ERRNO("pomp_timer_clear", -res);
+		client->reconnect.attempts = 0;
+		set_connection_state(client, RTSP_CLIENT_CONN_STATE_CONNECTED);
+
+		/* If sessions already exist, re-attach to them */
+		resume_sessions(client);
+		break;
+
+	case TSKT_CLIENT_EVENT_DISCONNECTED:
+		client->sock = NULL;
+		tx_reset(client);
+		if (client->conn_state ==
+		    RTSP_CLIENT_CONN_STATE_DISCONNECTING) {
+			/* Disconnetion initiated by the user */
+			ULOGI("client disconnected");
+
+			clear_remote_info(client);
+			request_complete_all(client,
+					     RTSP_CLIENT_REQ_STATUS_ABORTED);
+
+			set_connection_state(
+				client, RTSP_CLIENT_CONN_STATE_DISCONNECTED);
+		} else if (client->conn_state ==
+			   RTSP_CLIENT_CONN_STATE_CONNECTED) {
+			/* Disconnetion by the network, auto reconnect*/
+			ULOGI("client disconnected, waiting for reconnection");
+
+			request_complete_all(client,
+					     RTSP_CLIENT_REQ_STATUS_ABORTED);
+
+			set_connection_state(client,
+					     RTSP_CLIENT_CONN_STATE_CONNECTING);
+
+			/* Replace the transport reconnection by attempts
+			 * with an exponential backoff */
+			if (client->reconnect.min_delay_ms != 0) {
+				res = tskt_client_stop(client->tclient);
+				if (res < 0)
+					ULOG_ERRNO("tskt_client_stop", -res);
+				client->reconnect.disconnect_us = get_time_us();
+				client->reconnect.delay_ms =
+					client->reconnect.min_delay_ms;
+				reconnect_schedule(client);
+			}
+		} else if ((client->conn_state ==
+			    RTSP_CLIENT_CONN_STATE_CONNECTING) &&
+			   (client->race.count > 0)) {
+			/* The first connection attempt of the race failed */
+			race_attempt_failed(client, 0);
+		}
+
+		break;
+
+	case TSKT_CLIENT_EVENT_READY_TO_SEND:
+		/* Send the remaining data of a partial write first */
+		res = tx_flush(client);
+		if (res < 0) {
+			if (res != -EAGAIN)
+				ULOG_ERRNO("tx_flush", -res);
+			break;
+		}
+
+		/* Notify client */
+		if (client->cbs.ready_to_send_cb) {
+			(*client->cbs.ready_to_send_cb)(client,
+							client->cbs_userdata);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+static int teardown_request_process(struct rtsp_client *client,
+				    struct rtsp_message *msg,
+				    int *status_code,
+				    const char **status_string)
+{
+	int ret;
+	int err;
+	int session_removed = 0;
+	char *uri = xstrdup(msg->header.req.uri);
+	char *path = NULL;
+	struct rtsp_client_session *session = NULL;
+	struct rtsp_client_session_media *media = NULL;
+
+	*status_code = RTSP_STATUS_CODE_OK;
+	*status_string = RTSP_STATUS_STRING_OK;
+
+	session =
+		rtsp_client_get_session(client, msg->header.req.session_id, 0);
+	if (session == NULL) {
+		ret = -ENOENT;
+		ULOGW("%s: session not found", __func__);
+		*status_code = RTSP_STATUS_CODE_SESSION_NOT_FOUND;
+		goto out;
+	}
+
+	ret = rtsp_url_parse_path(uri, &path);
+	if (ret < 0) {
+		ULOG_ERRNO(
+			"rtsp_url_parse_path(%s)", -ret, msg->header.req.uri);
+		goto out;
+	} else if (path == NULL) {
+		ret = -EINVAL;
+		ULOGE("invalid RTSP URL: '%s', path is missing",
+		      msg->header.req.uri);
+		goto out;
+	} else if (strcmp(msg->header.req.uri, session->content_base) != 0) {
+		media = rtsp_client_session_media_find(client, session, path);
+		if (media == NULL)
+			ULOGW("%s: media not found", __func__);
+	}
+
+	(*client->cbs.teardown)(client,
+				media ? media->path : path,
+				msg->header.req.session_id,
+				msg->header.req.ext,
+				msg->header.req.ext_count,
+				client->cbs_userdata);
+
+	if (media != NULL) {
+		if (is_channel_pair_valid(&media->channel_pair)) {
+			set_channel_pair_used(client->channel_used,
+					      &media->channel_pair,
+					      false);
+		}
+		err = rtsp_client_session_media_remove(client, session, media);
+		if (err < 0)
+			ULOG_ERRNO("rtsp_client_session_media_remove", -err);
+		session_removed = (session->media_count == 0);
+	}
+	if (media == NULL || session_removed) {
 		ret = rtsp_client_remove_session_internal(
 			client,
 			msg->header.req.session_id,
@@ -1512,6 +2008,82 @@ static int rtsp_client_interleaved_process(struct rtsp_client *client,
 }
 
 
+/* Deliver the complete interleaved packets at the beginning of the
+ * received data, without going through the RTSP message parser; returns
+ * -EINVAL if an RTSP message follows, -EAGAIN otherwise */
+static int rtsp_client_interleaved_batch_process(struct rtsp_client *client)
+{
+	int res;
+	size_t off = 0;
+	size_t pkt_len;
+	size_t count = 0;
+	struct rtsp_interleaved_info info;
+
+	while ((res = rtsp_get_next_interleaved(client->response.buf,
+						&client->parser_ctx,
+						off,
+						&info,
+						&pkt_len)) == 0) {
+		off += pkt_len;
+
+		if (client->cbs.interleaved_batch_cb == NULL) {
+			if (client->cbs.interleaved_data_cb) {
+				(*client->cbs.interleaved_data_cb)(
+					client,
+					info.channel,
+					info.data,
+					info.len,
+					client->cbs_userdata);
+			}
+			continue;
+		}
+
+		if (count == client->rx.batch_capacity) {
+			size_t capacity = 2 * client->rx.batch_capacity;
+			if (capacity == 0)
+				capacity = 16;
+			struct rtsp_interleaved_info *tmp = realloc(
+				client->rx.batch, capacity * sizeof(*tmp));
+			if (tmp == NULL) {
+				ULOG_ERRNO("realloc", ENOMEM);
+				/* Deliver what we have so far, then this
+				 * packet alone */
+				if (count > 0) {
+					(*client->cbs.interleaved_batch_cb)(
+						client,
+						client->rx.batch,
+						count,
+						client->cbs_userdata);
+					count = 0;
+				}
+				(*client->cbs.interleaved_batch_cb)(
+					client, &info, 1, client->cbs_userdata);
+				continue;
+			}
+			client->rx.batch = tmp;
+			client->rx.batch_capacity = capacity;
+		}
+		client->rx.batch[count++] = info;
+	}
+
+	if (count > 0) {
+		(*client->cbs.interleaved_batch_cb)(
+			client, client->rx.batch, count, client->cbs_userdata);
+	}
+
+	/* The data is consumed only after the callbacks, as consuming
+	 * may reset the buffer */
+	rtsp_message_parser_consume(
+		&client->parser_ctx, client->response.buf, off);
+
+	if (res != -EINVAL && res != -EAGAIN) {
+		ULOG_ERRNO("rtsp_get_next_interleaved", -res);
+		res = -EAGAIN;
+	}
+	return res;
+}
+
+
 static int rtsp_client_request_process(struct rtsp_client *client,
 				       struct rtsp_message *msg)
 {
@@ -1525,7 +2097,7 @@ static int rtsp_client_request_process(struct rtsp_client *client,
 	struct rtsp_message resp;
 	struct pomp_buffer *resp_buf = NULL;
 	struct rtsp_string resp_str;
-	struct timespec cur_ts = {0, 0};
+	struct rtsp_response_lines lines;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
@@ -1584,8 +2156,7 @@ static int rtsp_client_request_process(struct rtsp_client *client,
 	resp.header.resp.cseq = msg->header.req.cseq;
 	resp.header.resp.status_code = status_code;
 	resp.header.resp.status_string = strdup(status_string);
-	time_get_monotonic(&cur_ts);
-	resp.header.resp.date = cur_ts.tv_sec;
+	resp.header.resp.date = rtsp_date_cache_now(&client->date);
 
 	ULOGI("send RTSP response to %s: status=%d(%s) cseq=%d session=%s",
 	      rtsp_method_type_str(msg->header.req.method),
@@ -1601,12 +2172,14 @@ static int rtsp_client_request_process(struct rtsp_client *client,
 		goto out;
 	}
 
-	ret = pomp_buffer_get_data(
-		resp_buf, (void **)&resp_str.str, NULL, &resp_str.max_len);
+	ret = rtsp_string_init(&resp_str, resp_buf, client->max_msg_size);
 	if (ret < 0)
 		goto out;
 
-	res = rtsp_response_header_write(&resp.header.resp, &resp_str);
+	memset(&lines, 0, sizeof(lines));
+	lines.date = rtsp_date_cache_line(&client->date, resp.header.resp.date);
+	res = rtsp_response_header_write_lines(
+		&resp.header.resp, &lines, &resp_str);
 	if (res < 0) {
 		ret = res;
 		goto out;
@@ -1638,46 +2211,35 @@ out:
 static int rtsp_client_response_process(struct rtsp_client *client,
 					const struct rtsp_message *msg)
 {
-	struct rtsp_client_session *session;
+	struct rtsp_client_request *req;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
 
-	/* Note: VLC server doesn't repeat the cseq in error case */
-	if (msg->header.resp.cseq != client->request.header.cseq) {
-
-		list_walk_entry_forward(&client->sessions, session, node)
-		{
-			if (!session->keep_alive_in_progress)
-				continue;
-
-			/* We suppose that this is in fact the response to a
-			 * pending keep alive; drop the response */
-			session->keep_alive_in_progress = 0;
-			ULOGW("%s: dropping RTSP response cseq=%d session=%s"
-			      " (probably %s)",
-			      __func__,
-			      msg->header.resp.cseq,
-			      session->id,
-			      rtsp_method_type_str(
-				      RTSP_METHOD_TYPE_GET_PARAMETER));
-
-			/* Try to send a keep alive later as this one has been
-			 * dropped. Moreover the following response may not
-			 * be related to this session. */
-			reset_keep_alive_timer(session,
-					       session->timeout_ms / 2);
-			return 0;
+	req = request_find(client, (unsigned int)msg->header.resp.cseq);
+
+	/* Note: VLC server doesn't repeat the cseq in error case; the
+	 * response can still be matched if a single request is in flight.
+	 * CSeq numbering starts at 1, so 0 means no CSeq header; a wrong
+	 * CSeq is never matched */
+	if ((req == NULL) && (msg->header.resp.cseq == 0) &&
+	    (client->request.count == 1)) {
+		for (size_t i = 0; i < RTSP_CLIENT_MAX_INFLIGHT; i++) {
+			if (client->request.slots[i].is_pending)
+				req = &client->request.slots[i];
 		}
+	}
 
-		ULOGE("%s: unexpected CSeq (req: %d, resp: %d)",
+	if (req == NULL) {
+		ULOGE("%s: unexpected CSeq %d (%u requests in flight)",
 		      __func__,
-		      client->request.header.cseq,
-		      msg->header.resp.cseq);
+		      msg->header.resp.cseq,
+		      client->request.count);
 		return -EPROTO;
 	}
 
 	return request_complete(client,
+				req,
 				&msg->header.resp,
 				msg->body,
 				msg->body_len,
@@ -1715,14 +2277,18 @@ static void tskt_client_data_cb(struct tskt_client *self,
 	}
 
 	/* Add the data to the buffer */
-	res = pomp_buffer_append_data(client->response.buf, cdata, len);
+	res = rtsp_message_parser_append_data(
+		&client->parser_ctx, client->response.buf, cdata, len);
 	if (res < 0) {
-		ULOG_ERRNO("pomp_buffer_append_data", -res);
+		ULOG_ERRNO("rtsp_message_parser_append_data", -res);
 		return;
 	}
 
-	/* Iterate over complete messages */
-	while ((res = rtsp_get_next_message(client->response.buf,
+	/* Iterate over complete messages; interleaved packets take a
+	 * fast path, RTSP messages go through the parser */
+	while ((res = rtsp_client_interleaved_batch_process(client)) !=
+		       -EAGAIN &&
+	       (res = rtsp_get_next_message(client->response.buf,
 					    &msg,
 					    &client->parser_ctx)) == 0) {
 		if (msg.type == RTSP_MESSAGE_TYPE_INTERLEAVED) {
@@ -1742,14 +2308,19 @@ static void tskt_client_data_cb(struct tskt_client *self,
 			}
 		}
 
-		rtsp_buffer_remove_first_bytes(client->response.buf,
-					       msg.total_len);
+		rtsp_message_parser_consume(&client->parser_ctx,
+					    client->response.buf,
+					    msg.total_len);
 	}
 
-	if (res != -EAGAIN)
+	/* On parse error, skip the invalid message; msg is not cleared
+	 * when the loop stops on incomplete interleaved data */
+	if (res != -EAGAIN) {
 		ULOG_ERRNO("rtsp_get_next_message", -res);
-
-	rtsp_buffer_remove_first_bytes(client->response.buf, msg.total_len);
+		rtsp_message_parser_consume(&client->parser_ctx,
+					    client->response.buf,
+					    msg.total_len);
+	}
 }
 
 
@@ -1758,13 +2329,17 @@ static void rtsp_client_resp_timeout_cb(struct pomp_timer *timer,
 {
 	UNUSED(timer);
 
-	struct rtsp_client *client = userdata;
+	struct rtsp_client_request *req = userdata;
 	int ret = 0;
 
-	ULOG_ERRNO_RETURN_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(req == NULL, EINVAL);
 
-	ret = request_complete(
-		client, NULL, NULL, 0, RTSP_CLIENT_REQ_STATUS_TIMEOUT);
+	ret = request_complete(req->client,
+			       req,
+			       NULL,
+			       NULL,
+			       0,
+			       RTSP_CLIENT_REQ_STATUS_TIMEOUT);
 	if (ret < 0)
 		ULOG_ERRNO("request_complete", -ret);
 }
@@ -1798,6 +2373,64 @@ static const struct tskt_client_cbs tclient_cbs = {
 };
 
 
+/* Start the next connection attempts of the race, until one of them
+ * can be started, and arm the delay before the following one */
+static void race_start_next(struct rtsp_client *client)
+{
+	int err;
+	unsigned int i;
+	uint16_t port = rtsp_url_get_port(client->remote.url);
+	struct tskt_client *tclient;
+
+	while (client->race.started < client->race.count) {
+		i = client->race.started++;
+		ULOGI("connection attempt %u to %s",
+		      i + 1,
+		      client->race.addrs[i]);
+		err = tskt_client_new(
+			client->loop, tclient_cbs, client, &tclient);
+		if (err < 0) {
+			ULOG_ERRNO("tskt_client_new", -err);
+			client->race.failed |= 1U << i;
+			continue;
+		}
+		client->race.tclients[i] = tclient;
+
+		err = tskt_client_connect(
+			tclient, NULL, 0, client->race.addrs[i], port);
+		if (err == 0)
+			break;
+		ULOG_ERRNO("tskt_client_connect", -err);
+		client->race.failed |= 1U << i;
+		err = tskt_client_stop(tclient);
+		if (err < 0)
+			ULOG_ERRNO("tskt_client_stop", -err);
+	}
+
+	if (client->race.started < client->race.count) {
+		err = pomp_timer_set(client->race.timer,
+				     RTSP_CLIENT_CONNECT_ATTEMPT_DELAY_MS);
+		if (err < 0)
+			ULOG_ERRNO("pomp_timer_set", -err);
+	}
+}
+
+
+/* Start the next connection attempt of the race, once the attempt delay
+ * has elapsed or the previous attempt has failed */
+static void race_timer_cb(struct pomp_timer *timer, void *userdata)
+{
+	UNUSED(timer);
+
+	struct rtsp_client *client = userdata;
+
+	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTING)
+		return;
+
+	race_start_next(client);
+}
+
+
 int rtsp_client_new(struct pomp_loop *loop,
 		    const char *software_name,
 		    const struct rtsp_client_cbs *cbs,
@@ -1826,19 +2459,40 @@ int rtsp_client_new(struct pomp_loop *loop,
 	client->sock_params.class_selector = UINT32_MAX;
 
 	list_init(&client->sessions);
+	list_init(&client->cache.entries);
+
+	/* Create a response timeout timer per in-flight request */
+	for (size_t i = 0; i < RTSP_CLIENT_MAX_INFLIGHT; i++) {
+		struct rtsp_client_request *req = &client->request.slots[i];
+		req->client = client;
+		req->timer =
+			pomp_timer_new(loop, &rtsp_client_resp_timeout_cb, req);
+		if (req->timer == NULL) {
+			res = -ENOMEM;
+			ULOG_ERRNO("pomp_timer_new", -res);
+			goto error;
+		}
+	}
 
-	/* Create a timer for response timeout */
-	client->request.timer =
-		pomp_timer_new(loop, &rtsp_client_resp_timeout_cb, client);
-	if (client->request.timer == NULL) {
+	client->resolv.timer =
+		pomp_timer_new(client->loop, &resolv_timer_cb, client);
+	if (client->resolv.timer == NULL) {
 		res = -ENOMEM;
 		ULOG_ERRNO("pomp_timer_new", -res);
 		goto error;
 	}
 
-	client->resolv.timer =
-		pomp_timer_new(client->loop, &resolv_timer_cb, client);
-	if (client->resolv.timer == NULL) {
+	client->reconnect.timer =
+		pomp_timer_new(client->loop, &reconnect_timer_cb, client);
+	if (client->reconnect.timer == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("pomp_timer_new", -res);
+		goto error;
+	}
+
+	client->race.timer =
+		pomp_timer_new(client->loop, &race_timer_cb, client);
+	if (client->race.timer == NULL) {
 		res = -ENOMEM;
 		ULOG_ERRNO("pomp_timer_new", -res);
 		goto error;
@@ -1867,6 +2521,7 @@ int rtsp_client_new(struct pomp_loop *loop,
 	}
 
 	/* Initialize request */
+	client->max_msg_size = RTSP_DEFAULT_MAX_MSG_SIZE;
 	client->request.buf = pomp_buffer_new(PIPE_BUF - 1);
 	if (client->request.buf == NULL) {
 		res = -ENOMEM;
@@ -1898,12 +2553,17 @@ int rtsp_client_destroy(struct rtsp_client *client)
 	if (client == NULL)
 		return 0;
 
-	if (client->request.timer != NULL) {
-		err = pomp_timer_clear(client->request.timer);
+	for (size_t i = 0; i < RTSP_CLIENT_MAX_INFLIGHT; i++) {
+		if (client->request.slots[i].timer == NULL)
+			continue;
+		err = pomp_timer_clear(client->request.slots[i].timer);
 		if (err < 0)
 			ULOG_ERRNO("pomp_timer_clear", -err);
 	}
 
+	if (client->race.timer != NULL)
+		race_finish(client, NULL);
+
 	/* Before removing any session, the pomp context must be stopped
 	 * to trigger a POMP_EVENT_DISCONNECTED event and complete any
 	 * pending request with a RTSP_CLIENT_REQ_STATUS_ABORTED status */
@@ -1914,9 +2574,13 @@ int rtsp_client_destroy(struct rtsp_client *client)
 	}
 
 	rtsp_client_remove_all_sessions(client);
+	rtsp_client_playback_clear(client);
+	rtsp_client_cache_clear(client);
 
-	if (client->request.timer != NULL) {
-		err = pomp_timer_destroy(client->request.timer);
+	for (size_t i = 0; i < RTSP_CLIENT_MAX_INFLIGHT; i++) {
+		if (client->request.slots[i].timer == NULL)
+			continue;
+		err = pomp_timer_destroy(client->request.slots[i].timer);
 		if (err < 0)
 			ULOG_ERRNO("pomp_timer_destroy", -err);
 	}
@@ -1944,29 +2608,137 @@ int rtsp_client_destroy(struct rtsp_client *client)
 		pomp_buffer_unref(client->request.buf);
 	if (client->response.buf != NULL)
 		pomp_buffer_unref(client->response.buf);
+	if (client->tx.pending != NULL)
+		pomp_buffer_unref(client->tx.pending);
+	free(client->rx.batch);
+
+	if (client->resolv.timer != NULL) {
+		err = pomp_timer_clear(client->resolv.timer);
+		if (err < 0)
+			ULOG_ERRNO("pomp_timer_clear", -err);
+		err = pomp_timer_destroy(client->resolv.timer);
+		if (err < 0)
+			ULOG_ERRNO("pomp_timer_destroy", -err);
+	}
 
-	if (client->resolv.timer != NULL) {
-		err = pomp_timer_clear(client->resolv.timer);
+	if (client->reconnect.timer != NULL) {
+		err = pomp_timer_clear(client->reconnect.timer);
 		if (err < 0)
 			ULOG_ERRNO("pomp_timer_clear", -err);
-		err = pomp_timer_destroy(client->resolv.timer);
+		err = pomp_timer_destroy(client->reconnect.timer);
+		if (err < 0)
+			ULOG_ERRNO("pomp_timer_destroy", -err);
+	}
+
+	if (client->race.timer != NULL) {
+		err = pomp_timer_destroy(client->race.timer);
 		if (err < 0)
 			ULOG_ERRNO("pomp_timer_destroy", -err);
 	}
 
-	free(client->request.uri);
-	free(client->request.content_base);
-	rtsp_request_header_clear(&client->request.header);
-	rtsp_message_clear(&client->parser_ctx.msg);
+	for (size_t i = 0; i < RTSP_CLIENT_MAX_INFLIGHT; i++) {
+		free(client->request.slots[i].content_base);
+		rtsp_request_header_clear(&client->request.slots[i].header);
+	}
+	rtsp_message_parser_ctx_clear(&client->parser_ctx);
 
 	clear_remote_info(client);
 	free(client->software_name);
+	rtsp_date_cache_clear(&client->date);
 	free(client);
 
 	return 0;
 }
 
 
+unsigned int rtsp_client_sort_addrs(const char *const *addrs,
+				    int naddrs,
+				    const char **sorted)
+{
+	unsigned int count = 0;
+	int next[2] = {0, 0};
+	int family;
+	int is_v6;
+
+	if (naddrs <= 0)
+		return 0;
+	family = (strchr(addrs[0], ':') != NULL);
+
+	while (count < RTSP_CLIENT_CONNECT_MAX_ADDRS) {
+		/* Next address of the family, or of the other one */
+		for (int k = 0; k < 2; k++, family = !family) {
+			while (next[family] < naddrs) {
+				is_v6 = (strchr(addrs[next[family]], ':') !=
+					 NULL);
+				if (is_v6 == family)
+					break;
+				next[family]++;
+			}
+			if (next[family] < naddrs)
+				break;
+		}
+		if (next[family] >= naddrs)
+			break;
+		sorted[count++] = addrs[next[family]++];
+		family = !family;
+	}
+
+	return count;
+}
+
+
+int rtsp_client_connect_addrs(struct rtsp_client *client,
+			      const char *const *addrs,
+			      unsigned int count)
+{
+	int res;
+	int err;
+
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(addrs == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count > RTSP_CLIENT_CONNECT_MAX_ADDRS, EINVAL);
+
+	res = rtsp_url_set_resolved_host(client->remote.url, addrs[0]);
+	if (res < 0) {
+		ULOG_ERRNO("rtsp_url_set_resolved_host", -res);
+		return res;
+	}
+
+	/* Race the other addresses if the first one does not connect
+	 * quickly enough */
+	race_finish(client, NULL);
+	for (unsigned int i = 0; (count > 1) && (i < count); i++) {
+		client->race.addrs[i] = strdup(addrs[i]);
+		if (client->race.addrs[i] == NULL) {
+			ULOG_ERRNO("strdup", ENOMEM);
+			break;
+		}
+		client->race.count++;
+	}
+	if (client->race.count > 1) {
+		client->race.started = 1;
+		err = pomp_timer_set(client->race.timer,
+				     RTSP_CLIENT_CONNECT_ATTEMPT_DELAY_MS);
+		if (err < 0)
+			ULOG_ERRNO("pomp_timer_set", -err);
+	}
+
+	res = tskt_client_connect(
+		client->tclient,
+		NULL,
+		0,
+		rtsp_url_get_resolved_host(client->remote.url),
+		rtsp_url_get_port(client->remote.url));
+	if (res < 0) {
+		ULOG_ERRNO("tskt_client_connect", -res);
+		return res;
+	}
+
+	return 0;
+}
+
+
 static void tskt_resolv_cb(struct tskt_resolv *self,
 			   int id,
 			   enum tskt_resolv_error result,
@@ -1976,16 +2748,15 @@ static void tskt_resolv_cb(struct tskt_resolv *self,
 {
 	UNUSED(self);
 	UNUSED(id);
-	UNUSED(naddrs);
 
 	int res = 0;
 	int err;
 	const char *host = NULL;
-	uint16_t port = 0;
 	struct rtsp_client *client = (struct rtsp_client *)userdata;
+	const char *sorted[RTSP_CLIENT_CONNECT_MAX_ADDRS];
+	unsigned int count;
 
 	host = rtsp_url_get_host(client->remote.url);
-	port = rtsp_url_get_port(client->remote.url);
 
 	err = pomp_timer_clear(client->resolv.timer);
 	if (err < 0)
@@ -1999,24 +2770,17 @@ static void tskt_resolv_cb(struct tskt_resolv *self,
 		goto error;
 	}
 
-	ULOGI("successfully resolved hostname '%s' to %s", host, addrs[0]);
+	ULOGI("successfully resolved hostname '%s' to %s%s",
+	      host,
+	      addrs[0],
+	      (naddrs > 1) ? " (and others)" : "");
 
-	res = rtsp_url_set_resolved_host(client->remote.url, addrs[0]);
-	if (res < 0) {
-		ULOG_ERRNO("rtsp_url_set_resolved_host", -res);
+	count = rtsp_client_sort_addrs(addrs, naddrs, sorted);
+	if (count == 0)
 		goto error;
-	}
-
-	res = tskt_client_connect(
-		client->tclient,
-		NULL,
-		0,
-		rtsp_url_get_resolved_host(client->remote.url),
-		port);
-	if (res < 0) {
-		ULOG_ERRNO("tskt_client_connect", -res);
+	res = rtsp_client_connect_addrs(client, sorted, count);
+	if (res < 0)
 		goto error;
-	}
 
 	return;
 
@@ -2031,6 +2795,7 @@ int rtsp_client_connect(struct rtsp_client *client, const char *addr)
 	const char *host = NULL;
 	const char *user = NULL;
 	uint16_t port = 0;
+	uint32_t methods;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(addr == NULL, EINVAL);
@@ -2053,6 +2818,12 @@ int rtsp_client_connect(struct rtsp_client *client, const char *addr)
 
 	rtsp_url_strip_credentials(addr, &client->remote.url_str);
 
+	/* Reuse the methods allowed by the server from a previous
+	 * connection, if cached */
+	methods = rtsp_client_cache_get_methods(client);
+	if (methods != 0)
+		client->methods_allowed = methods;
+
 	ULOGI("connecting to address %s port %d", host, port);
 	set_connection_state(client, RTSP_CLIENT_CONN_STATE_CONNECTING);
 
@@ -2121,6 +2892,12 @@ int rtsp_client_disconnect(struct rtsp_client *client)
 
 	set_connection_state(client, RTSP_CLIENT_CONN_STATE_DISCONNECTING);
 
+	res = pomp_timer_clear(client->reconnect.timer);
+	if (res < 0)
+		ULOG_ERRNO("pomp_timer_clear", -res);
+	client->reconnect.attempts = 0;
+	race_finish(client, NULL);
+
 	/* Before removing any session, the pomp context must be stopped
 	 * to trigger a POMP_EVENT_DISCONNECTED event and complete any
 	 * pending request with a RTSP_CLIENT_REQ_STATUS_ABORTED status */
@@ -2133,8 +2910,7 @@ int rtsp_client_disconnect(struct rtsp_client *client)
 	if (already_disconnected) {
 		ULOGI("client disconnected (already disconnected)");
 		clear_remote_info(client);
-		request_complete(
-			client, NULL, NULL, 0, RTSP_CLIENT_REQ_STATUS_ABORTED);
+		request_complete_all(client, RTSP_CLIENT_REQ_STATUS_ABORTED);
 		set_connection_state(client,
 				     RTSP_CLIENT_CONN_STATE_DISCONNECTED);
 	}
@@ -2154,64 +2930,76 @@ rtsp_client_get_remote_url(const struct rtsp_client *client)
 }
 
 
-int rtsp_client_options(struct rtsp_client *client,
-			const struct rtsp_header_ext *ext,
-			size_t ext_count,
-			void *req_userdata,
-			unsigned int timeout_ms)
+int rtsp_client_send_options(struct rtsp_client *client,
+			     const struct rtsp_client_cbs *cbs,
+			     const struct rtsp_header_ext *ext,
+			     size_t ext_count,
+			     void *req_userdata,
+			     unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.options_resp == NULL, ENOSYS);
 
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
 
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_OPTIONS;
-	client->request.header.uri = xstrdup("*");
-	client->request.header.cseq = client->cseq;
-	/* client->request.header.authorization not needed for OPTIONS */
-	client->request.header.user_agent = xstrdup(client->software_name);
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->cbs = cbs;
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_OPTIONS;
+	req->header.uri = xstrdup("*");
+	/* req->header.authorization not needed for OPTIONS */
+	req->header.user_agent = xstrdup(client->software_name);
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
-	client->request.is_pending = 1;
-	client->cseq++;
 	return 0;
 }
 
 
-int rtsp_client_describe(struct rtsp_client *client,
-			 const char *path,
-			 const struct rtsp_header_ext *ext,
-			 size_t ext_count,
-			 void *req_userdata,
-			 unsigned int timeout_ms)
+int rtsp_client_options(struct rtsp_client *client,
+			const struct rtsp_header_ext *ext,
+			size_t ext_count,
+			void *req_userdata,
+			unsigned int timeout_ms)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.options_resp == NULL, ENOSYS);
+
+	return rtsp_client_send_options(client,
+					NULL,
+					ext,
+					ext_count,
+					req_userdata,
+					timeout_ms);
+}
+
+
+int rtsp_client_send_describe(struct rtsp_client *client,
+			      const struct rtsp_client_cbs *cbs,
+			      const char *path,
+			      const struct rtsp_header_ext *ext,
+			      size_t ext_count,
+			      void *req_userdata,
+			      unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.describe_resp == NULL, ENOSYS);
 	ULOG_ERRNO_RETURN_ERR_IF(
 		(client->methods_allowed != 0) &&
 			!(client->methods_allowed & RTSP_METHOD_FLAG_DESCRIBE),
@@ -2220,42 +3008,56 @@ int rtsp_client_describe(struct rtsp_client *client,
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
 
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_DESCRIBE;
-	client->request.header.uri = make_uri(client, path);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	req->cbs = cbs;
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_DESCRIBE;
+	req->header.uri = rtsp_client_make_uri(client, path);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0 && res != -EAGAIN) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.accept = xstrdup(RTSP_CONTENT_TYPE_SDP);
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.accept = xstrdup(RTSP_CONTENT_TYPE_SDP);
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
-	client->request.is_pending = 1;
-	client->cseq++;
 	return 0;
 }
 
 
+int rtsp_client_describe(struct rtsp_client *client,
+			 const char *path,
+			 const struct rtsp_header_ext *ext,
+			 size_t ext_count,
+			 void *req_userdata,
+			 unsigned int timeout_ms)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.describe_resp == NULL, ENOSYS);
+
+	return rtsp_client_send_describe(client,
+					 NULL,
+					 path,
+					 ext,
+					 ext_count,
+					 req_userdata,
+					 timeout_ms);
+}
+
+
 int rtsp_client_announce(struct rtsp_client *client,
 			 const char *path,
 			 const char *session_description,
@@ -2265,7 +3067,7 @@ int rtsp_client_announce(struct rtsp_client *client,
 			 unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(session_description == NULL, EINVAL);
@@ -2284,39 +3086,32 @@ int rtsp_client_announce(struct rtsp_client *client,
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
 
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_ANNOUNCE;
-	client->request.header.uri = make_uri(client, path);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_ANNOUNCE;
+	req->header.uri = rtsp_client_make_uri(client, path);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0 && res != -EAGAIN) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.content_type = xstrdup(RTSP_CONTENT_TYPE_SDP);
-	client->request.header.content_length = session_description_len;
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.content_type = xstrdup(RTSP_CONTENT_TYPE_SDP);
+	req->header.content_length = session_description_len;
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, session_description, timeout_ms);
+	res = send_request(client, req, session_description, timeout_ms);
 	if (res < 0)
 		return res;
 
-	client->request.is_pending = 1;
-	client->cseq++;
 	return 0;
 }
 
@@ -2355,22 +3150,23 @@ static int allocate_interleaved_channels(struct rtsp_client *client,
 }
 
 
-int rtsp_client_setup(struct rtsp_client *client,
-		      const char *content_base,
-		      const char *resource_url,
-		      const char *session_id,
-		      enum rtsp_delivery delivery,
-		      enum rtsp_lower_transport lower_transport,
-		      uint16_t client_stream_port,
-		      uint16_t client_control_port,
-		      enum rtsp_transport_method method,
-		      const struct rtsp_header_ext *ext,
-		      size_t ext_count,
-		      void *req_userdata,
-		      unsigned int timeout_ms)
+int rtsp_client_send_setup(struct rtsp_client *client,
+			   const struct rtsp_client_cbs *cbs,
+			   const char *content_base,
+			   const char *resource_url,
+			   const char *session_id,
+			   enum rtsp_delivery delivery,
+			   enum rtsp_lower_transport lower_transport,
+			   uint16_t client_stream_port,
+			   uint16_t client_control_port,
+			   enum rtsp_transport_method method,
+			   const struct rtsp_header_ext *ext,
+			   size_t ext_count,
+			   void *req_userdata,
+			   unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 	char *_content_base = NULL;
 	struct rtsp_transport_header *th;
 
@@ -2391,7 +3187,6 @@ int rtsp_client_setup(struct rtsp_client *client,
 		ULOG_ERRNO_RETURN_ERR_IF(client_stream_port == 0, EINVAL);
 		ULOG_ERRNO_RETURN_ERR_IF(client_control_port == 0, EINVAL);
 	}
-	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.setup_resp == NULL, ENOSYS);
 	ULOG_ERRNO_RETURN_ERR_IF(
 		(client->methods_allowed != 0) &&
 			!(client->methods_allowed & RTSP_METHOD_FLAG_SETUP),
@@ -2400,13 +3195,9 @@ int rtsp_client_setup(struct rtsp_client *client,
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
 
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	/* If there is a pending request that is not a keep alive, remain in
-	 * busy state */
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	res = rtsp_url_strip_credentials(content_base, &_content_base);
@@ -2433,29 +3224,27 @@ int rtsp_client_setup(struct rtsp_client *client,
 	}
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_SETUP;
+	req->cbs = cbs;
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_SETUP;
 
 	res = format_request_uri(
-		client, _content_base, resource_url, &client->request.uri);
+		client, _content_base, resource_url, &req->header.uri);
 	if (res < 0)
 		goto out;
 
-	client->request.content_base = xstrdup(_content_base);
+	req->content_base = xstrdup(_content_base);
 
-	client->request.header.uri = xstrdup(client->request.uri);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
+	req->header.user_agent = xstrdup(client->software_name);
 
 	th = rtsp_transport_header_new();
-	client->request.header.transport[0] = th;
-	client->request.header.transport_count = 1;
+	req->header.transport[0] = th;
+	req->header.transport_count = 1;
 	th->transport_protocol = strdup(RTSP_TRANSPORT_PROTOCOL_RTP);
 	th->transport_profile = strdup(RTSP_TRANSPORT_PROFILE_AVP);
 	th->lower_transport = lower_transport;
@@ -2490,20 +3279,16 @@ int rtsp_client_setup(struct rtsp_client *client,
 		th->dst_stream_port = client_stream_port;
 		th->dst_control_port = client_control_port;
 	}
-	client->request.header.session_id = xstrdup(session_id);
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.session_id = xstrdup(session_id);
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		goto out;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		goto out;
 
-	client->request.is_pending = 1;
-	client->cseq++;
-
 	res = 0;
 
 out:
@@ -2512,23 +3297,57 @@ out:
 }
 
 
-int rtsp_client_play(struct rtsp_client *client,
-		     const char *session_id,
-		     const struct rtsp_range *range,
-		     float scale,
-		     const struct rtsp_header_ext *ext,
-		     size_t ext_count,
-		     void *req_userdata,
-		     unsigned int timeout_ms)
+int rtsp_client_setup(struct rtsp_client *client,
+		      const char *content_base,
+		      const char *resource_url,
+		      const char *session_id,
+		      enum rtsp_delivery delivery,
+		      enum rtsp_lower_transport lower_transport,
+		      uint16_t client_stream_port,
+		      uint16_t client_control_port,
+		      enum rtsp_transport_method method,
+		      const struct rtsp_header_ext *ext,
+		      size_t ext_count,
+		      void *req_userdata,
+		      unsigned int timeout_ms)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.setup_resp == NULL, ENOSYS);
+
+	return rtsp_client_send_setup(client,
+				      NULL,
+				      content_base,
+				      resource_url,
+				      session_id,
+				      delivery,
+				      lower_transport,
+				      client_stream_port,
+				      client_control_port,
+				      method,
+				      ext,
+				      ext_count,
+				      req_userdata,
+				      timeout_ms);
+}
+
+
+int rtsp_client_send_play(struct rtsp_client *client,
+			  const struct rtsp_client_cbs *cbs,
+			  const char *session_id,
+			  const struct rtsp_range *range,
+			  float scale,
+			  const struct rtsp_header_ext *ext,
+			  size_t ext_count,
+			  void *req_userdata,
+			  unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 	const struct rtsp_client_session *session;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(session_id == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(range == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.play_resp == NULL, ENOSYS);
 	ULOG_ERRNO_RETURN_ERR_IF(
 		(client->methods_allowed != 0) &&
 			!(client->methods_allowed & RTSP_METHOD_FLAG_PLAY),
@@ -2537,13 +3356,9 @@ int rtsp_client_play(struct rtsp_client *client,
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
 
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	/* If there is a pending request that is not a keep alive, remain in
-	 * busy state */
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Make sure that we know the session */
@@ -2554,36 +3369,56 @@ int rtsp_client_play(struct rtsp_client *client,
 	}
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_PLAY;
-	client->request.header.uri = xstrdup(session->content_base);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	req->cbs = cbs;
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_PLAY;
+	req->header.uri = xstrdup(session->content_base);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.session_id = xstrdup(session_id);
-	client->request.header.range = *range;
-	client->request.header.scale = scale;
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.session_id = xstrdup(session_id);
+	req->header.range = *range;
+	req->header.scale = scale;
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
-	client->request.is_pending = 1;
-	client->cseq++;
 	return 0;
 }
 
 
+int rtsp_client_play(struct rtsp_client *client,
+		     const char *session_id,
+		     const struct rtsp_range *range,
+		     float scale,
+		     const struct rtsp_header_ext *ext,
+		     size_t ext_count,
+		     void *req_userdata,
+		     unsigned int timeout_ms)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.play_resp == NULL, ENOSYS);
+
+	return rtsp_client_send_play(client,
+				     NULL,
+				     session_id,
+				     range,
+				     scale,
+				     ext,
+				     ext_count,
+				     req_userdata,
+				     timeout_ms);
+}
+
+
 int rtsp_client_pause(struct rtsp_client *client,
 		      const char *session_id,
 		      const struct rtsp_range *range,
@@ -2593,7 +3428,7 @@ int rtsp_client_pause(struct rtsp_client *client,
 		      unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 	const struct rtsp_client_session *session;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
@@ -2607,13 +3442,9 @@ int rtsp_client_pause(struct rtsp_client *client,
 
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	/* If there is a pending request that is not a keep alive, remain in
-	 * busy state */
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Make sure that we know the session */
@@ -2624,31 +3455,26 @@ int rtsp_client_pause(struct rtsp_client *client,
 	}
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_PAUSE;
-	client->request.header.uri = xstrdup(session->content_base);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_PAUSE;
+	req->header.uri = xstrdup(session->content_base);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.session_id = xstrdup(session_id);
-	client->request.header.range = *range;
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.session_id = xstrdup(session_id);
+	req->header.range = *range;
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
-	client->request.is_pending = 1;
-	client->cseq++;
 	return 0;
 }
 
@@ -2662,7 +3488,7 @@ int rtsp_client_record(struct rtsp_client *client,
 		       unsigned int timeout_ms)
 {
 	int res = 0;
-	int keep_alive_in_progress = 0;
+	struct rtsp_client_request *req;
 	struct rtsp_client_session *session;
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
@@ -2677,13 +3503,9 @@ int rtsp_client_record(struct rtsp_client *client,
 	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
 		return -EPIPE;
 
-	keep_alive_in_progress = clear_pending_keep_alive_timer(client);
-	if (keep_alive_in_progress < 0)
-		return keep_alive_in_progress;
-
-	/* If there is a pending request that is not a keep alive, remain in
-	 * busy state */
-	if (client->request.is_pending && !keep_alive_in_progress)
+	/* Too many requests in flight */
+	req = request_slot_get(client);
+	if (req == NULL)
 		return -EBUSY;
 
 	/* Make sure that we know the session */
@@ -2694,31 +3516,26 @@ int rtsp_client_record(struct rtsp_client *client,
 	}
 
 	/* Set request header */
-	rtsp_request_header_clear(&client->request.header);
-	client->request.userdata = req_userdata;
-	client->request.header.method = RTSP_METHOD_TYPE_RECORD;
-	client->request.header.uri = xstrdup(session->content_base);
-	client->request.header.cseq = client->cseq;
-	res = generate_authorization_header(client);
+	req->userdata = req_userdata;
+	req->header.method = RTSP_METHOD_TYPE_RECORD;
+	req->header.uri = xstrdup(session->content_base);
+	res = generate_authorization_header(client, &req->header);
 	if (res < 0) {
 		ULOG_ERRNO("generate_authorization_header", -res);
 		return res;
 	}
-	client->request.header.user_agent = xstrdup(client->software_name);
-	client->request.header.session_id = xstrdup(session_id);
-	client->request.header.range = *range;
-	res = rtsp_request_header_copy_ext(
-		&client->request.header, ext, ext_count);
+	req->header.user_agent = xstrdup(client->software_name);
+	req->header.session_id = xstrdup(session_id);
+	req->header.range = *range;
+	res = rtsp_request_header_copy_ext(&req->header, ext, ext_count);
 	if (res < 0)
 		return res;
 
 	/* Send the request */
-	res = send_request(client, NULL, timeout_ms);
+	res = send_request(client, req, NULL, timeout_ms);
 	if (res < 0)
 		return res;
 
-	client->request.is_pending = 1;
-	client->cseq++;
 	return 0;
 }
 
@@ -2728,9 +3545,9 @@ int rtsp_client_send_interleaved(struct rtsp_client *client,
 				 const uint8_t *data,
 				 size_t len)
 {
-	int res;
-	struct pomp_buffer *pomp_buf = NULL;
-	struct rtsp_interleaved_info info = {};
+	ssize_t res;
+	uint8_t header[RTSP_INTERLEAVED_HEADER_LEN];
+	struct iovec iov[2];
 
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(data == NULL, EINVAL);
@@ -2743,28 +3560,125 @@ int rtsp_client_send_interleaved(struct rtsp_client *client,
 	if (!client->channel_used[channel])
 		return -ENOENT;
 
-	info.channel = (uint8_t)channel;
-	info.data = data;
-	info.len = (uint16_t)len;
+	if (client->sock == NULL)
+		return -EPIPE;
+
+	/* The framing header is sent along with the caller's data in a
+	 * single gathered write, without copying the payload */
+	rtsp_interleaved_header_write(channel, len, header);
+	iov[0].iov_base = header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
 
-	res = rtsp_build_interleaved(&info, &pomp_buf);
-	if (res < 0) {
-		ULOG_ERRNO("rtsp_build_interleaved", -res);
-		goto out;
+	res = tx_writev(client, iov, 2, sizeof(header) + len);
+	if (res < 0)
+		return res;
+
+	return 0;
+}
+
+
+int rtsp_client_send_interleaved_batch(struct rtsp_client *client,
+				       const struct rtsp_interleaved_info *pkts,
+				       size_t count)
+{
+	int res;
+	ssize_t written;
+	size_t sent = 0;
+	uint8_t headers[RTSP_CLIENT_TX_BATCH_MAX][RTSP_INTERLEAVED_HEADER_LEN];
+	struct iovec iov[2 * RTSP_CLIENT_TX_BATCH_MAX];
+
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(pkts == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count > INT_MAX, EINVAL);
+
+	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
+		return -EPIPE;
+
+	if (client->sock == NULL)
+		return -EPIPE;
+
+	/* Check all packets before sending anything */
+	for (size_t i = 0; i < count; i++) {
+		ULOG_ERRNO_RETURN_ERR_IF(pkts[i].data == NULL, EINVAL);
+		ULOG_ERRNO_RETURN_ERR_IF(pkts[i].len == 0, EINVAL);
+		if (!client->channel_used[pkts[i].channel])
+			return -ENOENT;
 	}
 
-	/* Send the request */
-	res = send_raw_buf(client, pomp_buf);
-	if (res < 0) {
-		if (res != -EAGAIN)
-			ULOG_ERRNO("send_raw_buf", -res);
-		goto out;
+	if (!tx_pending_is_empty(client))
+		return -EAGAIN;
+
+	while (sent < count) {
+		size_t n = count - sent;
+		size_t total_len = 0;
+		size_t done = 0;
+		size_t off = 0;
+
+		if (n > RTSP_CLIENT_TX_BATCH_MAX)
+			n = RTSP_CLIENT_TX_BATCH_MAX;
+
+		for (size_t i = 0; i < n; i++) {
+			const struct rtsp_interleaved_info *pkt =
+				&pkts[sent + i];
+			rtsp_interleaved_header_write(
+				pkt->channel, pkt->len, headers[i]);
+			iov[2 * i].iov_base = headers[i];
+			iov[2 * i].iov_len = RTSP_INTERLEAVED_HEADER_LEN;
+			iov[2 * i + 1].iov_base = (void *)pkt->data;
+			iov[2 * i + 1].iov_len = pkt->len;
+			total_len += RTSP_INTERLEAVED_HEADER_LEN + pkt->len;
+		}
+
+		written = tskt_socket_writev(client->sock, iov, 2 * n);
+		if (written == -EAGAIN) {
+			res = tskt_socket_update_events(
+				client->sock, POMP_FD_EVENT_OUT, 0);
+			if (res < 0)
+				ULOG_ERRNO("tskt_socket_update_events", -res);
+			break;
+		} else if (written < 0) {
+			ULOG_ERRNO("tskt_socket_writev", (int)-written);
+			if (sent > 0)
+				break;
+			return written;
+		}
+
+		if ((size_t)written == total_len) {
+			sent += n;
+			continue;
+		}
+
+		/* Partial write: the packets fully written are sent, and
+		 * the rest of the one being written is kept to be sent
+		 * first when the socket is writable again */
+		while (done < n) {
+			size_t pkt_len = RTSP_INTERLEAVED_HEADER_LEN +
+					 pkts[sent + done].len;
+			if (off + pkt_len > (size_t)written)
+				break;
+			off += pkt_len;
+			done++;
+		}
+		if (off < (size_t)written) {
+			res = tx_pending_add(
+				client, &iov[2 * done], 2, written - off);
+			if (res < 0)
+				return res;
+			done++;
+		} else {
+			res = tskt_socket_update_events(
+				client->sock, POMP_FD_EVENT_OUT, 0);
+			if (res < 0)
+				ULOG_ERRNO("tskt_socket_update_events", -res);
+		}
+		sent += done;
+		break;
 	}
 
-out:
-	if (pomp_buf != NULL)
-		pomp_buffer_unref(pomp_buf);
-	return res;
+	return (sent > 0) ? (int)sent : -EAGAIN;
 }
 
 
@@ -2798,8 +3712,8 @@ int rtsp_client_cancel(struct rtsp_client *client)
 {
 	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
 
-	return request_complete(
-		client, NULL, NULL, 0, RTSP_CLIENT_REQ_STATUS_CANCELED);
+	request_complete_all(client, RTSP_CLIENT_REQ_STATUS_CANCELED);
+	return 0;
 }
 
 
@@ -2829,6 +3743,35 @@ int rtsp_client_set_socket_rxbuf_size(struct rtsp_client *client, size_t size)
 }
 
 
+int rtsp_client_set_reconnect_backoff(struct rtsp_client *client,
+				      unsigned int min_delay_ms,
+				      unsigned int max_delay_ms)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+
+	if (max_delay_ms == 0)
+		max_delay_ms = RTSP_CLIENT_RECONNECT_DEFAULT_MAX_DELAY_MS;
+	ULOG_ERRNO_RETURN_ERR_IF(
+		(min_delay_ms != 0) && (max_delay_ms < min_delay_ms), EINVAL);
+
+	client->reconnect.min_delay_ms = min_delay_ms;
+	client->reconnect.max_delay_ms = max_delay_ms;
+
+	return 0;
+}
+
+
+int rtsp_client_set_max_msg_size(struct rtsp_client *client, size_t size)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(size == 0, EINVAL);
+
+	client->max_msg_size = size;
+
+	return 0;
+}
+
+
 int rtsp_client_set_socket_class_selector(struct rtsp_client *client,
 					  uint32_t class_selector)
 {
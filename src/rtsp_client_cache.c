@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_client_priv.h"
+
+#define ULOG_TAG rtsp_client
+#include <ulog.h>
+
+
+static uint64_t cache_now_us(void)
+{
+	struct timespec ts = {0, 0};
+	uint64_t now_us = 0;
+
+	time_get_monotonic(&ts);
+	time_timespec_to_us(&ts, &now_us);
+
+	return now_us;
+}
+
+
+static void cache_entry_destroy(struct rtsp_client *client,
+				struct rtsp_client_cache_entry *entry)
+{
+	list_del(&entry->node);
+	client->cache.count--;
+	free(entry->uri);
+	free(entry->content_base);
+	free(entry->sdp);
+	free(entry);
+}
+
+
+static struct rtsp_client_cache_entry *cache_find(struct rtsp_client *client,
+						  const char *uri,
+						  int add)
+{
+	struct rtsp_client_cache_entry *entry;
+
+	if ((client->cache.ttl_ms == 0) || (uri == NULL))
+		return NULL;
+
+	list_walk_entry_forward(&client->cache.entries, entry, node)
+	{
+		if (strcmp(entry->uri, uri) == 0)
+			return entry;
+	}
+
+	if (!add)
+		return NULL;
+
+	/* Evict the least recently added entry */
+	if (client->cache.count >= RTSP_CLIENT_CACHE_MAX_ENTRIES) {
+		entry = list_entry(list_first(&client->cache.entries),
+				   struct rtsp_client_cache_entry,
+				   node);
+		cache_entry_destroy(client, entry);
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		ULOG_ERRNO("calloc", ENOMEM);
+		return NULL;
+	}
+	entry->uri = strdup(uri);
+	if (entry->uri == NULL) {
+		ULOG_ERRNO("strdup", ENOMEM);
+		free(entry);
+		return NULL;
+	}
+	list_node_unref(&entry->node);
+	list_add_before(&client->cache.entries, &entry->node);
+	client->cache.count++;
+
+	return entry;
+}
+
+
+uint32_t rtsp_client_cache_get_methods(struct rtsp_client *client)
+{
+	struct rtsp_client_cache_entry *entry;
+
+	entry = cache_find(client, client->remote.url_str, 0);
+	if ((entry == NULL) || (entry->methods_expiry_us < cache_now_us()))
+		return 0;
+
+	return entry->methods;
+}
+
+
+void rtsp_client_cache_set_methods(struct rtsp_client *client,
+				   uint32_t methods)
+{
+	struct rtsp_client_cache_entry *entry;
+
+	entry = cache_find(client, client->remote.url_str, 1);
+	if (entry == NULL)
+		return;
+
+	entry->methods = methods;
+	entry->methods_expiry_us =
+		cache_now_us() + (uint64_t)client->cache.ttl_ms * 1000;
+}
+
+
+int rtsp_client_cache_get_description(struct rtsp_client *client,
+				      const char *uri,
+				      const char **content_base,
+				      const char **sdp)
+{
+	struct rtsp_client_cache_entry *entry;
+
+	entry = cache_find(client, uri, 0);
+	if ((entry == NULL) || (entry->sdp == NULL) ||
+	    (entry->sdp_expiry_us < cache_now_us()))
+		return -ENOENT;
+
+	*content_base = entry->content_base;
+	*sdp = entry->sdp;
+
+	return 0;
+}
+
+
+void rtsp_client_cache_set_description(struct rtsp_client *client,
+				       const char *uri,
+				       const char *content_base,
+				       const char *sdp)
+{
+	struct rtsp_client_cache_entry *entry;
+	char *_content_base;
+	char *_sdp;
+
+	if (sdp == NULL)
+		return;
+
+	entry = cache_find(client, uri, 1);
+	if (entry == NULL)
+		return;
+
+	_content_base = xstrdup(content_base);
+	_sdp = strdup(sdp);
+	if (((content_base != NULL) && (_content_base == NULL)) ||
+	    (_sdp == NULL)) {
+		ULOG_ERRNO("strdup", ENOMEM);
+		free(_content_base);
+		free(_sdp);
+		return;
+	}
+
+	free(entry->content_base);
+	free(entry->sdp);
+	entry->content_base = _content_base;
+	entry->sdp = _sdp;
+	entry->sdp_expiry_us =
+		cache_now_us() + (uint64_t)client->cache.ttl_ms * 1000;
+}
+
+
+void rtsp_client_cache_remove_description(struct rtsp_client *client,
+					  const char *uri)
+{
+	struct rtsp_client_cache_entry *entry;
+
+	entry = cache_find(client, uri, 0);
+	if (entry == NULL)
+		return;
+
+	ULOGI("dropping the cached description of %s", uri);
+	xfree((void **)&entry->content_base);
+	xfree((void **)&entry->sdp);
+	entry->sdp_expiry_us = 0;
+}
+
+
+void rtsp_client_cache_clear(struct rtsp_client *client)
+{
+	struct rtsp_client_cache_entry *entry, *tmp;
+
+	list_walk_entry_forward_safe(&client->cache.entries, entry, tmp, node)
+	{
+		cache_entry_destroy(client, entry);
+	}
+}
+
+
+int rtsp_client_set_cache_ttl(struct rtsp_client *client, unsigned int ttl_ms)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+
+	if (ttl_ms == 0)
+		rtsp_client_cache_clear(client);
+	client->cache.ttl_ms = ttl_ms;
+
+	return 0;
+}
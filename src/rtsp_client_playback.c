@@ -0,0 +1,617 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_client_priv.h"
+
+#define ULOG_TAG rtsp_client
+#include <ulog.h>
+
+
+static int playback_describe(struct rtsp_client_playback *playback);
+
+
+static int playback_advance(struct rtsp_client_playback *playback);
+
+
+static void playback_reset_description(struct rtsp_client_playback *playback)
+{
+	for (size_t i = 0; i < playback->media_count; i++) {
+		free(playback->setups[i].type);
+		free(playback->setups[i].control_url);
+	}
+	xfree((void **)&playback->setups);
+	xfree((void **)&playback->medias);
+	xfree((void **)&playback->content_base);
+	xfree((void **)&playback->sdp);
+	playback->media_count = 0;
+	playback->next_setup = 0;
+	playback->from_cache = 0;
+}
+
+
+static void playback_destroy(struct rtsp_client_playback *playback)
+{
+	if (playback == NULL)
+		return;
+
+	playback_reset_description(playback);
+	free(playback->path);
+	free(playback->uri);
+	free(playback->session_id);
+	free(playback);
+}
+
+
+/* Free the playback start once completed and without requests in
+ * flight (their responses refer to it) */
+static void playback_release(struct rtsp_client_playback *playback)
+{
+	if (!playback->done || (playback->pending > 0))
+		return;
+
+	if (playback->client->playback == playback)
+		playback->client->playback = NULL;
+	playback_destroy(playback);
+}
+
+
+static void playback_complete(struct rtsp_client_playback *playback,
+			      enum rtsp_client_req_status req_status,
+			      int status,
+			      const struct rtsp_range *range)
+{
+	struct rtsp_client *client = playback->client;
+	struct timespec ts = {0, 0};
+	uint64_t now_us = 0;
+
+	if (playback->done)
+		return;
+	playback->done = 1;
+
+	time_get_monotonic(&ts);
+	time_timespec_to_us(&ts, &now_us);
+	ULOGI("playback start %s: status=%d medias=%zu time_to_play=%" PRIu64
+	      "ms",
+	      rtsp_client_req_status_str(req_status),
+	      status,
+	      playback->media_count,
+	      (now_us - playback->start_us) / 1000);
+
+	(*client->cbs.playback_resp)(client,
+				     playback->session_id,
+				     req_status,
+				     status,
+				     playback->content_base,
+				     playback->sdp,
+				     playback->medias,
+				     playback->media_count,
+				     range,
+				     client->cbs_userdata,
+				     playback->userdata);
+}
+
+
+/* Find the media sections of a session description and their control
+ * URL (RFC 2326 appendix C.1.1); the rest of the SDP is left to the
+ * application */
+static int playback_sdp_parse(struct rtsp_client_playback *playback,
+			      const char *sdp)
+{
+	const char *line = sdp;
+	const char *end;
+	size_t len;
+	struct rtsp_client_playback_setup *setup = NULL;
+	struct rtsp_client_playback_setup *setups;
+
+	while (*line != '\0') {
+		end = strchr(line, '\n');
+		if (end == NULL)
+			end = line + strlen(line);
+		len = end - line;
+		if ((len > 0) && (line[len - 1] == '\r'))
+			len--;
+
+		if ((len > 2) && (strncmp(line, "m=", 2) == 0)) {
+			setups = realloc(playback->setups,
+					 (playback->media_count + 1) *
+						 sizeof(*setups));
+			if (setups == NULL)
+				return -ENOMEM;
+			playback->setups = setups;
+			setup = &setups[playback->media_count++];
+			memset(setup, 0, sizeof(*setup));
+			setup->playback = playback;
+			setup->index = playback->media_count - 1;
+			setup->type =
+				strndup(line + 2, strcspn(line + 2, " \r\n"));
+			if (setup->type == NULL)
+				return -ENOMEM;
+		} else if ((setup != NULL) && (setup->control_url == NULL) &&
+			   (len > 10) &&
+			   (strncmp(line, "a=control:", 10) == 0)) {
+			if ((len != 11) || (line[10] != '*')) {
+				/* Not the aggregate control URL */
+				setup->control_url =
+					strndup(line + 10, len - 10);
+				if (setup->control_url == NULL)
+					return -ENOMEM;
+			}
+		}
+
+		line = (*end == '\0') ? end : end + 1;
+	}
+
+	if (playback->media_count == 0)
+		return 0;
+
+	playback->medias =
+		calloc(playback->media_count, sizeof(*playback->medias));
+	if (playback->medias == NULL)
+		return -ENOMEM;
+	for (size_t i = 0; i < playback->media_count; i++) {
+		playback->medias[i].type = playback->setups[i].type;
+		playback->medias[i].control_url =
+			playback->setups[i].control_url;
+		/* Not set up yet */
+		playback->medias[i].status = -EAGAIN;
+	}
+
+	return 0;
+}
+
+
+static int playback_set_description(struct rtsp_client_playback *playback,
+				    const char *content_base,
+				    const char *sdp)
+{
+	int ret;
+
+	playback->content_base = xstrdup(content_base);
+	playback->sdp = xstrdup(sdp);
+	if ((playback->content_base == NULL) || (playback->sdp == NULL))
+		return -ENOMEM;
+
+	ret = playback_sdp_parse(playback, sdp);
+	if (ret < 0)
+		return ret;
+	if (playback->media_count == 0) {
+		ULOGE("playback start: no media in the session description");
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+
+static void playback_options_resp(struct rtsp_client *client,
+				  enum rtsp_client_req_status req_status,
+				  int status,
+				  uint32_t methods,
+				  const struct rtsp_header_ext *ext,
+				  size_t ext_count,
+				  void *userdata,
+				  void *req_userdata)
+{
+	struct rtsp_client_playback *playback = req_userdata;
+
+	UNUSED(client);
+	UNUSED(methods);
+	UNUSED(ext);
+	UNUSED(ext_count);
+	UNUSED(userdata);
+
+	playback->pending--;
+
+	/* The DESCRIBE request was pipelined: only log failures */
+	if (req_status != RTSP_CLIENT_REQ_STATUS_OK) {
+		ULOGW("playback start: OPTIONS %s (%d)",
+		      rtsp_client_req_status_str(req_status),
+		      status);
+	}
+
+	playback_release(playback);
+}
+
+
+static void playback_describe_resp(struct rtsp_client *client,
+				   enum rtsp_client_req_status req_status,
+				   int status,
+				   const char *content_base,
+				   const struct rtsp_header_ext *ext,
+				   size_t ext_count,
+				   const char *sdp,
+				   void *userdata,
+				   void *req_userdata)
+{
+	int ret;
+	struct rtsp_client_playback *playback = req_userdata;
+
+	UNUSED(client);
+	UNUSED(ext);
+	UNUSED(ext_count);
+	UNUSED(userdata);
+
+	playback->pending--;
+	if (playback->done)
+		goto out;
+
+	if (req_status != RTSP_CLIENT_REQ_STATUS_OK) {
+		playback_complete(playback, req_status, status, NULL);
+		goto out;
+	}
+
+	ret = playback_set_description(playback, content_base, sdp);
+	if (ret < 0)
+		goto error;
+
+	ret = playback_advance(playback);
+	if (ret < 0)
+		goto error;
+	goto out;
+
+error:
+	ULOG_ERRNO("playback start", -ret);
+	playback_complete(playback, RTSP_CLIENT_REQ_STATUS_FAILED, ret, NULL);
+out:
+	playback_release(playback);
+}
+
+
+static void playback_setup_resp(struct rtsp_client *client,
+				const char *session_id,
+				enum rtsp_client_req_status req_status,
+				int status,
+				uint16_t src_stream_port,
+				uint16_t src_control_port,
+				int ssrc_valid,
+				uint32_t ssrc,
+				const struct rtsp_header_ext *ext,
+				size_t ext_count,
+				void *userdata,
+				void *req_userdata)
+{
+	int ret;
+	struct rtsp_client_playback_setup *setup = req_userdata;
+	struct rtsp_client_playback *playback = setup->playback;
+	struct rtsp_client_playback_media *media =
+		&playback->medias[setup->index];
+
+	UNUSED(client);
+	UNUSED(ext);
+	UNUSED(ext_count);
+	UNUSED(userdata);
+
+	playback->pending--;
+
+	if (req_status != RTSP_CLIENT_REQ_STATUS_OK) {
+		media->status = (status < 0) ? status : -EPROTO;
+		ULOGW("playback start: SETUP of media %zu %s (%d)",
+		      setup->index,
+		      rtsp_client_req_status_str(req_status),
+		      status);
+		/* Not fatal for the other medias, whose SETUP requests
+		 * may still be waiting for a free slot */
+		if (setup->index > 0)
+			goto advance;
+		if (playback->from_cache &&
+		    (req_status == RTSP_CLIENT_REQ_STATUS_FAILED)) {
+			/* The cached description is probably outdated:
+			 * drop it and start over from DESCRIBE */
+			rtsp_client_cache_remove_description(playback->client,
+							     playback->uri);
+			playback_reset_description(playback);
+			ret = playback_describe(playback);
+			if (ret < 0) {
+				playback_complete(playback,
+						  RTSP_CLIENT_REQ_STATUS_FAILED,
+						  ret,
+						  NULL);
+			}
+			goto out;
+		}
+		/* The session is created by the first SETUP */
+		playback_complete(playback, req_status, status, NULL);
+		goto out;
+	}
+
+	media->status = 0;
+	media->src_stream_port = src_stream_port;
+	media->src_control_port = src_control_port;
+	media->ssrc_valid = ssrc_valid;
+	media->ssrc = ssrc;
+
+	if ((setup->index == 0) && (playback->session_id == NULL)) {
+		playback->session_id = xstrdup(session_id);
+		if (playback->session_id == NULL) {
+			ULOG_ERRNO("strdup", ENOMEM);
+			playback_complete(playback,
+					  RTSP_CLIENT_REQ_STATUS_FAILED,
+					  -ENOMEM,
+					  NULL);
+			goto out;
+		}
+	}
+
+advance:
+	if (playback->done)
+		goto out;
+	ret = playback_advance(playback);
+	if (ret < 0) {
+		playback_complete(
+			playback, RTSP_CLIENT_REQ_STATUS_FAILED, ret, NULL);
+	}
+
+out:
+	playback_release(playback);
+}
+
+
+static void playback_play_resp(struct rtsp_client *client,
+			       const char *session_id,
+			       enum rtsp_client_req_status req_status,
+			       int status,
+			       const struct rtsp_range *range,
+			       float scale,
+			       int seq_valid,
+			       uint16_t seq,
+			       int rtptime_valid,
+			       uint32_t rtptime,
+			       const struct rtsp_header_ext *ext,
+			       size_t ext_count,
+			       void *userdata,
+			       void *req_userdata)
+{
+	struct rtsp_client_playback *playback = req_userdata;
+
+	UNUSED(client);
+	UNUSED(session_id);
+	UNUSED(scale);
+	UNUSED(seq_valid);
+	UNUSED(seq);
+	UNUSED(rtptime_valid);
+	UNUSED(rtptime);
+	UNUSED(ext);
+	UNUSED(ext_count);
+	UNUSED(userdata);
+
+	playback->pending--;
+	playback_complete(playback, req_status, status, range);
+	playback_release(playback);
+}
+
+
+static const struct rtsp_client_cbs s_playback_cbs = {
+	.options_resp = &playback_options_resp,
+	.describe_resp = &playback_describe_resp,
+	.setup_resp = &playback_setup_resp,
+	.play_resp = &playback_play_resp,
+};
+
+
+static int playback_describe(struct rtsp_client_playback *playback)
+{
+	int ret;
+
+	ret = rtsp_client_send_describe(playback->client,
+					&s_playback_cbs,
+					playback->path,
+					NULL,
+					0,
+					playback,
+					playback->timeout_ms);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_client_send_describe", -ret);
+		return ret;
+	}
+	playback->pending++;
+
+	return 0;
+}
+
+
+/* Send the requests that can be sent: the first SETUP, then once the
+ * session exists the other SETUP requests and PLAY, back-to-back; when
+ * too many requests are in flight, the next response resumes it */
+static int playback_advance(struct rtsp_client_playback *playback)
+{
+	int ret;
+	struct rtsp_client *client = playback->client;
+	struct rtsp_client_playback_setup *setup;
+	uint16_t port = 0;
+
+	while (playback->next_setup < playback->media_count) {
+		setup = &playback->setups[playback->next_setup];
+		if ((setup->index > 0) && (playback->session_id == NULL))
+			return 0;
+
+		if (playback->lower_transport == RTSP_LOWER_TRANSPORT_UDP)
+			port = playback->udp_port + 2 * setup->index;
+		ret = rtsp_client_send_setup(
+			client,
+			&s_playback_cbs,
+			playback->content_base,
+			(setup->control_url != NULL) ? setup->control_url
+						     : playback->content_base,
+			playback->session_id,
+			RTSP_DELIVERY_UNICAST,
+			playback->lower_transport,
+			port,
+			(port != 0) ? port + 1 : 0,
+			RTSP_TRANSPORT_METHOD_UNKNOWN,
+			NULL,
+			0,
+			setup,
+			playback->timeout_ms);
+		if (ret == -EBUSY && playback->pending > 0)
+			return 0;
+		playback->next_setup++;
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_client_send_setup", -ret);
+			playback->medias[setup->index].status = ret;
+			if (setup->index == 0)
+				return ret;
+			continue;
+		}
+		playback->pending++;
+		if (setup->index == 0)
+			return 0;
+	}
+
+	if (playback->play_sent)
+		return 0;
+
+	ret = rtsp_client_send_play(client,
+				    &s_playback_cbs,
+				    playback->session_id,
+				    &playback->range,
+				    playback->scale,
+				    NULL,
+				    0,
+				    playback,
+				    playback->timeout_ms);
+	if (ret == -EBUSY && playback->pending > 0)
+		return 0;
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_client_send_play", -ret);
+		return ret;
+	}
+	playback->play_sent = 1;
+	playback->pending++;
+
+	return 0;
+}
+
+
+void rtsp_client_playback_clear(struct rtsp_client *client)
+{
+	playback_destroy(client->playback);
+	client->playback = NULL;
+}
+
+
+int rtsp_client_start_playback(struct rtsp_client *client,
+			       const struct rtsp_client_playback_params *params,
+			       void *req_userdata)
+{
+	int ret;
+	struct rtsp_client_playback *playback;
+	struct timespec ts = {0, 0};
+	const char *content_base;
+	const char *sdp;
+
+	ULOG_ERRNO_RETURN_ERR_IF(client == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(params == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(
+		(params->lower_transport == RTSP_LOWER_TRANSPORT_UDP) &&
+			(params->udp_port == 0),
+		EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(client->cbs.playback_resp == NULL, ENOSYS);
+
+	if (client->conn_state != RTSP_CLIENT_CONN_STATE_CONNECTED)
+		return -EPIPE;
+	if (client->playback != NULL)
+		return -EBUSY;
+
+	playback = calloc(1, sizeof(*playback));
+	ULOG_ERRNO_RETURN_ERR_IF(playback == NULL, ENOMEM);
+	playback->client = client;
+	playback->userdata = req_userdata;
+	playback->lower_transport = params->lower_transport;
+	playback->udp_port = params->udp_port;
+	playback->scale = params->scale;
+	playback->timeout_ms = params->timeout_ms;
+	if (params->range != NULL) {
+		playback->range = *params->range;
+	} else {
+		playback->range.start.format = RTSP_TIME_FORMAT_NPT;
+		playback->range.start.npt.now = 1;
+		playback->range.stop.format = RTSP_TIME_FORMAT_NPT;
+		playback->range.stop.npt.infinity = 1;
+	}
+	playback->path = xstrdup(params->path);
+	if ((params->path != NULL) && (playback->path == NULL)) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	playback->uri = rtsp_client_make_uri(client, params->path);
+	if (playback->uri == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	time_get_monotonic(&ts);
+	time_timespec_to_us(&ts, &playback->start_us);
+
+	/* Go straight to SETUP with a cached description */
+	ret = rtsp_client_cache_get_description(
+		client, playback->uri, &content_base, &sdp);
+	if (ret == 0) {
+		ULOGI("playback start: using the cached description of %s",
+		      playback->uri);
+		ret = playback_set_description(playback, content_base, sdp);
+		if (ret < 0)
+			goto error;
+		playback->from_cache = 1;
+		ret = playback_advance(playback);
+		if (ret < 0)
+			goto error;
+		client->playback = playback;
+		return 0;
+	}
+
+	/* The server methods are only needed once per connection; the
+	 * DESCRIBE request does not wait for the OPTIONS response */
+	if (client->methods_allowed == 0) {
+		ret = rtsp_client_send_options(client,
+					       &s_playback_cbs,
+					       NULL,
+					       0,
+					       playback,
+					       playback->timeout_ms);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_client_send_options", -ret);
+			goto error;
+		}
+		playback->pending++;
+	}
+
+	ret = playback_describe(playback);
+	if (ret < 0)
+		goto error;
+
+	client->playback = playback;
+	return 0;
+
+error:
+	if (playback->pending > 0) {
+		/* The requests sent refer to the playback start */
+		playback->done = 1;
+		client->playback = playback;
+		return ret;
+	}
+	playback_destroy(playback);
+	return ret;
+}
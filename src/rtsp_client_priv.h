@@ -45,6 +45,15 @@
 #define RTSP_CLIENT_MAX_FAILED_REQUESTS 5
 #define RTSP_CLIENT_MAX_FAILED_KEEP_ALIVE 3
 #define RTSP_CLIENT_RESOLV_TIMEOUT_MS 5000
+#define RTSP_CLIENT_RECONNECT_DEFAULT_MAX_DELAY_MS 8000
+/* Resolved addresses raced when connecting, and delay before starting
+ * the next attempt (RFC 8305 'Connection Attempt Delay') */
+#define RTSP_CLIENT_CONNECT_MAX_ADDRS 8
+#define RTSP_CLIENT_CONNECT_ATTEMPT_DELAY_MS 250
+/* Maximum number of interleaved packets per gathered write */
+#define RTSP_CLIENT_TX_BATCH_MAX 32
+/* Maximum number of requests in flight (power of 2) */
+#define RTSP_CLIENT_MAX_INFLIGHT 8
 
 
 enum rtsp_client_state {
@@ -84,6 +93,8 @@ struct rtsp_client_session {
 	unsigned int failed_keep_alive;
 	int keep_alive_in_progress;
 	int internal_teardown;
+	/* Last PLAY succeeded (not paused since) */
+	int playing;
 
 	/* Medias */
 	unsigned int media_count;
@@ -93,6 +104,83 @@ struct rtsp_client_session {
 };
 
 
+/* SETUP request of a media in a playback start */
+struct rtsp_client_playback_setup {
+	struct rtsp_client_playback *playback;
+	size_t index;
+	char *type;
+	char *control_url;
+};
+
+
+/* Maximum number of cached URLs, see rtsp_client_set_cache_ttl() */
+#define RTSP_CLIENT_CACHE_MAX_ENTRIES 16
+
+
+/* Results of the OPTIONS request to a server URL and of the DESCRIBE
+ * request to a URI, kept across reconnections */
+struct rtsp_client_cache_entry {
+	struct list_node node;
+	char *uri;
+	/* OPTIONS result (0 if unknown) */
+	uint32_t methods;
+	uint64_t methods_expiry_us;
+	/* DESCRIBE result (sdp is NULL if unknown) */
+	char *content_base;
+	char *sdp;
+	uint64_t sdp_expiry_us;
+};
+
+
+/* Playback start in progress, see rtsp_client_start_playback() */
+struct rtsp_client_playback {
+	struct rtsp_client *client;
+	void *userdata;
+	char *path;
+	/* URI of the DESCRIBE request, key of the cached description */
+	char *uri;
+	enum rtsp_lower_transport lower_transport;
+	uint16_t udp_port;
+	struct rtsp_range range;
+	float scale;
+	unsigned int timeout_ms;
+	uint64_t start_us;
+
+	char *content_base;
+	char *sdp;
+	/* The description comes from the cache, see
+	 * rtsp_client_set_cache_ttl() */
+	int from_cache;
+	char *session_id;
+	struct rtsp_client_playback_setup *setups;
+	struct rtsp_client_playback_media *medias;
+	size_t media_count;
+	/* Index of the next SETUP request to send */
+	size_t next_setup;
+	int play_sent;
+	/* Requests of the playback start in flight */
+	unsigned int pending;
+	/* The completion has been called */
+	int done;
+};
+
+
+/* Request sent and waiting for its response */
+struct rtsp_client_request {
+	struct rtsp_client *client;
+	struct rtsp_request_header header;
+	int is_pending;
+	int is_internal;
+	char *content_base;
+	/* Callbacks for the response, if not the client ones (requests
+	 * sent internally, e.g. by rtsp_client_start_playback()) */
+	const struct rtsp_client_cbs *cbs;
+	void *userdata;
+	/* Response timeout */
+	struct pomp_timer *timer;
+};
+
+
 struct rtsp_client {
 	struct pomp_loop *loop;
 	struct tskt_client *tclient;
@@ -105,6 +193,8 @@ struct rtsp_client {
 	struct rtsp_client_cbs cbs;
 	void *cbs_userdata;
 	char *software_name;
+	size_t max_msg_size;
+	struct rtsp_date_cache date;
 	struct rtsp_authorization_header *auth;
 	struct rtsp_authorization_header *server_auth;
 	bool channel_used[UINT8_MAX + 1];
@@ -121,6 +211,31 @@ struct rtsp_client {
 		struct pomp_timer *timer;
 	} resolv;
 
+	/* Connection attempts racing over the resolved addresses, IPv6 and
+	 * IPv4 interleaved (RFC 8305); the first attempt uses tclient, the
+	 * first one connected becomes tclient */
+	struct {
+		char *addrs[RTSP_CLIENT_CONNECT_MAX_ADDRS];
+		struct tskt_client *tclients[RTSP_CLIENT_CONNECT_MAX_ADDRS];
+		unsigned int count;
+		unsigned int started;
+		/* Bit field of the failed attempts */
+		uint32_t failed;
+		struct pomp_timer *timer;
+	} race;
+
+	/* Reconnection after a network disconnection, see
+	 * rtsp_client_set_reconnect_backoff() */
+	struct {
+		unsigned int min_delay_ms;
+		unsigned int max_delay_ms;
+		/* Delay before the next attempt, without jitter */
+		unsigned int delay_ms;
+		unsigned int attempts;
+		uint64_t disconnect_us;
+		struct pomp_timer *timer;
+	} reconnect;
+
 	/* RTSPS */
 	bool secure;
 	bool ttls_init;
@@ -134,21 +249,40 @@ struct rtsp_client {
 	unsigned int failed_requests;
 
 	struct {
-		struct rtsp_request_header header;
 		struct pomp_buffer *buf;
-		int is_pending;
-		int is_internal;
-		char *uri;
-		char *content_base;
-		void *userdata;
-		struct pomp_timer *timer;
+		/* Requests in flight, indexed by CSeq modulo
+		 * RTSP_CLIENT_MAX_INFLIGHT; responses are matched by CSeq,
+		 * so that independent requests can be pipelined */
+		struct rtsp_client_request slots[RTSP_CLIENT_MAX_INFLIGHT];
+		unsigned int count;
 	} request;
 
 	struct {
 		struct pomp_buffer *buf;
 	} response;
 
+	struct {
+		/* Interleaved packets delivered to interleaved_batch_cb */
+		struct rtsp_interleaved_info *batch;
+		size_t batch_capacity;
+	} rx;
+
+	struct {
+		/* Data left after a partial write (see tx_writev) */
+		struct pomp_buffer *pending;
+		size_t pending_off;
+	} tx;
+
 	struct rtsp_message_parser_ctx parser_ctx;
+
+	struct rtsp_client_playback *playback;
+
+	/* See rtsp_client_set_cache_ttl() */
+	struct {
+		unsigned int ttl_ms;
+		struct list_node entries;
+		size_t count;
+	} cache;
 };
 
 
@@ -192,12 +326,111 @@ rtsp_client_session_media_find(const struct rtsp_client *client,
 void rtsp_client_pomp_timer_cb(struct pomp_timer *timer, void *userdata);
 
 
-static inline bool is_channel_pair_valid(const struct rtsp_channel_pair *pair)
-{
-	if (!pair)
-		return false;
-	return (pair->rtp != pair->rtcp);
-}
+/* Free a playback start still in progress, without calling its
+ * completion (client destruction) */
+void rtsp_client_playback_clear(struct rtsp_client *client);
+
+
+char *rtsp_client_make_uri(struct rtsp_client *client, const char *path);
+
+
+/* Cached methods of the current server, 0 if unknown or stale */
+uint32_t rtsp_client_cache_get_methods(struct rtsp_client *client);
+
+
+void rtsp_client_cache_set_methods(struct rtsp_client *client,
+				   uint32_t methods);
+
+
+/* The strings are owned by the cache and only valid until the next
+ * cache update */
+RTSP_API int
+rtsp_client_cache_get_description(struct rtsp_client *client,
+				  const char *uri,
+				  const char **content_base,
+				  const char **sdp);
+
+
+RTSP_API void
+rtsp_client_cache_set_description(struct rtsp_client *client,
+				  const char *uri,
+				  const char *content_base,
+				  const char *sdp);
+
+
+void rtsp_client_cache_remove_description(struct rtsp_client *client,
+					  const char *uri);
+
+
+void rtsp_client_cache_clear(struct rtsp_client *client);
+
+
+/* Variants of the rtsp_client_*() request functions with the callbacks
+ * to use for the response (or NULL for the client callbacks) */
+int rtsp_client_send_options(struct rtsp_client *client,
+			     const struct rtsp_client_cbs *cbs,
+			     const struct rtsp_header_ext *ext,
+			     size_t ext_count,
+			     void *req_userdata,
+			     unsigned int timeout_ms);
+
+
+int rtsp_client_send_describe(struct rtsp_client *client,
+			      const struct rtsp_client_cbs *cbs,
+			      const char *path,
+			      const struct rtsp_header_ext *ext,
+			      size_t ext_count,
+			      void *req_userdata,
+			      unsigned int timeout_ms);
+
+
+int rtsp_client_send_setup(struct rtsp_client *client,
+			   const struct rtsp_client_cbs *cbs,
+			   const char *content_base,
+			   const char *resource_url,
+			   const char *session_id,
+			   enum rtsp_delivery delivery,
+			   enum rtsp_lower_transport lower_transport,
+			   uint16_t client_stream_port,
+			   uint16_t client_control_port,
+			   enum rtsp_transport_method method,
+			   const struct rtsp_header_ext *ext,
+			   size_t ext_count,
+			   void *req_userdata,
+			   unsigned int timeout_ms);
+
+
+int rtsp_client_send_play(struct rtsp_client *client,
+			  const struct rtsp_client_cbs *cbs,
+			  const char *session_id,
+			  const struct rtsp_range *range,
+			  float scale,
+			  const struct rtsp_header_ext *ext,
+			  size_t ext_count,
+			  void *req_userdata,
+			  unsigned int timeout_ms);
+
+
+/* Order the resolved addresses for the connection race: alternate the
+ * address families, starting with the family of the first address
+ * (RFC 8305 chapter 4); returns the number of addresses kept, at most
+ * RTSP_CLIENT_CONNECT_MAX_ADDRS */
+RTSP_API unsigned int rtsp_client_sort_addrs(const char *const *addrs,
+					     int naddrs,
+					     const char **sorted);
+
+
+/* Connect to the (sorted) resolved addresses of the URL host, racing
+ * them if there are several */
+RTSP_API int rtsp_client_connect_addrs(struct rtsp_client *client,
+				       const char *const *addrs,
+				       unsigned int count);
+
+
+/* Get the delay of the next reconnection attempt, randomized by up to
+ * half of its value, and double the delay of the following one up to
+ * the maximum */
+RTSP_API unsigned int rtsp_client_reconnect_delay(struct rtsp_client *client);
 
 
 static inline void set_channel_pair_used(bool *channel_used,
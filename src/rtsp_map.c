@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+
+#define ULOG_TAG rtsp
+#include <ulog.h>
+
+
+#define RTSP_MAP_MIN_CAPACITY 16
+
+
+/* 64-bit finalizer (splitmix64) to spread pointer and identifier keys */
+static inline uint64_t rtsp_map_hash(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+
+static int rtsp_map_resize(struct rtsp_map *map, size_t capacity)
+{
+	struct rtsp_map_entry *entries;
+	struct rtsp_map_entry *old_entries = map->entries;
+	size_t old_capacity = map->capacity;
+
+	entries = calloc(capacity, sizeof(*entries));
+	if (entries == NULL)
+		return -ENOMEM;
+
+	map->entries = entries;
+	map->capacity = capacity;
+	map->count = 0;
+
+	for (size_t i = 0; i < old_capacity; i++) {
+		if (old_entries[i].value == NULL)
+			continue;
+		size_t mask = capacity - 1;
+		size_t j = rtsp_map_hash(old_entries[i].key) & mask;
+		while (entries[j].value != NULL)
+			j = (j + 1) & mask;
+		entries[j] = old_entries[i];
+		map->count++;
+	}
+
+	free(old_entries);
+
+	return 0;
+}
+
+
+void rtsp_map_clear(struct rtsp_map *map)
+{
+	if (map == NULL)
+		return;
+
+	free(map->entries);
+	memset(map, 0, sizeof(*map));
+}
+
+
+void *rtsp_map_get(const struct rtsp_map *map, uint64_t key)
+{
+	size_t mask;
+	size_t i;
+
+	ULOG_ERRNO_RETURN_VAL_IF(map == NULL, EINVAL, NULL);
+
+	if (map->count == 0)
+		return NULL;
+
+	mask = map->capacity - 1;
+	i = rtsp_map_hash(key) & mask;
+	while (map->entries[i].value != NULL) {
+		if (map->entries[i].key == key)
+			return map->entries[i].value;
+		i = (i + 1) & mask;
+	}
+
+	return NULL;
+}
+
+
+int rtsp_map_put(struct rtsp_map *map, uint64_t key, void *value)
+{
+	int ret;
+	size_t mask;
+	size_t i;
+
+	ULOG_ERRNO_RETURN_ERR_IF(map == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(value == NULL, EINVAL);
+
+	/* Keep the load factor below 3/4 */
+	if ((map->count + 1) * 4 > map->capacity * 3) {
+		ret = rtsp_map_resize(map,
+				      (map->capacity == 0)
+					      ? RTSP_MAP_MIN_CAPACITY
+					      : map->capacity * 2);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_map_resize", -ret);
+			return ret;
+		}
+	}
+
+	mask = map->capacity - 1;
+	i = rtsp_map_hash(key) & mask;
+	while (map->entries[i].value != NULL) {
+		if (map->entries[i].key == key)
+			return -EEXIST;
+		i = (i + 1) & mask;
+	}
+
+	map->entries[i].key = key;
+	map->entries[i].value = value;
+	map->count++;
+
+	return 0;
+}
+
+
+int rtsp_map_remove(struct rtsp_map *map, uint64_t key)
+{
+	size_t mask;
+	size_t i;
+	size_t j;
+	size_t home;
+
+	ULOG_ERRNO_RETURN_ERR_IF(map == NULL, EINVAL);
+
+	if (map->count == 0)
+		return -ENOENT;
+
+	mask = map->capacity - 1;
+	i = rtsp_map_hash(key) & mask;
+	while (map->entries[i].key != key || map->entries[i].value == NULL) {
+		if (map->entries[i].value == NULL)
+			return -ENOENT;
+		i = (i + 1) & mask;
+	}
+
+	/* Backward shift deletion: move the following entries of the
+	 * cluster into the hole when their home slot allows it, so that
+	 * no tombstone is needed */
+	j = i;
+	while (1) {
+		map->entries[i].value = NULL;
+		do {
+			j = (j + 1) & mask;
+			if (map->entries[j].value == NULL) {
+				map->count--;
+				return 0;
+			}
+			home = rtsp_map_hash(map->entries[j].key) & mask;
+		} while ((i <= j) ? ((i < home) && (home <= j))
+				  : ((i < home) || (home <= j)));
+		map->entries[i] = map->entries[j];
+		i = j;
+	}
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+
+#define ULOG_TAG rtsp
+#include <ulog.h>
+
+
+/* Vyukov's intrusive MPSC queue, with a stub node so that the queue is
+ * never empty from the producers point of view */
+void rtsp_mpsc_init(struct rtsp_mpsc *queue)
+{
+	queue->stub.next = NULL;
+	queue->head = &queue->stub;
+	queue->tail = &queue->stub;
+}
+
+
+void rtsp_mpsc_push(struct rtsp_mpsc *queue, struct rtsp_mpsc_node *node)
+{
+	struct rtsp_mpsc_node *prev;
+
+	__atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+	/* The node is only reachable by the consumer from here */
+	__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+
+struct rtsp_mpsc_node *rtsp_mpsc_pop(struct rtsp_mpsc *queue)
+{
+	struct rtsp_mpsc_node *tail = queue->tail;
+	struct rtsp_mpsc_node *next;
+	struct rtsp_mpsc_node *head;
+
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (tail == &queue->stub) {
+		if (next == NULL)
+			return NULL;
+		queue->tail = next;
+		tail = next;
+		next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+	}
+
+	if (next != NULL) {
+		queue->tail = next;
+		return tail;
+	}
+
+	head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+	if (tail != head) {
+		/* A producer is between its exchange and its link */
+		return NULL;
+	}
+
+	/* Last node: push the stub back so that it can be unlinked */
+	rtsp_mpsc_push(queue, &queue->stub);
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (next != NULL) {
+		queue->tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+
+static void mpsc_evt_drain(struct rtsp_mpsc_evt *mq, int process)
+{
+	struct rtsp_mpsc_node *node;
+
+	while ((node = rtsp_mpsc_pop(&mq->queue)) != NULL)
+		(*mq->cb)(node, process, mq->userdata);
+}
+
+
+/* Process all the posted nodes in a single wakeup */
+static void mpsc_evt_cb(struct pomp_evt *evt, void *userdata)
+{
+	struct rtsp_mpsc_evt *mq = userdata;
+
+	UNUSED(evt);
+
+	/* A node whose producer has not finished linking it is left in
+	 * the queue; that producer signals the event again */
+	mpsc_evt_drain(mq, 1);
+}
+
+
+int rtsp_mpsc_evt_init(struct rtsp_mpsc_evt *mq,
+		       struct pomp_loop *loop,
+		       rtsp_mpsc_evt_cb_t cb,
+		       void *userdata)
+{
+	int ret;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mq == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(loop == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(cb == NULL, EINVAL);
+
+	rtsp_mpsc_init(&mq->queue);
+	mq->loop = loop;
+	mq->cb = cb;
+	mq->userdata = userdata;
+
+	mq->evt = pomp_evt_new();
+	if (mq->evt == NULL) {
+		ULOG_ERRNO("pomp_evt_new", ENOMEM);
+		return -ENOMEM;
+	}
+
+	ret = pomp_evt_attach_to_loop(mq->evt, loop, &mpsc_evt_cb, mq);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_evt_attach_to_loop", -ret);
+		pomp_evt_destroy(mq->evt);
+		mq->evt = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+
+void rtsp_mpsc_evt_clear(struct rtsp_mpsc_evt *mq)
+{
+	int ret;
+
+	if ((mq == NULL) || (mq->evt == NULL))
+		return;
+
+	/* Drop the nodes that were never processed */
+	mpsc_evt_drain(mq, 0);
+
+	ret = pomp_evt_detach_from_loop(mq->evt, mq->loop);
+	if (ret < 0)
+		ULOG_ERRNO("pomp_evt_detach_from_loop", -ret);
+	ret = pomp_evt_destroy(mq->evt);
+	if (ret < 0)
+		ULOG_ERRNO("pomp_evt_destroy", -ret);
+	mq->evt = NULL;
+}
+
+
+int rtsp_mpsc_evt_post(struct rtsp_mpsc_evt *mq, struct rtsp_mpsc_node *node)
+{
+	int ret;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mq == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(node == NULL, EINVAL);
+
+	rtsp_mpsc_push(&mq->queue, node);
+	ret = pomp_evt_signal(mq->evt);
+	if (ret < 0)
+		ULOG_ERRNO("pomp_evt_signal", -ret);
+	return 0;
+}
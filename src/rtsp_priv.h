@@ -98,6 +98,46 @@ int rtsp_status_to_errno(int status);
 const char *rtsp_status_str(int status);
 
 
+int rtsp_status_line_write(int status_code,
+			   const char *status_string,
+			   struct rtsp_string *str);
+
+
+int rtsp_date_header_write(uint64_t date, struct rtsp_string *str);
+
+
+/* Current date (wall clock seconds since the Epoch) and its pre-serialized
+ * 'Date' line, rendered again only when the second changes */
+struct rtsp_date_cache {
+	uint64_t date;
+	struct rtsp_header_line line;
+};
+
+
+/* Get the current date (0 if unavailable) and refresh the cached line */
+uint64_t rtsp_date_cache_now(struct rtsp_date_cache *cache);
+
+
+/* Get the cached line of a date, NULL if it is not the cached date */
+const struct rtsp_header_line *
+rtsp_date_cache_line(const struct rtsp_date_cache *cache, uint64_t date);
+
+
+void rtsp_date_cache_clear(struct rtsp_date_cache *cache);
+
+
+/* Common method set (e.g. the librtsp server 'Public' methods) and its
+ * pre-serialized list, in the order of the method flags */
+#define RTSP_METHOD_FLAGS_PLAYBACK                                             \
+	(RTSP_METHOD_FLAG_DESCRIBE | RTSP_METHOD_FLAG_SETUP |                  \
+	 RTSP_METHOD_FLAG_PLAY | RTSP_METHOD_FLAG_PAUSE |                      \
+	 RTSP_METHOD_FLAG_TEARDOWN | RTSP_METHOD_FLAG_GET_PARAMETER)
+#define RTSP_METHOD_FLAGS_PLAYBACK_STR                                         \
+	RTSP_METHOD_DESCRIBE "," RTSP_METHOD_SETUP "," RTSP_METHOD_PLAY        \
+			     "," RTSP_METHOD_PAUSE "," RTSP_METHOD_TEARDOWN    \
+			     "," RTSP_METHOD_GET_PARAMETER
+
+
 int rtsp_allow_header_write(uint32_t methods, struct rtsp_string *str);
 
 
@@ -148,25 +188,30 @@ int rtsp_rtp_info_header_read(char *str,
 			      unsigned int *count);
 
 
-struct rtsp_transport_header *rtsp_transport_header_new(void);
+RTSP_API struct rtsp_transport_header *rtsp_transport_header_new(void);
 
 
-int rtsp_transport_header_free(struct rtsp_transport_header **transport);
+RTSP_API int
+rtsp_transport_header_free(struct rtsp_transport_header **transport);
 
 
 int rtsp_transport_header_copy(const struct rtsp_transport_header *src,
 			       struct rtsp_transport_header *dst);
 
 
-int rtsp_transport_header_write(struct rtsp_transport_header *const *transport,
-				unsigned int count,
-				struct rtsp_string *str);
+/* IPv6 addresses in the 'destination' and 'source' parameters are
+ * written and read enclosed in brackets */
+RTSP_API int
+rtsp_transport_header_write(struct rtsp_transport_header *const *transport,
+			    unsigned int count,
+			    struct rtsp_string *str);
 
 
-int rtsp_transport_header_read(char *str,
-			       struct rtsp_transport_header **transport,
-			       unsigned int max_count,
-			       unsigned int *count);
+RTSP_API int
+rtsp_transport_header_read(char *str,
+			   struct rtsp_transport_header **transport,
+			   unsigned int max_count,
+			   unsigned int *count);
 
 
 struct rtsp_authorization_header *rtsp_authorization_header_new(void);
@@ -265,6 +310,158 @@ int rtsp_url_parse_host_and_path(char *url, char **host, char **path);
 int rtsp_url_parse_path(char *url, char **path);
 
 
+/* Open addressing hash map (linear probing) with 64-bit keys;
+ * values must not be NULL */
+struct rtsp_map_entry {
+	uint64_t key;
+	void *value;
+};
+
+
+struct rtsp_map {
+	struct rtsp_map_entry *entries;
+	size_t capacity;
+	size_t count;
+};
+
+
+RTSP_API void rtsp_map_clear(struct rtsp_map *map);
+
+
+RTSP_API void *rtsp_map_get(const struct rtsp_map *map, uint64_t key);
+
+
+RTSP_API int rtsp_map_put(struct rtsp_map *map, uint64_t key, void *value);
+
+
+RTSP_API int rtsp_map_remove(struct rtsp_map *map, uint64_t key);
+
+
+/* Hierarchical timer wheel with RTSP_TWHEEL_LEVELS levels of
+ * RTSP_TWHEEL_SLOTS slots; setting and cancelling a timer is O(1).
+ * Timers further than the wheel range are cascaded until they expire. */
+#define RTSP_TWHEEL_SLOT_BITS 6
+#define RTSP_TWHEEL_SLOTS (1 << RTSP_TWHEEL_SLOT_BITS)
+#define RTSP_TWHEEL_LEVELS 3
+
+
+struct rtsp_twheel_timer;
+
+
+typedef void (*rtsp_twheel_cb_t)(struct rtsp_twheel_timer *timer,
+				 void *userdata);
+
+
+struct rtsp_twheel_timer {
+	rtsp_twheel_cb_t cb;
+	void *userdata;
+	/* Expiration time in ticks */
+	uint64_t expiry;
+	bool armed;
+	struct list_node node;
+};
+
+
+struct rtsp_twheel {
+	unsigned int tick_ms;
+	/* Current time in ticks */
+	uint64_t now;
+	unsigned int count;
+	struct list_node slots[RTSP_TWHEEL_LEVELS][RTSP_TWHEEL_SLOTS];
+};
+
+
+RTSP_API void rtsp_twheel_init(struct rtsp_twheel *wheel,
+			       unsigned int tick_ms);
+
+
+RTSP_API void rtsp_twheel_timer_init(struct rtsp_twheel_timer *timer,
+				     rtsp_twheel_cb_t cb,
+				     void *userdata);
+
+
+RTSP_API void rtsp_twheel_timer_set(struct rtsp_twheel *wheel,
+				    struct rtsp_twheel_timer *timer,
+				    uint64_t now_ms,
+				    uint32_t delay_ms);
+
+
+RTSP_API void rtsp_twheel_timer_cancel(struct rtsp_twheel *wheel,
+				       struct rtsp_twheel_timer *timer);
+
+
+RTSP_API void rtsp_twheel_advance(struct rtsp_twheel *wheel, uint64_t now_ms);
+
+
+/* Get the time in milliseconds of the next non-empty slot, when
+ * rtsp_twheel_advance() must be called next: the exact expiration for
+ * the first level, the cascade of the slot for the higher ones; returns
+ * -ENOENT if no timer is armed */
+RTSP_API int rtsp_twheel_next_expiry(const struct rtsp_twheel *wheel,
+				     uint64_t *expiry_ms);
+
+
+/* Intrusive lock-free queue with multiple producers and a single
+ * consumer: rtsp_mpsc_push() can be called from any thread and never
+ * blocks, rtsp_mpsc_pop() must only be called by the consumer thread */
+struct rtsp_mpsc_node {
+	struct rtsp_mpsc_node *next;
+};
+
+
+struct rtsp_mpsc {
+	/* Last pushed node (producers side) */
+	struct rtsp_mpsc_node *head;
+	/* Next node to pop (consumer side) */
+	struct rtsp_mpsc_node *tail;
+	struct rtsp_mpsc_node stub;
+};
+
+
+RTSP_API void rtsp_mpsc_init(struct rtsp_mpsc *queue);
+
+
+RTSP_API void rtsp_mpsc_push(struct rtsp_mpsc *queue,
+			     struct rtsp_mpsc_node *node);
+
+
+/* Returns NULL if the queue is empty, or if a producer has not finished
+ * linking its node yet (it is then available on the next call) */
+RTSP_API struct rtsp_mpsc_node *rtsp_mpsc_pop(struct rtsp_mpsc *queue);
+
+
+/* MPSC queue drained on a loop: rtsp_mpsc_evt_post() can be called from
+ * any thread and signals an event, the callback is then called on the
+ * loop thread for each node; it is called with 'process' set to 0 for
+ * the nodes dropped by rtsp_mpsc_evt_clear() */
+typedef void (*rtsp_mpsc_evt_cb_t)(struct rtsp_mpsc_node *node,
+				   int process,
+				   void *userdata);
+
+
+struct rtsp_mpsc_evt {
+	struct rtsp_mpsc queue;
+	struct pomp_evt *evt;
+	struct pomp_loop *loop;
+	rtsp_mpsc_evt_cb_t cb;
+	void *userdata;
+};
+
+
+int rtsp_mpsc_evt_init(struct rtsp_mpsc_evt *mq,
+		       struct pomp_loop *loop,
+		       rtsp_mpsc_evt_cb_t cb,
+		       void *userdata);
+
+
+void rtsp_mpsc_evt_clear(struct rtsp_mpsc_evt *mq);
+
+
+/* Returns 0 once the node is queued, even if the event cannot be
+ * signaled: the node is then processed on the next wakeup */
+int rtsp_mpsc_evt_post(struct rtsp_mpsc_evt *mq, struct rtsp_mpsc_node *node);
+
+
 #define MAX_RTSP_BASE64_LEN 4096
 
 
@@ -336,12 +533,104 @@ rtsp_auth_generate_digest_response(struct rtsp_authorization_header *auth,
 	} while (0)
 
 
+int rtsp_string_init(struct rtsp_string *str,
+		     struct pomp_buffer *buf,
+		     size_t limit);
+
+
+int rtsp_string_grow(struct rtsp_string *str, size_t size);
+
+
+/* String writer: appends without format string parsing; the lengths of
+ * the literals are computed at compile time */
+static inline int
+rtsp_string_append(struct rtsp_string *str, const char *data, size_t len)
+{
+	int ret;
+	if (str->len + len >= str->max_len) {
+		ret = rtsp_string_grow(str, str->len + len + 1);
+		if (ret < 0)
+			return ret;
+	}
+	memcpy(str->str + str->len, data, len);
+	str->len += len;
+	str->str[str->len] = '\0';
+	return 0;
+}
+
+
+static inline int rtsp_string_append_str(struct rtsp_string *str,
+					 const char *s)
+{
+	return rtsp_string_append(str, s, strlen(s));
+}
+
+
+#define rtsp_string_append_lit(_str, _lit)                                     \
+	rtsp_string_append((_str), "" _lit, sizeof(_lit) - 1)
+
+
+int rtsp_string_append_int(struct rtsp_string *str, int64_t val);
+
+
+/* Append a 'name: value' header line */
+int rtsp_string_append_field(struct rtsp_string *str,
+			     const char *name,
+			     size_t name_len,
+			     const char *value,
+			     size_t value_len);
+
+
+int rtsp_string_append_field_int(struct rtsp_string *str,
+				 const char *name,
+				 size_t name_len,
+				 int64_t value);
+
+
+#define rtsp_header_field_write_str(_str, _name, _value)                       \
+	rtsp_string_append_field(                                              \
+		(_str), "" _name, sizeof(_name) - 1, (_value), strlen(_value))
+
+
+#define rtsp_header_field_write_int(_str, _name, _value)                       \
+	rtsp_string_append_field_int(                                          \
+		(_str), "" _name, sizeof(_name) - 1, (_value))
+
+
+/* Copy the contents of src to a pre-serialized line */
+int rtsp_header_line_set(struct rtsp_header_line *line,
+			 const struct rtsp_string *src);
+
+
+void rtsp_header_line_clear(struct rtsp_header_line *line);
+
+
+/* Deep copy of an array of header extensions, to be released with
+ * rtsp_header_ext_array_free() */
+int rtsp_header_ext_array_copy(const struct rtsp_header_ext *src,
+			       size_t count,
+			       struct rtsp_header_ext **dst);
+
+
+void rtsp_header_ext_array_free(struct rtsp_header_ext *ext, size_t count);
+
+
+/* Format the address of an IPv4 or IPv6 socket address (IPv4-mapped
+ * IPv6 addresses are formatted as IPv4); str should be at least
+ * INET6_ADDRSTRLEN long */
+int rtsp_sockaddr_to_str(const struct sockaddr *addr,
+			 uint32_t addrlen,
+			 char *str,
+			 size_t len);
+
+
 /* clang-format off */
 __attribute__((__format__(__printf__, 2, 3)))
 static inline int rtsp_sprintf(struct rtsp_string *str, const char *fmt, ...)
 /* clang-format on */
 {
 	int len;
+	int ret;
 	if (str->len >= str->max_len)
 		return -ENOBUFS;
 	va_list args;
@@ -351,8 +640,22 @@ static inline int rtsp_sprintf(struct rtsp_string *str, const char *fmt, ...)
 	va_end(args);
 	if (len < 0)
 		return len;
-	if (len >= (signed)(str->max_len - str->len))
-		return -ENOBUFS;
+	if (len >= (signed)(str->max_len - str->len)) {
+		/* Grow the string if possible and format this part again */
+		ret = rtsp_string_grow(str, str->len + len + 1);
+		if (ret < 0)
+			return ret;
+		va_start(args, fmt);
+		len = vsnprintf(str->str + str->len,
+				str->max_len - str->len,
+				fmt,
+				args);
+		va_end(args);
+		if (len < 0)
+			return len;
+		if (len >= (signed)(str->max_len - str->len))
+			return -ENOBUFS;
+	}
 	str->len += len;
 	return 0;
 }
@@ -405,6 +708,14 @@ static inline char get_last_char(const char *str, size_t max_len)
 }
 
 
+static inline bool is_channel_pair_valid(const struct rtsp_channel_pair *pair)
+{
+	if (!pair)
+		return false;
+	return (pair->rtp != pair->rtcp);
+}
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
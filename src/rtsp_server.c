@@ -58,19 +58,67 @@ static void pomp_socket_cb(struct pomp_ctx *ctx,
 			   void *userdata)
 {
 	UNUSED(ctx);
-	UNUSED(kind);
 
 	struct rtsp_server *server = userdata;
+	int family;
 
 	ULOG_ERRNO_RETURN_IF(server == NULL, EINVAL);
 
+	/* The listening socket is not bound yet, and the accepted sockets
+	 * have the same family: use the address given to pomp_ctx_listen */
+	family = server->listen_addr.ss_family;
+
+	if ((kind == POMP_SOCKET_KIND_SERVER) && (family == AF_INET6)) {
+		/* Dual-stack: also accept IPv4 peers */
+		int v6only = 0;
+		if (setsockopt(fd,
+			       IPPROTO_IPV6,
+			       IPV6_V6ONLY,
+			       (const void *)&v6only,
+			       sizeof(v6only)) < 0) {
+			ULOG_ERRNO("setsockopt:IPV6_V6ONLY", errno);
+		}
+	}
+
+#ifdef SO_REUSEPORT
+	if ((kind == POMP_SOCKET_KIND_SERVER) && (server->group != NULL)) {
+		/* The shards of a group all listen on the same port */
+		int reuse = 1;
+		if (setsockopt(fd,
+			       SOL_SOCKET,
+			       SO_REUSEPORT,
+			       (const void *)&reuse,
+			       sizeof(reuse)) < 0) {
+			ULOG_ERRNO("setsockopt:SO_REUSEPORT", errno);
+		}
+	}
+#endif
+
+	/* On a dual-stack socket, the traffic to IPv4-mapped peers uses
+	 * the IPv4 TOS: set both */
 	int tos = IPTOS_PREC_FLASHOVERRIDE;
-	int err = setsockopt(
+	int err;
+#ifdef IPV6_TCLASS
+	if (family == AF_INET6) {
+		err = setsockopt(fd,
+				 IPPROTO_IPV6,
+				 IPV6_TCLASS,
+				 (const void *)&tos,
+				 sizeof(tos));
+		if (err < 0) {
+			ULOGW("failed to set traffic class for socket: "
+			      "err=%d(%s)",
+			      errno,
+			      strerror(errno));
+		}
+	}
+#endif
+	err = setsockopt(
 		fd, IPPROTO_IP, IP_TOS, (const void *)&tos, sizeof(tos));
 	if (err < 0) {
 		ULOGW("failed to set class selector for socket: err=%d(%s)",
-		      err,
-		      strerror(-err));
+		      errno,
+		      strerror(errno));
 	}
 
 	if (server->cbs.socket_cb)
@@ -78,53 +126,293 @@ static void pomp_socket_cb(struct pomp_ctx *ctx,
 }
 
 
-static int error_response(const struct rtsp_server *server,
-			  struct rtsp_server_pending_request *request,
-			  int status)
+/* Get a buffer for an outgoing message from the pool (or a new one) and
+ * set up the string to format the message directly in it; the buffer
+ * grows as needed up to max_msg_size */
+int rtsp_server_buffer_get(struct rtsp_server *server,
+			   struct pomp_buffer **buf,
+			   struct rtsp_string *str)
 {
-	int ret = 0;
-	struct rtsp_string response;
-	struct pomp_buffer *resp_buf = NULL;
-	int status_code = 0;
-	const char *status_string = NULL;
-	struct timespec cur_ts = {0, 0};
+	int ret;
+	struct pomp_buffer *b = NULL;
 
-	memset(&response, 0, sizeof(response));
+	/* Buffers still referenced by a pomp write queue are skipped */
+	for (unsigned int i = server->buf_pool.count; i > 0; i--) {
+		if (pomp_buffer_is_shared(server->buf_pool.bufs[i - 1]))
+			continue;
+		b = server->buf_pool.bufs[i - 1];
+		server->buf_pool.bufs[i - 1] =
+			server->buf_pool.bufs[--server->buf_pool.count];
+		server->buf_pool.reuses++;
+		break;
+	}
+	if (b == NULL) {
+		b = pomp_buffer_new(PIPE_BUF - 1);
+		if (b == NULL)
+			return -ENOMEM;
+		server->buf_pool.allocs++;
+	}
 
-	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(status == 0, EINVAL);
+	ret = rtsp_string_init(str, b, server->max_msg_size);
+	if (ret < 0) {
+		pomp_buffer_unref(b);
+		return ret;
+	}
 
-	if (request->conn == NULL) {
-		ret = -ECONNRESET;
-		ULOGE("%s: cannot reply to request: connection closed",
-		      __func__);
+	*buf = b;
+
+	return 0;
+}
+
+
+/* Give back a buffer to the pool, once sent (or on error) */
+void rtsp_server_buffer_put(struct rtsp_server *server,
+			    struct pomp_buffer *buf)
+{
+	if (buf == NULL)
+		return;
+
+	if (server->buf_pool.count < RTSP_SERVER_BUFFER_POOL_SIZE)
+		server->buf_pool.bufs[server->buf_pool.count++] = buf;
+	else
+		pomp_buffer_unref(buf);
+}
+
+
+/* Pre-serialize the 'Server', 'Public' and 'Content-Type' lines, which
+ * do not change during the server lifetime */
+static int rtsp_server_lines_init(struct rtsp_server *server)
+{
+	int ret;
+	struct rtsp_string str;
+	struct pomp_buffer *buf = NULL;
+
+	ret = rtsp_server_buffer_get(server, &buf, &str);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
+		return ret;
+	}
+
+	if (server->software_name[0] != '\0') {
+		ret = rtsp_header_field_write_str(
+			&str, RTSP_HEADER_SERVER, server->software_name);
+		if (ret < 0)
+			goto out;
+		ret = rtsp_header_line_set(&server->lines.server, &str);
+		if (ret < 0)
+			goto out;
+	}
+
+	str.len = 0;
+	ret = rtsp_public_header_write(RTSP_SERVER_PUBLIC_METHODS, &str);
+	if (ret < 0)
 		goto out;
+	ret = rtsp_header_line_set(&server->lines.public_methods, &str);
+	if (ret < 0)
+		goto out;
+
+	str.len = 0;
+	ret = rtsp_header_field_write_str(
+		&str, RTSP_HEADER_CONTENT_TYPE, RTSP_CONTENT_TYPE_SDP);
+	if (ret < 0)
+		goto out;
+	ret = rtsp_header_line_set(&server->lines.content_type_sdp, &str);
+
+out:
+	rtsp_server_buffer_put(server, buf);
+	return ret;
+}
+
+
+static void rtsp_server_lines_clear(struct rtsp_server *server)
+{
+	for (unsigned int i = 0; i < server->lines.status_count; i++)
+		rtsp_header_line_clear(&server->lines.status[i].line);
+	server->lines.status_count = 0;
+	rtsp_header_line_clear(&server->lines.public_methods);
+	rtsp_header_line_clear(&server->lines.server);
+	rtsp_header_line_clear(&server->lines.content_type_sdp);
+	for (unsigned int i = 0; i < server->lines.content_base_count; i++) {
+		free(server->lines.content_base[i].uri);
+		rtsp_header_line_clear(&server->lines.content_base[i].line);
+	}
+	server->lines.content_base_count = 0;
+}
+
+
+/* Get the pre-serialized status line of a status code, the line is
+ * only used if the status string matches */
+static const struct rtsp_header_line *
+rtsp_server_status_line_get(struct rtsp_server *server,
+			    int status_code,
+			    const char *status_string)
+{
+	int ret;
+	char data[128];
+	struct rtsp_string str;
+	struct rtsp_header_line *line = NULL;
+	size_t prefix_len, len;
+
+	if ((status_string == NULL) || (status_string[0] == '\0'))
+		return NULL;
+
+	for (unsigned int i = 0; i < server->lines.status_count; i++) {
+		if (server->lines.status[i].code == status_code) {
+			line = &server->lines.status[i].line;
+			break;
+		}
 	}
 
-	/* Map status to status codes and status strings */
-	rtsp_status_get(status, &status_code, &status_string);
+	if (line == NULL) {
+		if (server->lines.status_count >=
+		    RTSP_SERVER_STATUS_LINE_CACHE_SIZE)
+			return NULL;
+		memset(&str, 0, sizeof(str));
+		str.str = data;
+		str.max_len = sizeof(data);
+		ret = rtsp_status_line_write(status_code, status_string, &str);
+		if (ret < 0)
+			return NULL;
+		line = &server->lines.status[server->lines.status_count].line;
+		ret = rtsp_header_line_set(line, &str);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_header_line_set", -ret);
+			return NULL;
+		}
+		server->lines.status[server->lines.status_count++].code =
+			status_code;
+		return line;
+	}
 
-	ULOG_ERRNO_RETURN_ERR_IF(status_code == 0, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(status_string == NULL, EINVAL);
+	/* 'RTSP/1.0 <code> <string>\r\n': the code is always 3 digits */
+	prefix_len = strlen(RTSP_VERSION " 000 ");
+	len = strlen(status_string);
+	if ((line->len != prefix_len + len + strlen(RTSP_CRLF)) ||
+	    (memcmp(line->str + prefix_len, status_string, len) != 0))
+		return NULL;
 
-	request->response_header.status_code = status_code;
-	request->response_header.status_string = strdup(status_string);
-	request->response_header.cseq = request->request_header.cseq;
-	request->response_header.server = strdup(server->software_name);
-	time_get_monotonic(&cur_ts);
-	request->response_header.date = cur_ts.tv_sec;
+	return line;
+}
+
+
+/* Get the pre-serialized 'Content-Base' line of a URI (the DESCRIBE
+ * request URI); NULL if the cache is full */
+static const struct rtsp_header_line *
+rtsp_server_content_base_line_get(struct rtsp_server *server,
+				  const char *uri)
+{
+	int ret;
+	unsigned int i;
+	struct rtsp_string str;
+	struct pomp_buffer *buf = NULL;
+	struct rtsp_header_line *line = NULL;
+
+	if ((uri == NULL) || (uri[0] == '\0'))
+		return NULL;
+
+	for (i = 0; i < server->lines.content_base_count; i++) {
+		if (strcmp(server->lines.content_base[i].uri, uri) == 0)
+			return &server->lines.content_base[i].line;
+	}
+
+	if (i >= RTSP_SERVER_CONTENT_BASE_LINE_CACHE_SIZE)
+		return NULL;
+
+	ret = rtsp_server_buffer_get(server, &buf, &str);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
+		return NULL;
+	}
+	ret = rtsp_header_field_write_str(&str, RTSP_HEADER_CONTENT_BASE, uri);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_header_field_write_str", -ret);
+		goto out;
+	}
+	server->lines.content_base[i].uri = strdup(uri);
+	if (server->lines.content_base[i].uri == NULL) {
+		ULOG_ERRNO("strdup", ENOMEM);
+		goto out;
+	}
+	ret = rtsp_header_line_set(&server->lines.content_base[i].line, &str);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_header_line_set", -ret);
+		xfree((void **)&server->lines.content_base[i].uri);
+		goto out;
+	}
+	line = &server->lines.content_base[i].line;
+	server->lines.content_base_count++;
+
+out:
+	rtsp_server_buffer_put(server, buf);
+	return line;
+}
+
+
+/* Write a response header, splicing the pre-serialized status line,
+ * 'Date', 'Session', 'Content-Type', 'Public', 'Server' and
+ * 'Content-Base' lines when they match the header fields; the other
+ * fields (CSeq...) are formatted */
+static int rtsp_server_response_write(struct rtsp_server *server,
+				      const struct rtsp_server_session *session,
+				      const struct rtsp_response_header *header,
+				      struct rtsp_string *str)
+{
+	struct rtsp_response_lines lines;
+
+	memset(&lines, 0, sizeof(lines));
+
+	lines.status = rtsp_server_status_line_get(
+		server, header->status_code, header->status_string);
+
+	lines.date = rtsp_date_cache_line(&server->date, header->date);
+
+	if ((session != NULL) && (session->session_line.str != NULL) &&
+	    (header->session_id != NULL) &&
+	    (strcmp(header->session_id, session->session_id) == 0) &&
+	    (header->session_timeout == session->timeout_ms / 1000))
+		lines.session = &session->session_line;
+
+	if ((header->public_methods == RTSP_SERVER_PUBLIC_METHODS) &&
+	    (server->lines.public_methods.str != NULL))
+		lines.public_methods = &server->lines.public_methods;
+
+	if (server->lines.server.str != NULL)
+		lines.server = &server->lines.server;
+
+	if ((header->content_type != NULL) &&
+	    (server->lines.content_type_sdp.str != NULL) &&
+	    (strcmp(header->content_type, RTSP_CONTENT_TYPE_SDP) == 0))
+		lines.content_type = &server->lines.content_type_sdp;
+
+	lines.content_base =
+		rtsp_server_content_base_line_get(server, header->content_base);
+
+	return rtsp_response_header_write_lines(header, &lines, str);
+}
+
+
+/* Write and send a response; the response header is built on the stack
+ * by the caller and its strings are borrowed */
+static int rtsp_server_response_send(struct rtsp_server *server,
+				     struct pomp_conn *conn,
+				     const struct rtsp_server_session *session,
+				     const struct rtsp_request_header *req_h,
+				     const struct rtsp_response_header *resp_h)
+{
+	int ret = 0;
+	struct rtsp_string response;
+	struct pomp_buffer *resp_buf = NULL;
+
+	memset(&response, 0, sizeof(response));
 
 	/* Create the response */
-	response.max_len = server->max_msg_size;
-	response.str = calloc(server->max_msg_size, 1);
-	if (response.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
+	ret = rtsp_server_buffer_get(server, &resp_buf, &response);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 		goto out;
 	}
 
-	ret = rtsp_response_header_write(&request->response_header, &response);
+	ret = rtsp_server_response_write(server, session, resp_h, &response);
 	if (ret < 0)
 		goto out;
 
@@ -132,18 +420,17 @@ static int error_response(const struct rtsp_server *server,
 		/* Send the response */
 		ULOGI("send RTSP response to %s: "
 		      "status=%d(%s) cseq=%d session=%s",
-		      rtsp_method_type_str(request->request_header.method),
-		      request->response_header.status_code,
-		      request->response_header.status_string
-			      ? request->response_header.status_string
-			      : "-",
-		      request->response_header.cseq,
-		      request->request_header.session_id
-			      ? request->request_header.session_id
-			      : "-");
-		resp_buf =
-			pomp_buffer_new_with_data(response.str, response.len);
-		ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
+		      rtsp_method_type_str(req_h->method),
+		      resp_h->status_code,
+		      resp_h->status_string ? resp_h->status_string : "-",
+		      resp_h->cseq,
+		      req_h->session_id ? req_h->session_id : "-");
+		ret = pomp_buffer_set_len(resp_buf, response.len);
+		if (ret < 0) {
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+			goto out;
+		}
+		ret = pomp_conn_send_raw_buf(conn, resp_buf);
 		if (ret < 0) {
 			ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
 			goto out;
@@ -151,61 +438,157 @@ static int error_response(const struct rtsp_server *server,
 	}
 
 out:
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
+	rtsp_server_buffer_put(server, resp_buf);
 	return ret;
 }
 
 
-static void rtsp_server_timer_cb(struct pomp_timer *timer, void *userdata)
+static int error_response_send(struct rtsp_server *server,
+			       struct pomp_conn *conn,
+			       const struct rtsp_request_header *req_h,
+			       int status)
 {
-	UNUSED(timer);
+	struct rtsp_response_header resp_h;
+	int status_code = 0;
+	const char *status_string = NULL;
 
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(req_h == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(status == 0, EINVAL);
+
+	if (conn == NULL) {
+		ULOGE("%s: cannot reply to request: connection closed",
+		      __func__);
+		return -ECONNRESET;
+	}
+
+	/* Map status to status codes and status strings */
+	rtsp_status_get(status, &status_code, &status_string);
+
+	ULOG_ERRNO_RETURN_ERR_IF(status_code == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(status_string == NULL, EINVAL);
+
+	memset(&resp_h, 0, sizeof(resp_h));
+	resp_h.is_view = 1;
+	resp_h.status_code = status_code;
+	resp_h.status_string = (char *)status_string;
+	resp_h.cseq = req_h->cseq;
+	resp_h.date = rtsp_date_cache_now(&server->date);
+
+	return rtsp_server_response_send(server, conn, NULL, req_h, &resp_h);
+}
+
+
+static int error_response(struct rtsp_server *server,
+			  struct rtsp_server_pending_request *request,
+			  int status)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
+
+	return error_response_send(
+		server, request->conn, &request->request_header, status);
+}
+
+
+/* Arm the loop timer for the given time, if it is not already armed for
+ * an earlier one */
+static void rtsp_server_timer_arm(struct rtsp_server *server,
+				  uint64_t expiry,
+				  uint64_t cur_time)
+{
+	int ret;
+	uint32_t delay;
+
+	if (server->timer_running && (server->timer_expiry <= expiry))
+		return;
+
+	delay = (expiry > cur_time) ? (uint32_t)(expiry - cur_time) : 1;
+	ret = pomp_timer_set(server->timer, delay);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_timer_set", -ret);
+		return;
+	}
+	server->timer_running = true;
+	server->timer_expiry = expiry;
+}
+
+
+static void rtsp_server_timer_cb(struct pomp_timer *timer, void *userdata)
+{
 	int ret;
 	struct rtsp_server *server = (struct rtsp_server *)userdata;
-	struct rtsp_server_pending_request *request = NULL;
-	struct rtsp_server_pending_request *tmp_request = NULL;
 	struct timespec cur_ts = {0, 0};
 	uint64_t cur_time = 0;
+	uint64_t expiry = 0;
+
+	UNUSED(timer);
 
 	time_get_monotonic(&cur_ts);
-	time_timespec_to_us(&cur_ts, &cur_time);
+	time_timespec_to_ms(&cur_ts, &cur_time);
 
-	/* Remove pending requests on timeout */
-	list_walk_entry_forward_safe(
-		&server->pending_requests, request, tmp_request, node)
-	{
-		if ((request->timeout > 0) && (cur_time > request->timeout)) {
-			ULOGI("timeout on %s request, removing",
-			      rtsp_method_type_str(
-				      request->request_header.method));
-
-			/* Reply with an error */
-			ret = error_response(
-				server,
-				request,
-				RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR);
-			if (ret < 0)
-				ULOG_ERRNO("error_response", -ret);
-
-			(*server->cbs.request_timeout)(
-				server,
-				(void *)request,
-				request->request_header.method,
-				server->cbs_userdata);
-			ret = rtsp_server_pending_request_remove(server,
-								 request);
-			if (ret < 0) {
-				ULOG_ERRNO("rtsp_server_pending_request_remove",
-					   -ret);
-			}
-		}
-	}
+	server->timer_running = false;
+	rtsp_twheel_advance(&server->timers, cur_time);
+
+	/* Sleep until the next non-empty slot, the loop timer is stopped
+	 * until the next timer is set if the wheel is empty */
+	ret = rtsp_twheel_next_expiry(&server->timers, &expiry);
+	if (ret < 0)
+		return;
+	rtsp_server_timer_arm(server, expiry, cur_time);
+}
+
+
+void rtsp_server_timer_set(struct rtsp_server *server,
+			   struct rtsp_twheel_timer *timer,
+			   uint32_t delay_ms)
+{
+	struct timespec cur_ts = {0, 0};
+	uint64_t cur_time = 0;
+
+	ULOG_ERRNO_RETURN_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(timer == NULL, EINVAL);
+
+	time_get_monotonic(&cur_ts);
+	time_timespec_to_ms(&cur_ts, &cur_time);
+
+	rtsp_twheel_timer_set(&server->timers, timer, cur_time, delay_ms);
+
+	/* The loop timer is armed no later than all the other timers: only
+	 * an earlier expiration needs to re-arm it */
+	rtsp_server_timer_arm(
+		server, timer->expiry * server->timers.tick_ms, cur_time);
+}
+
+
+void rtsp_server_pending_request_timer_cb(struct rtsp_twheel_timer *timer,
+					  void *userdata)
+{
+	int ret;
+	struct rtsp_server *server = userdata;
+	struct rtsp_server_pending_request *request = container_of(
+		timer, struct rtsp_server_pending_request, timer);
+
+	ULOGI("timeout on %s request, removing",
+	      rtsp_method_type_str(request->request_header.method));
+
+	/* Reply with an error */
+	ret = error_response(
+		server, request, RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR);
+	if (ret < 0)
+		ULOG_ERRNO("error_response", -ret);
+
+	(*server->cbs.request_timeout)(server,
+				       rtsp_server_pending_request_ctx(request),
+				       request->request_header.method,
+				       server->cbs_userdata);
+	ret = rtsp_server_pending_request_remove(server, request);
+	if (ret < 0)
+		ULOG_ERRNO("rtsp_server_pending_request_remove", -ret);
 }
 
 
-void rtsp_server_session_timer_cb(struct pomp_timer *timer, void *userdata)
+void rtsp_server_session_timer_cb(struct rtsp_twheel_timer *timer,
+				  void *userdata)
 {
 	UNUSED(timer);
 
@@ -263,34 +646,29 @@ static void rtsp_server_pomp_event_cb(struct pomp_ctx *ctx,
 	UNUSED(ctx);
 	UNUSED(msg);
 
-	const struct rtsp_server *server = userdata;
-	const struct sockaddr *peer_addr = NULL;
-	uint32_t addrlen = 0;
-	char addr[INET_ADDRSTRLEN] = "";
+	int ret;
+	struct rtsp_server *server = userdata;
+	struct rtsp_server_conn *c = NULL;
 	struct rtsp_server_pending_request *request = NULL;
 
-	peer_addr = pomp_conn_get_peer_addr(conn, &addrlen);
-	if ((peer_addr != NULL) && (peer_addr->sa_family == AF_INET) &&
-	    (addrlen == sizeof(struct sockaddr_in))) {
-		const struct sockaddr_in *peer_addr_in =
-			(const struct sockaddr_in *)peer_addr;
-		inet_ntop(AF_INET,
-			  &peer_addr_in->sin_addr,
-			  addr,
-			  INET_ADDRSTRLEN);
-	}
-
 	switch (event) {
 	case POMP_EVENT_CONNECTED:
-		if (addr[0] != '\0')
-			ULOGI("client connected (%s)", addr);
+		c = rtsp_server_conn_add(server, conn);
+		if (c == NULL) {
+			ULOGE("%s: failed to create connection context",
+			      __func__);
+			break;
+		}
+		if (c->peer_addr[0] != '\0')
+			ULOGI("client connected (%s)", c->peer_addr);
 		else
 			ULOGI("client connected");
 		break;
 
 	case POMP_EVENT_DISCONNECTED:
-		if (addr[0] != '\0')
-			ULOGI("client disconnected (%s)", addr);
+		c = rtsp_server_conn_find(server, conn);
+		if ((c != NULL) && (c->peer_addr[0] != '\0'))
+			ULOGI("client disconnected (%s)", c->peer_addr);
 		else
 			ULOGI("client disconnected");
 		/* Flag the connection as not available on all pending
@@ -301,6 +679,22 @@ static void rtsp_server_pomp_event_cb(struct pomp_ctx *ctx,
 			if (request->conn == conn)
 				request->conn = NULL;
 		}
+		if (c == NULL)
+			break;
+		ULOGD("connection stats: rx_bytes=%" PRIu64
+		      " requests=%u responses=%u parse_errors=%u"
+		      " interleaved rx=%u(dropped %u) tx=%u(dropped %u)",
+		      c->stats.rx_bytes,
+		      c->stats.rx_requests,
+		      c->stats.rx_responses,
+		      c->stats.parse_errors,
+		      c->stats.rx_interleaved,
+		      c->stats.rx_interleaved_dropped,
+		      c->stats.tx_interleaved,
+		      c->stats.tx_interleaved_dropped);
+		ret = rtsp_server_conn_remove(server, c);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_conn_remove", -ret);
 		break;
 
 	case POMP_EVENT_MSG:
@@ -312,78 +706,29 @@ static void rtsp_server_pomp_event_cb(struct pomp_ctx *ctx,
 
 
 static int rtsp_server_options(struct rtsp_server *server,
-			       struct rtsp_server_pending_request *request)
+			       struct pomp_conn *conn,
+			       const struct rtsp_request_header *req_h)
 {
-	int ret = 0;
-	struct rtsp_string response;
-	struct pomp_buffer *resp_buf = NULL;
-	struct timespec cur_ts = {0, 0};
-
-	memset(&response, 0, sizeof(response));
+	struct rtsp_response_header resp_h;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(req_h == NULL, EINVAL);
 
-	if (request->conn == NULL) {
-		ret = -ECONNRESET;
+	if (conn == NULL) {
 		ULOGE("%s: cannot reply to request: connection closed",
 		      __func__);
-		goto out;
-	}
-
-	request->response_header.status_code = RTSP_STATUS_CODE_OK;
-	request->response_header.status_string = strdup(RTSP_STATUS_STRING_OK);
-	request->response_header.cseq = request->request_header.cseq;
-	request->response_header.server = strdup(server->software_name);
-	time_get_monotonic(&cur_ts);
-	request->response_header.date = cur_ts.tv_sec;
-	request->response_header.public_methods =
-		RTSP_METHOD_FLAG_DESCRIBE | RTSP_METHOD_FLAG_SETUP |
-		RTSP_METHOD_FLAG_TEARDOWN | RTSP_METHOD_FLAG_PLAY |
-		RTSP_METHOD_FLAG_PAUSE | RTSP_METHOD_FLAG_GET_PARAMETER;
-
-	/* Create the response */
-	response.max_len = server->max_msg_size;
-	response.str = calloc(server->max_msg_size, 1);
-	if (response.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
-		goto out;
+		return -ECONNRESET;
 	}
 
-	ret = rtsp_response_header_write(&request->response_header, &response);
-	if (ret < 0)
-		goto out;
-
-	if (response.len > 0) {
-		/* Send the response */
-		ULOGI("send RTSP response to %s: "
-		      "status=%d(%s) cseq=%d session=%s",
-		      rtsp_method_type_str(request->request_header.method),
-		      request->response_header.status_code,
-		      request->response_header.status_string
-			      ? request->response_header.status_string
-			      : "-",
-		      request->response_header.cseq,
-		      request->response_header.session_id
-			      ? request->response_header.session_id
-			      : "-");
-		resp_buf =
-			pomp_buffer_new_with_data(response.str, response.len);
-		ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
-		if (ret < 0) {
-			ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
-			goto out;
-		}
-	}
+	memset(&resp_h, 0, sizeof(resp_h));
+	resp_h.is_view = 1;
+	resp_h.status_code = RTSP_STATUS_CODE_OK;
+	resp_h.status_string = (char *)RTSP_STATUS_STRING_OK;
+	resp_h.cseq = req_h->cseq;
+	resp_h.date = rtsp_date_cache_now(&server->date);
+	resp_h.public_methods = RTSP_SERVER_PUBLIC_METHODS;
 
-out:
-	if (ret == 0)
-		rtsp_server_pending_request_remove(server, request);
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
-	return ret;
+	return rtsp_server_response_send(server, conn, NULL, req_h, &resp_h);
 }
 
 
@@ -412,7 +757,7 @@ static int rtsp_server_describe(struct rtsp_server *server,
 				path,
 				request->request_header.ext,
 				request->request_header.ext_count,
-				(void *)request,
+				rtsp_server_pending_request_ctx(request),
 				server->cbs_userdata);
 
 out:
@@ -425,7 +770,7 @@ out:
 
 
 static int rtsp_server_setup(struct rtsp_server *server,
-			     const char *dst_address,
+			     struct rtsp_server_conn *conn,
 			     struct rtsp_server_pending_request *request,
 			     int *status)
 {
@@ -437,11 +782,14 @@ static int rtsp_server_setup(struct rtsp_server *server,
 	char *path = NULL;
 	struct rtsp_server_session *session = NULL;
 	struct rtsp_server_session_media *media = NULL;
+	struct rtsp_server_pending_request_media *req_media;
+	struct rtsp_transport_header *transport;
+	uint16_t dst_stream_port, dst_control_port;
 	int session_created = 0;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(dst_address == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(dst_address[0] == '\0', EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(conn == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(conn->peer_addr[0] == '\0', EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(status == NULL, EINVAL);
 
@@ -496,10 +844,41 @@ static int rtsp_server_setup(struct rtsp_server *server,
 		ret = -EPROTO;
 		goto out;
 	}
+	req_media =
+		rtsp_server_pending_request_media_add(server, request, media);
+	if (req_media == NULL) {
+		ret = -ENOMEM;
+		(void)rtsp_server_session_media_remove(server, session, media);
+		goto out;
+	}
+
+	transport = request->request_header.transport[0];
+	dst_stream_port = transport->dst_stream_port;
+	dst_control_port = transport->dst_control_port;
+	if (transport->lower_transport == RTSP_LOWER_TRANSPORT_TCP) {
+		/* Interleaved channels on this connection; like for the
+		 * client, they are given as the ports in the callback */
+		struct rtsp_channel_pair pair = {0};
+		if (transport->interleaved_count > 0)
+			pair = transport->interleaved[0];
+		ret = rtsp_server_conn_channels_bind(conn, media, &pair);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_server_conn_channels_bind", -ret);
+			*status = RTSP_STATUS_CODE_UNSUPPORTED_TRANSPORT;
+			/* Removing the session media only forgets it in the
+			 * request, which must not keep the entry */
+			(void)rtsp_server_pending_request_media_remove(
+				server, request, req_media);
+			(void)rtsp_server_session_media_remove(
+				server, session, media);
+			goto out;
+		}
+		dst_stream_port = pair.rtp;
+		dst_control_port = pair.rtcp;
+	}
 
 	rtsp_server_session_reset_timeout(session);
 
-	/* TODO: source address? */
 	request->in_callback = 1;
 	session->op_in_progress = request->request_header.method;
 	(*server->cbs.setup)(
@@ -508,14 +887,14 @@ static int rtsp_server_setup(struct rtsp_server *server,
 		session->session_id,
 		request->request_header.ext,
 		request->request_header.ext_count,
-		(void *)request,
+		rtsp_server_pending_request_ctx(request),
 		(void *)media,
-		request->request_header.transport[0]->delivery,
-		request->request_header.transport[0]->lower_transport,
-		"0.0.0.0",
-		dst_address,
-		request->request_header.transport[0]->dst_stream_port,
-		request->request_header.transport[0]->dst_control_port,
+		transport->delivery,
+		transport->lower_transport,
+		(conn->local_addr[0] != '\0') ? conn->local_addr : "0.0.0.0",
+		conn->peer_addr,
+		dst_stream_port,
+		dst_control_port,
 		server->cbs_userdata);
 
 out:
@@ -536,6 +915,7 @@ out:
 
 
 static int rtsp_server_play(struct rtsp_server *server,
+			    struct rtsp_server_conn *conn,
 			    struct rtsp_server_pending_request *request,
 			    int *status)
 {
@@ -547,6 +927,7 @@ static int rtsp_server_play(struct rtsp_server *server,
 	struct rtsp_server_pending_request_media *req_media;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(conn == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request->request_header.session_id == NULL,
 				 EINVAL);
@@ -573,6 +954,16 @@ static int rtsp_server_play(struct rtsp_server *server,
 
 	rtsp_server_session_reset_timeout(session);
 
+	/* A client resuming the session after a reconnection sends the
+	 * PLAY request on a new connection: the interleaved medias are
+	 * moved to it */
+	ret = rtsp_server_conn_channels_rebind(conn, session);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_conn_channels_rebind", -ret);
+		*status = RTSP_STATUS_CODE_UNSUPPORTED_TRANSPORT;
+		goto out;
+	}
+
 	request->in_callback = 1;
 	session->op_in_progress = request->request_header.method;
 	list_walk_entry_forward(&session->medias, media, node)
@@ -590,7 +981,7 @@ static int rtsp_server_play(struct rtsp_server *server,
 				    session->session_id,
 				    request->request_header.ext,
 				    request->request_header.ext_count,
-				    (void *)request,
+				    rtsp_server_pending_request_ctx(request),
 				    (void *)req_media->media,
 				    &request->request_header.range,
 				    request->request_header.scale,
@@ -667,7 +1058,7 @@ static int rtsp_server_pause(struct rtsp_server *server,
 				     session->session_id,
 				     request->request_header.ext,
 				     request->request_header.ext_count,
-				     (void *)request,
+				     rtsp_server_pending_request_ctx(request),
 				     (void *)req_media->media,
 				     &request->request_header.range,
 				     req_media->media->userdata,
@@ -792,7 +1183,7 @@ static int rtsp_server_teardown(struct rtsp_server *server,
 			RTSP_SERVER_TEARDOWN_REASON_CLIENT_REQUEST,
 			request->request_header.ext,
 			request->request_header.ext_count,
-			(void *)request,
+			rtsp_server_pending_request_ctx(request),
 			(void *)req_media->media,
 			req_media->media->userdata,
 			server->cbs_userdata);
@@ -827,160 +1218,117 @@ out:
 
 static int
 rtsp_server_get_parameter(struct rtsp_server *server,
-			  struct rtsp_server_pending_request *request,
+			  struct pomp_conn *conn,
+			  const struct rtsp_request_header *req_h,
 			  int *status)
 {
 	int ret = 0;
-	char *uri = NULL;
+	char uri[PATH_MAX];
 	char *path = NULL;
 	struct rtsp_server_session *session = NULL;
-	struct rtsp_string response;
-	struct pomp_buffer *resp_buf = NULL;
-	struct timespec cur_ts = {0, 0};
+	struct rtsp_response_header resp_h;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(request->request_header.session_id == NULL,
-				 EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(req_h == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(req_h->session_id == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(status == NULL, EINVAL);
 
-	memset(&response, 0, sizeof(response));
-
-	if (request->conn == NULL) {
-		ret = -ECONNRESET;
+	if (conn == NULL) {
 		ULOGE("%s: cannot reply to request: connection closed",
 		      __func__);
-		goto out;
+		return -ECONNRESET;
 	}
 
-	uri = xstrdup(request->request_header.uri);
+	/* The URL is parsed in place: work on a stack copy */
+	if ((req_h->uri == NULL) || (strlen(req_h->uri) >= sizeof(uri))) {
+		ULOGE("%s: invalid URL", __func__);
+		return -EINVAL;
+	}
+	strcpy(uri, req_h->uri);
 	ret = rtsp_url_parse_path(uri, &path);
 	if (ret < 0) {
-		ULOG_ERRNO("rtsp_url_parse_path(%s)",
-			   -ret,
-			   request->request_header.uri);
-		goto out;
+		ULOG_ERRNO("rtsp_url_parse_path(%s)", -ret, req_h->uri);
+		return ret;
 	}
 	/* TODO: check that the path corresponds to the session */
 
-	session = rtsp_server_session_find(server,
-					   request->request_header.session_id);
+	session = rtsp_server_session_find(server, req_h->session_id);
 	if ((session == NULL) || (session->media_count == 0)) {
 		ULOGW("%s: session not found", __func__);
 		*status = RTSP_STATUS_CODE_SESSION_NOT_FOUND;
-		ret = -ENOENT;
-		goto out;
+		return -ENOENT;
 	}
 
 	rtsp_server_session_reset_timeout(session);
 
-	request->response_header.status_code = RTSP_STATUS_CODE_OK;
-	request->response_header.status_string = strdup(RTSP_STATUS_STRING_OK);
-	request->response_header.cseq = request->request_header.cseq;
-	request->response_header.server = strdup(server->software_name);
-	time_get_monotonic(&cur_ts);
-	request->response_header.date = cur_ts.tv_sec;
-	request->response_header.session_id =
-		strdup(request->request_header.session_id);
-	request->response_header.session_timeout = session->timeout_ms / 1000;
-
-	/* Create the response */
-	response.max_len = server->max_msg_size;
-	response.str = calloc(server->max_msg_size, 1);
-	if (response.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
-		goto out;
-	}
-
-	ret = rtsp_response_header_write(&request->response_header, &response);
-	if (ret < 0)
-		goto out;
-
-	if (response.len > 0) {
-		/* Send the response */
-		ULOGI("send RTSP response to %s: "
-		      "status=%d(%s) cseq=%d session=%s",
-		      rtsp_method_type_str(request->request_header.method),
-		      request->response_header.status_code,
-		      request->response_header.status_string
-			      ? request->response_header.status_string
-			      : "-",
-		      request->response_header.cseq,
-		      request->response_header.session_id
-			      ? request->response_header.session_id
-			      : "-");
-		resp_buf =
-			pomp_buffer_new_with_data(response.str, response.len);
-		ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
-		if (ret < 0) {
-			ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
-			goto out;
-		}
-	}
-
-out:
-	if (ret == 0)
-		rtsp_server_pending_request_remove(server, request);
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
-	free(uri);
-	return ret;
+	memset(&resp_h, 0, sizeof(resp_h));
+	resp_h.is_view = 1;
+	resp_h.status_code = RTSP_STATUS_CODE_OK;
+	resp_h.status_string = (char *)RTSP_STATUS_STRING_OK;
+	resp_h.cseq = req_h->cseq;
+	resp_h.date = rtsp_date_cache_now(&server->date);
+	resp_h.session_id = req_h->session_id;
+	resp_h.session_timeout = session->timeout_ms / 1000;
+
+	return rtsp_server_response_send(
+		server, conn, session, req_h, &resp_h);
 }
 
 
 static int rtsp_server_request_process(struct rtsp_server *server,
-				       struct pomp_conn *conn,
+				       struct rtsp_server_conn *conn,
 				       const struct rtsp_message *msg)
 {
 	int ret = 0;
 	int err = 0;
 	int status = 0;
-	const struct sockaddr *peer_addr = NULL;
-	uint32_t addrlen = 0;
-	char dst_address[INET_ADDRSTRLEN] = "";
+	const struct rtsp_request_header *req_h = NULL;
 	struct rtsp_server_pending_request *request = NULL;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(conn == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
 
-	peer_addr = pomp_conn_get_peer_addr(conn, &addrlen);
-	if ((peer_addr->sa_family == AF_INET) &&
-	    (addrlen == sizeof(struct sockaddr_in))) {
-		const struct sockaddr_in *peer_addr_in =
-			(const struct sockaddr_in *)peer_addr;
-		inet_ntop(AF_INET,
-			  &peer_addr_in->sin_addr,
-			  dst_address,
-			  INET_ADDRSTRLEN);
+	req_h = &msg->header.req;
+
+	ULOGI("received RTSP request %s: cseq=%d session=%s",
+	      rtsp_method_type_str(req_h->method),
+	      req_h->cseq,
+	      req_h->session_id ? req_h->session_id : "-");
+
+	/* OPTIONS and GET_PARAMETER are answered synchronously straight
+	 * from the parsed message; only the requests which are replied to
+	 * by the application are kept pending with a copy of the header */
+	switch (req_h->method) {
+	case RTSP_METHOD_TYPE_OPTIONS:
+		err = rtsp_server_options(server, conn->conn, req_h);
+		goto out;
+	case RTSP_METHOD_TYPE_GET_PARAMETER:
+		err = rtsp_server_get_parameter(
+			server, conn->conn, req_h, &status);
+		goto out;
+	default:
+		break;
 	}
 
 	request = rtsp_server_pending_request_add(
-		server, conn, server->reply_timeout_ms);
+		server, conn->conn, server->reply_timeout_ms);
 	if (request == NULL) {
 		ret = -ENOMEM;
 		goto out;
 	}
 
-	rtsp_request_header_copy(&msg->header.req, &request->request_header);
-
-	ULOGI("received RTSP request %s: cseq=%d session=%s",
-	      rtsp_method_type_str(request->request_header.method),
-	      request->request_header.cseq,
-	      request->request_header.session_id
-		      ? request->request_header.session_id
-		      : "-");
+	err = rtsp_request_header_copy(req_h, &request->request_header);
+	if (err < 0) {
+		ULOG_ERRNO("rtsp_request_header_copy", -err);
+		goto out;
+	}
 
 	switch (request->request_header.method) {
 	default:
 	case RTSP_METHOD_TYPE_UNKNOWN:
 		ULOGE("%s: unknown method", __func__);
 		break;
-	case RTSP_METHOD_TYPE_OPTIONS:
-		err = rtsp_server_options(server, request);
-		break;
 	case RTSP_METHOD_TYPE_DESCRIBE:
 		err = rtsp_server_describe(server, request);
 		break;
@@ -988,10 +1336,10 @@ static int rtsp_server_request_process(struct rtsp_server *server,
 		/* TODO */
 		break;
 	case RTSP_METHOD_TYPE_SETUP:
-		err = rtsp_server_setup(server, dst_address, request, &status);
+		err = rtsp_server_setup(server, conn, request, &status);
 		break;
 	case RTSP_METHOD_TYPE_PLAY:
-		err = rtsp_server_play(server, request, &status);
+		err = rtsp_server_play(server, conn, request, &status);
 		break;
 	case RTSP_METHOD_TYPE_PAUSE:
 		err = rtsp_server_pause(server, request, &status);
@@ -999,9 +1347,6 @@ static int rtsp_server_request_process(struct rtsp_server *server,
 	case RTSP_METHOD_TYPE_TEARDOWN:
 		err = rtsp_server_teardown(server, request, &status);
 		break;
-	case RTSP_METHOD_TYPE_GET_PARAMETER:
-		err = rtsp_server_get_parameter(server, request, &status);
-		break;
 	case RTSP_METHOD_TYPE_SET_PARAMETER:
 		/* TODO */
 		break;
@@ -1014,35 +1359,136 @@ static int rtsp_server_request_process(struct rtsp_server *server,
 	}
 
 out:
-	if ((err < 0) && (request != NULL)) {
+	if (err < 0) {
 		/* Reply with an error */
-		error_response(
+		error_response_send(
 			server,
-			request,
+			conn->conn,
+			req_h,
 			(RTSP_STATUS_CLASS(status) > RTSP_STATUS_CLASS_SUCCESS)
 				? status
 				: err);
-		rtsp_server_pending_request_remove(server, request);
+		if (request != NULL)
+			rtsp_server_pending_request_remove(server, request);
+	}
+	return ret;
+}
+
+
+static int rtsp_server_response_process(const struct rtsp_server *server,
+					const struct rtsp_message *msg)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
+
+	ULOGI("response to RTSP request %s: status=%d(%s) cseq=%d session=%s",
+	      rtsp_method_type_str(msg->header.req.method),
+	      msg->header.resp.status_code,
+	      msg->header.resp.status_string ? msg->header.resp.status_string
+					     : "-",
+	      msg->header.resp.cseq,
+	      msg->header.resp.session_id ? msg->header.resp.session_id : "-");
+
+	return 0;
+}
+
+
+/* Deliver the complete interleaved packets at the beginning of the
+ * received data to the medias set up on the connection; returns -EINVAL
+ * if an RTSP message follows, -EAGAIN otherwise */
+static int rtsp_server_interleaved_process(struct rtsp_server *server,
+					   struct rtsp_server_conn *c)
+{
+	int ret;
+	size_t off = 0;
+	size_t pkt_len;
+	struct rtsp_interleaved_info info;
+	struct rtsp_server_session_media *media;
+
+	while ((ret = rtsp_get_next_interleaved(c->request_buf,
+						&c->parser_ctx,
+						off,
+						&info,
+						&pkt_len)) == 0) {
+		off += pkt_len;
+		c->stats.rx_interleaved++;
+
+		media = c->channel_media[info.channel];
+		if (media == NULL || server->cbs.interleaved_data == NULL) {
+			c->stats.rx_interleaved_dropped++;
+			continue;
+		}
+		(*server->cbs.interleaved_data)(server,
+						media->session->session_id,
+						info.channel,
+						info.data,
+						info.len,
+						media->userdata,
+						server->cbs_userdata);
+	}
+
+	/* The data is consumed only after the callbacks, as consuming
+	 * may reset the buffer */
+	rtsp_message_parser_consume(&c->parser_ctx, c->request_buf, off);
+
+	if (ret != -EINVAL && ret != -EAGAIN) {
+		ULOG_ERRNO("rtsp_get_next_interleaved", -ret);
+		ret = -EAGAIN;
 	}
 	return ret;
 }
 
 
-static int rtsp_server_response_process(const struct rtsp_server *server,
-					const struct rtsp_message *msg)
+/* Called by pomp for each buffer sent (or dropped) on a connection; used
+ * to track the interleaved data waiting in the write queues */
+static void rtsp_server_pomp_send_cb(struct pomp_ctx *ctx,
+				     struct pomp_conn *conn,
+				     struct pomp_buffer *buf,
+				     uint32_t status,
+				     void *cookie,
+				     void *userdata)
 {
-	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(msg == NULL, EINVAL);
+	UNUSED(ctx);
+	UNUSED(cookie);
 
-	ULOGI("response to RTSP request %s: status=%d(%s) cseq=%d session=%s",
-	      rtsp_method_type_str(msg->header.req.method),
-	      msg->header.resp.status_code,
-	      msg->header.resp.status_string ? msg->header.resp.status_string
-					     : "-",
-	      msg->header.resp.cseq,
-	      msg->header.resp.session_id ? msg->header.resp.session_id : "-");
+	int ret;
+	struct rtsp_server *server = userdata;
+	struct rtsp_server_conn *c;
+	const uint8_t *data;
+	size_t len;
 
-	return 0;
+	ULOG_ERRNO_RETURN_IF(server == NULL, EINVAL);
+
+	c = rtsp_server_conn_find(server, conn);
+	if (c == NULL)
+		return;
+
+	/* Only interleaved data is accounted for; RTSP messages never
+	 * start with '$' */
+	ret = pomp_buffer_get_cdata(buf, (const void **)&data, &len, NULL);
+	if (ret == 0 && len > 0 && data[0] == 0x24) {
+		if (c->tx.queued_bytes >= len)
+			c->tx.queued_bytes -= len;
+		else
+			c->tx.queued_bytes = 0;
+	}
+
+	if (!(status & POMP_SEND_STATUS_QUEUE_EMPTY) || !c->tx.blocked)
+		return;
+
+	/* The write queue has been drained */
+	c->tx.blocked = false;
+	if (server->cbs.ready_to_send == NULL)
+		return;
+	for (size_t i = 0; i < SIZEOF_ARRAY(c->channel_media); i++) {
+		struct rtsp_server_session_media *media = c->channel_media[i];
+		if (media == NULL || media->channel_pair.rtp != i)
+			continue;
+		(*server->cbs.ready_to_send)(server,
+					     media->session->session_id,
+					     media->userdata,
+					     server->cbs_userdata);
+	}
 }
 
 
@@ -1054,6 +1500,7 @@ static void rtsp_server_pomp_cb(struct pomp_ctx *ctx,
 	UNUSED(ctx);
 
 	struct rtsp_server *server = (struct rtsp_server *)userdata;
+	struct rtsp_server_conn *c = NULL;
 	int ret;
 	size_t len = 0;
 	const void *cdata = NULL;
@@ -1062,6 +1509,17 @@ static void rtsp_server_pomp_cb(struct pomp_ctx *ctx,
 
 	ULOG_ERRNO_RETURN_IF(server == NULL, EINVAL);
 
+	/* Get the connection receive context */
+	c = rtsp_server_conn_find(server, conn);
+	if (c == NULL) {
+		c = rtsp_server_conn_add(server, conn);
+		if (c == NULL) {
+			ULOGE("%s: failed to create connection context",
+			      __func__);
+			return;
+		}
+	}
+
 	/* Get the message data */
 	ret = pomp_buffer_get_cdata(buf, &cdata, &len, NULL);
 	if ((ret < 0) || (!cdata)) {
@@ -1069,29 +1527,39 @@ static void rtsp_server_pomp_cb(struct pomp_ctx *ctx,
 		return;
 	}
 
-	/* Add the data to the buffer */
-	ret = pomp_buffer_append_data(server->request_buf, cdata, len);
+	/* Add the data to the connection buffer */
+	ret = rtsp_message_parser_append_data(
+		&c->parser_ctx, c->request_buf, cdata, len);
 	if (ret < 0) {
-		ULOG_ERRNO("pomp_buffer_append_data", -ret);
+		ULOG_ERRNO("rtsp_message_parser_append_data", -ret);
 		return;
 	}
+	c->stats.rx_bytes += len;
 
-	/* Iterate over complete messages */
-	while ((ret = rtsp_get_next_message(
-			server->request_buf, &msg, &server->parser_ctx)) == 0) {
-		if (msg.type == RTSP_MESSAGE_TYPE_REQUEST)
-			(void)rtsp_server_request_process(server, conn, &msg);
-		else
+	/* Iterate over complete messages; interleaved data takes a fast
+	 * path, RTSP messages go through the parser */
+	while ((ret = rtsp_server_interleaved_process(server, c)) != -EAGAIN &&
+	       (ret = rtsp_get_next_message(
+			c->request_buf, &msg, &c->parser_ctx)) == 0) {
+		if (msg.type == RTSP_MESSAGE_TYPE_REQUEST) {
+			c->stats.rx_requests++;
+			(void)rtsp_server_request_process(server, c, &msg);
+		} else {
+			c->stats.rx_responses++;
 			(void)rtsp_server_response_process(server, &msg);
-		rtsp_buffer_remove_first_bytes(server->request_buf,
-					       msg.total_len);
+		}
+		rtsp_message_parser_consume(
+			&c->parser_ctx, c->request_buf, msg.total_len);
 	}
 
-	if (ret != -EAGAIN)
+	/* On parse error, skip the invalid message; msg is not cleared
+	 * when the loop stops on incomplete interleaved data */
+	if (ret != -EAGAIN) {
+		c->stats.parse_errors++;
 		ULOG_ERRNO("rtsp_get_next_message", -ret);
-
-
-	rtsp_buffer_remove_first_bytes(server->request_buf, msg.total_len);
+		rtsp_message_parser_consume(
+			&c->parser_ctx, c->request_buf, msg.total_len);
+	}
 }
 
 
@@ -1102,7 +1570,7 @@ static int rtsp_server_send_teardown(struct rtsp_server *server,
 				     size_t ext_count)
 {
 	struct rtsp_request_header header;
-	struct pomp_buffer *req_buf;
+	struct pomp_buffer *req_buf = NULL;
 	struct rtsp_string request;
 	int ret = 0;
 
@@ -1134,11 +1602,9 @@ static int rtsp_server_send_teardown(struct rtsp_server *server,
 
 	/* Create the request */
 	memset(&request, 0, sizeof(request));
-	request.max_len = server->max_msg_size;
-	request.str = calloc(server->max_msg_size, 1);
-	if (request.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
+	ret = rtsp_server_buffer_get(server, &req_buf, &request);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 		goto out;
 	}
 
@@ -1152,15 +1618,18 @@ static int rtsp_server_send_teardown(struct rtsp_server *server,
 		      rtsp_method_type_str(header.method),
 		      header.cseq,
 		      header.session_id ? header.session_id : "-");
-		req_buf = pomp_buffer_new_with_data(request.str, request.len);
+		ret = pomp_buffer_set_len(req_buf, request.len);
+		if (ret < 0) {
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+			goto out;
+		}
 		ret = pomp_ctx_send_raw_buf(server->pomp, req_buf);
-		pomp_buffer_unref(req_buf);
 	}
 
 out:
+	rtsp_server_buffer_put(server, req_buf);
 	free(header.session_id);
 	free(header.uri);
-	free(request.str);
 	return ret;
 }
 
@@ -1173,6 +1642,57 @@ int rtsp_server_new(const char *software_name,
 		    const struct rtsp_server_cbs *cbs,
 		    void *userdata,
 		    struct rtsp_server **ret_obj)
+{
+	return rtsp_server_new_shard(software_name,
+				     port,
+				     reply_timeout_ms,
+				     session_timeout_ms,
+				     loop,
+				     cbs,
+				     userdata,
+				     NULL,
+				     0,
+				     ret_obj);
+}
+
+
+static int server_listen(struct rtsp_server *server, int family, uint16_t port)
+{
+	socklen_t addrlen;
+
+	memset(&server->listen_addr, 0, sizeof(server->listen_addr));
+	if (family == AF_INET6) {
+		struct sockaddr_in6 *addr =
+			(struct sockaddr_in6 *)&server->listen_addr;
+		addr->sin6_family = AF_INET6;
+		addr->sin6_addr = in6addr_any;
+		addr->sin6_port = htons(port);
+		addrlen = sizeof(*addr);
+	} else {
+		struct sockaddr_in *addr =
+			(struct sockaddr_in *)&server->listen_addr;
+		addr->sin_family = AF_INET;
+		addr->sin_addr.s_addr = htonl(INADDR_ANY);
+		addr->sin_port = htons(port);
+		addrlen = sizeof(*addr);
+	}
+
+	return pomp_ctx_listen(server->pomp,
+			       (const struct sockaddr *)&server->listen_addr,
+			       addrlen);
+}
+
+
+int rtsp_server_new_shard(const char *software_name,
+			  uint16_t port,
+			  int reply_timeout_ms,
+			  int session_timeout_ms,
+			  struct pomp_loop *loop,
+			  const struct rtsp_server_cbs *cbs,
+			  void *userdata,
+			  struct rtsp_server_group *group,
+			  unsigned int shard_index,
+			  struct rtsp_server **ret_obj)
 {
 	int ret;
 	struct rtsp_server *server = NULL;
@@ -1191,8 +1711,10 @@ int rtsp_server_new(const char *software_name,
 	server = calloc(1, sizeof(*server));
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, ENOMEM);
 	server->cseq = 1;
-	server->max_msg_size = PIPE_BUF - 1;
+	server->max_msg_size = RTSP_DEFAULT_MAX_MSG_SIZE;
 	server->loop = loop;
+	server->group = group;
+	server->shard_index = shard_index;
 	server->cbs = *cbs;
 	server->cbs_userdata = userdata;
 	server->reply_timeout_ms =
@@ -1203,6 +1725,7 @@ int rtsp_server_new(const char *software_name,
 			? RTSP_SERVER_DEFAULT_SESSION_TIMEOUT_MS
 			: session_timeout_ms;
 	list_init(&server->sessions);
+	list_init(&server->conns);
 	list_init(&server->pending_requests);
 
 	server->software_name =
@@ -1214,6 +1737,18 @@ int rtsp_server_new(const char *software_name,
 		goto error;
 	}
 
+	ret = rtsp_server_lines_init(server);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_lines_init", -ret);
+		goto error;
+	}
+
+	ret = rtsp_server_reply_queue_init(server);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_reply_queue_init", -ret);
+		goto error;
+	}
+
 	server->pomp = pomp_ctx_new_with_loop(
 		&rtsp_server_pomp_event_cb, (void *)server, server->loop);
 	if (!server->pomp) {
@@ -1244,6 +1779,15 @@ int rtsp_server_new(const char *software_name,
 		goto error;
 	}
 
+	ret = pomp_ctx_set_send_cb(server->pomp, &rtsp_server_pomp_send_cb);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_ctx_set_send_cb", -ret);
+		goto error;
+	}
+
+	/* Single loop timer driving the timer wheel; it is started when
+	 * the first timer is set */
+	rtsp_twheel_init(&server->timers, RTSP_SERVER_TIMER_TICK_MS);
 	server->timer = pomp_timer_new(
 		server->loop, &rtsp_server_timer_cb, (void *)server);
 	if (!server->timer) {
@@ -1251,32 +1795,20 @@ int rtsp_server_new(const char *software_name,
 		ULOG_ERRNO("pomp_timer_new", -ret);
 		goto error;
 	}
-	ret = pomp_timer_set_periodic(server->timer, 1000, 1000);
+
+	/* Listen on a dual-stack IPv6 socket (the IPv4 peers are seen
+	 * with IPv4-mapped addresses), or on IPv4 only if IPv6 is not
+	 * available */
+	ret = server_listen(server, AF_INET6, port);
 	if (ret < 0) {
-		ULOG_ERRNO("pomp_timer_set_periodic", -ret);
-		goto error;
+		ULOGW("IPv6 listening failed (%d), falling back to IPv4", ret);
+		ret = server_listen(server, AF_INET, port);
 	}
-
-	/* TODO */
-	server->listen_addr_in.sin_family = AF_INET;
-	server->listen_addr_in.sin_addr.s_addr = htonl(INADDR_ANY);
-	server->listen_addr_in.sin_port = htons(port);
-
-	ret = pomp_ctx_listen(server->pomp,
-			      (const struct sockaddr *)&server->listen_addr_in,
-			      sizeof(server->listen_addr_in));
 	if (ret < 0) {
 		ULOG_ERRNO("pomp_ctx_listen", -ret);
 		goto error;
 	}
 
-	server->request_buf = pomp_buffer_new(PIPE_BUF - 1);
-	if (server->request_buf == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("pomp_buffer_new", -ret);
-		goto error;
-	}
-
 	*ret_obj = server;
 	return 0;
 
@@ -1294,6 +1826,8 @@ int rtsp_server_destroy(struct rtsp_server *server)
 	struct rtsp_server_session *tmp_session = NULL;
 	struct rtsp_server_pending_request *request = NULL;
 	struct rtsp_server_pending_request *tmp_request = NULL;
+	struct rtsp_server_conn *conn = NULL;
+	struct rtsp_server_conn *tmp_conn = NULL;
 
 	if (server == NULL)
 		return 0;
@@ -1318,14 +1852,17 @@ int rtsp_server_destroy(struct rtsp_server *server)
 		}
 	}
 
+	rtsp_server_reply_queue_clear(server);
+
 	/* Remove all pending requests */
 	list_walk_entry_forward_safe(
 		&server->pending_requests, request, tmp_request, node)
 	{
-		(*server->cbs.request_timeout)(server,
-					       (void *)request,
-					       request->request_header.method,
-					       server->cbs_userdata);
+		(*server->cbs.request_timeout)(
+			server,
+			rtsp_server_pending_request_ctx(request),
+			request->request_header.method,
+			server->cbs_userdata);
 		ret = rtsp_server_pending_request_remove(server, request);
 		if (ret < 0)
 			ULOG_ERRNO("rtsp_server_pending_request_remove", -ret);
@@ -1340,10 +1877,25 @@ int rtsp_server_destroy(struct rtsp_server *server)
 			ULOG_ERRNO("rtsp_server_session_remove", -ret);
 	}
 
-	rtsp_message_clear(&server->parser_ctx.msg);
+	/* Remove all connection contexts */
+	list_walk_entry_forward_safe(&server->conns, conn, tmp_conn, node)
+	{
+		ret = rtsp_server_conn_remove(server, conn);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_conn_remove", -ret);
+	}
+	rtsp_map_clear(&server->conn_map);
+	rtsp_map_clear(&server->session_map);
+	free(server->request_slab.slots);
+
+	ULOGD("outgoing message buffers: allocated=%u reused=%u",
+	      server->buf_pool.allocs,
+	      server->buf_pool.reuses);
+	for (unsigned int i = 0; i < server->buf_pool.count; i++)
+		pomp_buffer_unref(server->buf_pool.bufs[i]);
+	rtsp_server_lines_clear(server);
+	rtsp_date_cache_clear(&server->date);
 
-	if (server->request_buf)
-		pomp_buffer_unref(server->request_buf);
 	free(server->software_name);
 	free(server);
 
@@ -1365,7 +1917,6 @@ int rtsp_server_reply_to_describe(struct rtsp_server *server,
 	int status_code = 0;
 	int error_status = 0;
 	const char *status_string = NULL;
-	struct timespec cur_ts = {0, 0};
 	size_t session_description_len = 0;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
@@ -1373,11 +1924,10 @@ int rtsp_server_reply_to_describe(struct rtsp_server *server,
 
 	memset(&response, 0, sizeof(response));
 
-	request = request_ctx;
-	ret = rtsp_server_pending_request_find(server, request);
-	if (ret < 0) {
+	request = rtsp_server_pending_request_find(server, request_ctx);
+	if (request == NULL) {
+		ret = -ENOENT;
 		ULOG_ERRNO("rtsp_server_pending_request_find", -ret);
-		request = NULL;
 		goto out;
 	}
 
@@ -1422,9 +1972,7 @@ int rtsp_server_reply_to_describe(struct rtsp_server *server,
 	request->response_header.status_code = status_code;
 	request->response_header.status_string = strdup(status_string);
 	request->response_header.cseq = request->request_header.cseq;
-	request->response_header.server = strdup(server->software_name);
-	time_get_monotonic(&cur_ts);
-	request->response_header.date = cur_ts.tv_sec;
+	request->response_header.date = rtsp_date_cache_now(&server->date);
 	request->response_header.content_length = session_description_len;
 	request->response_header.content_type =
 		strdup(RTSP_CONTENT_TYPE_SDP); /* TODO */
@@ -1438,16 +1986,15 @@ int rtsp_server_reply_to_describe(struct rtsp_server *server,
 	}
 
 	/* Create the response */
-	response.max_len = server->max_msg_size;
-	response.str = calloc(server->max_msg_size, 1);
-	if (response.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
+	ret = rtsp_server_buffer_get(server, &resp_buf, &response);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
 		goto out;
 	}
 
-	ret = rtsp_response_header_write(&request->response_header, &response);
+	ret = rtsp_server_response_write(
+		server, NULL, &request->response_header, &response);
 	if (ret < 0) {
 		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
 		goto out;
@@ -1473,8 +2020,11 @@ int rtsp_server_reply_to_describe(struct rtsp_server *server,
 		      request->response_header.session_id
 			      ? request->response_header.session_id
 			      : "-");
-		resp_buf =
-			pomp_buffer_new_with_data(response.str, response.len);
+		ret = pomp_buffer_set_len(resp_buf, response.len);
+		if (ret < 0) {
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+			goto out;
+		}
 		ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
 		if (ret < 0) {
 			ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
@@ -1492,9 +2042,7 @@ out:
 		if (!request->in_callback)
 			rtsp_server_pending_request_remove(server, request);
 	}
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
+	rtsp_server_buffer_put(server, resp_buf);
 	return ret;
 }
 
@@ -1513,15 +2061,16 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 {
 	int ret = 0;
 	int failed = 0;
+	bool is_tcp;
 	struct rtsp_server_session *session = NULL;
 	struct rtsp_server_session_media *media = NULL;
 	struct rtsp_server_pending_request *request = NULL;
+	struct rtsp_server_pending_request_media *req_media = NULL;
 	struct rtsp_string response;
 	struct pomp_buffer *resp_buf = NULL;
 	int status_code = 0;
 	int error_status = 0;
 	const char *status_string = NULL;
-	struct timespec cur_ts = {0, 0};
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
@@ -1529,17 +2078,27 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 
 	memset(&response, 0, sizeof(response));
 
-	request = request_ctx;
-	media = media_ctx;
-	session = media->session;
-
-	ret = rtsp_server_pending_request_find(server, request);
-	if (ret < 0) {
+	request = rtsp_server_pending_request_find(server, request_ctx);
+	if (request == NULL) {
+		ret = -ENOENT;
 		ULOG_ERRNO("rtsp_server_pending_request_find", -ret);
-		request = NULL;
 		goto out;
 	}
 
+	/* The media context is only dereferenced once it is known to
+	 * belong to the request */
+	req_media = rtsp_server_pending_request_media_find(
+		server, request, media_ctx);
+	if (req_media == NULL) {
+		ULOGE("%s: media not found", __func__);
+		ret = -ENOENT;
+		failed = 1;
+		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
+		goto out;
+	}
+	media = req_media->media;
+	session = media->session;
+
 	if (session == NULL) {
 		ret = -EINVAL;
 		goto out;
@@ -1561,7 +2120,17 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 		goto out;
 	}
 
-	if ((src_stream_port == 0) || (src_control_port == 0)) {
+	is_tcp = (request->request_header.transport[0]->lower_transport ==
+		  RTSP_LOWER_TRANSPORT_TCP);
+	if (is_tcp && media->conn == NULL) {
+		ULOGE("%s: interleaved connection closed", __func__);
+		ret = -ECONNRESET;
+		failed = 1;
+		goto out;
+	}
+
+	/* Source ports are not used with interleaved channels */
+	if (!is_tcp && ((src_stream_port == 0) || (src_control_port == 0))) {
 		ULOGE("%s: invalid source ports", __func__);
 		ret = -EINVAL;
 		failed = 1;
@@ -1582,9 +2151,7 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 	request->response_header.status_code = status_code;
 	request->response_header.status_string = strdup(status_string);
 	request->response_header.cseq = request->request_header.cseq;
-	request->response_header.server = strdup(server->software_name);
-	time_get_monotonic(&cur_ts);
-	request->response_header.date = cur_ts.tv_sec;
+	request->response_header.date = rtsp_date_cache_now(&server->date);
 	request->response_header.session_id = strdup(session->session_id);
 	request->response_header.session_timeout = session->timeout_ms / 1000;
 	request->response_header.transport = rtsp_transport_header_new();
@@ -1607,6 +2174,11 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 	request->response_header.transport->src_control_port = src_control_port;
 	request->response_header.transport->ssrc_valid = ssrc_valid;
 	request->response_header.transport->ssrc = ssrc;
+	if (is_tcp) {
+		request->response_header.transport->interleaved[0] =
+			media->channel_pair;
+		request->response_header.transport->interleaved_count = 1;
+	}
 	ret = rtsp_response_header_copy_ext(
 		&request->response_header, ext, ext_count);
 	if (ret < 0) {
@@ -1616,17 +2188,16 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 	}
 
 	/* Create the response */
-	response.max_len = server->max_msg_size;
-	response.str = calloc(server->max_msg_size, 1);
-	if (response.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
+	ret = rtsp_server_buffer_get(server, &resp_buf, &response);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 		failed = 1;
 		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
 		goto out;
 	}
 
-	ret = rtsp_response_header_write(&request->response_header, &response);
+	ret = rtsp_server_response_write(
+		server, session, &request->response_header, &response);
 	if (ret < 0) {
 		failed = 1;
 		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
@@ -1646,8 +2217,11 @@ int rtsp_server_reply_to_setup(struct rtsp_server *server,
 		      request->response_header.session_id
 			      ? request->response_header.session_id
 			      : "-");
-		resp_buf =
-			pomp_buffer_new_with_data(response.str, response.len);
+		ret = pomp_buffer_set_len(resp_buf, response.len);
+		if (ret < 0) {
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+			goto out;
+		}
 		ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
 		if (ret < 0) {
 			ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
@@ -1685,9 +2259,7 @@ out:
 			rtsp_server_pending_request_remove(server, request);
 		}
 	}
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
+	rtsp_server_buffer_put(server, resp_buf);
 	return ret;
 }
 
@@ -1706,7 +2278,6 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 			      size_t ext_count)
 {
 	int ret = 0;
-	int found = 0;
 	int replied = 0;
 	struct rtsp_server_pending_request *request = NULL;
 	struct rtsp_string response;
@@ -1718,7 +2289,6 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 	int status_code = 0;
 	int error_status = 0;
 	const char *status_string = NULL;
-	struct timespec cur_ts = {0, 0};
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
@@ -1726,17 +2296,27 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 
 	memset(&response, 0, sizeof(response));
 
-	request = request_ctx;
-	media = media_ctx;
-	session = media->session;
-
-	ret = rtsp_server_pending_request_find(server, request);
-	if (ret < 0) {
+	request = rtsp_server_pending_request_find(server, request_ctx);
+	if (request == NULL) {
+		ret = -ENOENT;
 		ULOG_ERRNO("rtsp_server_pending_request_find", -ret);
-		request = NULL;
 		goto out;
 	}
 
+	/* The media context is only dereferenced once it is known to
+	 * belong to the request */
+	req_media = rtsp_server_pending_request_media_find(
+		server, request, media_ctx);
+	if (req_media == NULL) {
+		ULOGE("%s: media not found", __func__);
+		ret = -ENOENT;
+		replied = request->media_count;
+		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
+		goto out;
+	}
+	media = req_media->media;
+	session = media->session;
+
 	if (request->conn == NULL) {
 		ret = -ECONNRESET;
 		ULOGE("%s: cannot reply to request: connection closed",
@@ -1763,20 +2343,6 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 		ret = -EINVAL;
 		goto out;
 	}
-	list_walk_entry_forward(&request->medias, req_media, node)
-	{
-		if (req_media->media == media) {
-			found = 1;
-			break;
-		}
-	}
-	if (!found) {
-		ULOGE("%s: media not found", __func__);
-		ret = -ENOENT;
-		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
-		replied = request->media_count;
-		goto out;
-	}
 
 	if (request->request_first_reply) {
 		session->range = *range;
@@ -1843,10 +2409,8 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 		free(request->response_header.status_string);
 		request->response_header.status_string = strdup(status_string);
 		request->response_header.cseq = request->request_header.cseq;
-		free(request->response_header.server);
-		request->response_header.server = strdup(server->software_name);
-		time_get_monotonic(&cur_ts);
-		request->response_header.date = cur_ts.tv_sec;
+		request->response_header.date =
+			rtsp_date_cache_now(&server->date);
 		free(request->response_header.session_id);
 		request->response_header.session_id =
 			strdup(session->session_id);
@@ -1862,16 +2426,16 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 		}
 
 		/* Create the response */
-		response.max_len = server->max_msg_size;
-		response.str = calloc(server->max_msg_size, 1);
-		if (response.str == NULL) {
-			ret = -ENOMEM;
-			ULOG_ERRNO("calloc", -ret);
+		ret = rtsp_server_buffer_get(server, &resp_buf, &response);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 			error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
 			goto out;
 		}
 
-		ret = rtsp_response_header_write(&request->response_header,
+		ret = rtsp_server_response_write(server,
+						 session,
+						 &request->response_header,
 						 &response);
 		if (ret < 0) {
 			error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
@@ -1892,8 +2456,11 @@ int rtsp_server_reply_to_play(struct rtsp_server *server,
 			      request->response_header.session_id
 				      ? request->response_header.session_id
 				      : "-");
-			resp_buf = pomp_buffer_new_with_data(response.str,
-							     response.len);
+			ret = pomp_buffer_set_len(resp_buf, response.len);
+			if (ret < 0) {
+				ULOG_ERRNO("pomp_buffer_set_len", -ret);
+				goto out;
+			}
 			ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
 			if (ret < 0) {
 				ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
@@ -1916,9 +2483,7 @@ out:
 			rtsp_server_pending_request_remove(server, request);
 		}
 	}
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
+	rtsp_server_buffer_put(server, resp_buf);
 	return ret;
 }
 
@@ -1932,7 +2497,6 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 			       size_t ext_count)
 {
 	int ret = 0;
-	int found = 0;
 	int replied = 0;
 	struct rtsp_server_pending_request *request = NULL;
 	struct rtsp_string response;
@@ -1944,7 +2508,6 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 	int status_code = 0;
 	int error_status = 0;
 	const char *status_string = NULL;
-	struct timespec cur_ts = {0, 0};
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
@@ -1952,17 +2515,27 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 
 	memset(&response, 0, sizeof(response));
 
-	request = request_ctx;
-	media = media_ctx;
-	session = media->session;
-
-	ret = rtsp_server_pending_request_find(server, request);
-	if (ret < 0) {
+	request = rtsp_server_pending_request_find(server, request_ctx);
+	if (request == NULL) {
+		ret = -ENOENT;
 		ULOG_ERRNO("rtsp_server_pending_request_find", -ret);
-		request = NULL;
 		goto out;
 	}
 
+	/* The media context is only dereferenced once it is known to
+	 * belong to the request */
+	req_media = rtsp_server_pending_request_media_find(
+		server, request, media_ctx);
+	if (req_media == NULL) {
+		ULOGE("%s: media not found", __func__);
+		ret = -ENOENT;
+		replied = request->media_count;
+		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
+		goto out;
+	}
+	media = req_media->media;
+	session = media->session;
+
 	if (request->conn == NULL) {
 		ret = -ECONNRESET;
 		ULOGE("%s: cannot reply to request: connection closed",
@@ -1989,20 +2562,6 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 		ret = -EINVAL;
 		goto out;
 	}
-	list_walk_entry_forward(&request->medias, req_media, node)
-	{
-		if (req_media->media == media) {
-			found = 1;
-			break;
-		}
-	}
-	if (!found) {
-		ULOGE("%s: media not found", __func__);
-		ret = -ENOENT;
-		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
-		replied = request->media_count;
-		goto out;
-	}
 
 	if (request->request_first_reply) {
 		session->range = *range;
@@ -2040,10 +2599,8 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 		free(request->response_header.status_string);
 		request->response_header.status_string = strdup(status_string);
 		request->response_header.cseq = request->request_header.cseq;
-		free(request->response_header.server);
-		request->response_header.server = strdup(server->software_name);
-		time_get_monotonic(&cur_ts);
-		request->response_header.date = cur_ts.tv_sec;
+		request->response_header.date =
+			rtsp_date_cache_now(&server->date);
 		free(request->response_header.session_id);
 		request->response_header.session_id =
 			strdup(session->session_id);
@@ -2059,17 +2616,17 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 		}
 
 		/* Create the response */
-		response.max_len = server->max_msg_size;
-		response.str = calloc(server->max_msg_size, 1);
-		if (response.str == NULL) {
-			ret = -ENOMEM;
-			ULOG_ERRNO("calloc", -ret);
+		ret = rtsp_server_buffer_get(server, &resp_buf, &response);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 			error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
 			replied = request->media_count;
 			goto out;
 		}
 
-		ret = rtsp_response_header_write(&request->response_header,
+		ret = rtsp_server_response_write(server,
+						 session,
+						 &request->response_header,
 						 &response);
 		if (ret < 0) {
 			error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
@@ -2091,8 +2648,11 @@ int rtsp_server_reply_to_pause(struct rtsp_server *server,
 			      request->response_header.session_id
 				      ? request->response_header.session_id
 				      : "-");
-			resp_buf = pomp_buffer_new_with_data(response.str,
-							     response.len);
+			ret = pomp_buffer_set_len(resp_buf, response.len);
+			if (ret < 0) {
+				ULOG_ERRNO("pomp_buffer_set_len", -ret);
+				goto out;
+			}
 			ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
 			if (ret < 0) {
 				ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
@@ -2115,9 +2675,7 @@ out:
 			rtsp_server_pending_request_remove(server, request);
 		}
 	}
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
+	rtsp_server_buffer_put(server, resp_buf);
 	return ret;
 }
 
@@ -2130,7 +2688,6 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 				  size_t ext_count)
 {
 	int ret = 0;
-	int found = 0;
 	int replied = 0;
 	struct rtsp_server_pending_request *request = NULL;
 	struct rtsp_string response;
@@ -2143,7 +2700,6 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 	int status_code = 0;
 	int error_status = 0;
 	const char *status_string = NULL;
-	struct timespec cur_ts = {0, 0};
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
@@ -2151,17 +2707,27 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 
 	memset(&response, 0, sizeof(response));
 
-	request = request_ctx;
-	media = media_ctx;
-	session = media->session;
-
-	ret = rtsp_server_pending_request_find(server, request);
-	if (ret < 0) {
+	request = rtsp_server_pending_request_find(server, request_ctx);
+	if (request == NULL) {
+		ret = -ENOENT;
 		ULOG_ERRNO("rtsp_server_pending_request_find", -ret);
-		request = NULL;
 		goto out;
 	}
 
+	/* The media context is only dereferenced once it is known to
+	 * belong to the request */
+	req_media = rtsp_server_pending_request_media_find(
+		server, request, media_ctx);
+	if (req_media == NULL) {
+		ULOGE("%s: media not found", __func__);
+		ret = -ENOENT;
+		replied = request->media_count;
+		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
+		goto out;
+	}
+	media = req_media->media;
+	session = media->session;
+
 	if (request->conn == NULL) {
 		ret = -ECONNRESET;
 		ULOGE("%s: cannot reply to request: connection closed",
@@ -2181,20 +2747,6 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 		ret = -EINVAL;
 		goto out;
 	}
-	list_walk_entry_forward(&request->medias, req_media, node)
-	{
-		if (req_media->media == media) {
-			found = 1;
-			break;
-		}
-	}
-	if (!found) {
-		ULOGE("%s: media not found", __func__);
-		ret = -ENOENT;
-		error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
-		replied = request->media_count;
-		goto out;
-	}
 
 	req_media->replied = 1;
 	list_walk_entry_forward(&request->medias, rm, node)
@@ -2217,10 +2769,8 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 		free(request->response_header.status_string);
 		request->response_header.status_string = strdup(status_string);
 		request->response_header.cseq = request->request_header.cseq;
-		free(request->response_header.server);
-		request->response_header.server = strdup(server->software_name);
-		time_get_monotonic(&cur_ts);
-		request->response_header.date = cur_ts.tv_sec;
+		request->response_header.date =
+			rtsp_date_cache_now(&server->date);
 		free(request->response_header.session_id);
 		request->response_header.session_id =
 			strdup(request->request_header.session_id);
@@ -2235,17 +2785,17 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 		}
 
 		/* Create the response */
-		response.max_len = server->max_msg_size;
-		response.str = calloc(server->max_msg_size, 1);
-		if (response.str == NULL) {
-			ret = -ENOMEM;
-			ULOG_ERRNO("calloc", -ret);
+		ret = rtsp_server_buffer_get(server, &resp_buf, &response);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 			error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
 			replied = request->media_count;
 			goto out;
 		}
 
-		ret = rtsp_response_header_write(&request->response_header,
+		ret = rtsp_server_response_write(server,
+						 session,
+						 &request->response_header,
 						 &response);
 		if (ret < 0) {
 			error_status = RTSP_STATUS_CODE_INTERNAL_SERVER_ERROR;
@@ -2267,8 +2817,11 @@ int rtsp_server_reply_to_teardown(struct rtsp_server *server,
 			      request->response_header.session_id
 				      ? request->response_header.session_id
 				      : "-");
-			resp_buf = pomp_buffer_new_with_data(response.str,
-							     response.len);
+			ret = pomp_buffer_set_len(resp_buf, response.len);
+			if (ret < 0) {
+				ULOG_ERRNO("pomp_buffer_set_len", -ret);
+				goto out;
+			}
 			ret = pomp_conn_send_raw_buf(request->conn, resp_buf);
 			if (ret < 0) {
 				ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
@@ -2306,9 +2859,7 @@ out:
 			}
 		}
 	}
-	if (resp_buf != NULL)
-		pomp_buffer_unref(resp_buf);
-	free(response.str);
+	rtsp_server_buffer_put(server, resp_buf);
 	return ret;
 }
 
@@ -2321,9 +2872,8 @@ int rtsp_server_announce(struct rtsp_server *server,
 {
 	int ret = 0;
 	struct rtsp_request_header header;
-	struct pomp_buffer *req_buf;
+	struct pomp_buffer *req_buf = NULL;
 	struct rtsp_string request;
-	struct timespec cur_ts = {0, 0};
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(uri == NULL, EINVAL);
@@ -2342,8 +2892,7 @@ int rtsp_server_announce(struct rtsp_server *server,
 	header.cseq = server->cseq++;
 	header.content_length = session_description_len;
 	header.content_type = RTSP_CONTENT_TYPE_SDP;
-	time_get_monotonic(&cur_ts);
-	header.date = cur_ts.tv_sec;
+	header.date = rtsp_date_cache_now(&server->date);
 	header.server = server->software_name;
 	ret = rtsp_request_header_copy_ext(&header, ext, ext_count);
 	if (ret < 0)
@@ -2357,11 +2906,9 @@ int rtsp_server_announce(struct rtsp_server *server,
 
 	/* Create the request */
 	memset(&request, 0, sizeof(request));
-	request.max_len = server->max_msg_size;
-	request.str = calloc(server->max_msg_size, 1);
-	if (request.str == NULL) {
-		ret = -ENOMEM;
-		ULOG_ERRNO("calloc", -ret);
+	ret = rtsp_server_buffer_get(server, &req_buf, &request);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_server_buffer_get", -ret);
 		goto out;
 	}
 
@@ -2382,20 +2929,101 @@ int rtsp_server_announce(struct rtsp_server *server,
 		      rtsp_method_type_str(header.method),
 		      header.cseq,
 		      header.session_id ? header.session_id : "-");
-		req_buf = pomp_buffer_new_with_data(request.str, request.len);
+		ret = pomp_buffer_set_len(req_buf, request.len);
+		if (ret < 0) {
+			ULOG_ERRNO("pomp_buffer_set_len", -ret);
+			goto out;
+		}
 		ret = pomp_ctx_send_raw_buf(server->pomp, req_buf);
 		if (ret < 0)
 			ULOG_ERRNO("pomp_ctx_send_raw_buf", -ret);
-		pomp_buffer_unref(req_buf);
 	}
 
 out:
+	rtsp_server_buffer_put(server, req_buf);
 	free(header.uri);
-	free(request.str);
 	return ret;
 }
 
 
+int rtsp_server_set_max_msg_size(struct rtsp_server *server, size_t size)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(size == 0, EINVAL);
+
+	server->max_msg_size = size;
+
+	return 0;
+}
+
+
+int rtsp_server_send_interleaved(struct rtsp_server *server,
+				 const char *session_id,
+				 uint8_t channel,
+				 struct pomp_buffer *buf)
+{
+	int ret;
+	uint8_t *data;
+	size_t len;
+	struct rtsp_server_session *session;
+	struct rtsp_server_session_media *media;
+	struct rtsp_server_conn *c = NULL;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(session_id == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+
+	session = rtsp_server_session_find(server, session_id);
+	if (session == NULL)
+		return -ENOENT;
+
+	list_walk_entry_forward(&session->medias, media, node)
+	{
+		if (media->conn != NULL &&
+		    (media->channel_pair.rtp == channel ||
+		     media->channel_pair.rtcp == channel)) {
+			c = media->conn;
+			break;
+		}
+	}
+	if (c == NULL)
+		return -ENOENT;
+
+	/* The header is written in place, in the buffer headroom */
+	ret = pomp_buffer_get_data(buf, (void **)&data, &len, NULL);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_buffer_get_data", -ret);
+		return ret;
+	}
+	ULOG_ERRNO_RETURN_ERR_IF(len <= RTSP_INTERLEAVED_HEADER_LEN, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(
+		len - RTSP_INTERLEAVED_HEADER_LEN > UINT16_MAX, EINVAL);
+
+	/* Backpressure: do not queue more data on a slow connection */
+	if (c->tx.queued_bytes + len > RTSP_SERVER_CONN_TX_QUEUE_MAX) {
+		c->tx.blocked = true;
+		c->stats.tx_interleaved_dropped++;
+		return -EAGAIN;
+	}
+
+	rtsp_interleaved_header_write(
+		channel, len - RTSP_INTERLEAVED_HEADER_LEN, data);
+
+	/* Accounted before sending, as the send callback can be called
+	 * synchronously if the data is written right away */
+	c->tx.queued_bytes += len;
+	ret = pomp_conn_send_raw_buf(c->conn, buf);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_conn_send_raw_buf", -ret);
+		c->tx.queued_bytes -= len;
+		return ret;
+	}
+	c->stats.tx_interleaved++;
+
+	return 0;
+}
+
+
 int rtsp_server_force_teardown(struct rtsp_server *server,
 			       const char *session_id,
 			       const char *path,
@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_server_priv.h"
+
+#define ULOG_TAG rtsp_server
+#include <ulog.h>
+
+
+struct rtsp_server_conn *rtsp_server_conn_add(struct rtsp_server *server,
+					      struct pomp_conn *conn)
+{
+	int ret;
+	struct rtsp_server_conn *c = NULL;
+	const struct sockaddr *addr = NULL;
+	uint32_t addrlen = 0;
+
+	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
+	ULOG_ERRNO_RETURN_VAL_IF(conn == NULL, EINVAL, NULL);
+
+	c = calloc(1, sizeof(*c));
+	ULOG_ERRNO_RETURN_VAL_IF(c == NULL, ENOMEM, NULL);
+	list_node_unref(&c->node);
+	c->server = server;
+	c->conn = conn;
+
+	addr = pomp_conn_get_peer_addr(conn, &addrlen);
+	if (addr != NULL) {
+		(void)rtsp_sockaddr_to_str(
+			addr, addrlen, c->peer_addr, sizeof(c->peer_addr));
+	}
+	addr = pomp_conn_get_local_addr(conn, &addrlen);
+	if (addr != NULL) {
+		(void)rtsp_sockaddr_to_str(
+			addr, addrlen, c->local_addr, sizeof(c->local_addr));
+	}
+
+	c->request_buf = pomp_buffer_new(PIPE_BUF - 1);
+	if (c->request_buf == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("pomp_buffer_new", -ret);
+		goto error;
+	}
+
+	ret = rtsp_map_put(&server->conn_map, (uintptr_t)conn, c);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_map_put", -ret);
+		goto error;
+	}
+
+	/* Add to the list */
+	list_add_before(&server->conns, &c->node);
+	server->conn_count++;
+
+	return c;
+
+error:
+	if (c->request_buf != NULL)
+		pomp_buffer_unref(c->request_buf);
+	free(c);
+	return NULL;
+}
+
+
+int rtsp_server_conn_remove(struct rtsp_server *server,
+			    struct rtsp_server_conn *conn)
+{
+	int ret;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(conn == NULL, EINVAL);
+
+	ret = rtsp_map_remove(&server->conn_map, (uintptr_t)conn->conn);
+	if (ret < 0) {
+		ULOGE("%s: connection not found", __func__);
+		return ret;
+	}
+
+	/* Remove from the list */
+	list_del(&conn->node);
+	server->conn_count--;
+
+	/* The medias set up on this connection can no longer send or
+	 * receive interleaved data */
+	for (size_t i = 0; i < SIZEOF_ARRAY(conn->channel_media); i++) {
+		if (conn->channel_media[i] != NULL)
+			conn->channel_media[i]->conn = NULL;
+	}
+
+	rtsp_message_parser_ctx_clear(&conn->parser_ctx);
+	if (conn->request_buf != NULL)
+		pomp_buffer_unref(conn->request_buf);
+	free(conn);
+
+	return 0;
+}
+
+
+struct rtsp_server_conn *rtsp_server_conn_find(const struct rtsp_server *server,
+					       const struct pomp_conn *conn)
+{
+	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
+	ULOG_ERRNO_RETURN_VAL_IF(conn == NULL, EINVAL, NULL);
+
+	return rtsp_map_get(&server->conn_map, (uintptr_t)conn);
+}
+
+
+/* Bind a pair of interleaved channels on the connection to a media; if
+ * the pair is not valid, the next available pair is used */
+int rtsp_server_conn_channels_bind(struct rtsp_server_conn *conn,
+				   struct rtsp_server_session_media *media,
+				   struct rtsp_channel_pair *pair)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(conn == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(media == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(pair == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(media->conn != NULL, EBUSY);
+
+	if (is_channel_pair_valid(pair)) {
+		if (conn->channel_media[pair->rtp] != NULL ||
+		    conn->channel_media[pair->rtcp] != NULL) {
+			ULOGE("%s: channels %u-%u already used",
+			      __func__,
+			      pair->rtp,
+			      pair->rtcp);
+			return -EEXIST;
+		}
+	} else {
+		/* Use next available channels */
+		size_t i;
+		for (i = 0; i < SIZEOF_ARRAY(conn->channel_media) - 1; i += 2) {
+			if (conn->channel_media[i] == NULL &&
+			    conn->channel_media[i + 1] == NULL)
+				break;
+		}
+		if (i >= SIZEOF_ARRAY(conn->channel_media) - 1) {
+			ULOGE("%s: no more channels available", __func__);
+			return -ENOSPC;
+		}
+		pair->rtp = i;
+		pair->rtcp = i + 1;
+	}
+
+	conn->channel_media[pair->rtp] = media;
+	conn->channel_media[pair->rtcp] = media;
+	media->channel_pair = *pair;
+	media->conn = conn;
+
+	return 0;
+}
+
+
+void rtsp_server_conn_channels_unbind(struct rtsp_server_session_media *media)
+{
+	struct rtsp_server_conn *conn;
+
+	if (media == NULL || media->conn == NULL)
+		return;
+
+	conn = media->conn;
+	if (conn->channel_media[media->channel_pair.rtp] == media)
+		conn->channel_media[media->channel_pair.rtp] = NULL;
+	if (conn->channel_media[media->channel_pair.rtcp] == media)
+		conn->channel_media[media->channel_pair.rtcp] = NULL;
+	media->conn = NULL;
+}
+
+
+/* Bind the interleaved medias of a session whose connection was closed
+ * to another connection, on the same channels; either all of them or
+ * none are bound */
+int rtsp_server_conn_channels_rebind(struct rtsp_server_conn *conn,
+				     struct rtsp_server_session *session)
+{
+	int ret;
+	struct rtsp_server_session_media *media;
+
+	ULOG_ERRNO_RETURN_ERR_IF(conn == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(session == NULL, EINVAL);
+
+	/* The medias not using interleaved channels have no valid pair */
+	list_walk_entry_forward(&session->medias, media, node)
+	{
+		if (media->conn != NULL ||
+		    !is_channel_pair_valid(&media->channel_pair))
+			continue;
+		if (conn->channel_media[media->channel_pair.rtp] != NULL ||
+		    conn->channel_media[media->channel_pair.rtcp] != NULL) {
+			ULOGE("%s: channels %u-%u already used",
+			      __func__,
+			      media->channel_pair.rtp,
+			      media->channel_pair.rtcp);
+			return -EEXIST;
+		}
+	}
+
+	list_walk_entry_forward(&session->medias, media, node)
+	{
+		struct rtsp_channel_pair pair = media->channel_pair;
+		if (media->conn != NULL || !is_channel_pair_valid(&pair))
+			continue;
+		ret = rtsp_server_conn_channels_bind(conn, media, &pair);
+		if (ret < 0)
+			return ret;
+		ULOGI("%s: channels %u-%u moved to a new connection",
+		      __func__,
+		      pair.rtp,
+		      pair.rtcp);
+	}
+
+	return 0;
+}
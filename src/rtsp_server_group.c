@@ -0,0 +1,346 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_server_priv.h"
+
+#define ULOG_TAG rtsp_server
+#include <ulog.h>
+
+
+static void group_msg_destroy(struct rtsp_server_group_msg *msg)
+{
+	if (msg == NULL)
+		return;
+
+	rtsp_header_ext_array_free(msg->ext, msg->ext_count);
+	free(msg->session_id);
+	free(msg->path);
+	free(msg->uri);
+	free(msg->session_description);
+	free(msg);
+}
+
+
+static struct rtsp_server_group_msg *
+group_msg_new(enum rtsp_server_group_msg_type type,
+	      const struct rtsp_header_ext *ext,
+	      size_t ext_count)
+{
+	struct rtsp_server_group_msg *msg;
+
+	msg = calloc(1, sizeof(*msg));
+	if (msg == NULL)
+		return NULL;
+	msg->type = type;
+
+	if (rtsp_header_ext_array_copy(ext, ext_count, &msg->ext) < 0) {
+		free(msg);
+		return NULL;
+	}
+	msg->ext_count = ext_count;
+
+	return msg;
+}
+
+
+static void group_msg_process(struct rtsp_server_group_shard *shard,
+			      struct rtsp_server_group_msg *msg)
+{
+	int ret;
+
+	switch (msg->type) {
+	case RTSP_SERVER_GROUP_MSG_FORCE_TEARDOWN:
+		ret = rtsp_server_force_teardown(shard->server,
+						 msg->session_id,
+						 msg->path,
+						 msg->ext,
+						 msg->ext_count);
+		if ((ret < 0) && (ret != -EALREADY))
+			ULOG_ERRNO("rtsp_server_force_teardown", -ret);
+		break;
+	case RTSP_SERVER_GROUP_MSG_ANNOUNCE:
+		ret = rtsp_server_announce(shard->server,
+					   msg->uri,
+					   msg->ext,
+					   msg->ext_count,
+					   msg->session_description);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_announce", -ret);
+		break;
+	default:
+		ULOGW("%s: unknown message type %d", __func__, msg->type);
+		break;
+	}
+}
+
+
+/* Called on the shard loop */
+static void group_node_cb(struct rtsp_mpsc_node *node,
+			  int process,
+			  void *userdata)
+{
+	struct rtsp_server_group_shard *shard = userdata;
+	struct rtsp_server_group_msg *msg;
+
+	msg = container_of(node, struct rtsp_server_group_msg, node);
+	if (process)
+		group_msg_process(shard, msg);
+	group_msg_destroy(msg);
+}
+
+
+static int group_shard_init(struct rtsp_server_group_shard *shard,
+			    struct rtsp_server_group *group,
+			    unsigned int index,
+			    const char *software_name,
+			    uint16_t port,
+			    int reply_timeout_ms,
+			    int session_timeout_ms,
+			    struct pomp_loop *loop,
+			    const struct rtsp_server_cbs *cbs,
+			    void *userdata)
+{
+	int ret;
+
+	shard->group = group;
+	shard->loop = loop;
+
+	ret = rtsp_mpsc_evt_init(&shard->mq, loop, &group_node_cb, shard);
+	if (ret < 0)
+		return ret;
+
+	ret = rtsp_server_new_shard(software_name,
+				    port,
+				    reply_timeout_ms,
+				    session_timeout_ms,
+				    loop,
+				    cbs,
+				    userdata,
+				    group,
+				    index,
+				    &shard->server);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+
+static int group_shard_clear(struct rtsp_server_group_shard *shard)
+{
+	int ret;
+
+	if (shard->server != NULL) {
+		ret = rtsp_server_destroy(shard->server);
+		if (ret < 0)
+			return ret;
+		shard->server = NULL;
+	}
+
+	/* Drop the messages that were never processed */
+	rtsp_mpsc_evt_clear(&shard->mq);
+
+	return 0;
+}
+
+
+int rtsp_server_group_new(const char *software_name,
+			  uint16_t port,
+			  int reply_timeout_ms,
+			  int session_timeout_ms,
+			  struct pomp_loop *const *loops,
+			  unsigned int loop_count,
+			  const struct rtsp_server_cbs *cbs,
+			  void *userdata,
+			  struct rtsp_server_group **ret_obj)
+{
+	int ret;
+	struct rtsp_server_group *group = NULL;
+
+	ULOG_ERRNO_RETURN_ERR_IF(loops == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(loop_count == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(loop_count > RTSP_SERVER_GROUP_MAX_SHARDS,
+				 EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+#ifndef SO_REUSEPORT
+	/* The shards need to share the listening port */
+	ULOGE("%s: SO_REUSEPORT is not supported", __func__);
+	return -ENOSYS;
+#endif
+
+	group = calloc(1, sizeof(*group));
+	ULOG_ERRNO_RETURN_ERR_IF(group == NULL, ENOMEM);
+
+	group->shards = calloc(loop_count, sizeof(*group->shards));
+	if (group->shards == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	group->shard_count = loop_count;
+
+	for (unsigned int i = 0; i < loop_count; i++) {
+		ret = group_shard_init(&group->shards[i],
+				       group,
+				       i,
+				       software_name,
+				       port,
+				       reply_timeout_ms,
+				       session_timeout_ms,
+				       loops[i],
+				       cbs,
+				       userdata);
+		if (ret < 0)
+			goto error;
+	}
+
+	*ret_obj = group;
+	return 0;
+
+error:
+	rtsp_server_group_destroy(group);
+	return ret;
+}
+
+
+int rtsp_server_group_destroy(struct rtsp_server_group *group)
+{
+	int ret;
+
+	if (group == NULL)
+		return 0;
+
+	for (unsigned int i = 0; i < group->shard_count; i++) {
+		ret = group_shard_clear(&group->shards[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	free(group->shards);
+	free(group);
+	return 0;
+}
+
+
+unsigned int
+rtsp_server_group_get_shard_count(const struct rtsp_server_group *group)
+{
+	ULOG_ERRNO_RETURN_VAL_IF(group == NULL, EINVAL, 0);
+
+	return group->shard_count;
+}
+
+
+struct rtsp_server *
+rtsp_server_group_get_shard(const struct rtsp_server_group *group,
+			    unsigned int index)
+{
+	ULOG_ERRNO_RETURN_VAL_IF(group == NULL, EINVAL, NULL);
+	ULOG_ERRNO_RETURN_VAL_IF(index >= group->shard_count, EINVAL, NULL);
+
+	return group->shards[index].server;
+}
+
+
+int rtsp_server_group_force_teardown(struct rtsp_server_group *group,
+				     const char *session_id,
+				     const char *path,
+				     const struct rtsp_header_ext *ext,
+				     size_t ext_count)
+{
+	int ret;
+	unsigned int index;
+	struct rtsp_server_group_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(group == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(session_id == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	ret = rtsp_server_session_id_get_shard(session_id, &index);
+	if ((ret < 0) || (index >= group->shard_count)) {
+		ULOGE("%s: invalid session id '%s'", __func__, session_id);
+		return -ENOENT;
+	}
+
+	msg = group_msg_new(
+		RTSP_SERVER_GROUP_MSG_FORCE_TEARDOWN, ext, ext_count);
+	if (msg == NULL)
+		goto nomem;
+	msg->session_id = strdup(session_id);
+	if (msg->session_id == NULL)
+		goto nomem;
+	if (path != NULL) {
+		msg->path = strdup(path);
+		if (msg->path == NULL)
+			goto nomem;
+	}
+
+	return rtsp_mpsc_evt_post(&group->shards[index].mq, &msg->node);
+
+nomem:
+	ULOG_ERRNO("strdup", ENOMEM);
+	group_msg_destroy(msg);
+	return -ENOMEM;
+}
+
+
+int rtsp_server_group_announce(struct rtsp_server_group *group,
+			       const char *uri,
+			       const struct rtsp_header_ext *ext,
+			       size_t ext_count,
+			       const char *session_description)
+{
+	int ret, err = 0;
+	struct rtsp_server_group_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(group == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(uri == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(session_description == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	/* Each shard announces to its own sessions */
+	for (unsigned int i = 0; i < group->shard_count; i++) {
+		msg = group_msg_new(
+			RTSP_SERVER_GROUP_MSG_ANNOUNCE, ext, ext_count);
+		if (msg != NULL) {
+			msg->uri = strdup(uri);
+			msg->session_description = strdup(session_description);
+		}
+		if ((msg == NULL) || (msg->uri == NULL) ||
+		    (msg->session_description == NULL)) {
+			ULOG_ERRNO("strdup", ENOMEM);
+			group_msg_destroy(msg);
+			err = -ENOMEM;
+			continue;
+		}
+		ret = rtsp_mpsc_evt_post(&group->shards[i].mq, &msg->node);
+		if (ret < 0)
+			err = ret;
+	}
+
+	return err;
+}
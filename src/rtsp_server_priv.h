@@ -32,9 +32,33 @@
 
 
 #define RTSP_SERVER_DEFAULT_SOFTWARE_NAME "librtsp_server"
-#define RTSP_SERVER_SESSION_ID_LENGTH 8
+/* Session identifiers are 64-bit values formatted as lowercase hex */
+#define RTSP_SERVER_SESSION_ID_LENGTH 16
 #define RTSP_SERVER_DEFAULT_REPLY_TIMEOUT_MS 1000
 #define RTSP_SERVER_DEFAULT_SESSION_TIMEOUT_MS 60000
+#define RTSP_SERVER_TIMER_TICK_MS 100
+#define RTSP_SERVER_BUFFER_POOL_SIZE 8
+#define RTSP_SERVER_CONN_TX_QUEUE_MAX (1024 * 1024)
+#define RTSP_SERVER_STATUS_LINE_CACHE_SIZE 16
+#define RTSP_SERVER_CONTENT_BASE_LINE_CACHE_SIZE 16
+
+/* In a server group, the most significant byte of the session
+ * identifiers is the index of the shard owning the session */
+#define RTSP_SERVER_GROUP_MAX_SHARDS 256
+#define RTSP_SERVER_SESSION_SHARD_SHIFT 56
+#define RTSP_SERVER_SESSION_SHARD_MASK                                         \
+	(0xffULL << RTSP_SERVER_SESSION_SHARD_SHIFT)
+#define RTSP_SERVER_PUBLIC_METHODS RTSP_METHOD_FLAGS_PLAYBACK
+
+/* Pending request handles: slot index + 1 in the low 16 bits, slot
+ * generation in the remaining bits of a pointer (48 bits on 64-bit
+ * platforms) */
+#define RTSP_SERVER_PENDING_REQUEST_INDEX_BITS 16
+#define RTSP_SERVER_PENDING_REQUEST_INDEX_MASK 0xffff
+#define RTSP_SERVER_PENDING_REQUEST_GEN_MASK                                   \
+	(UINTPTR_MAX >> RTSP_SERVER_PENDING_REQUEST_INDEX_BITS)
+#define RTSP_SERVER_PENDING_REQUEST_MAX UINT16_MAX
+#define RTSP_SERVER_PENDING_REQUEST_MIN_SLOTS 16
 
 
 struct rtsp_server_session_media {
@@ -44,26 +68,39 @@ struct rtsp_server_session_media {
 	void *userdata;
 	bool is_tearing_down;
 
+	/* Interleaved channels and connection, for lower transport
+	 * RTSP_LOWER_TRANSPORT_TCP (NULL connection otherwise) */
+	struct rtsp_channel_pair channel_pair;
+	struct rtsp_server_conn *conn;
+
+	/* Next media with the same path hash (see media_map) */
+	uint64_t path_hash;
+	struct rtsp_server_session_media *hash_next;
+
 	struct list_node node;
 };
 
 
 struct rtsp_server_session {
 	struct rtsp_server *server;
+	uint64_t id;
 	char *session_id;
 	char *uri;
 	unsigned int timeout_ms;
-	struct pomp_timer *timer;
+	struct rtsp_twheel_timer timer;
 	int playing;
+	/* Pre-serialized 'Session' response line */
+	struct rtsp_header_line session_line;
 	struct rtsp_range range;
 	float scale;
 
 	/* Operation in progress */
 	enum rtsp_method_type op_in_progress;
 
-	/* Medias */
+	/* Medias (also indexed by path hash) */
 	unsigned int media_count;
 	struct list_node medias;
+	struct rtsp_map media_map;
 
 	struct list_node node;
 };
@@ -81,11 +118,14 @@ struct rtsp_server_pending_request {
 	struct pomp_conn *conn;
 	struct rtsp_request_header request_header;
 	struct rtsp_response_header response_header;
-	uint64_t timeout;
+	struct rtsp_twheel_timer timer;
 	int request_first_reply;
 	int in_callback;
 	int replied;
 
+	/* Handle given to the application as request_ctx */
+	uintptr_t handle;
+
 	/* Medias */
 	unsigned int media_count;
 	struct list_node medias;
@@ -94,44 +134,212 @@ struct rtsp_server_pending_request {
 };
 
 
+struct rtsp_server_pending_request_slot {
+	struct rtsp_server_pending_request *request;
+	uintptr_t gen;
+	/* Next free slot index + 1 (0 if none) */
+	uint32_t next_free;
+};
+
+
+struct rtsp_server_conn {
+	struct rtsp_server *server;
+	struct pomp_conn *conn;
+	char peer_addr[INET6_ADDRSTRLEN];
+	char local_addr[INET6_ADDRSTRLEN];
+
+	/* Receive buffer and parser state */
+	struct pomp_buffer *request_buf;
+	struct rtsp_message_parser_ctx parser_ctx;
+
+	/* Interleaved channels demux (medias set up on this connection) */
+	struct rtsp_server_session_media *channel_media[UINT8_MAX + 1];
+
+	/* Interleaved data waiting in the pomp write queue */
+	struct {
+		size_t queued_bytes;
+		bool blocked;
+	} tx;
+
+	/* Statistics */
+	struct {
+		uint64_t rx_bytes;
+		unsigned int rx_requests;
+		unsigned int rx_responses;
+		unsigned int rx_interleaved;
+		unsigned int rx_interleaved_dropped;
+		unsigned int tx_interleaved;
+		unsigned int tx_interleaved_dropped;
+		unsigned int parse_errors;
+	} stats;
+
+	struct list_node node;
+};
+
+
 struct rtsp_server {
-	struct sockaddr_in listen_addr_in;
+	/* Set before pomp_ctx_listen(), used by the socket callback */
+	struct sockaddr_storage listen_addr;
 	struct pomp_loop *loop;
 	struct pomp_ctx *pomp;
-	struct pomp_timer *timer;
-	unsigned int max_msg_size;
+	/* Group of the server when it is one of its shards (or NULL) */
+	struct rtsp_server_group *group;
+	unsigned int shard_index;
+	size_t max_msg_size;
 	struct rtsp_server_cbs cbs;
 	void *cbs_userdata;
 
 	char *software_name;
 
+	/* Request and session timeouts; the loop timer is armed for the
+	 * next non-empty slot of the wheel (timer_expiry, in ms) */
+	struct pomp_timer *timer;
+	bool timer_running;
+	uint64_t timer_expiry;
+	struct rtsp_twheel timers;
+
+	/* Outgoing messages buffers pool */
+	struct {
+		struct pomp_buffer *bufs[RTSP_SERVER_BUFFER_POOL_SIZE];
+		unsigned int count;
+		/* Allocator counters */
+		unsigned int allocs;
+		unsigned int reuses;
+	} buf_pool;
+
+	/* Pre-serialized response lines (see rtsp_server_response_write),
+	 * the status and 'Content-Base' lines are added on first use */
+	struct {
+		struct {
+			int code;
+			struct rtsp_header_line line;
+		} status[RTSP_SERVER_STATUS_LINE_CACHE_SIZE];
+		unsigned int status_count;
+		struct rtsp_header_line public_methods;
+		struct rtsp_header_line server;
+		struct rtsp_header_line content_type_sdp;
+		struct {
+			char *uri;
+			struct rtsp_header_line line;
+		} content_base[RTSP_SERVER_CONTENT_BASE_LINE_CACHE_SIZE];
+		unsigned int content_base_count;
+	} lines;
+	struct rtsp_date_cache date;
+
 	int pending_content_length;
 	int reply_timeout_ms;
 
-	/* Sessions */
+	/* Sessions (also indexed by identifier) */
 	int session_timeout_ms;
 	unsigned int session_count;
 	struct list_node sessions;
+	struct rtsp_map session_map;
 
-	/* Pending requests */
-	struct pomp_buffer *request_buf;
+	/* Client connections (indexed by pomp_conn) */
+	unsigned int conn_count;
+	struct list_node conns;
+	struct rtsp_map conn_map;
+
+	/* Pending requests (also in a slab of slots, see
+	 * rtsp_server_pending_request_find) */
 	unsigned int pending_request_count;
 	struct list_node pending_requests;
+	struct {
+		struct rtsp_server_pending_request_slot *slots;
+		size_t count;
+		/* First and last free slot indexes + 1 (0 if none); the
+		 * slots are reused in FIFO order, so that a stale handle
+		 * does not match a new request right away */
+		uint32_t free_head;
+		uint32_t free_tail;
+	} request_slab;
 
 	/* Announce requests */
 	unsigned int cseq;
 
-	struct rtsp_message_parser_ctx parser_ctx;
+	/* Replies posted from other threads, see rtsp_server_post_reply_*() */
+	struct rtsp_mpsc_evt replies;
+};
+
+
+/* Reply posted from any thread, run on the server loop */
+struct rtsp_server_reply_msg {
+	struct rtsp_mpsc_node node;
+	enum rtsp_method_type method;
+	void *request_ctx;
+	void *media_ctx;
+	int status;
+	struct rtsp_header_ext *ext;
+	size_t ext_count;
+	union {
+		struct {
+			char *session_description;
+		} describe;
+		struct {
+			uint16_t src_stream_port;
+			uint16_t src_control_port;
+			int ssrc_valid;
+			uint32_t ssrc;
+			void *stream_userdata;
+		} setup;
+		struct {
+			int range_valid;
+			struct rtsp_range range;
+			float scale;
+			int seq_valid;
+			uint16_t seq;
+			int rtptime_valid;
+			uint32_t rtptime;
+		} play;
+		struct {
+			int range_valid;
+			struct rtsp_range range;
+		} pause;
+	};
+};
+
+
+enum rtsp_server_group_msg_type {
+	RTSP_SERVER_GROUP_MSG_FORCE_TEARDOWN = 0,
+	RTSP_SERVER_GROUP_MSG_ANNOUNCE,
+};
+
+
+/* Request posted to a shard from any thread */
+struct rtsp_server_group_msg {
+	struct rtsp_mpsc_node node;
+	enum rtsp_server_group_msg_type type;
+	char *session_id;
+	char *path;
+	char *uri;
+	char *session_description;
+	struct rtsp_header_ext *ext;
+	size_t ext_count;
+};
+
+
+struct rtsp_server_group_shard {
+	struct rtsp_server_group *group;
+	struct rtsp_server *server;
+	struct pomp_loop *loop;
+	struct rtsp_mpsc_evt mq;
 };
 
 
-struct rtsp_server_session *rtsp_server_session_add(struct rtsp_server *server,
-						    unsigned int timeout_ms,
-						    const char *uri);
+struct rtsp_server_group {
+	struct rtsp_server_group_shard *shards;
+	unsigned int shard_count;
+};
+
+
+RTSP_API struct rtsp_server_session *
+rtsp_server_session_add(struct rtsp_server *server,
+			unsigned int timeout_ms,
+			const char *uri);
 
 
-int rtsp_server_session_remove(struct rtsp_server *server,
-			       struct rtsp_server_session *session);
+RTSP_API int rtsp_server_session_remove(struct rtsp_server *server,
+					struct rtsp_server_session *session);
 
 
 void rtsp_server_session_remove_idle(void *userdata);
@@ -140,21 +348,27 @@ void rtsp_server_session_remove_idle(void *userdata);
 int rtsp_server_session_reset_timeout(struct rtsp_server_session *session);
 
 
-struct rtsp_server_session *
+/* Get the index of the shard owning a session from its identifier */
+RTSP_API int rtsp_server_session_id_get_shard(const char *session_id,
+					      unsigned int *shard_index);
+
+
+RTSP_API struct rtsp_server_session *
 rtsp_server_session_find(const struct rtsp_server *server,
 			 const char *session_id);
 
 
-struct rtsp_server_session_media *
+RTSP_API struct rtsp_server_session_media *
 rtsp_server_session_media_add(const struct rtsp_server *server,
 			      struct rtsp_server_session *session,
 			      const char *uri,
 			      const char *path);
 
 
-int rtsp_server_session_media_remove(const struct rtsp_server *server,
-				     struct rtsp_server_session *session,
-				     struct rtsp_server_session_media *media);
+RTSP_API int
+rtsp_server_session_media_remove(const struct rtsp_server *server,
+				 struct rtsp_server_session *session,
+				 struct rtsp_server_session_media *media);
 
 
 struct rtsp_server_session_media *
@@ -163,35 +377,123 @@ rtsp_server_session_media_find(const struct rtsp_server *server,
 			       const char *path);
 
 
-struct rtsp_server_pending_request *
+struct rtsp_server_conn *rtsp_server_conn_add(struct rtsp_server *server,
+					      struct pomp_conn *conn);
+
+
+int rtsp_server_conn_remove(struct rtsp_server *server,
+			    struct rtsp_server_conn *conn);
+
+
+struct rtsp_server_conn *rtsp_server_conn_find(const struct rtsp_server *server,
+					       const struct pomp_conn *conn);
+
+
+RTSP_API int
+rtsp_server_conn_channels_bind(struct rtsp_server_conn *conn,
+			       struct rtsp_server_session_media *media,
+			       struct rtsp_channel_pair *pair);
+
+
+RTSP_API void
+rtsp_server_conn_channels_unbind(struct rtsp_server_session_media *media);
+
+
+RTSP_API int
+rtsp_server_conn_channels_rebind(struct rtsp_server_conn *conn,
+				 struct rtsp_server_session *session);
+
+
+RTSP_API struct rtsp_server_pending_request *
 rtsp_server_pending_request_add(struct rtsp_server *server,
 				struct pomp_conn *conn,
 				unsigned int timeout);
 
 
-int rtsp_server_pending_request_remove(
+RTSP_API int rtsp_server_pending_request_remove(
 	struct rtsp_server *server,
 	struct rtsp_server_pending_request *request);
 
 
-int rtsp_server_pending_request_find(
-	const struct rtsp_server *server,
-	const struct rtsp_server_pending_request *request);
+RTSP_API struct rtsp_server_pending_request *
+rtsp_server_pending_request_find(const struct rtsp_server *server,
+				 void *request_ctx);
+
+
+static inline void *rtsp_server_pending_request_ctx(
+	const struct rtsp_server_pending_request *request)
+{
+	return (void *)request->handle;
+}
 
 
-struct rtsp_server_pending_request_media *rtsp_server_pending_request_media_add(
+RTSP_API struct rtsp_server_pending_request_media *
+rtsp_server_pending_request_media_add(
 	const struct rtsp_server *server,
 	struct rtsp_server_pending_request *request,
 	struct rtsp_server_session_media *media);
 
 
-int rtsp_server_pending_request_media_remove(
+RTSP_API int rtsp_server_pending_request_media_remove(
 	const struct rtsp_server *server,
 	struct rtsp_server_pending_request *request,
 	struct rtsp_server_pending_request_media *media);
 
 
-void rtsp_server_session_timer_cb(struct pomp_timer *timer, void *userdata);
+/* Returns NULL if the media context is not one of the request medias */
+struct rtsp_server_pending_request_media *
+rtsp_server_pending_request_media_find(
+	const struct rtsp_server *server,
+	struct rtsp_server_pending_request *request,
+	const void *media_ctx);
+
+
+/* Called when a session media is removed */
+void rtsp_server_pending_request_media_forget(
+	const struct rtsp_server *server,
+	const struct rtsp_server_session_media *media);
+
+
+RTSP_API int rtsp_server_reply_queue_init(struct rtsp_server *server);
+
+
+/* Drop the replies that were not processed yet */
+RTSP_API void rtsp_server_reply_queue_clear(struct rtsp_server *server);
+
+
+RTSP_API int rtsp_server_buffer_get(struct rtsp_server *server,
+				    struct pomp_buffer **buf,
+				    struct rtsp_string *str);
+
+
+RTSP_API void rtsp_server_buffer_put(struct rtsp_server *server,
+				     struct pomp_buffer *buf);
+
+
+int rtsp_server_new_shard(const char *software_name,
+			  uint16_t port,
+			  int reply_timeout_ms,
+			  int session_timeout_ms,
+			  struct pomp_loop *loop,
+			  const struct rtsp_server_cbs *cbs,
+			  void *userdata,
+			  struct rtsp_server_group *group,
+			  unsigned int shard_index,
+			  struct rtsp_server **ret_obj);
+
+
+void rtsp_server_timer_set(struct rtsp_server *server,
+			   struct rtsp_twheel_timer *timer,
+			   uint32_t delay_ms);
+
+
+RTSP_API void
+rtsp_server_pending_request_timer_cb(struct rtsp_twheel_timer *timer,
+				     void *userdata);
+
+
+void rtsp_server_session_timer_cb(struct rtsp_twheel_timer *timer,
+				  void *userdata);
 
 
 #endif /* !_RTSP_SERVER_PRIV_H_ */
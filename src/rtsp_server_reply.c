@@ -0,0 +1,373 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_server_priv.h"
+
+#define ULOG_TAG rtsp_server
+#include <ulog.h>
+
+
+static void reply_msg_destroy(struct rtsp_server_reply_msg *msg)
+{
+	if (msg == NULL)
+		return;
+
+	rtsp_header_ext_array_free(msg->ext, msg->ext_count);
+	if (msg->method == RTSP_METHOD_TYPE_DESCRIBE)
+		free(msg->describe.session_description);
+	free(msg);
+}
+
+
+static struct rtsp_server_reply_msg *
+reply_msg_new(enum rtsp_method_type method,
+	      void *request_ctx,
+	      void *media_ctx,
+	      int status,
+	      const struct rtsp_header_ext *ext,
+	      size_t ext_count)
+{
+	int ret;
+	struct rtsp_server_reply_msg *msg;
+
+	msg = calloc(1, sizeof(*msg));
+	if (msg == NULL) {
+		ULOG_ERRNO("calloc", ENOMEM);
+		return NULL;
+	}
+	msg->method = method;
+	msg->request_ctx = request_ctx;
+	msg->media_ctx = media_ctx;
+	msg->status = status;
+
+	ret = rtsp_header_ext_array_copy(ext, ext_count, &msg->ext);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_header_ext_array_copy", -ret);
+		free(msg);
+		return NULL;
+	}
+	msg->ext_count = ext_count;
+
+	return msg;
+}
+
+
+static void reply_msg_process(struct rtsp_server *server,
+			      struct rtsp_server_reply_msg *msg)
+{
+	int ret;
+
+	/* The request may have timed out or its connection may have been
+	 * closed since the reply was posted */
+	if (rtsp_server_pending_request_find(server, msg->request_ctx) ==
+	    NULL) {
+		ULOGW("%s: %s request not found, dropping the reply",
+		      __func__,
+		      rtsp_method_type_str(msg->method));
+		return;
+	}
+
+	switch (msg->method) {
+	case RTSP_METHOD_TYPE_DESCRIBE:
+		ret = rtsp_server_reply_to_describe(
+			server,
+			msg->request_ctx,
+			msg->status,
+			msg->ext,
+			msg->ext_count,
+			msg->describe.session_description);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_reply_to_describe", -ret);
+		break;
+	case RTSP_METHOD_TYPE_SETUP:
+		ret = rtsp_server_reply_to_setup(
+			server,
+			msg->request_ctx,
+			msg->media_ctx,
+			msg->status,
+			msg->setup.src_stream_port,
+			msg->setup.src_control_port,
+			msg->setup.ssrc_valid,
+			msg->setup.ssrc,
+			msg->ext,
+			msg->ext_count,
+			msg->setup.stream_userdata);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_reply_to_setup", -ret);
+		break;
+	case RTSP_METHOD_TYPE_PLAY:
+		ret = rtsp_server_reply_to_play(
+			server,
+			msg->request_ctx,
+			msg->media_ctx,
+			msg->status,
+			msg->play.range_valid ? &msg->play.range : NULL,
+			msg->play.scale,
+			msg->play.seq_valid,
+			msg->play.seq,
+			msg->play.rtptime_valid,
+			msg->play.rtptime,
+			msg->ext,
+			msg->ext_count);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_reply_to_play", -ret);
+		break;
+	case RTSP_METHOD_TYPE_PAUSE:
+		ret = rtsp_server_reply_to_pause(
+			server,
+			msg->request_ctx,
+			msg->media_ctx,
+			msg->status,
+			msg->pause.range_valid ? &msg->pause.range : NULL,
+			msg->ext,
+			msg->ext_count);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_reply_to_pause", -ret);
+		break;
+	case RTSP_METHOD_TYPE_TEARDOWN:
+		ret = rtsp_server_reply_to_teardown(
+			server,
+			msg->request_ctx,
+			msg->media_ctx,
+			msg->status,
+			msg->ext,
+			msg->ext_count);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_server_reply_to_teardown", -ret);
+		break;
+	default:
+		ULOGW("%s: unsupported method %d", __func__, msg->method);
+		break;
+	}
+}
+
+
+/* Called on the server loop for each posted reply */
+static void reply_node_cb(struct rtsp_mpsc_node *node,
+			  int process,
+			  void *userdata)
+{
+	struct rtsp_server *server = userdata;
+	struct rtsp_server_reply_msg *msg;
+
+	msg = container_of(node, struct rtsp_server_reply_msg, node);
+	if (process)
+		reply_msg_process(server, msg);
+	reply_msg_destroy(msg);
+}
+
+
+static int reply_msg_post(struct rtsp_server *server,
+			  struct rtsp_server_reply_msg *msg)
+{
+	return rtsp_mpsc_evt_post(&server->replies, &msg->node);
+}
+
+
+int rtsp_server_reply_queue_init(struct rtsp_server *server)
+{
+	return rtsp_mpsc_evt_init(
+		&server->replies, server->loop, &reply_node_cb, server);
+}
+
+
+void rtsp_server_reply_queue_clear(struct rtsp_server *server)
+{
+	rtsp_mpsc_evt_clear(&server->replies);
+}
+
+
+int rtsp_server_post_reply_to_describe(struct rtsp_server *server,
+				       void *request_ctx,
+				       int status,
+				       const struct rtsp_header_ext *ext,
+				       size_t ext_count,
+				       const char *session_description)
+{
+	struct rtsp_server_reply_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	msg = reply_msg_new(RTSP_METHOD_TYPE_DESCRIBE,
+			    request_ctx,
+			    NULL,
+			    status,
+			    ext,
+			    ext_count);
+	if (msg == NULL)
+		return -ENOMEM;
+
+	if (session_description != NULL) {
+		msg->describe.session_description = strdup(session_description);
+		if (msg->describe.session_description == NULL) {
+			ULOG_ERRNO("strdup", ENOMEM);
+			reply_msg_destroy(msg);
+			return -ENOMEM;
+		}
+	}
+
+	return reply_msg_post(server, msg);
+}
+
+
+int rtsp_server_post_reply_to_setup(struct rtsp_server *server,
+				    void *request_ctx,
+				    void *media_ctx,
+				    int status,
+				    uint16_t src_stream_port,
+				    uint16_t src_control_port,
+				    int ssrc_valid,
+				    uint32_t ssrc,
+				    const struct rtsp_header_ext *ext,
+				    size_t ext_count,
+				    void *stream_userdata)
+{
+	struct rtsp_server_reply_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	msg = reply_msg_new(RTSP_METHOD_TYPE_SETUP,
+			    request_ctx,
+			    media_ctx,
+			    status,
+			    ext,
+			    ext_count);
+	if (msg == NULL)
+		return -ENOMEM;
+
+	msg->setup.src_stream_port = src_stream_port;
+	msg->setup.src_control_port = src_control_port;
+	msg->setup.ssrc_valid = ssrc_valid;
+	msg->setup.ssrc = ssrc;
+	msg->setup.stream_userdata = stream_userdata;
+
+	return reply_msg_post(server, msg);
+}
+
+
+int rtsp_server_post_reply_to_play(struct rtsp_server *server,
+				   void *request_ctx,
+				   void *media_ctx,
+				   int status,
+				   const struct rtsp_range *range,
+				   float scale,
+				   int seq_valid,
+				   uint16_t seq,
+				   int rtptime_valid,
+				   uint32_t rtptime,
+				   const struct rtsp_header_ext *ext,
+				   size_t ext_count)
+{
+	struct rtsp_server_reply_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	msg = reply_msg_new(RTSP_METHOD_TYPE_PLAY,
+			    request_ctx,
+			    media_ctx,
+			    status,
+			    ext,
+			    ext_count);
+	if (msg == NULL)
+		return -ENOMEM;
+
+	if (range != NULL) {
+		msg->play.range_valid = 1;
+		msg->play.range = *range;
+	}
+	msg->play.scale = scale;
+	msg->play.seq_valid = seq_valid;
+	msg->play.seq = seq;
+	msg->play.rtptime_valid = rtptime_valid;
+	msg->play.rtptime = rtptime;
+
+	return reply_msg_post(server, msg);
+}
+
+
+int rtsp_server_post_reply_to_pause(struct rtsp_server *server,
+				    void *request_ctx,
+				    void *media_ctx,
+				    int status,
+				    const struct rtsp_range *range,
+				    const struct rtsp_header_ext *ext,
+				    size_t ext_count)
+{
+	struct rtsp_server_reply_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	msg = reply_msg_new(RTSP_METHOD_TYPE_PAUSE,
+			    request_ctx,
+			    media_ctx,
+			    status,
+			    ext,
+			    ext_count);
+	if (msg == NULL)
+		return -ENOMEM;
+
+	if (range != NULL) {
+		msg->pause.range_valid = 1;
+		msg->pause.range = *range;
+	}
+
+	return reply_msg_post(server, msg);
+}
+
+
+int rtsp_server_post_reply_to_teardown(struct rtsp_server *server,
+				       void *request_ctx,
+				       void *media_ctx,
+				       int status,
+				       const struct rtsp_header_ext *ext,
+				       size_t ext_count)
+{
+	struct rtsp_server_reply_msg *msg;
+
+	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(request_ctx == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ext == NULL && ext_count != 0, EINVAL);
+
+	msg = reply_msg_new(RTSP_METHOD_TYPE_TEARDOWN,
+			    request_ctx,
+			    media_ctx,
+			    status,
+			    ext,
+			    ext_count);
+	if (msg == NULL)
+		return -ENOMEM;
+
+	return reply_msg_post(server, msg);
+}
@@ -31,27 +31,101 @@
 #include <ulog.h>
 
 
+/* Get a free slot index in the pending requests slab, growing it if
+ * needed */
+static int request_slot_get(struct rtsp_server *server, uint32_t *index)
+{
+	struct rtsp_server_pending_request_slot *slots;
+	size_t count = server->request_slab.count;
+	size_t new_count;
+
+	if (server->request_slab.free_head == 0) {
+		if (count >= RTSP_SERVER_PENDING_REQUEST_MAX)
+			return -ENOBUFS;
+		new_count = (count == 0) ? RTSP_SERVER_PENDING_REQUEST_MIN_SLOTS
+					 : 2 * count;
+		if (new_count > RTSP_SERVER_PENDING_REQUEST_MAX)
+			new_count = RTSP_SERVER_PENDING_REQUEST_MAX;
+		slots = realloc(server->request_slab.slots,
+				new_count * sizeof(*slots));
+		if (slots == NULL)
+			return -ENOMEM;
+		/* Chain the new slots in the free list */
+		for (size_t i = count; i < new_count; i++) {
+			slots[i].request = NULL;
+			slots[i].gen = 0;
+			slots[i].next_free = (i + 1 < new_count) ? i + 2 : 0;
+		}
+		server->request_slab.slots = slots;
+		server->request_slab.count = new_count;
+		server->request_slab.free_head = count + 1;
+		server->request_slab.free_tail = new_count;
+	}
+
+	*index = server->request_slab.free_head - 1;
+	server->request_slab.free_head =
+		server->request_slab.slots[*index].next_free;
+	if (server->request_slab.free_head == 0)
+		server->request_slab.free_tail = 0;
+
+	return 0;
+}
+
+
+/* Release a slot at the end of the free list; bumping the generation
+ * invalidates the handle */
+static void request_slot_put(struct rtsp_server *server, uint32_t index)
+{
+	struct rtsp_server_pending_request_slot *slot =
+		&server->request_slab.slots[index];
+
+	slot->request = NULL;
+	slot->gen = (slot->gen + 1) & RTSP_SERVER_PENDING_REQUEST_GEN_MASK;
+	slot->next_free = 0;
+	if (server->request_slab.free_tail != 0) {
+		server->request_slab.slots[server->request_slab.free_tail - 1]
+			.next_free = index + 1;
+	} else {
+		server->request_slab.free_head = index + 1;
+	}
+	server->request_slab.free_tail = index + 1;
+}
+
+
 struct rtsp_server_pending_request *
 rtsp_server_pending_request_add(struct rtsp_server *server,
 				struct pomp_conn *conn,
 				unsigned int timeout)
 {
-	struct timespec cur_ts = {0, 0};
+	int ret;
+	uint32_t index;
 	struct rtsp_server_pending_request *request = NULL;
 
 	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
 
 	request = calloc(1, sizeof(*request));
 	ULOG_ERRNO_RETURN_VAL_IF(request == NULL, ENOMEM, NULL);
+
+	ret = request_slot_get(server, &index);
+	if (ret < 0) {
+		ULOG_ERRNO("request_slot_get", -ret);
+		free(request);
+		return NULL;
+	}
+	server->request_slab.slots[index].request = request;
+	request->handle = (server->request_slab.slots[index].gen
+			   << RTSP_SERVER_PENDING_REQUEST_INDEX_BITS) |
+			  (index + 1);
+
 	list_node_unref(&request->node);
 	request->conn = conn;
 	request->request_first_reply = 1;
 	list_init(&request->medias);
 
-	time_get_monotonic(&cur_ts);
-	time_timespec_to_us(&cur_ts, &request->timeout);
-	request->timeout =
-		(timeout > 0) ? request->timeout + (uint64_t)timeout * 1000 : 0;
+	rtsp_twheel_timer_init(
+		&request->timer, &rtsp_server_pending_request_timer_cb, server);
+	if (timeout > 0)
+		rtsp_server_timer_set(server, &request->timer, timeout);
 
 	/* Add to the list */
 	list_add_before(&server->pending_requests, &request->node);
@@ -65,30 +139,26 @@ int rtsp_server_pending_request_remove(
 	struct rtsp_server *server,
 	struct rtsp_server_pending_request *request)
 {
-	int found = 0;
-	const struct rtsp_server_pending_request *_request = NULL;
 	struct rtsp_server_pending_request_media *media = NULL;
 	struct rtsp_server_pending_request_media *tmp_media = NULL;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
 
-	list_walk_entry_forward(&server->pending_requests, _request, node)
-	{
-		if (_request == request) {
-			found = 1;
-			break;
-		}
-	}
-
-	if (!found) {
+	if (rtsp_server_pending_request_find(
+		    server, rtsp_server_pending_request_ctx(request)) !=
+	    request) {
 		ULOGE("%s: pending request not found", __func__);
 		return -ENOENT;
 	}
 
-	/* Remove from the list */
+	/* Remove from the list and the slab */
 	list_del(&request->node);
 	server->pending_request_count--;
+	request_slot_put(
+		server,
+		(request->handle & RTSP_SERVER_PENDING_REQUEST_INDEX_MASK) - 1);
+	rtsp_twheel_timer_cancel(&server->timers, &request->timer);
 
 	/* Remove all medias */
 	list_walk_entry_forward_safe(&request->medias, media, tmp_media, node)
@@ -105,25 +175,29 @@ int rtsp_server_pending_request_remove(
 }
 
 
-int rtsp_server_pending_request_find(
-	const struct rtsp_server *server,
-	const struct rtsp_server_pending_request *request)
+struct rtsp_server_pending_request *
+rtsp_server_pending_request_find(const struct rtsp_server *server,
+				 void *request_ctx)
 {
-	int found = 0;
-	const struct rtsp_server_pending_request *_request = NULL;
-
-	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
-	ULOG_ERRNO_RETURN_ERR_IF(request == NULL, EINVAL);
-
-	list_walk_entry_forward(&server->pending_requests, _request, node)
-	{
-		if (_request == request) {
-			found = 1;
-			break;
-		}
-	}
+	uintptr_t handle;
+	uint32_t index;
+	const struct rtsp_server_pending_request_slot *slot;
 
-	return found ? 0 : -ENOENT;
+	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
+	ULOG_ERRNO_RETURN_VAL_IF(request_ctx == NULL, EINVAL, NULL);
+
+	/* A stale handle either points outside of the slab, or to a slot
+	 * whose generation has changed since */
+	handle = (uintptr_t)request_ctx;
+	index = handle & RTSP_SERVER_PENDING_REQUEST_INDEX_MASK;
+	if (index == 0 || index > server->request_slab.count)
+		return NULL;
+	slot = &server->request_slab.slots[index - 1];
+	if (slot->request == NULL ||
+	    slot->gen != (handle >> RTSP_SERVER_PENDING_REQUEST_INDEX_BITS))
+		return NULL;
+
+	return slot->request;
 }
 
 
@@ -184,3 +258,50 @@ int rtsp_server_pending_request_media_remove(
 
 	return 0;
 }
+
+
+struct rtsp_server_pending_request_media *
+rtsp_server_pending_request_media_find(
+	const struct rtsp_server *server,
+	struct rtsp_server_pending_request *request,
+	const void *media_ctx)
+{
+	struct rtsp_server_pending_request_media *media = NULL;
+
+	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
+	ULOG_ERRNO_RETURN_VAL_IF(request == NULL, EINVAL, NULL);
+
+	if (media_ctx == NULL)
+		return NULL;
+
+	list_walk_entry_forward(&request->medias, media, node)
+	{
+		if ((const void *)media->media == media_ctx)
+			return media;
+	}
+
+	return NULL;
+}
+
+
+void rtsp_server_pending_request_media_forget(
+	const struct rtsp_server *server,
+	const struct rtsp_server_session_media *media)
+{
+	struct rtsp_server_pending_request *request = NULL;
+	struct rtsp_server_pending_request_media *m = NULL;
+
+	ULOG_ERRNO_RETURN_IF(server == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(media == NULL, EINVAL);
+
+	/* The entry is kept so that the media count of the request does
+	 * not change, but a late reply for this media is not matched */
+	list_walk_entry_forward(&server->pending_requests, request, node)
+	{
+		list_walk_entry_forward(&request->medias, m, node)
+		{
+			if (m->media == media)
+				m->media = NULL;
+		}
+	}
+}
@@ -31,14 +31,70 @@
 #include <ulog.h>
 
 
+/* Parse the RTSP_SERVER_SESSION_ID_LENGTH hex digits of a session
+ * identifier, as formatted by rtsp_server_session_add(); anything else,
+ * including trailing characters, is not a session of this server */
+static int session_id_parse(const char *str, uint64_t *id)
+{
+	uint64_t val = 0;
+
+	for (size_t i = 0; i < RTSP_SERVER_SESSION_ID_LENGTH; i++) {
+		char c = str[i];
+		if (c >= '0' && c <= '9')
+			val = (val << 4) | (uint64_t)(c - '0');
+		else if (c >= 'a' && c <= 'f')
+			val = (val << 4) | (uint64_t)(c - 'a' + 10);
+		else
+			return -EINVAL;
+	}
+	if (str[RTSP_SERVER_SESSION_ID_LENGTH] != '\0')
+		return -EINVAL;
+
+	*id = val;
+	return 0;
+}
+
+
+int rtsp_server_session_id_get_shard(const char *session_id,
+				     unsigned int *shard_index)
+{
+	int ret;
+	uint64_t id;
+
+	ULOG_ERRNO_RETURN_ERR_IF(session_id == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(shard_index == NULL, EINVAL);
+
+	ret = session_id_parse(session_id, &id);
+	if (ret < 0)
+		return ret;
+
+	*shard_index = (unsigned int)(id >> RTSP_SERVER_SESSION_SHARD_SHIFT);
+	return 0;
+}
+
+
+/* 64-bit FNV-1a hash of a media path */
+static uint64_t media_path_hash(const char *path)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*path != '\0') {
+		hash ^= (uint8_t)*path++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+
 struct rtsp_server_session *rtsp_server_session_add(struct rtsp_server *server,
 						    unsigned int timeout_ms,
 						    const char *uri)
 {
 	int ret;
-	int found;
 	struct rtsp_server_session *session = NULL;
-	const struct rtsp_server_session *_session = NULL;
+	char line[64];
+	struct rtsp_string str;
 
 	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
 
@@ -48,46 +104,49 @@ struct rtsp_server_session *rtsp_server_session_add(struct rtsp_server *server,
 	list_init(&session->medias);
 	session->server = server;
 	session->timeout_ms = timeout_ms;
-	if (session->timeout_ms > 0) {
-		session->timer = pomp_timer_new(server->loop,
-						&rtsp_server_session_timer_cb,
-						(void *)session);
-		if (!session->timer) {
-			ULOG_ERRNO("pomp_timer_new", ENOMEM);
-			goto error;
-		}
-		ret = rtsp_server_session_reset_timeout(session);
-		if (ret < 0)
-			goto error;
-	}
+	rtsp_twheel_timer_init(
+		&session->timer, &rtsp_server_session_timer_cb, session);
 
+	/* Generate a session id that does not already exist */
 	do {
-		/* Generate a session id */
-		uint64_t id64;
-		ret = futils_random64(&id64);
+		ret = futils_random64(&session->id);
 		if (ret < 0) {
 			ULOG_ERRNO("futils_random64", -ret);
 			goto error;
 		}
-		ret = asprintf(&session->session_id, "%016" PRIx64, id64);
-		if ((ret < 0) || (session->session_id == NULL)) {
-			ULOG_ERRNO("asprintf", ENOMEM);
-			goto error;
+		if (server->group != NULL) {
+			/* Tag the identifier with the owning shard */
+			session->id &= ~RTSP_SERVER_SESSION_SHARD_MASK;
+			session->id |= (uint64_t)server->shard_index
+				       << RTSP_SERVER_SESSION_SHARD_SHIFT;
 		}
+	} while (rtsp_map_get(&server->session_map, session->id) != NULL);
 
-		/* Check that this session id does not already exist */
-		found = 0;
-		list_walk_entry_forward(&server->sessions, _session, node)
-		{
-			if (strncmp(_session->session_id,
-				    session->session_id,
-				    RTSP_SERVER_SESSION_ID_LENGTH) == 0) {
-				found = 1;
-				xfree((void **)&session->session_id);
-				break;
-			}
-		}
-	} while (found);
+	ret = asprintf(&session->session_id, "%016" PRIx64, session->id);
+	if ((ret < 0) || (session->session_id == NULL)) {
+		ULOG_ERRNO("asprintf", ENOMEM);
+		goto error;
+	}
+
+	/* Pre-serialize the 'Session' line of the responses */
+	memset(&str, 0, sizeof(str));
+	str.str = line;
+	str.max_len = sizeof(line);
+	ret = rtsp_session_header_write(
+		session->session_id, session->timeout_ms / 1000, &str);
+	if (ret < 0)
+		goto error;
+	ret = rtsp_header_line_set(&session->session_line, &str);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_header_line_set", -ret);
+		goto error;
+	}
+
+	ret = rtsp_map_put(&server->session_map, session->id, session);
+	if (ret < 0) {
+		ULOG_ERRNO("rtsp_map_put", -ret);
+		goto error;
+	}
 
 	/* store the URI */
 	session->uri = xstrdup(uri);
@@ -96,6 +155,8 @@ struct rtsp_server_session *rtsp_server_session_add(struct rtsp_server *server,
 	list_add_before(&server->sessions, &session->node);
 	server->session_count++;
 
+	(void)rtsp_server_session_reset_timeout(session);
+
 	ULOGI("server session %s added (URI='%s')",
 	      session->session_id,
 	      session->uri);
@@ -104,11 +165,7 @@ struct rtsp_server_session *rtsp_server_session_add(struct rtsp_server *server,
 
 error:
 	if (session) {
-		if (session->timer != NULL) {
-			ret = pomp_timer_destroy(session->timer);
-			if (ret < 0)
-				ULOG_ERRNO("pomp_timer_destroy", -ret);
-		}
+		rtsp_header_line_clear(&session->session_line);
 		free(session->session_id);
 		free(session);
 	}
@@ -120,24 +177,14 @@ error:
 int rtsp_server_session_remove(struct rtsp_server *server,
 			       struct rtsp_server_session *session)
 {
-	int found = 0;
 	int ret;
-	const struct rtsp_server_session *_session = NULL;
 	struct rtsp_server_session_media *media = NULL;
 	struct rtsp_server_session_media *tmp_media = NULL;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(session == NULL, EINVAL);
 
-	list_walk_entry_forward(&server->sessions, _session, node)
-	{
-		if (_session == session) {
-			found = 1;
-			break;
-		}
-	}
-
-	if (!found) {
+	if (rtsp_map_get(&server->session_map, session->id) != session) {
 		ULOGE("%s: session not found", __func__);
 		return -ENOENT;
 	}
@@ -155,16 +202,17 @@ int rtsp_server_session_remove(struct rtsp_server *server,
 	/* Remove from the list */
 	list_del(&session->node);
 	server->session_count--;
+	ret = rtsp_map_remove(&server->session_map, session->id);
+	if (ret < 0)
+		ULOG_ERRNO("rtsp_map_remove", -ret);
+	rtsp_map_clear(&session->media_map);
 
-	if (session->timer != NULL) {
-		ret = pomp_timer_destroy(session->timer);
-		if (ret < 0)
-			ULOG_ERRNO("pomp_timer_destroy", -ret);
-	}
+	rtsp_twheel_timer_cancel(&server->timers, &session->timer);
 	ret = pomp_loop_idle_remove(
 		server->loop, &rtsp_server_session_remove_idle, session);
 	if (ret < 0)
 		ULOG_ERRNO("pomp_loop_idle_remove", -ret);
+	rtsp_header_line_clear(&session->session_line);
 	free(session->session_id);
 	free(session->uri);
 	free(session);
@@ -175,20 +223,20 @@ int rtsp_server_session_remove(struct rtsp_server *server,
 
 int rtsp_server_session_reset_timeout(struct rtsp_server_session *session)
 {
-	int ret;
-
 	ULOG_ERRNO_RETURN_ERR_IF(session == NULL, EINVAL);
 
+	if (session->timeout_ms == 0)
+		return 0;
+
 	/* Set the timer to >= 20% more than the advertised session timeout
 	 * because some players (like VLC) will only send GET_PARAMETER
 	 * request every 'timeout_ms' ms, which can cause timeouts here
 	 * otherwise due to latency */
-	ret = pomp_timer_set(session->timer,
-			     ((12 * session->timeout_ms) + 9) / 10);
-	if (ret < 0)
-		ULOG_ERRNO("pomp_timer_set", -ret);
+	rtsp_server_timer_set(session->server,
+			      &session->timer,
+			      ((12 * session->timeout_ms) + 9) / 10);
 
-	return ret;
+	return 0;
 }
 
 
@@ -196,24 +244,15 @@ struct rtsp_server_session *
 rtsp_server_session_find(const struct rtsp_server *server,
 			 const char *session_id)
 {
-	int found = 0;
-	struct rtsp_server_session *session = NULL;
+	uint64_t id;
 
 	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
 	ULOG_ERRNO_RETURN_VAL_IF(session_id == NULL, EINVAL, NULL);
 
-	list_walk_entry_forward(&server->sessions, session, node)
-	{
-		if (session->session_id != NULL &&
-		    strncmp(session->session_id,
-			    session_id,
-			    RTSP_SERVER_SESSION_ID_LENGTH) == 0) {
-			found = 1;
-			break;
-		}
-	}
+	if (session_id_parse(session_id, &id) < 0)
+		return NULL;
 
-	return found ? session : NULL;
+	return rtsp_map_get(&server->session_map, id);
 }
 
 
@@ -223,7 +262,9 @@ rtsp_server_session_media_add(const struct rtsp_server *server,
 			      const char *uri,
 			      const char *path)
 {
+	int ret;
 	struct rtsp_server_session_media *media = NULL;
+	struct rtsp_server_session_media *head;
 	const struct rtsp_server_session_media *_media;
 
 	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
@@ -239,6 +280,25 @@ rtsp_server_session_media_add(const struct rtsp_server *server,
 	media->session = session;
 	media->uri = strdup(uri);
 	media->path = strdup(path);
+	media->path_hash = media_path_hash(path);
+
+	/* Medias with colliding path hashes are chained, the first one
+	 * being in the map */
+	head = rtsp_map_get(&session->media_map, media->path_hash);
+	if (head != NULL) {
+		media->hash_next = head->hash_next;
+		head->hash_next = media;
+	} else {
+		ret = rtsp_map_put(
+			&session->media_map, media->path_hash, media);
+		if (ret < 0) {
+			ULOG_ERRNO("rtsp_map_put", -ret);
+			free(media->uri);
+			free(media->path);
+			free(media);
+			return NULL;
+		}
+	}
 
 	/* Add to the list */
 	list_add_before(&session->medias, &media->node);
@@ -254,30 +314,46 @@ int rtsp_server_session_media_remove(const struct rtsp_server *server,
 				     struct rtsp_server_session *session,
 				     struct rtsp_server_session_media *media)
 {
-	int found = 0;
-	const struct rtsp_server_session_media *_media = NULL;
+	int ret;
+	struct rtsp_server_session_media *head;
+	struct rtsp_server_session_media **prev;
 
 	ULOG_ERRNO_RETURN_ERR_IF(server == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(session == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(media == NULL, EINVAL);
 
-	list_walk_entry_forward(&session->medias, _media, node)
-	{
-		if (_media == media) {
-			found = 1;
-			break;
-		}
-	}
+	head = rtsp_map_get(&session->media_map, media->path_hash);
+	prev = &head;
+	while (*prev != NULL && *prev != media)
+		prev = &(*prev)->hash_next;
 
-	if (!found) {
+	if (*prev == NULL) {
 		ULOGE("%s: media not found", __func__);
 		return -ENOENT;
 	}
 
+	/* Remove from the hash chain, replacing the map entry if this
+	 * media was the first one */
+	*prev = media->hash_next;
+	if (prev == &head) {
+		ret = rtsp_map_remove(&session->media_map, media->path_hash);
+		if (ret < 0)
+			ULOG_ERRNO("rtsp_map_remove", -ret);
+		if (head != NULL) {
+			ret = rtsp_map_put(
+				&session->media_map, head->path_hash, head);
+			if (ret < 0)
+				ULOG_ERRNO("rtsp_map_put", -ret);
+		}
+	}
+
 	/* Remove from the list */
 	list_del(&media->node);
 	session->media_count--;
 
+	rtsp_server_conn_channels_unbind(media);
+	rtsp_server_pending_request_media_forget(server, media);
+
 	ULOGI("server session %s media '%s' removed",
 	      session->session_id,
 	      media->path);
@@ -295,20 +371,15 @@ rtsp_server_session_media_find(const struct rtsp_server *server,
 			       const struct rtsp_server_session *session,
 			       const char *path)
 {
-	int found = 0;
 	struct rtsp_server_session_media *media = NULL;
 
 	ULOG_ERRNO_RETURN_VAL_IF(server == NULL, EINVAL, NULL);
 	ULOG_ERRNO_RETURN_VAL_IF(session == NULL, EINVAL, NULL);
 	ULOG_ERRNO_RETURN_VAL_IF(path == NULL, EINVAL, NULL);
 
-	list_walk_entry_forward(&session->medias, media, node)
-	{
-		if (strcmp(media->path, path) == 0) {
-			found = 1;
-			break;
-		}
-	}
+	media = rtsp_map_get(&session->media_map, media_path_hash(path));
+	while (media != NULL && strcmp(media->path, path) != 0)
+		media = media->hash_next;
 
-	return found ? media : NULL;
+	return media;
 }
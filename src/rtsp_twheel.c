@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+
+#define ULOG_TAG rtsp
+#include <ulog.h>
+
+
+#define RTSP_TWHEEL_SLOT_MASK (RTSP_TWHEEL_SLOTS - 1)
+
+
+/* Put an armed timer in the slot matching its expiration: level n holds
+ * the timers expiring within the next RTSP_TWHEEL_SLOTS level n periods
+ * (a level 0 period being one tick) */
+static void twheel_insert(struct rtsp_twheel *wheel,
+			  struct rtsp_twheel_timer *timer)
+{
+	unsigned int level;
+	unsigned int shift = 0;
+	uint64_t slot;
+
+	for (level = 0; level < RTSP_TWHEEL_LEVELS; level++) {
+		shift = level * RTSP_TWHEEL_SLOT_BITS;
+		if ((timer->expiry >> shift) - (wheel->now >> shift) <
+		    RTSP_TWHEEL_SLOTS)
+			break;
+	}
+
+	if (level < RTSP_TWHEEL_LEVELS) {
+		slot = timer->expiry >> shift;
+	} else {
+		/* Beyond the wheel range: put it in the farthest slot, it
+		 * will be inserted again when cascading */
+		level = RTSP_TWHEEL_LEVELS - 1;
+		slot = (wheel->now >> shift) + RTSP_TWHEEL_SLOTS - 1;
+	}
+
+	list_add_before(&wheel->slots[level][slot & RTSP_TWHEEL_SLOT_MASK],
+			&timer->node);
+}
+
+
+/* Move the timers of the current slot of a level to the lower levels */
+static void twheel_cascade(struct rtsp_twheel *wheel, unsigned int level)
+{
+	struct list_node *list;
+	struct rtsp_twheel_timer *timer;
+	unsigned int shift = level * RTSP_TWHEEL_SLOT_BITS;
+
+	list = &wheel->slots[level]
+			    [(wheel->now >> shift) & RTSP_TWHEEL_SLOT_MASK];
+	while (!list_is_empty(list)) {
+		timer = list_entry(
+			list_first(list), struct rtsp_twheel_timer, node);
+		list_del(&timer->node);
+		twheel_insert(wheel, timer);
+	}
+}
+
+
+static void twheel_tick(struct rtsp_twheel *wheel)
+{
+	struct list_node *list;
+	struct rtsp_twheel_timer *timer;
+
+	wheel->now++;
+
+	/* Cascade the higher levels when the lower ones wrap around */
+	for (unsigned int level = RTSP_TWHEEL_LEVELS - 1; level > 0; level--) {
+		uint64_t mask =
+			((uint64_t)1 << (level * RTSP_TWHEEL_SLOT_BITS)) - 1;
+		if ((wheel->now & mask) == 0)
+			twheel_cascade(wheel, level);
+	}
+
+	/* Expire the timers; callbacks can set or cancel any timer, new
+	 * ones never go in the current slot */
+	list = &wheel->slots[0][wheel->now & RTSP_TWHEEL_SLOT_MASK];
+	while (!list_is_empty(list)) {
+		timer = list_entry(
+			list_first(list), struct rtsp_twheel_timer, node);
+		list_del(&timer->node);
+		timer->armed = false;
+		wheel->count--;
+		(*timer->cb)(timer, timer->userdata);
+	}
+}
+
+
+void rtsp_twheel_init(struct rtsp_twheel *wheel, unsigned int tick_ms)
+{
+	ULOG_ERRNO_RETURN_IF(wheel == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(tick_ms == 0, EINVAL);
+
+	memset(wheel, 0, sizeof(*wheel));
+	wheel->tick_ms = tick_ms;
+	for (unsigned int i = 0; i < RTSP_TWHEEL_LEVELS; i++) {
+		for (unsigned int j = 0; j < RTSP_TWHEEL_SLOTS; j++)
+			list_init(&wheel->slots[i][j]);
+	}
+}
+
+
+void rtsp_twheel_timer_init(struct rtsp_twheel_timer *timer,
+			    rtsp_twheel_cb_t cb,
+			    void *userdata)
+{
+	ULOG_ERRNO_RETURN_IF(timer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(cb == NULL, EINVAL);
+
+	memset(timer, 0, sizeof(*timer));
+	list_node_unref(&timer->node);
+	timer->cb = cb;
+	timer->userdata = userdata;
+}
+
+
+void rtsp_twheel_timer_set(struct rtsp_twheel *wheel,
+			   struct rtsp_twheel_timer *timer,
+			   uint64_t now_ms,
+			   uint32_t delay_ms)
+{
+	ULOG_ERRNO_RETURN_IF(wheel == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(timer == NULL, EINVAL);
+
+	rtsp_twheel_timer_cancel(wheel, timer);
+
+	/* An empty wheel is not advanced: catch up with the current time */
+	if (wheel->count == 0)
+		wheel->now = now_ms / wheel->tick_ms;
+
+	/* Round up to the next tick, the timer never fires early */
+	timer->expiry = (now_ms + delay_ms + wheel->tick_ms - 1) /
+			wheel->tick_ms;
+	if (timer->expiry <= wheel->now)
+		timer->expiry = wheel->now + 1;
+
+	timer->armed = true;
+	wheel->count++;
+	twheel_insert(wheel, timer);
+}
+
+
+void rtsp_twheel_timer_cancel(struct rtsp_twheel *wheel,
+			      struct rtsp_twheel_timer *timer)
+{
+	ULOG_ERRNO_RETURN_IF(wheel == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_IF(timer == NULL, EINVAL);
+
+	if (!timer->armed)
+		return;
+
+	list_del(&timer->node);
+	timer->armed = false;
+	wheel->count--;
+}
+
+
+void rtsp_twheel_advance(struct rtsp_twheel *wheel, uint64_t now_ms)
+{
+	uint64_t now;
+
+	ULOG_ERRNO_RETURN_IF(wheel == NULL, EINVAL);
+
+	now = now_ms / wheel->tick_ms;
+	while (wheel->now < now) {
+		if (wheel->count == 0) {
+			wheel->now = now;
+			break;
+		}
+		twheel_tick(wheel);
+	}
+}
+
+
+int rtsp_twheel_next_expiry(const struct rtsp_twheel *wheel,
+			    uint64_t *expiry_ms)
+{
+	unsigned int shift;
+	uint64_t slot;
+	uint64_t next = UINT64_MAX;
+	const struct list_node *slots;
+
+	ULOG_ERRNO_RETURN_ERR_IF(wheel == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(expiry_ms == NULL, EINVAL);
+
+	if (wheel->count == 0)
+		return -ENOENT;
+
+	/* The first non-empty slot of each level after the current one;
+	 * the slots of a level are in increasing time order from there */
+	for (unsigned int level = 0; level < RTSP_TWHEEL_LEVELS; level++) {
+		shift = level * RTSP_TWHEEL_SLOT_BITS;
+		slots = wheel->slots[level];
+		for (slot = (wheel->now >> shift) + 1;
+		     slot < (wheel->now >> shift) + RTSP_TWHEEL_SLOTS;
+		     slot++) {
+			if (list_is_empty(&slots[slot & RTSP_TWHEEL_SLOT_MASK]))
+				continue;
+			if ((slot << shift) < next)
+				next = slot << shift;
+			break;
+		}
+	}
+	if (next == UINT64_MAX)
+		return -ENOENT;
+
+	*expiry_ms = next * wheel->tick_ms;
+	return 0;
+}
@@ -31,6 +31,12 @@
 static CU_SuiteInfo s_suites[] = {
 	{FN("auth"), NULL, NULL, g_rtsp_test_auth},
 	{FN("base64"), NULL, NULL, g_rtsp_test_base64},
+	{FN("client"), NULL, NULL, g_rtsp_test_client},
+	{FN("map"), NULL, NULL, g_rtsp_test_map},
+	{FN("mpsc"), NULL, NULL, g_rtsp_test_mpsc},
+	{FN("parser"), NULL, NULL, g_rtsp_test_parser},
+	{FN("server"), NULL, NULL, g_rtsp_test_server},
+	{FN("twheel"), NULL, NULL, g_rtsp_test_twheel},
 	{FN("url_c"), NULL, NULL, g_rtsp_test_url_c},
 	{FN("url_cpp"), NULL, NULL, g_rtsp_test_url_cpp},
 
@@ -47,6 +47,12 @@
 
 extern CU_TestInfo g_rtsp_test_auth[];
 extern CU_TestInfo g_rtsp_test_base64[];
+extern CU_TestInfo g_rtsp_test_client[];
+extern CU_TestInfo g_rtsp_test_map[];
+extern CU_TestInfo g_rtsp_test_mpsc[];
+extern CU_TestInfo g_rtsp_test_parser[];
+extern CU_TestInfo g_rtsp_test_server[];
+extern CU_TestInfo g_rtsp_test_twheel[];
 extern CU_TestInfo g_rtsp_test_url_c[];
 extern CU_TestInfo g_rtsp_test_url_cpp[];
 
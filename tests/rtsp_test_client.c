@@ -0,0 +1,1367 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_client_priv.h"
+#include "rtsp_test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define TEST_TIMEOUT_MS 5000
+#define TEST_MEDIA_COUNT 10
+#define TEST_MAX_REQUESTS 32
+#define TEST_MAX_OPTIONS (RTSP_CLIENT_MAX_INFLIGHT + 1)
+#define TEST_PKT_LEN 60000
+#define TEST_PKT_COUNT 64
+/* More than RTSP_CLIENT_TX_BATCH_MAX, to send in several writes */
+#define TEST_BATCH_LEN 40
+
+
+struct test_request {
+	char method[32];
+	char uri[256];
+	unsigned int cseq;
+};
+
+
+/* Scripted RTSP server: the requests are recorded and answered by the
+ * test handler, which can also leave them unanswered */
+struct test_srv {
+	struct pomp_loop *loop;
+	int listen_fd;
+	int fd;
+	uint16_t port;
+	char buf[8192];
+	size_t len;
+	struct test_request requests[TEST_MAX_REQUESTS];
+	size_t request_count;
+	void (*handler)(struct test_srv *srv, const struct test_request *req);
+	/* Interleaved data mode: the received data must only be framed
+	 * packets of pkt_len bytes, each filled with its index */
+	int interleaved;
+	uint16_t pkt_len;
+	uint8_t hdr[RTSP_INTERLEAVED_HEADER_LEN];
+	size_t hdr_len;
+	size_t payload_left;
+	size_t rx_count;
+	unsigned int rx_errors;
+};
+
+
+struct test_client {
+	struct rtsp_client *client;
+	enum rtsp_client_conn_state state;
+	int playback_done;
+	enum rtsp_client_req_status playback_req_status;
+	size_t playback_media_count;
+	int playback_media_status[TEST_MEDIA_COUNT];
+	size_t options_count;
+	void *options_userdata[TEST_MAX_OPTIONS];
+	enum rtsp_client_req_status options_status[TEST_MAX_OPTIONS];
+	size_t interleaved_count;
+	uint8_t interleaved_data[16];
+	size_t interleaved_len;
+	/* Interleaved packets to send, see test_client_send() */
+	const struct rtsp_interleaved_info *tx_pkts;
+	size_t tx_count;
+	size_t tx_next;
+	unsigned int tx_blocked;
+	unsigned int ready_count;
+};
+
+
+static void test_srv_write(struct test_srv *srv, const void *data, size_t len)
+{
+	ssize_t ret;
+
+	ret = write(srv->fd, data, len);
+	CU_ASSERT_EQUAL(ret, (ssize_t)len);
+}
+
+
+static void test_srv_send(struct test_srv *srv, const char *resp)
+{
+	test_srv_write(srv, resp, strlen(resp));
+}
+
+
+static void test_srv_reply(struct test_srv *srv,
+			   unsigned int cseq,
+			   const char *status,
+			   const char *headers,
+			   const char *body)
+{
+	char resp[4096];
+	int len;
+
+	len = snprintf(resp,
+		       sizeof(resp),
+		       "RTSP/1.0 %s\r\n"
+		       "CSeq: %u\r\n"
+		       "%s"
+		       "Content-Length: %zu\r\n"
+		       "\r\n"
+		       "%s",
+		       status,
+		       cseq,
+		       (headers != NULL) ? headers : "",
+		       (body != NULL) ? strlen(body) : 0,
+		       (body != NULL) ? body : "");
+	CU_ASSERT_FATAL((len > 0) && ((size_t)len < sizeof(resp)));
+
+	test_srv_send(srv, resp);
+}
+
+
+static void test_srv_request_process(struct test_srv *srv, const char *msg)
+{
+	struct test_request *req;
+	const char *cseq;
+	int ret;
+
+	CU_ASSERT_FATAL(srv->request_count < TEST_MAX_REQUESTS);
+	req = &srv->requests[srv->request_count++];
+
+	ret = sscanf(msg, "%31s %255s", req->method, req->uri);
+	CU_ASSERT_EQUAL(ret, 2);
+	cseq = strcasestr(msg, "\r\nCSeq:");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(cseq);
+	req->cseq = strtoul(cseq + 7, NULL, 10);
+
+	if (srv->handler != NULL)
+		(*srv->handler)(srv, req);
+}
+
+
+static void test_srv_interleaved_process(struct test_srv *srv,
+					 const uint8_t *data,
+					 size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (srv->hdr_len < RTSP_INTERLEAVED_HEADER_LEN) {
+			srv->hdr[srv->hdr_len++] = data[i];
+			if (srv->hdr_len < RTSP_INTERLEAVED_HEADER_LEN)
+				continue;
+			if ((srv->hdr[0] != 0x24) ||
+			    (((srv->hdr[2] << 8) | srv->hdr[3]) !=
+			     srv->pkt_len))
+				srv->rx_errors++;
+			srv->payload_left = srv->pkt_len;
+			continue;
+		}
+		if (data[i] != (uint8_t)srv->rx_count)
+			srv->rx_errors++;
+		if (--srv->payload_left == 0) {
+			srv->hdr_len = 0;
+			srv->rx_count++;
+		}
+	}
+}
+
+
+static void test_srv_data_cb(int fd, uint32_t revents, void *userdata)
+{
+	struct test_srv *srv = userdata;
+	char *end;
+	ssize_t ret;
+	size_t len;
+	uint8_t data[16384];
+
+	if (srv->interleaved) {
+		ret = read(fd, data, sizeof(data));
+		if (ret > 0) {
+			test_srv_interleaved_process(srv, data, ret);
+			return;
+		}
+	} else {
+		ret = read(fd,
+			   srv->buf + srv->len,
+			   sizeof(srv->buf) - srv->len - 1);
+	}
+	if (ret <= 0) {
+		pomp_loop_remove(srv->loop, fd);
+		close(fd);
+		srv->fd = -1;
+		return;
+	}
+	srv->len += ret;
+	srv->buf[srv->len] = '\0';
+
+	/* The client requests of these tests have no body */
+	while ((end = strstr(srv->buf, "\r\n\r\n")) != NULL) {
+		*end = '\0';
+		test_srv_request_process(srv, srv->buf);
+		len = end + 4 - srv->buf;
+		memmove(srv->buf, srv->buf + len, srv->len - len + 1);
+		srv->len -= len;
+	}
+}
+
+
+static void test_srv_accept_cb(int fd, uint32_t revents, void *userdata)
+{
+	struct test_srv *srv = userdata;
+	int res;
+
+	CU_ASSERT_EQUAL(srv->fd, -1);
+	srv->fd = accept(fd, NULL, NULL);
+	CU_ASSERT_FATAL(srv->fd >= 0);
+
+	res = pomp_loop_add(
+		srv->loop, srv->fd, POMP_FD_EVENT_IN, &test_srv_data_cb, srv);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+
+static void test_srv_start(struct test_srv *srv, struct pomp_loop *loop)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int res;
+
+	memset(srv, 0, sizeof(*srv));
+	srv->loop = loop;
+	srv->fd = -1;
+
+	srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	CU_ASSERT_FATAL(srv->listen_fd >= 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	res = bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = listen(srv->listen_fd, 1);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = getsockname(srv->listen_fd, (struct sockaddr *)&addr, &addrlen);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	srv->port = ntohs(addr.sin_port);
+
+	res = pomp_loop_add(loop,
+			    srv->listen_fd,
+			    POMP_FD_EVENT_IN,
+			    &test_srv_accept_cb,
+			    srv);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+
+static void test_srv_stop(struct test_srv *srv)
+{
+	if (srv->fd >= 0) {
+		pomp_loop_remove(srv->loop, srv->fd);
+		close(srv->fd);
+		srv->fd = -1;
+	}
+	pomp_loop_remove(srv->loop, srv->listen_fd);
+	close(srv->listen_fd);
+}
+
+
+static const struct test_request *test_srv_find(struct test_srv *srv,
+						const char *method)
+{
+	for (size_t i = 0; i < srv->request_count; i++) {
+		if (strcmp(srv->requests[i].method, method) == 0)
+			return &srv->requests[i];
+	}
+	return NULL;
+}
+
+
+/* Process the loop until *done is set, or fail after TEST_TIMEOUT_MS */
+static void test_loop_run(struct pomp_loop *loop, const int *done)
+{
+	for (int i = 0; (i < TEST_TIMEOUT_MS / 10) && !*done; i++)
+		pomp_loop_wait_and_process(loop, 10);
+	CU_ASSERT_TRUE(*done);
+}
+
+
+/* Process the loop until the server has received count requests */
+static void test_srv_wait(struct test_srv *srv, size_t count)
+{
+	for (int i = 0; i < TEST_TIMEOUT_MS / 10; i++) {
+		if (srv->request_count >= count)
+			break;
+		pomp_loop_wait_and_process(srv->loop, 10);
+	}
+	CU_ASSERT_EQUAL(srv->request_count, count);
+}
+
+
+static void connection_state_cb(struct rtsp_client *client,
+				enum rtsp_client_conn_state state,
+				void *userdata)
+{
+	struct test_client *tc = userdata;
+
+	tc->state = state;
+}
+
+
+static void session_removed_cb(struct rtsp_client *client,
+			       const char *session_id,
+			       int status,
+			       void *userdata)
+{
+}
+
+
+static void announce_cb(struct rtsp_client *client,
+			const char *content_base,
+			const struct rtsp_header_ext *ext,
+			size_t ext_count,
+			const char *sdp,
+			void *userdata)
+{
+}
+
+
+static void options_resp_cb(struct rtsp_client *client,
+			    enum rtsp_client_req_status req_status,
+			    int status,
+			    uint32_t methods,
+			    const struct rtsp_header_ext *ext,
+			    size_t ext_count,
+			    void *userdata,
+			    void *req_userdata)
+{
+	struct test_client *tc = userdata;
+
+	CU_ASSERT_FATAL(tc->options_count < TEST_MAX_OPTIONS);
+	tc->options_userdata[tc->options_count] = req_userdata;
+	tc->options_status[tc->options_count] = req_status;
+	tc->options_count++;
+}
+
+
+static void interleaved_data_cb(struct rtsp_client *client,
+				uint8_t channel,
+				const uint8_t *data,
+				size_t len,
+				void *userdata)
+{
+	struct test_client *tc = userdata;
+
+	tc->interleaved_count++;
+	tc->interleaved_len = len;
+	if (len > sizeof(tc->interleaved_data))
+		len = sizeof(tc->interleaved_data);
+	memcpy(tc->interleaved_data, data, len);
+}
+
+
+/* Send the remaining interleaved packets until the socket is busy */
+static void test_client_send(struct test_client *tc)
+{
+	int res;
+	size_t n;
+
+	while (tc->tx_next < tc->tx_count) {
+		n = tc->tx_count - tc->tx_next;
+		if (n > TEST_BATCH_LEN)
+			n = TEST_BATCH_LEN;
+		res = rtsp_client_send_interleaved_batch(
+			tc->client, &tc->tx_pkts[tc->tx_next], n);
+		if (res == -EAGAIN) {
+			tc->tx_blocked++;
+			return;
+		}
+		CU_ASSERT_FATAL((res > 0) && ((size_t)res <= n));
+		tc->tx_next += res;
+		if ((size_t)res < n) {
+			/* Resumed from the first unsent packet */
+			tc->tx_blocked++;
+			return;
+		}
+	}
+}
+
+
+static void ready_to_send_cb(struct rtsp_client *client, void *userdata)
+{
+	struct test_client *tc = userdata;
+
+	tc->ready_count++;
+	test_client_send(tc);
+}
+
+
+static void playback_resp_cb(struct rtsp_client *client,
+			     const char *session_id,
+			     enum rtsp_client_req_status req_status,
+			     int status,
+			     const char *content_base,
+			     const char *sdp,
+			     const struct rtsp_client_playback_media *medias,
+			     size_t media_count,
+			     const struct rtsp_range *range,
+			     void *userdata,
+			     void *req_userdata)
+{
+	struct test_client *tc = userdata;
+
+	tc->playback_done = 1;
+	tc->playback_req_status = req_status;
+	tc->playback_media_count = media_count;
+	for (size_t i = 0; (i < media_count) && (i < TEST_MEDIA_COUNT); i++)
+		tc->playback_media_status[i] = medias[i].status;
+}
+
+
+static const struct rtsp_client_cbs s_test_client_cbs = {
+	.connection_state = &connection_state_cb,
+	.session_removed = &session_removed_cb,
+	.options_resp = &options_resp_cb,
+	.announce = &announce_cb,
+	.interleaved_data_cb = &interleaved_data_cb,
+	.ready_to_send_cb = &ready_to_send_cb,
+	.playback_resp = &playback_resp_cb,
+};
+
+
+static void test_client_connect(struct test_client *tc,
+				struct test_srv *srv,
+				struct pomp_loop *loop)
+{
+	char url[64];
+	int connected = 0;
+	int res;
+
+	memset(tc, 0, sizeof(*tc));
+	res = rtsp_client_new(loop, NULL, &s_test_client_cbs, tc, &tc->client);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	snprintf(url, sizeof(url), "rtsp://127.0.0.1:%u/stream", srv->port);
+	res = rtsp_client_connect(tc->client, url);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	for (int i = 0; (i < TEST_TIMEOUT_MS / 10) && !connected; i++) {
+		pomp_loop_wait_and_process(loop, 10);
+		connected = (tc->state == RTSP_CLIENT_CONN_STATE_CONNECTED) &&
+			    (srv->fd >= 0);
+	}
+	CU_ASSERT_TRUE_FATAL(connected);
+}
+
+
+/* Process the loop until count OPTIONS responses have been received */
+static void test_client_wait(struct pomp_loop *loop,
+			     struct test_client *tc,
+			     size_t count)
+{
+	for (int i = 0; i < TEST_TIMEOUT_MS / 10; i++) {
+		if (tc->options_count >= count)
+			break;
+		pomp_loop_wait_and_process(loop, 10);
+	}
+	CU_ASSERT_EQUAL(tc->options_count, count);
+}
+
+
+/* Only the first media can be set up */
+static void playback_handler(struct test_srv *srv,
+			     const struct test_request *req)
+{
+	char headers[256];
+	char sdp[2048];
+	size_t len = 0;
+
+	if (strcmp(req->method, "OPTIONS") == 0) {
+		test_srv_reply(srv,
+			       req->cseq,
+			       "200 OK",
+			       "Public: OPTIONS, DESCRIBE, SETUP, PLAY, "
+			       "TEARDOWN, GET_PARAMETER\r\n",
+			       NULL);
+	} else if (strcmp(req->method, "DESCRIBE") == 0) {
+		len += snprintf(sdp + len,
+				sizeof(sdp) - len,
+				"v=0\r\n"
+				"o=- 0 0 IN IP4 127.0.0.1\r\n"
+				"s=test\r\n"
+				"t=0 0\r\n"
+				"a=control:*\r\n");
+		for (int i = 0; i < TEST_MEDIA_COUNT; i++) {
+			len += snprintf(sdp + len,
+					sizeof(sdp) - len,
+					"m=video 0 RTP/AVP 96\r\n"
+					"a=control:track%d\r\n",
+					i);
+		}
+		snprintf(headers,
+			 sizeof(headers),
+			 "Content-Base: rtsp://127.0.0.1:%u/stream/\r\n"
+			 "Content-Type: application/sdp\r\n",
+			 srv->port);
+		test_srv_reply(srv, req->cseq, "200 OK", headers, sdp);
+	} else if (strcmp(req->method, "SETUP") == 0) {
+		if (strstr(req->uri, "/track0") == NULL) {
+			test_srv_reply(srv,
+				       req->cseq,
+				       "500 Internal Server Error",
+				       "Session: 0123456789ABCDEF\r\n",
+				       NULL);
+			return;
+		}
+		test_srv_reply(srv,
+			       req->cseq,
+			       "200 OK",
+			       "Session: 0123456789ABCDEF;timeout=60\r\n"
+			       "Transport: RTP/AVP/UDP;unicast;"
+			       "client_port=5000-5001;"
+			       "server_port=6000-6001\r\n",
+			       NULL);
+	} else {
+		test_srv_reply(srv,
+			       req->cseq,
+			       "200 OK",
+			       "Session: 0123456789ABCDEF\r\n"
+			       "Range: npt=0-\r\n",
+			       NULL);
+	}
+}
+
+
+static void test_rtsp_client_playback_setup_failed(void)
+{
+	int res;
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+	struct rtsp_client_playback_params params;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	srv.handler = &playback_handler;
+	test_client_connect(&tc, &srv, loop);
+
+	/* More medias than requests in flight: the SETUP requests blocked
+	 * by the limit are sent as the failed ones complete */
+	memset(&params, 0, sizeof(params));
+	params.lower_transport = RTSP_LOWER_TRANSPORT_UDP;
+	params.udp_port = 5000;
+	params.scale = 1.f;
+	params.timeout_ms = TEST_TIMEOUT_MS;
+	res = rtsp_client_start_playback(tc.client, &params, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	test_loop_run(loop, &tc.playback_done);
+
+	CU_ASSERT_EQUAL(tc.playback_req_status, RTSP_CLIENT_REQ_STATUS_OK);
+	CU_ASSERT_EQUAL(tc.playback_media_count, TEST_MEDIA_COUNT);
+	CU_ASSERT_EQUAL(tc.playback_media_status[0], 0);
+	for (int i = 1; i < TEST_MEDIA_COUNT; i++)
+		CU_ASSERT_TRUE(tc.playback_media_status[i] < 0);
+	CU_ASSERT_PTR_NOT_NULL(test_srv_find(&srv, "PLAY"));
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_cseq(void)
+{
+	int res;
+	int userdata[3];
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	test_client_connect(&tc, &srv, loop);
+
+	for (int i = 0; i < 3; i++) {
+		res = rtsp_client_options(tc.client, NULL, 0, &userdata[i], 0);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	test_srv_wait(&srv, 3);
+	CU_ASSERT_EQUAL(srv.requests[1].cseq, srv.requests[0].cseq + 1);
+	CU_ASSERT_EQUAL(srv.requests[2].cseq, srv.requests[1].cseq + 1);
+
+	/* The responses are matched by CSeq, not by order */
+	test_srv_reply(&srv, srv.requests[2].cseq, "200 OK", NULL, NULL);
+	test_srv_reply(&srv, srv.requests[0].cseq, "200 OK", NULL, NULL);
+	test_srv_reply(&srv, srv.requests[1].cseq, "200 OK", NULL, NULL);
+	test_client_wait(loop, &tc, 3);
+	CU_ASSERT_PTR_EQUAL(tc.options_userdata[0], &userdata[2]);
+	CU_ASSERT_PTR_EQUAL(tc.options_userdata[1], &userdata[0]);
+	CU_ASSERT_PTR_EQUAL(tc.options_userdata[2], &userdata[1]);
+	for (int i = 0; i < 3; i++) {
+		CU_ASSERT_EQUAL(tc.options_status[i],
+				RTSP_CLIENT_REQ_STATUS_OK);
+	}
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_no_cseq(void)
+{
+	int res;
+	int userdata[2];
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	test_client_connect(&tc, &srv, loop);
+
+	/* Error response without CSeq (VLC server): matched to the single
+	 * request in flight */
+	res = rtsp_client_options(tc.client, NULL, 0, &userdata[0], 0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_srv_wait(&srv, 1);
+	test_srv_send(&srv, "RTSP/1.0 404 Not Found\r\n\r\n");
+	test_client_wait(loop, &tc, 1);
+	CU_ASSERT_PTR_EQUAL(tc.options_userdata[0], &userdata[0]);
+	CU_ASSERT_EQUAL(tc.options_status[0], RTSP_CLIENT_REQ_STATUS_FAILED);
+
+	/* Ambiguous with two requests in flight: dropped */
+	for (int i = 0; i < 2; i++) {
+		res = rtsp_client_options(tc.client, NULL, 0, &userdata[i], 0);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	test_srv_wait(&srv, 3);
+	test_srv_send(&srv, "RTSP/1.0 404 Not Found\r\n\r\n");
+	test_srv_reply(&srv, srv.requests[2].cseq, "200 OK", NULL, NULL);
+	test_client_wait(loop, &tc, 2);
+	CU_ASSERT_PTR_EQUAL(tc.options_userdata[1], &userdata[1]);
+	CU_ASSERT_EQUAL(tc.options_status[1], RTSP_CLIENT_REQ_STATUS_OK);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_stale_cseq(void)
+{
+	int res;
+	int userdata[2];
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	test_client_connect(&tc, &srv, loop);
+
+	res = rtsp_client_options(tc.client, NULL, 0, &userdata[0], 0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_srv_wait(&srv, 1);
+	test_srv_reply(&srv, srv.requests[0].cseq, "200 OK", NULL, NULL);
+	test_client_wait(loop, &tc, 1);
+
+	/* With a single request in flight, responses with the CSeq of an
+	 * answered request or with an unknown CSeq are not matched */
+	res = rtsp_client_options(tc.client, NULL, 0, &userdata[1], 0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_srv_wait(&srv, 2);
+	test_srv_reply(&srv, srv.requests[0].cseq, "404 Not Found", NULL, NULL);
+	test_srv_reply(
+		&srv, srv.requests[1].cseq + 100, "404 Not Found", NULL, NULL);
+	test_srv_reply(&srv, srv.requests[1].cseq, "200 OK", NULL, NULL);
+	test_client_wait(loop, &tc, 2);
+	CU_ASSERT_PTR_EQUAL(tc.options_userdata[1], &userdata[1]);
+	CU_ASSERT_EQUAL(tc.options_status[1], RTSP_CLIENT_REQ_STATUS_OK);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_interleaved_split(void)
+{
+	int res;
+	char resp[128];
+	int len;
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	test_client_connect(&tc, &srv, loop);
+
+	/* A response followed by the first byte of an interleaved packet,
+	 * whose header and payload are then received in pieces */
+	res = rtsp_client_options(tc.client, NULL, 0, NULL, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_srv_wait(&srv, 1);
+	len = snprintf(resp,
+		       sizeof(resp),
+		       "RTSP/1.0 200 OK\r\nCSeq: %u\r\n\r\n$",
+		       srv.requests[0].cseq);
+	test_srv_write(&srv, resp, len);
+	test_client_wait(loop, &tc, 1);
+	test_srv_write(&srv, "\x01\x00", 2);
+	for (int i = 0; i < 5; i++)
+		pomp_loop_wait_and_process(loop, 10);
+	test_srv_write(&srv, "\x04" "ab", 3);
+	for (int i = 0; i < 5; i++)
+		pomp_loop_wait_and_process(loop, 10);
+	CU_ASSERT_EQUAL(tc.interleaved_count, 0);
+	test_srv_write(&srv, "cd", 2);
+	for (int i = 0; (i < TEST_TIMEOUT_MS / 10) && !tc.interleaved_count;
+	     i++)
+		pomp_loop_wait_and_process(loop, 10);
+	CU_ASSERT_EQUAL_FATAL(tc.interleaved_count, 1);
+	CU_ASSERT_EQUAL(tc.interleaved_len, 4);
+	CU_ASSERT_EQUAL(memcmp(tc.interleaved_data, "abcd", 4), 0);
+
+	/* The next response is still parsed */
+	res = rtsp_client_options(tc.client, NULL, 0, NULL, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_srv_wait(&srv, 2);
+	test_srv_reply(&srv, srv.requests[1].cseq, "200 OK", NULL, NULL);
+	test_client_wait(loop, &tc, 2);
+	CU_ASSERT_EQUAL(tc.options_status[1], RTSP_CLIENT_REQ_STATUS_OK);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_sort_addrs(void)
+{
+	unsigned int count;
+	const char *sorted[RTSP_CLIENT_CONNECT_MAX_ADDRS];
+	const char *addrs[] = {
+		"::1",
+		"fe80::1",
+		"10.0.0.1",
+		"10.0.0.2",
+		"10.0.0.3",
+		"::2",
+	};
+	const char *expected[] = {
+		"::1",
+		"10.0.0.1",
+		"fe80::1",
+		"10.0.0.2",
+		"::2",
+		"10.0.0.3",
+	};
+	const char *many[RTSP_CLIENT_CONNECT_MAX_ADDRS + 2];
+
+	/* The families alternate, starting with the first address one */
+	count = rtsp_client_sort_addrs(addrs, SIZEOF_ARRAY(addrs), sorted);
+	CU_ASSERT_EQUAL_FATAL(count, SIZEOF_ARRAY(expected));
+	for (unsigned int i = 0; i < count; i++)
+		CU_ASSERT_STRING_EQUAL(sorted[i], expected[i]);
+
+	count = rtsp_client_sort_addrs(addrs + 2, 4, sorted);
+	CU_ASSERT_EQUAL_FATAL(count, 4);
+	CU_ASSERT_STRING_EQUAL(sorted[0], "10.0.0.1");
+	CU_ASSERT_STRING_EQUAL(sorted[1], "::2");
+	CU_ASSERT_STRING_EQUAL(sorted[2], "10.0.0.2");
+	CU_ASSERT_STRING_EQUAL(sorted[3], "10.0.0.3");
+
+	/* At most RTSP_CLIENT_CONNECT_MAX_ADDRS addresses are kept */
+	for (unsigned int i = 0; i < SIZEOF_ARRAY(many); i++)
+		many[i] = "127.0.0.1";
+	count = rtsp_client_sort_addrs(many, SIZEOF_ARRAY(many), sorted);
+	CU_ASSERT_EQUAL(count, RTSP_CLIENT_CONNECT_MAX_ADDRS);
+	count = rtsp_client_sort_addrs(many, 0, sorted);
+	CU_ASSERT_EQUAL(count, 0);
+}
+
+
+static uint64_t test_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static void test_rtsp_client_race(void)
+{
+	int res;
+	int connected = 0;
+	char url[64];
+	uint64_t start, elapsed;
+	const char *host;
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+	struct tskt_client *first;
+	const char *addrs[] = {"127.0.0.2", "127.0.0.1"};
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	memset(&tc, 0, sizeof(tc));
+	res = rtsp_client_new(loop, NULL, &s_test_client_cbs, &tc, &tc.client);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	/* Replace the host resolution by two addresses, the first one
+	 * refusing the connection */
+	snprintf(url, sizeof(url), "rtsp://127.0.0.1:%u/stream", srv.port);
+	res = rtsp_client_connect(tc.client, url);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = tskt_resolv_cancel(tc.client->resolv.resolv,
+				 tc.client->resolv.req_id);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_timer_clear(tc.client->resolv.timer);
+	CU_ASSERT_EQUAL(res, 0);
+	first = tc.client->tclient;
+	start = test_time_ms();
+	res = rtsp_client_connect_addrs(tc.client, addrs, 2);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	/* The failure of the first attempt starts the second one without
+	 * waiting for the attempt delay; the second one wins */
+	for (int i = 0; (i < TEST_TIMEOUT_MS / 10) && !connected; i++) {
+		pomp_loop_wait_and_process(loop, 10);
+		connected = (tc.state == RTSP_CLIENT_CONN_STATE_CONNECTED) &&
+			    (srv.fd >= 0);
+	}
+	CU_ASSERT_TRUE_FATAL(connected);
+	elapsed = test_time_ms() - start;
+	CU_ASSERT(elapsed < RTSP_CLIENT_CONNECT_ATTEMPT_DELAY_MS);
+	CU_ASSERT_PTR_NOT_EQUAL(tc.client->tclient, first);
+	CU_ASSERT_EQUAL(tc.client->race.count, 0);
+	host = rtsp_url_get_resolved_host(tc.client->remote.url);
+	CU_ASSERT_STRING_EQUAL(host, "127.0.0.1");
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_reconnect_delay(void)
+{
+	int res;
+	unsigned int delay;
+	struct pomp_loop *loop;
+	struct rtsp_client *client;
+	const unsigned int expected[] = {100, 200, 300, 300};
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	res = rtsp_client_new(loop, NULL, &s_test_client_cbs, NULL, &client);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	res = rtsp_client_set_reconnect_backoff(client, 400, 300);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = rtsp_client_set_reconnect_backoff(client, 100, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(client->reconnect.max_delay_ms,
+			RTSP_CLIENT_RECONNECT_DEFAULT_MAX_DELAY_MS);
+
+	/* The delay doubles from the minimum and stops at the maximum; the
+	 * jitter shortens it by at most half */
+	res = rtsp_client_set_reconnect_backoff(client, 100, 300);
+	CU_ASSERT_EQUAL(res, 0);
+	for (int run = 0; run < 10; run++) {
+		client->reconnect.delay_ms = client->reconnect.min_delay_ms;
+		for (size_t i = 0; i < SIZEOF_ARRAY(expected); i++) {
+			delay = rtsp_client_reconnect_delay(client);
+			CU_ASSERT(delay <= expected[i]);
+			CU_ASSERT(delay >= expected[i] / 2);
+		}
+		CU_ASSERT_EQUAL(client->reconnect.delay_ms, 300);
+	}
+
+	rtsp_client_destroy(client);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_reconnect_resume(void)
+{
+	int res;
+	int reconnected = 0;
+	unsigned int attempts = 0;
+	size_t count;
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+	struct rtsp_client_session *session;
+	struct rtsp_client_playback_params params;
+	const struct test_request *play = NULL;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	srv.handler = &playback_handler;
+	test_client_connect(&tc, &srv, loop);
+	res = rtsp_client_set_reconnect_backoff(tc.client, 20, 80);
+	CU_ASSERT_EQUAL(res, 0);
+
+	memset(&params, 0, sizeof(params));
+	params.lower_transport = RTSP_LOWER_TRANSPORT_UDP;
+	params.udp_port = 5000;
+	params.scale = 1.f;
+	params.timeout_ms = TEST_TIMEOUT_MS;
+	res = rtsp_client_start_playback(tc.client, &params, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	test_loop_run(loop, &tc.playback_done);
+	CU_ASSERT_FATAL(!list_is_empty(&tc.client->sessions));
+	session = list_entry(
+		list_first(&tc.client->sessions), typeof(*session), node);
+	CU_ASSERT_TRUE(session->playing);
+
+	/* Connection dropped by the server, which keeps listening */
+	pomp_loop_remove(loop, srv.fd);
+	close(srv.fd);
+	srv.fd = -1;
+	count = srv.request_count;
+	for (int i = 0; (i < TEST_TIMEOUT_MS / 10) && !reconnected; i++) {
+		pomp_loop_wait_and_process(loop, 10);
+		if (tc.client->reconnect.attempts > attempts)
+			attempts = tc.client->reconnect.attempts;
+		reconnected = (tc.state == RTSP_CLIENT_CONN_STATE_CONNECTED) &&
+			      (srv.fd >= 0);
+	}
+	CU_ASSERT_TRUE_FATAL(reconnected);
+	CU_ASSERT(attempts > 0);
+	CU_ASSERT_EQUAL(tc.client->reconnect.attempts, 0);
+
+	/* The playing session is resumed with a PLAY request on the new
+	 * connection, and kept */
+	test_srv_wait(&srv, count + 1);
+	if (srv.request_count > count)
+		play = &srv.requests[count];
+	CU_ASSERT_PTR_NOT_NULL_FATAL(play);
+	CU_ASSERT_STRING_EQUAL(play->method, "PLAY");
+	for (int i = 0; i < 10; i++)
+		pomp_loop_wait_and_process(loop, 10);
+	CU_ASSERT_FALSE(list_is_empty(&tc.client->sessions));
+	CU_ASSERT_TRUE(session->playing);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_cache_ttl(void)
+{
+	int res;
+	struct pomp_loop *loop;
+	struct rtsp_client *client;
+	const char *content_base;
+	const char *sdp;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	res = rtsp_client_new(loop, NULL, &s_test_client_cbs, NULL, &client);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	/* Nothing is cached by default */
+	rtsp_client_cache_set_description(client, "rtsp://h/s", "b", "v=0");
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/s", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	res = rtsp_client_set_cache_ttl(client, 50);
+	CU_ASSERT_EQUAL(res, 0);
+	rtsp_client_cache_set_description(client, "rtsp://h/s", "b", "v=0");
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/s", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_STRING_EQUAL(content_base, "b");
+	CU_ASSERT_STRING_EQUAL(sdp, "v=0");
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/t", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	/* Stale after the TTL; a new description restarts it */
+	usleep(60 * 1000);
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/s", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	rtsp_client_cache_set_description(client, "rtsp://h/s", NULL, "v=1");
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/s", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_NULL(content_base);
+	CU_ASSERT_STRING_EQUAL(sdp, "v=1");
+	CU_ASSERT_EQUAL(client->cache.count, 1);
+
+	/* A zero TTL disables the cache and drops its entries */
+	res = rtsp_client_set_cache_ttl(client, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(client->cache.count, 0);
+
+	rtsp_client_destroy(client);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_cache_eviction(void)
+{
+	int res;
+	char uri[32];
+	struct pomp_loop *loop;
+	struct rtsp_client *client;
+	const char *content_base;
+	const char *sdp;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	res = rtsp_client_new(loop, NULL, &s_test_client_cbs, NULL, &client);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = rtsp_client_set_cache_ttl(client, TEST_TIMEOUT_MS);
+	CU_ASSERT_EQUAL(res, 0);
+
+	for (int i = 0; i < RTSP_CLIENT_CACHE_MAX_ENTRIES; i++) {
+		snprintf(uri, sizeof(uri), "rtsp://h/s%d", i);
+		rtsp_client_cache_set_description(client, uri, NULL, uri);
+	}
+	CU_ASSERT_EQUAL(client->cache.count, RTSP_CLIENT_CACHE_MAX_ENTRIES);
+
+	/* Updating an entry does not add one */
+	rtsp_client_cache_set_description(client, "rtsp://h/s0", NULL, "v=0");
+	CU_ASSERT_EQUAL(client->cache.count, RTSP_CLIENT_CACHE_MAX_ENTRIES);
+
+	/* Full: the least recently added entry is evicted */
+	rtsp_client_cache_set_description(client, "rtsp://h/new", NULL, "v=0");
+	CU_ASSERT_EQUAL(client->cache.count, RTSP_CLIENT_CACHE_MAX_ENTRIES);
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/s0", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	for (int i = 1; i < RTSP_CLIENT_CACHE_MAX_ENTRIES; i++) {
+		snprintf(uri, sizeof(uri), "rtsp://h/s%d", i);
+		res = rtsp_client_cache_get_description(
+			client, uri, &content_base, &sdp);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_STRING_EQUAL(sdp, uri);
+	}
+	res = rtsp_client_cache_get_description(
+		client, "rtsp://h/new", &content_base, &sdp);
+	CU_ASSERT_EQUAL(res, 0);
+
+	rtsp_client_destroy(client);
+	pomp_loop_destroy(loop);
+}
+
+
+/* The medias of the outdated description cannot be set up */
+static void cache_handler(struct test_srv *srv, const struct test_request *req)
+{
+	if ((strcmp(req->method, "SETUP") == 0) &&
+	    (strstr(req->uri, "/old") != NULL)) {
+		test_srv_reply(srv, req->cseq, "404 Not Found", NULL, NULL);
+		return;
+	}
+	playback_handler(srv, req);
+}
+
+
+static void test_rtsp_client_cache_setup_failed(void)
+{
+	int res;
+	char content_base[64];
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+	struct rtsp_client_playback_params params;
+	const struct test_request *play;
+	const char *cached_content_base;
+	const char *cached_sdp;
+	const char *sdp = "v=0\r\n"
+			  "o=- 0 0 IN IP4 127.0.0.1\r\n"
+			  "s=test\r\n"
+			  "t=0 0\r\n"
+			  "a=control:*\r\n"
+			  "m=video 0 RTP/AVP 96\r\n"
+			  "a=control:old0\r\n";
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	srv.handler = &cache_handler;
+	test_client_connect(&tc, &srv, loop);
+	res = rtsp_client_set_cache_ttl(tc.client, TEST_TIMEOUT_MS);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Outdated description of the stream in the cache */
+	snprintf(content_base,
+		 sizeof(content_base),
+		 "rtsp://127.0.0.1:%u/stream/",
+		 srv.port);
+	rtsp_client_cache_set_description(
+		tc.client, tc.client->remote.url_str, content_base, sdp);
+
+	/* The playback starts with the SETUP of the cached media, then
+	 * falls back to a DESCRIBE request when it fails */
+	memset(&params, 0, sizeof(params));
+	params.lower_transport = RTSP_LOWER_TRANSPORT_UDP;
+	params.udp_port = 5000;
+	params.scale = 1.f;
+	params.timeout_ms = TEST_TIMEOUT_MS;
+	res = rtsp_client_start_playback(tc.client, &params, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	test_loop_run(loop, &tc.playback_done);
+
+	CU_ASSERT_FATAL(srv.request_count > 1);
+	CU_ASSERT_STRING_EQUAL(srv.requests[0].method, "SETUP");
+	CU_ASSERT_PTR_NOT_NULL(strstr(srv.requests[0].uri, "/old0"));
+	CU_ASSERT_PTR_NOT_NULL(test_srv_find(&srv, "DESCRIBE"));
+	play = test_srv_find(&srv, "PLAY");
+	CU_ASSERT_PTR_NOT_NULL(play);
+	CU_ASSERT_EQUAL(tc.playback_req_status, RTSP_CLIENT_REQ_STATUS_OK);
+	CU_ASSERT_EQUAL(tc.playback_media_count, TEST_MEDIA_COUNT);
+	CU_ASSERT_EQUAL(tc.playback_media_status[0], 0);
+
+	/* The fresh description replaced the outdated one */
+	res = rtsp_client_cache_get_description(tc.client,
+						tc.client->remote.url_str,
+						&cached_content_base,
+						&cached_sdp);
+	CU_ASSERT_EQUAL(res, 0);
+	if (res == 0) {
+		CU_ASSERT_PTR_NULL(strstr(cached_sdp, "old0"));
+		CU_ASSERT_PTR_NOT_NULL(strstr(cached_sdp, "track0"));
+	}
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+/* Process the loop until the server has received count interleaved
+ * packets */
+static void test_srv_wait_interleaved(struct test_srv *srv, size_t count)
+{
+	for (int i = 0; i < TEST_TIMEOUT_MS / 10; i++) {
+		if (srv->rx_count >= count)
+			break;
+		pomp_loop_wait_and_process(srv->loop, 10);
+	}
+	CU_ASSERT_EQUAL(srv->rx_count, count);
+	CU_ASSERT_EQUAL(srv->rx_errors, 0);
+}
+
+
+static void test_rtsp_client_send_interleaved(void)
+{
+	int res;
+	uint8_t data[1000];
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	test_client_connect(&tc, &srv, loop);
+	srv.interleaved = 1;
+	srv.pkt_len = sizeof(data);
+	tc.client->channel_used[0] = true;
+
+	res = rtsp_client_send_interleaved(tc.client, 2, data, sizeof(data));
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	res = rtsp_client_send_interleaved(tc.client, 0, data, 0);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	/* The header and the payload are written together: nothing is
+	 * buffered by the client */
+	for (int i = 0; i < 4; i++) {
+		memset(data, i, sizeof(data));
+		res = rtsp_client_send_interleaved(
+			tc.client, 0, data, sizeof(data));
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	CU_ASSERT_PTR_NULL(tc.client->tx.pending);
+	test_srv_wait_interleaved(&srv, 4);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_client_send_interleaved_batch(void)
+{
+	int res;
+	int connected = 0;
+	char url[64];
+	size_t len = 0;
+	uint8_t *data;
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+	struct rtsp_interleaved_info *pkts;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	data = malloc(TEST_PKT_COUNT * TEST_PKT_LEN);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data);
+	pkts = calloc(TEST_PKT_COUNT, sizeof(*pkts));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pkts);
+	for (size_t i = 0; i < TEST_PKT_COUNT; i++) {
+		memset(&data[i * TEST_PKT_LEN], (uint8_t)i, TEST_PKT_LEN);
+		pkts[i].channel = 0;
+		pkts[i].data = &data[i * TEST_PKT_LEN];
+		pkts[i].len = TEST_PKT_LEN;
+	}
+
+	/* Small send buffer, so that the writes are partial */
+	test_srv_start(&srv, loop);
+	memset(&tc, 0, sizeof(tc));
+	res = rtsp_client_new(loop, NULL, &s_test_client_cbs, &tc, &tc.client);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = rtsp_client_set_socket_txbuf_size(tc.client, 16384);
+	CU_ASSERT_EQUAL(res, 0);
+	snprintf(url, sizeof(url), "rtsp://127.0.0.1:%u/stream", srv.port);
+	res = rtsp_client_connect(tc.client, url);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	for (int i = 0; (i < TEST_TIMEOUT_MS / 10) && !connected; i++) {
+		pomp_loop_wait_and_process(loop, 10);
+		connected = (tc.state == RTSP_CLIENT_CONN_STATE_CONNECTED) &&
+			    (srv.fd >= 0);
+	}
+	CU_ASSERT_TRUE_FATAL(connected);
+	srv.interleaved = 1;
+	srv.pkt_len = TEST_PKT_LEN;
+	tc.client->channel_used[0] = true;
+
+	/* Without the server reading, the socket is full before all the
+	 * packets are sent */
+	tc.tx_pkts = pkts;
+	tc.tx_count = TEST_PKT_COUNT;
+	test_client_send(&tc);
+	CU_ASSERT(tc.tx_next < TEST_PKT_COUNT);
+	CU_ASSERT(tc.tx_blocked > 0);
+
+	/* The rest of the packet cut by the partial write is kept, and
+	 * nothing else can be sent before it */
+	CU_ASSERT_PTR_NOT_NULL_FATAL(tc.client->tx.pending);
+	res = pomp_buffer_get_cdata(tc.client->tx.pending, NULL, &len, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT(len > 0);
+	res = rtsp_client_send_interleaved(
+		tc.client, 0, data, TEST_PKT_LEN);
+	CU_ASSERT_EQUAL(res, -EAGAIN);
+
+	/* The rest of a cut packet is flushed on the writable event, then
+	 * the sending resumes from the first unsent packet: the server
+	 * gets all packets, whole and in order */
+	test_srv_wait_interleaved(&srv, TEST_PKT_COUNT);
+	CU_ASSERT_EQUAL(tc.tx_next, TEST_PKT_COUNT);
+	CU_ASSERT(tc.ready_count > 0);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+	free(pkts);
+	free(data);
+}
+
+
+static void test_rtsp_client_busy(void)
+{
+	int res;
+	int userdata[TEST_MAX_OPTIONS];
+	struct pomp_loop *loop;
+	struct test_srv srv;
+	struct test_client tc;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	test_srv_start(&srv, loop);
+	test_client_connect(&tc, &srv, loop);
+
+	for (int i = 0; i < RTSP_CLIENT_MAX_INFLIGHT; i++) {
+		res = rtsp_client_options(tc.client, NULL, 0, &userdata[i], 0);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = rtsp_client_options(tc.client,
+				  NULL,
+				  0,
+				  &userdata[RTSP_CLIENT_MAX_INFLIGHT],
+				  0);
+	CU_ASSERT_EQUAL(res, -EBUSY);
+	test_srv_wait(&srv, RTSP_CLIENT_MAX_INFLIGHT);
+
+	/* The slot of the oldest request is free once answered */
+	test_srv_reply(&srv, srv.requests[0].cseq, "200 OK", NULL, NULL);
+	test_client_wait(loop, &tc, 1);
+	res = rtsp_client_options(tc.client,
+				  NULL,
+				  0,
+				  &userdata[RTSP_CLIENT_MAX_INFLIGHT],
+				  0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_srv_wait(&srv, RTSP_CLIENT_MAX_INFLIGHT + 1);
+	CU_ASSERT_EQUAL(srv.requests[RTSP_CLIENT_MAX_INFLIGHT].cseq,
+			srv.requests[0].cseq + RTSP_CLIENT_MAX_INFLIGHT);
+
+	rtsp_client_destroy(tc.client);
+	test_srv_stop(&srv);
+	pomp_loop_destroy(loop);
+}
+
+
+CU_TestInfo g_rtsp_test_client[] = {
+	{FN("rtsp-client-playback-setup-failed"),
+	 &test_rtsp_client_playback_setup_failed},
+	{FN("rtsp-client-cseq"), &test_rtsp_client_cseq},
+	{FN("rtsp-client-no-cseq"), &test_rtsp_client_no_cseq},
+	{FN("rtsp-client-stale-cseq"), &test_rtsp_client_stale_cseq},
+	{FN("rtsp-client-interleaved-split"),
+	 &test_rtsp_client_interleaved_split},
+	{FN("rtsp-client-busy"), &test_rtsp_client_busy},
+	{FN("rtsp-client-send-interleaved"),
+	 &test_rtsp_client_send_interleaved},
+	{FN("rtsp-client-send-interleaved-batch"),
+	 &test_rtsp_client_send_interleaved_batch},
+	{FN("rtsp-client-cache-ttl"), &test_rtsp_client_cache_ttl},
+	{FN("rtsp-client-cache-eviction"), &test_rtsp_client_cache_eviction},
+	{FN("rtsp-client-cache-setup-failed"),
+	 &test_rtsp_client_cache_setup_failed},
+	{FN("rtsp-client-reconnect-delay"), &test_rtsp_client_reconnect_delay},
+	{FN("rtsp-client-reconnect-resume"),
+	 &test_rtsp_client_reconnect_resume},
+	{FN("rtsp-client-sort-addrs"), &test_rtsp_client_sort_addrs},
+	{FN("rtsp-client-race"), &test_rtsp_client_race},
+
+	CU_TEST_INFO_NULL,
+};
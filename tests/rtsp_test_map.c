@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+#include "rtsp_test.h"
+
+
+/* Initial capacity of a map, kept while it holds at most 12 entries */
+#define TEST_MAP_CAPACITY 16
+#define TEST_MAP_KEYS 4
+
+
+static int s_values[64];
+
+
+/* Home slot of a key in a map of TEST_MAP_CAPACITY entries: where it
+ * lands when inserted first */
+static size_t test_map_home(uint64_t key)
+{
+	int res;
+	size_t home = SIZE_MAX;
+	struct rtsp_map map;
+
+	memset(&map, 0, sizeof(map));
+	res = rtsp_map_put(&map, key, &s_values[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(map.capacity, TEST_MAP_CAPACITY);
+	for (size_t i = 0; i < map.capacity; i++) {
+		if (map.entries[i].value != NULL)
+			home = i;
+	}
+	rtsp_map_clear(&map);
+
+	return home;
+}
+
+
+/* Find count keys with the given home slot, starting from key */
+static void
+test_map_find_keys(size_t home, uint64_t key, uint64_t *keys, size_t count)
+{
+	size_t n = 0;
+
+	for (; n < count; key++) {
+		if (test_map_home(key) == home)
+			keys[n++] = key;
+	}
+}
+
+
+static void test_map_check_slot(const struct rtsp_map *map,
+				size_t slot,
+				uint64_t key)
+{
+	CU_ASSERT_PTR_NOT_NULL(map->entries[slot].value);
+	CU_ASSERT_EQUAL(map->entries[slot].key, key);
+}
+
+
+static void test_rtsp_map_collisions(void)
+{
+	int res;
+	size_t home = 3;
+	uint64_t keys[TEST_MAP_KEYS];
+	struct rtsp_map map;
+
+	memset(&map, 0, sizeof(map));
+	CU_ASSERT_PTR_NULL(rtsp_map_get(&map, 1));
+	res = rtsp_map_remove(&map, 1);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	/* Colliding keys are stored after their home slot */
+	test_map_find_keys(home, 1, keys, TEST_MAP_KEYS);
+	for (int i = 0; i < TEST_MAP_KEYS - 1; i++) {
+		res = rtsp_map_put(&map, keys[i], &s_values[i]);
+		CU_ASSERT_EQUAL(res, 0);
+		test_map_check_slot(&map, home + i, keys[i]);
+	}
+	CU_ASSERT_EQUAL(map.count, TEST_MAP_KEYS - 1);
+	for (int i = 0; i < TEST_MAP_KEYS - 1; i++)
+		CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, keys[i]), &s_values[i]);
+
+	/* Absent colliding key: the probe stops at the end of the
+	 * cluster */
+	CU_ASSERT_PTR_NULL(rtsp_map_get(&map, keys[TEST_MAP_KEYS - 1]));
+	res = rtsp_map_remove(&map, keys[TEST_MAP_KEYS - 1]);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	/* Duplicate key and NULL value */
+	res = rtsp_map_put(&map, keys[1], &s_values[10]);
+	CU_ASSERT_EQUAL(res, -EEXIST);
+	CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, keys[1]), &s_values[1]);
+	res = rtsp_map_put(&map, keys[TEST_MAP_KEYS - 1], NULL);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	/* Removing the head of the cluster shifts the others back */
+	res = rtsp_map_remove(&map, keys[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(map.count, TEST_MAP_KEYS - 2);
+	CU_ASSERT_PTR_NULL(rtsp_map_get(&map, keys[0]));
+	test_map_check_slot(&map, home, keys[1]);
+	test_map_check_slot(&map, home + 1, keys[2]);
+	CU_ASSERT_PTR_NULL(map.entries[home + 2].value);
+	CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, keys[1]), &s_values[1]);
+	CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, keys[2]), &s_values[2]);
+
+	rtsp_map_clear(&map);
+	CU_ASSERT_PTR_NULL(map.entries);
+	CU_ASSERT_EQUAL(map.count, 0);
+}
+
+
+static void test_rtsp_map_backward_shift(void)
+{
+	int res;
+	size_t home = TEST_MAP_CAPACITY - 2;
+	uint64_t keys[3];
+	uint64_t next_keys[2];
+	struct rtsp_map map;
+
+	memset(&map, 0, sizeof(map));
+	test_map_find_keys(home, 1, keys, SIZEOF_ARRAY(keys));
+	test_map_find_keys(home + 1, 1, next_keys, SIZEOF_ARRAY(next_keys));
+
+	/* Cluster wrapping around the end of the table:
+	 * [14] keys[0], [15] next_keys[0] (at home), [0] keys[1],
+	 * [1] next_keys[1], [2] keys[2] */
+	res = rtsp_map_put(&map, keys[0], &s_values[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_map_put(&map, next_keys[0], &s_values[10]);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_map_put(&map, keys[1], &s_values[1]);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_map_put(&map, next_keys[1], &s_values[11]);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_map_put(&map, keys[2], &s_values[2]);
+	CU_ASSERT_EQUAL(res, 0);
+	test_map_check_slot(&map, home, keys[0]);
+	test_map_check_slot(&map, home + 1, next_keys[0]);
+	test_map_check_slot(&map, 0, keys[1]);
+	test_map_check_slot(&map, 1, next_keys[1]);
+	test_map_check_slot(&map, 2, keys[2]);
+
+	/* Hole at the head of the cluster: the entry at its home slot
+	 * stays, the next one moves back over it */
+	res = rtsp_map_remove(&map, keys[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	test_map_check_slot(&map, home, keys[1]);
+	test_map_check_slot(&map, home + 1, next_keys[0]);
+	test_map_check_slot(&map, 0, next_keys[1]);
+	test_map_check_slot(&map, 1, keys[2]);
+	CU_ASSERT_PTR_NULL(map.entries[2].value);
+
+	/* Hole in the middle of the probe sequence of the later keys */
+	res = rtsp_map_remove(&map, next_keys[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	test_map_check_slot(&map, home, keys[1]);
+	test_map_check_slot(&map, home + 1, next_keys[1]);
+	test_map_check_slot(&map, 0, keys[2]);
+	CU_ASSERT_PTR_NULL(map.entries[1].value);
+
+	CU_ASSERT_EQUAL(map.count, 3);
+	CU_ASSERT_PTR_NULL(rtsp_map_get(&map, keys[0]));
+	CU_ASSERT_PTR_NULL(rtsp_map_get(&map, next_keys[0]));
+	CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, keys[1]), &s_values[1]);
+	CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, keys[2]), &s_values[2]);
+	CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, next_keys[1]), &s_values[11]);
+
+	rtsp_map_clear(&map);
+}
+
+
+static void test_rtsp_map_grow(void)
+{
+	int res;
+	const uint64_t count = SIZEOF_ARRAY(s_values);
+	struct rtsp_map map;
+
+	/* Entries are kept across resizes, and after removals */
+	memset(&map, 0, sizeof(map));
+	for (uint64_t key = 0; key < count; key++) {
+		res = rtsp_map_put(&map, key << 32, &s_values[key]);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	CU_ASSERT_EQUAL(map.count, count);
+	CU_ASSERT_TRUE(map.count * 4 <= map.capacity * 3);
+	for (uint64_t key = 0; key < count; key += 2) {
+		res = rtsp_map_remove(&map, key << 32);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	CU_ASSERT_EQUAL(map.count, count / 2);
+	for (uint64_t key = 0; key < count; key++) {
+		CU_ASSERT_PTR_EQUAL(rtsp_map_get(&map, key << 32),
+				    (key % 2) ? &s_values[key] : NULL);
+	}
+
+	rtsp_map_clear(&map);
+}
+
+
+CU_TestInfo g_rtsp_test_map[] = {
+	{FN("rtsp-map-collisions"), &test_rtsp_map_collisions},
+	{FN("rtsp-map-backward-shift"), &test_rtsp_map_backward_shift},
+	{FN("rtsp-map-grow"), &test_rtsp_map_grow},
+
+	CU_TEST_INFO_NULL,
+};
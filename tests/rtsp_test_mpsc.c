@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+#include "rtsp_test.h"
+
+#include <sched.h>
+
+
+#define TEST_PRODUCERS 4
+#define TEST_ITEMS 100000
+
+
+struct test_item {
+	struct rtsp_mpsc_node node;
+	unsigned int producer;
+	unsigned int index;
+};
+
+
+struct test_producer {
+	struct rtsp_mpsc *queue;
+	unsigned int index;
+	struct test_item *items;
+};
+
+
+static void *producer_thread(void *userdata)
+{
+	struct test_producer *producer = userdata;
+
+	for (unsigned int i = 0; i < TEST_ITEMS; i++) {
+		producer->items[i].producer = producer->index;
+		producer->items[i].index = i;
+		rtsp_mpsc_push(producer->queue, &producer->items[i].node);
+	}
+
+	return NULL;
+}
+
+
+static void test_rtsp_mpsc_single(void)
+{
+	struct rtsp_mpsc queue;
+	struct test_item items[3];
+	struct rtsp_mpsc_node *node;
+
+	rtsp_mpsc_init(&queue);
+	CU_ASSERT_PTR_NULL(rtsp_mpsc_pop(&queue));
+
+	/* FIFO order, also when pushing after the queue was emptied */
+	for (unsigned int i = 0; i < 2; i++)
+		rtsp_mpsc_push(&queue, &items[i].node);
+	node = rtsp_mpsc_pop(&queue);
+	CU_ASSERT_PTR_EQUAL(node, &items[0].node);
+	node = rtsp_mpsc_pop(&queue);
+	CU_ASSERT_PTR_EQUAL(node, &items[1].node);
+	CU_ASSERT_PTR_NULL(rtsp_mpsc_pop(&queue));
+
+	rtsp_mpsc_push(&queue, &items[2].node);
+	node = rtsp_mpsc_pop(&queue);
+	CU_ASSERT_PTR_EQUAL(node, &items[2].node);
+	CU_ASSERT_PTR_NULL(rtsp_mpsc_pop(&queue));
+}
+
+
+static void test_rtsp_mpsc_multi_producer(void)
+{
+	int res;
+	struct rtsp_mpsc queue;
+	struct test_producer producers[TEST_PRODUCERS];
+	pthread_t threads[TEST_PRODUCERS];
+	unsigned int next[TEST_PRODUCERS];
+	struct rtsp_mpsc_node *node;
+	struct test_item *item;
+	size_t count = 0;
+	int ordered = 1;
+
+	rtsp_mpsc_init(&queue);
+	for (unsigned int i = 0; i < TEST_PRODUCERS; i++) {
+		producers[i].queue = &queue;
+		producers[i].index = i;
+		producers[i].items =
+			calloc(TEST_ITEMS, sizeof(*producers[i].items));
+		CU_ASSERT_PTR_NOT_NULL_FATAL(producers[i].items);
+		next[i] = 0;
+	}
+	for (unsigned int i = 0; i < TEST_PRODUCERS; i++) {
+		res = pthread_create(
+			&threads[i], NULL, &producer_thread, &producers[i]);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Consume while the producers run: every node is popped once, in
+	 * the push order of each producer */
+	while (count < TEST_PRODUCERS * TEST_ITEMS) {
+		node = rtsp_mpsc_pop(&queue);
+		if (node == NULL) {
+			sched_yield();
+			continue;
+		}
+		item = container_of(node, struct test_item, node);
+		if (item->index != next[item->producer])
+			ordered = 0;
+		next[item->producer] = item->index + 1;
+		count++;
+	}
+	CU_ASSERT_TRUE(ordered);
+
+	for (unsigned int i = 0; i < TEST_PRODUCERS; i++) {
+		res = pthread_join(threads[i], NULL);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_EQUAL(next[i], TEST_ITEMS);
+		free(producers[i].items);
+	}
+	CU_ASSERT_PTR_NULL(rtsp_mpsc_pop(&queue));
+}
+
+
+CU_TestInfo g_rtsp_test_mpsc[] = {
+	{FN("rtsp-mpsc-single"), &test_rtsp_mpsc_single},
+	{FN("rtsp-mpsc-multi-producer"), &test_rtsp_mpsc_multi_producer},
+
+	CU_TEST_INFO_NULL,
+};
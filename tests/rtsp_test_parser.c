@@ -0,0 +1,1121 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+#include "rtsp_test.h"
+
+
+#define BENCH_ITERATIONS 200
+
+
+static const char s_describe_req[] =
+	"DESCRIBE rtsp://192.168.42.1/live RTSP/1.0\r\n"
+	"CSeq: 2\r\n"
+	"User-Agent: librtsp_client\r\n"
+	"Accept: application/sdp\r\n"
+	"X-com-parrot-test: value\r\n"
+	"Content-Type: text/parameters\r\n"
+	"Content-Length: 10\r\n"
+	"\r\n"
+	"0123456789";
+
+
+static const char s_options_resp[] =
+	"RTSP/1.0 200 OK\r\n"
+	"CSeq: 1\r\n"
+	"Public: OPTIONS, DESCRIBE, SETUP, TEARDOWN, PLAY, PAUSE\r\n"
+	"Server: librtsp_server\r\n"
+	"\r\n";
+
+
+/* Feed data to the parser in segments of seg_len bytes; returns the number
+ * of complete messages, the last one being kept in msg */
+static int feed_segmented(const char *data,
+			  size_t len,
+			  size_t seg_len,
+			  struct rtsp_message *msg)
+{
+	int ret;
+	int count = 0;
+	size_t off = 0;
+	size_t buf_len;
+	struct rtsp_message_parser_ctx ctx;
+	struct rtsp_message tmp;
+	struct pomp_buffer *buf;
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&tmp, 0, sizeof(tmp));
+
+	buf = pomp_buffer_new(len);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+
+	while (off < len) {
+		size_t n = (len - off < seg_len) ? len - off : seg_len;
+		ret = rtsp_message_parser_append_data(
+			&ctx, buf, data + off, n);
+		CU_ASSERT_EQUAL(ret, 0);
+		off += n;
+
+		while ((ret = rtsp_get_next_message(buf, &tmp, &ctx)) == 0) {
+			count++;
+			rtsp_message_clear(msg);
+			msg->type = tmp.type;
+			msg->body_len = tmp.body_len;
+			msg->total_len = tmp.total_len;
+			if (tmp.type == RTSP_MESSAGE_TYPE_REQUEST)
+				rtsp_request_header_copy(&tmp.header.req,
+							 &msg->header.req);
+			else if (tmp.type == RTSP_MESSAGE_TYPE_RESPONSE)
+				rtsp_response_header_copy(&tmp.header.resp,
+							  &msg->header.resp);
+			rtsp_message_parser_consume(&ctx, buf, tmp.total_len);
+		}
+		CU_ASSERT_EQUAL(ret, -EAGAIN);
+		rtsp_message_parser_consume(&ctx, buf, tmp.total_len);
+
+		/* While the header is incomplete, the scan must have
+		 * stopped at the end of the received data */
+		pomp_buffer_get_cdata(buf, NULL, &buf_len, NULL);
+		if (ctx.header_len == 0)
+			CU_ASSERT_EQUAL(ctx.scan_offset, buf_len - ctx.head);
+	}
+
+	rtsp_message_clear(&tmp);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+	return count;
+}
+
+
+static void test_rtsp_parser_segmented(void)
+{
+	int count;
+	struct rtsp_message msg;
+	size_t seg_lens[] = {1, 2, 3, 7, 16, 64, sizeof(s_describe_req)};
+
+	memset(&msg, 0, sizeof(msg));
+
+	for (size_t i = 0; i < SIZEOF_ARRAY(seg_lens); i++) {
+		count = feed_segmented(s_describe_req,
+				       strlen(s_describe_req),
+				       seg_lens[i],
+				       &msg);
+		CU_ASSERT_EQUAL(count, 1);
+		CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_REQUEST);
+		CU_ASSERT_EQUAL(msg.header.req.method,
+				RTSP_METHOD_TYPE_DESCRIBE);
+		CU_ASSERT_EQUAL(msg.header.req.cseq, 2);
+		CU_ASSERT_EQUAL(msg.header.req.content_length, 10);
+		CU_ASSERT_EQUAL(msg.header.req.ext_count, 1);
+		CU_ASSERT_EQUAL(msg.body_len, 10);
+		CU_ASSERT_EQUAL(msg.total_len, strlen(s_describe_req));
+		rtsp_message_clear(&msg);
+
+		count = feed_segmented(s_options_resp,
+				       strlen(s_options_resp),
+				       seg_lens[i],
+				       &msg);
+		CU_ASSERT_EQUAL(count, 1);
+		CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_RESPONSE);
+		CU_ASSERT_EQUAL(msg.header.resp.status_code, 200);
+		CU_ASSERT_EQUAL(msg.header.resp.cseq, 1);
+		CU_ASSERT_EQUAL(msg.header.resp.public_methods,
+				RTSP_METHOD_FLAG_OPTIONS |
+					RTSP_METHOD_FLAG_DESCRIBE |
+					RTSP_METHOD_FLAG_SETUP |
+					RTSP_METHOD_FLAG_TEARDOWN |
+					RTSP_METHOD_FLAG_PLAY |
+					RTSP_METHOD_FLAG_PAUSE);
+		rtsp_message_clear(&msg);
+	}
+}
+
+
+static void test_rtsp_parser_line_terminators(void)
+{
+	int count;
+	struct rtsp_message msg;
+	const char *reqs[] = {
+		"OPTIONS * RTSP/1.0\r\nCSeq: 3\r\n\r\n",
+		"OPTIONS * RTSP/1.0\nCSeq: 3\n\n",
+		"OPTIONS * RTSP/1.0\rCSeq: 3\r\r",
+		"OPTIONS * RTSP/1.0\n\rCSeq: 3\n\r\n\r",
+	};
+
+	memset(&msg, 0, sizeof(msg));
+
+	for (size_t i = 0; i < SIZEOF_ARRAY(reqs); i++) {
+		count = feed_segmented(reqs[i], strlen(reqs[i]), 1, &msg);
+		CU_ASSERT_EQUAL(count, 1);
+		CU_ASSERT_EQUAL(msg.header.req.method,
+				RTSP_METHOD_TYPE_OPTIONS);
+		CU_ASSERT_EQUAL(msg.header.req.cseq, 3);
+		CU_ASSERT_EQUAL(msg.total_len, strlen(reqs[i]));
+		rtsp_message_clear(&msg);
+	}
+}
+
+
+static void test_rtsp_parser_in_place(void)
+{
+	int ret;
+	const void *cdata;
+	size_t len;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct rtsp_request_header copy;
+	struct rtsp_header_ext *ext;
+	struct pomp_buffer *buf;
+	const char keepalive[] =
+		"GET_PARAMETER rtsp://10.0.0.1/live RTSP/1.0\r\n"
+		"CSeq: 5\r\n"
+		"Session: 12345678;timeout=60\r\n"
+		"X-com-parrot-a: 1\r\n"
+		"X-com-parrot-b: 2\r\n"
+		"content-length: 4\r\n"
+		"\r\n"
+		"body";
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&copy, 0, sizeof(copy));
+
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, keepalive, strlen(keepalive));
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, keepalive, strlen(keepalive));
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = pomp_buffer_get_cdata(buf, &cdata, &len, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The strings point into the buffer */
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_REQUEST);
+	CU_ASSERT_TRUE(msg.header.req.is_view);
+	CU_ASSERT_EQUAL(msg.header.req.cseq, 5);
+	CU_ASSERT_EQUAL(msg.header.req.content_length, 4);
+	CU_ASSERT_TRUE(msg.header.req.uri > (char *)cdata &&
+		       msg.header.req.uri < (char *)cdata + len);
+	CU_ASSERT_STRING_EQUAL(msg.header.req.uri, "rtsp://10.0.0.1/live");
+	CU_ASSERT_STRING_EQUAL(msg.header.req.session_id, "12345678");
+	CU_ASSERT_EQUAL(msg.header.req.session_timeout, 60);
+	CU_ASSERT_EQUAL_FATAL(msg.header.req.ext_count, 2);
+	CU_ASSERT_STRING_EQUAL(msg.header.req.ext[1].key, "X-com-parrot-b");
+	CU_ASSERT_STRING_EQUAL(msg.header.req.ext[1].value, "2");
+	CU_ASSERT_EQUAL(msg.body_len, 4);
+	CU_ASSERT_EQUAL(memcmp(msg.body, "body", 4), 0);
+	CU_ASSERT_EQUAL(msg.total_len, strlen(keepalive));
+	ext = msg.header.req.ext;
+
+	/* A copy owns its strings */
+	ret = rtsp_request_header_copy(&msg.header.req, &copy);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_FALSE(copy.is_view);
+	CU_ASSERT_PTR_NOT_EQUAL(copy.uri, msg.header.req.uri);
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	CU_ASSERT_EQUAL(ctx.head, strlen(keepalive));
+
+	/* The extensions storage is reused for the next message, which
+	 * is parsed where it was received */
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_PTR_EQUAL(msg.body,
+			    (char *)cdata + 2 * strlen(keepalive) - 4);
+	CU_ASSERT_EQUAL(msg.header.req.ext_count, 2);
+	CU_ASSERT_PTR_EQUAL(msg.header.req.ext, ext);
+	CU_ASSERT_STRING_EQUAL(copy.uri, "rtsp://10.0.0.1/live");
+	CU_ASSERT_STRING_EQUAL(copy.ext[0].key, "X-com-parrot-a");
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	CU_ASSERT_EQUAL(ctx.head, 0);
+	pomp_buffer_get_cdata(buf, NULL, &len, NULL);
+	CU_ASSERT_EQUAL(len, 0);
+
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	CU_ASSERT_EQUAL(msg.total_len, 0);
+
+	rtsp_request_header_clear(&copy);
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_fields(void)
+{
+	int ret;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct pomp_buffer *buf;
+	const char response[] = "RTSP/1.0 200 OK\r\n"
+				"cseq: 4\r\n"
+				"Content-Base-Foo: rtsp://10.0.0.1/foo/\r\n"
+				"content-base: rtsp://10.0.0.1/live/\r\n"
+				"Sessions: 1234\r\n"
+				"Server : test\r\n"
+				"X: 1\r\n"
+				"x-com-parrot-a: 2\r\n"
+				"\r\n";
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, response, strlen(response));
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Field names are matched exactly, regardless of case */
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.header.resp.cseq, 4);
+	CU_ASSERT_STRING_EQUAL(msg.header.resp.content_base,
+			       "rtsp://10.0.0.1/live/");
+	CU_ASSERT_PTR_NULL(msg.header.resp.session_id);
+	CU_ASSERT_STRING_EQUAL(msg.header.resp.server, "test");
+	CU_ASSERT_EQUAL_FATAL(msg.header.resp.ext_count, 1);
+	CU_ASSERT_STRING_EQUAL(msg.header.resp.ext[0].key, "x-com-parrot-a");
+	CU_ASSERT_STRING_EQUAL(msg.header.resp.ext[0].value, "2");
+
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_content_length(void)
+{
+	int count;
+	struct rtsp_message msg;
+	/* Only the exact 'Content-Length' field gives the body length; the
+	 * next request must not be taken as a body */
+	const char requests[] =
+		"GET_PARAMETER rtsp://10.0.0.1/live RTSP/1.0\r\n"
+		"CSeq: 3\r\n"
+		"Content-Length-Foo: 100\r\n"
+		"Content-Lengthy: 5\r\n"
+		"\r\n"
+		"OPTIONS * RTSP/1.0\r\n"
+		"CSeq: 4\r\n"
+		"Content-Length : 4\r\n"
+		"\r\n"
+		"abcd";
+
+	memset(&msg, 0, sizeof(msg));
+
+	count = feed_segmented(requests, strlen(requests), 8, &msg);
+	CU_ASSERT_EQUAL(count, 2);
+	CU_ASSERT_EQUAL(msg.header.req.method, RTSP_METHOD_TYPE_OPTIONS);
+	CU_ASSERT_EQUAL(msg.header.req.cseq, 4);
+	CU_ASSERT_EQUAL(msg.header.req.content_length, 4);
+	CU_ASSERT_EQUAL(msg.body_len, 4);
+	rtsp_message_clear(&msg);
+
+	/* First request alone: no body */
+	count = feed_segmented(requests,
+			       strstr(requests, "OPTIONS") - requests,
+			       strlen(requests),
+			       &msg);
+	CU_ASSERT_EQUAL(count, 1);
+	CU_ASSERT_EQUAL(msg.header.req.method,
+			RTSP_METHOD_TYPE_GET_PARAMETER);
+	CU_ASSERT_EQUAL(msg.header.req.content_length, 0);
+	CU_ASSERT_EQUAL(msg.body_len, 0);
+	rtsp_message_clear(&msg);
+}
+
+
+static void test_rtsp_parser_methods(void)
+{
+	int ret;
+	char data[1024];
+	struct rtsp_string str;
+	struct rtsp_response_header header;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct pomp_buffer *buf;
+	const uint32_t sets[] = {
+		RTSP_METHOD_FLAG_PLAY,
+		RTSP_METHOD_FLAG_DESCRIBE | RTSP_METHOD_FLAG_SETUP |
+			RTSP_METHOD_FLAG_PLAY | RTSP_METHOD_FLAG_PAUSE |
+			RTSP_METHOD_FLAG_TEARDOWN |
+			RTSP_METHOD_FLAG_GET_PARAMETER,
+		RTSP_METHOD_FLAG_OPTIONS | RTSP_METHOD_FLAG_DESCRIBE |
+			RTSP_METHOD_FLAG_SETUP | RTSP_METHOD_FLAG_PLAY |
+			RTSP_METHOD_FLAG_PAUSE | RTSP_METHOD_FLAG_TEARDOWN |
+			RTSP_METHOD_FLAG_GET_PARAMETER,
+		RTSP_METHOD_FLAG_ANNOUNCE | RTSP_METHOD_FLAG_RECORD,
+		RTSP_METHOD_FLAG_OPTIONS | RTSP_METHOD_FLAG_DESCRIBE |
+			RTSP_METHOD_FLAG_ANNOUNCE | RTSP_METHOD_FLAG_SETUP |
+			RTSP_METHOD_FLAG_PLAY | RTSP_METHOD_FLAG_PAUSE |
+			RTSP_METHOD_FLAG_TEARDOWN |
+			RTSP_METHOD_FLAG_GET_PARAMETER |
+			RTSP_METHOD_FLAG_SET_PARAMETER |
+			RTSP_METHOD_FLAG_REDIRECT | RTSP_METHOD_FLAG_RECORD,
+	};
+	const char allow[] = "RTSP/1.0 200 OK\r\n"
+			     "CSeq: 1\r\n"
+			     "Allow: PLAY , FOO,SETUP,play,PLAYS\r\n"
+			     "\r\n";
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+
+	/* The method sets survive a write/read round trip, whether they
+	 * are pre-serialized or not */
+	for (size_t i = 0; i < SIZEOF_ARRAY(sets); i++) {
+		memset(&header, 0, sizeof(header));
+		header.status_code = RTSP_STATUS_CODE_OK;
+		header.status_string = RTSP_STATUS_STRING_OK;
+		header.cseq = 1;
+		header.public_methods = sets[i];
+		memset(&str, 0, sizeof(str));
+		str.str = data;
+		str.max_len = sizeof(data);
+		ret = rtsp_response_header_write(&header, &str);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		if (i == 1) {
+			CU_ASSERT_PTR_NOT_NULL(strstr(
+				data,
+				"Public: DESCRIBE,SETUP,PLAY,PAUSE,TEARDOWN,"
+				"GET_PARAMETER\r\n"));
+		}
+
+		ret = rtsp_message_parser_append_data(&ctx, buf, data, str.len);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = rtsp_get_next_message(buf, &msg, &ctx);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		CU_ASSERT_EQUAL(msg.header.resp.public_methods, sets[i]);
+		rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	}
+
+	/* Method names are case-sensitive and matched exactly */
+	ret = rtsp_message_parser_append_data(&ctx, buf, allow, strlen(allow));
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.header.resp.allowed_methods,
+			RTSP_METHOD_FLAG_PLAY | RTSP_METHOD_FLAG_SETUP);
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_date(void)
+{
+	int ret;
+	uint64_t date = 0;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct rtsp_response_header header;
+	struct pomp_buffer *buf;
+	const char response[] = "RTSP/1.0 200 OK\r\n"
+				"CSeq: 3\r\n"
+				"Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+				"\r\n";
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&header, 0, sizeof(header));
+
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, response, strlen(response));
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The date is kept as received and only parsed on demand */
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_RESPONSE);
+	CU_ASSERT_EQUAL(msg.header.resp.date, 0);
+	CU_ASSERT_STRING_EQUAL(msg.header.resp.date_str,
+			       "Sun, 06 Nov 1994 08:49:37 GMT");
+	ret = rtsp_response_header_get_date(&msg.header.resp, &date);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(date, 784111777);
+
+	/* The date to write has precedence */
+	header.date = 1000;
+	ret = rtsp_response_header_get_date(&header, &date);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(date, 1000);
+
+	header.date = 0;
+	ret = rtsp_response_header_get_date(&header, &date);
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_compaction(void)
+{
+	int ret;
+	const void *cdata;
+	const void *prev;
+	size_t len, capacity;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct pomp_buffer *buf;
+	const char req[] = "OPTIONS * RTSP/1.0\r\nCSeq: 1\r\n\r\n";
+	const size_t req_len = strlen(req);
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+
+	buf = pomp_buffer_new(3 * req_len + 16);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	ret = pomp_buffer_get_cdata(buf, &prev, NULL, &capacity);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Three messages and a partial one */
+	for (int i = 0; i < 3; i++) {
+		ret = rtsp_message_parser_append_data(&ctx, buf, req, req_len);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	ret = rtsp_message_parser_append_data(&ctx, buf, req, 10);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Consuming messages only moves the head */
+	for (int i = 0; i < 3; i++) {
+		ret = rtsp_get_next_message(buf, &msg, &ctx);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(msg.header.req.method,
+				RTSP_METHOD_TYPE_OPTIONS);
+		rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+		CU_ASSERT_EQUAL(ctx.head, (i + 1) * req_len);
+	}
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	pomp_buffer_get_cdata(buf, &cdata, &len, NULL);
+	CU_ASSERT_PTR_EQUAL(cdata, prev);
+	CU_ASSERT_EQUAL(len, 3 * req_len + 10);
+
+	/* Not enough room at the end: the pending bytes are moved to the
+	 * front of the buffer, without growing it */
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, req + 10, req_len - 10);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(ctx.head, 0);
+	pomp_buffer_get_cdata(buf, &cdata, &len, NULL);
+	CU_ASSERT_EQUAL(len, req_len);
+	CU_ASSERT_EQUAL(memcmp(cdata, req, req_len), 0);
+
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.header.req.cseq, 1);
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_interleaved(void)
+{
+	int ret;
+	uint8_t header[RTSP_INTERLEAVED_HEADER_LEN];
+	uint8_t payload[300];
+	size_t off, len;
+	struct rtsp_interleaved_info info;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct pomp_buffer *buf;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+	for (size_t i = 0; i < sizeof(payload); i++)
+		payload[i] = i & 0xff;
+
+	rtsp_interleaved_header_write(3, sizeof(payload), header);
+	CU_ASSERT_EQUAL(header[0], '$');
+	CU_ASSERT_EQUAL(header[1], 3);
+	CU_ASSERT_EQUAL(header[2], sizeof(payload) >> 8);
+	CU_ASSERT_EQUAL(header[3], sizeof(payload) & 0xff);
+
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, header, sizeof(header));
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, payload, sizeof(payload));
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_INTERLEAVED);
+	CU_ASSERT_EQUAL(msg.interleaved.channel, 3);
+	CU_ASSERT_EQUAL(msg.interleaved.len, sizeof(payload));
+	CU_ASSERT_EQUAL(
+		memcmp(msg.interleaved.data, payload, sizeof(payload)), 0);
+	CU_ASSERT_EQUAL(msg.total_len, sizeof(header) + sizeof(payload));
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+
+	/* Fast path: two packets followed by an RTSP message */
+	for (int i = 0; i < 2; i++) {
+		rtsp_interleaved_header_write(i, sizeof(payload), header);
+		ret = rtsp_message_parser_append_data(
+			&ctx, buf, header, sizeof(header));
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = rtsp_message_parser_append_data(
+			&ctx, buf, payload, sizeof(payload));
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, s_options_resp, strlen(s_options_resp));
+	CU_ASSERT_EQUAL(ret, 0);
+
+	off = 0;
+	for (int i = 0; i < 2; i++) {
+		ret = rtsp_get_next_interleaved(buf, &ctx, off, &info, &len);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		CU_ASSERT_EQUAL(info.channel, i);
+		CU_ASSERT_EQUAL(info.len, sizeof(payload));
+		CU_ASSERT_EQUAL(len, sizeof(header) + sizeof(payload));
+		off += len;
+	}
+	ret = rtsp_get_next_interleaved(buf, &ctx, off, &info, &len);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	rtsp_message_parser_consume(&ctx, buf, off);
+
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_RESPONSE);
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	ret = rtsp_get_next_interleaved(buf, &ctx, 0, &info, &len);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_interleaved_split(void)
+{
+	int ret;
+	uint8_t pkt[RTSP_INTERLEAVED_HEADER_LEN + 8];
+	size_t piece, len;
+	struct rtsp_interleaved_info info;
+	struct rtsp_message msg;
+	struct rtsp_message_parser_ctx ctx;
+	struct pomp_buffer *buf;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+	rtsp_interleaved_header_write(
+		1, sizeof(pkt) - RTSP_INTERLEAVED_HEADER_LEN, pkt);
+	for (size_t i = RTSP_INTERLEAVED_HEADER_LEN; i < sizeof(pkt); i++)
+		pkt[i] = i;
+
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+
+	/* Feed the packet in 1, 2 and 3-byte pieces, falling back to the
+	 * message parser as the connections do */
+	for (size_t step = 1; step <= 3; step++) {
+		for (size_t off = 0; off < sizeof(pkt); off += step) {
+			piece = sizeof(pkt) - off < step ? sizeof(pkt) - off
+							 : step;
+			ret = rtsp_message_parser_append_data(
+				&ctx, buf, pkt + off, piece);
+			CU_ASSERT_EQUAL(ret, 0);
+			if (off + piece == sizeof(pkt))
+				break;
+			ret = rtsp_get_next_interleaved(
+				buf, &ctx, 0, &info, &len);
+			CU_ASSERT_EQUAL(ret, -EAGAIN);
+			ret = rtsp_get_next_message(buf, &msg, &ctx);
+			CU_ASSERT_EQUAL(ret, -EAGAIN);
+			CU_ASSERT_EQUAL(ctx.scan_offset, 0);
+		}
+		ret = rtsp_get_next_interleaved(buf, &ctx, 0, &info, &len);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		CU_ASSERT_EQUAL(info.channel, 1);
+		CU_ASSERT_EQUAL(len, sizeof(pkt));
+		rtsp_message_parser_consume(&ctx, buf, len);
+	}
+
+	/* An RTSP message split in its header, then an interleaved packet
+	 * once the message is consumed */
+	ret = rtsp_message_parser_append_data(&ctx, buf, s_options_resp, 10);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, s_options_resp + 10, strlen(s_options_resp) - 10);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_message_parser_append_data(&ctx, buf, pkt, 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_get_next_message(buf, &msg, &ctx);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_RESPONSE);
+	rtsp_message_parser_consume(&ctx, buf, msg.total_len);
+	ret = rtsp_get_next_interleaved(buf, &ctx, 0, &info, &len);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = rtsp_message_parser_append_data(
+		&ctx, buf, pkt + 2, sizeof(pkt) - 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = rtsp_get_next_interleaved(buf, &ctx, 0, &info, &len);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(len, sizeof(pkt));
+
+	rtsp_message_clear(&msg);
+	rtsp_message_parser_ctx_clear(&ctx);
+	pomp_buffer_unref(buf);
+}
+
+
+static void test_rtsp_parser_transport_ipv6(void)
+{
+	int ret;
+	char data[256];
+	char value[] = "RTP/AVP/UDP;unicast;destination=[fe80::1];"
+		       "source=[::1];client_port=5000-5001";
+	unsigned int count = 0;
+	struct rtsp_string str;
+	struct rtsp_transport_header *transport[1] = {NULL};
+	struct rtsp_transport_header trsp;
+
+	/* IPv6 addresses are written enclosed in brackets, once */
+	memset(&trsp, 0, sizeof(trsp));
+	trsp.transport_protocol = "RTP";
+	trsp.transport_profile = "AVP";
+	trsp.lower_transport = RTSP_LOWER_TRANSPORT_UDP;
+	trsp.delivery = RTSP_DELIVERY_UNICAST;
+	trsp.destination = "fe80::1";
+	trsp.source = "[::1]";
+	transport[0] = &trsp;
+	memset(&str, 0, sizeof(str));
+	str.str = data;
+	str.max_len = sizeof(data);
+	ret = rtsp_transport_header_write(transport, 1, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_PTR_NOT_NULL(strstr(data, ";destination=[fe80::1];"));
+	CU_ASSERT_PTR_NOT_NULL(strstr(data, ";source=[::1]"));
+	str.len = 0;
+	trsp.destination = "192.168.0.2";
+	trsp.source = NULL;
+	ret = rtsp_transport_header_write(transport, 1, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_PTR_NOT_NULL(strstr(data, ";destination=192.168.0.2"));
+	CU_ASSERT_PTR_NULL(strchr(data, '['));
+
+	/* The brackets are removed when reading */
+	transport[0] = NULL;
+	ret = rtsp_transport_header_read(value, transport, 1, &count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL_FATAL(count, 1);
+	CU_ASSERT_STRING_EQUAL(transport[0]->destination, "fe80::1");
+	CU_ASSERT_STRING_EQUAL(transport[0]->source, "::1");
+	CU_ASSERT_EQUAL(transport[0]->dst_stream_port, 5000);
+
+	rtsp_transport_header_free(&transport[0]);
+}
+
+
+static void test_rtsp_parser_write_grow(void)
+{
+	int ret;
+	char values[40][32];
+	struct rtsp_header_ext ext[40];
+	struct rtsp_response_header header;
+	struct rtsp_string ref;
+	struct rtsp_string str;
+	struct pomp_buffer *buf;
+	size_t capacity;
+
+	memset(&header, 0, sizeof(header));
+	header.status_code = RTSP_STATUS_CODE_OK;
+	header.status_string = RTSP_STATUS_STRING_OK;
+	header.cseq = 3;
+	for (size_t i = 0; i < SIZEOF_ARRAY(ext); i++) {
+		snprintf(values[i], sizeof(values[i]), "value-%zu", i);
+		ext[i].key = "X-test-header";
+		ext[i].value = values[i];
+	}
+	header.ext = ext;
+	header.ext_count = SIZEOF_ARRAY(ext);
+
+	/* Reference: fixed size string, large enough */
+	memset(&ref, 0, sizeof(ref));
+	ref.max_len = 4096;
+	ref.str = malloc(ref.max_len);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ref.str);
+	ret = rtsp_response_header_write(&header, &ref);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_TRUE(ref.len > 64);
+
+	/* String backed by a small buffer, grown while writing */
+	buf = pomp_buffer_new(64);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	memset(&str, 0, sizeof(str));
+	ret = pomp_buffer_get_data(
+		buf, (void **)&str.str, NULL, &str.max_len);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	str.buf = buf;
+	str.limit = 4096;
+	ret = rtsp_response_header_write(&header, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(str.len, ref.len);
+	CU_ASSERT_EQUAL(memcmp(str.str, ref.str, ref.len), 0);
+	pomp_buffer_get_cdata(buf, NULL, NULL, &capacity);
+	CU_ASSERT_TRUE(capacity > ref.len);
+	CU_ASSERT_TRUE(capacity <= str.limit);
+
+	/* The limit is enforced */
+	ret = pomp_buffer_get_data(
+		buf, (void **)&str.str, NULL, &str.max_len);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	str.len = 0;
+	str.max_len = 64;
+	str.limit = ref.len;
+	ret = rtsp_response_header_write(&header, &str);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+
+	/* Without a backing buffer, the string does not grow */
+	ref.len = 0;
+	ref.max_len = 64;
+	ret = rtsp_response_header_write(&header, &ref);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+
+	pomp_buffer_unref(buf);
+	free(ref.str);
+}
+
+
+static void fill_response_header(struct rtsp_response_header *header,
+				 struct rtsp_header_ext *ext,
+				 size_t ext_count)
+{
+	memset(header, 0, sizeof(*header));
+	header->status_code = RTSP_STATUS_CODE_OK;
+	header->status_string = RTSP_STATUS_STRING_OK;
+	header->cseq = 123456;
+	header->session_id = "0123456789abcdef";
+	header->session_timeout = 60;
+	header->server = "librtsp_server";
+	header->content_type = "application/sdp";
+	header->content_length = 1024;
+	header->ext = ext;
+	header->ext_count = ext_count;
+}
+
+
+static void test_rtsp_parser_write(void)
+{
+	int ret;
+	char data[1024];
+	struct rtsp_string str;
+	struct rtsp_response_header header;
+	struct rtsp_header_ext ext = {"X-test", "value"};
+	static const char expected[] =
+		"RTSP/1.0 200 OK\r\n"
+		"CSeq: 123456\r\n"
+		"Session: 0123456789abcdef;timeout=60\r\n"
+		"Content-Type: application/sdp\r\n"
+		"Server: librtsp_server\r\n"
+		"Content-Length: 1024\r\n"
+		"X-test: value\r\n"
+		"\r\n";
+
+	fill_response_header(&header, &ext, 1);
+	memset(&str, 0, sizeof(str));
+	str.str = data;
+	str.max_len = sizeof(data);
+	ret = rtsp_response_header_write(&header, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(str.len, strlen(expected));
+	CU_ASSERT_STRING_EQUAL(data, expected);
+
+	/* Zero values and optional fields unset */
+	header.cseq = 0;
+	header.content_length = 0;
+	header.session_id = NULL;
+	header.content_type = NULL;
+	header.ext_count = 0;
+	str.len = 0;
+	ret = rtsp_response_header_write(&header, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(data,
+			       "RTSP/1.0 200 OK\r\n"
+			       "CSeq: 0\r\n"
+			       "Server: librtsp_server\r\n"
+			       "Content-Length: 0\r\n"
+			       "\r\n");
+
+	/* Exactly full: no room for the terminating null byte */
+	str.max_len = str.len;
+	str.len = 0;
+	ret = rtsp_response_header_write(&header, &str);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+}
+
+
+static void test_rtsp_parser_write_lines(void)
+{
+	int ret;
+	char data[1024];
+	char ref[1024];
+	struct rtsp_string str;
+	struct rtsp_response_header header;
+	struct rtsp_header_line status = {
+		.str = "RTSP/1.0 200 OK\r\n",
+		.len = strlen("RTSP/1.0 200 OK\r\n"),
+	};
+	struct rtsp_header_line session = {
+		.str = "Session: 0123456789abcdef;timeout=60\r\n",
+		.len = strlen("Session: 0123456789abcdef;timeout=60\r\n"),
+	};
+	struct rtsp_header_line server = {
+		.str = "Server: librtsp_server\r\n",
+		.len = strlen("Server: librtsp_server\r\n"),
+	};
+	struct rtsp_header_line content_type = {
+		.str = "Content-Type: application/sdp\r\n",
+		.len = strlen("Content-Type: application/sdp\r\n"),
+	};
+	struct rtsp_header_line content_base = {
+		.str = "Content-Base: rtsp://10.0.0.1/live/\r\n",
+		.len = strlen("Content-Base: rtsp://10.0.0.1/live/\r\n"),
+	};
+	struct rtsp_response_lines lines = {
+		.status = &status,
+		.session = &session,
+		.content_type = &content_type,
+		.server = &server,
+		.content_base = &content_base,
+	};
+
+	fill_response_header(&header, NULL, 0);
+	header.content_base = "rtsp://10.0.0.1/live/";
+
+	memset(&str, 0, sizeof(str));
+	str.str = ref;
+	str.max_len = sizeof(ref);
+	ret = rtsp_response_header_write(&header, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The spliced lines give the same output as the header fields */
+	memset(&str, 0, sizeof(str));
+	str.str = data;
+	str.max_len = sizeof(data);
+	ret = rtsp_response_header_write_lines(&header, &lines, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(data, ref);
+
+	/* The lines replace the header fields */
+	header.status_string = NULL;
+	header.session_id = NULL;
+	header.server = NULL;
+	header.content_type = NULL;
+	header.content_base = NULL;
+	str.len = 0;
+	ret = rtsp_response_header_write_lines(&header, &lines, &str);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(data, ref);
+
+	/* Without the status line the header fields are required */
+	lines.status = NULL;
+	str.len = 0;
+	ret = rtsp_response_header_write_lines(&header, &lines, &str);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+static void test_rtsp_parser_write_bench(void)
+{
+	int ret;
+	char data[1024];
+	struct rtsp_string str;
+	struct rtsp_response_header header;
+	struct rtsp_header_ext ext[4] = {
+		{"X-test-1", "value"},
+		{"X-test-2", "value"},
+		{"X-test-3", "value"},
+		{"X-test-4", "value"},
+	};
+	struct timespec start, end;
+	uint64_t start_us, end_us;
+	size_t len = 0;
+
+	fill_response_header(&header, ext, SIZEOF_ARRAY(ext));
+	memset(&str, 0, sizeof(str));
+	str.str = data;
+	str.max_len = sizeof(data);
+
+	/* Header writer */
+	time_get_monotonic(&start);
+	for (int i = 0; i < 100 * BENCH_ITERATIONS; i++) {
+		str.len = 0;
+		ret = rtsp_response_header_write(&header, &str);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	time_get_monotonic(&end);
+	time_timespec_to_us(&start, &start_us);
+	time_timespec_to_us(&end, &end_us);
+	printf("\n    header writer: %.1f ns/message",
+	       (double)(end_us - start_us) * 1000. / (100 * BENCH_ITERATIONS));
+
+	/* Reference: the same lines formatted with snprintf */
+	time_get_monotonic(&start);
+	for (int i = 0; i < 100 * BENCH_ITERATIONS; i++) {
+		len = snprintf(data,
+			       sizeof(data),
+			       "RTSP/1.0 %d %s\r\n"
+			       "CSeq: %d\r\n",
+			       header.status_code,
+			       header.status_string,
+			       header.cseq);
+		len += snprintf(data + len,
+				sizeof(data) - len,
+				"Session: %s;timeout=%u\r\n",
+				header.session_id,
+				header.session_timeout);
+		len += snprintf(data + len,
+				sizeof(data) - len,
+				"Content-Type: %s\r\n",
+				header.content_type);
+		len += snprintf(data + len,
+				sizeof(data) - len,
+				"Server: %s\r\n",
+				header.server);
+		len += snprintf(data + len,
+				sizeof(data) - len,
+				"Content-Length: %d\r\n",
+				header.content_length);
+		for (size_t j = 0; j < header.ext_count; j++) {
+			len += snprintf(data + len,
+					sizeof(data) - len,
+					"%s: %s\r\n",
+					header.ext[j].key,
+					header.ext[j].value);
+		}
+		len += snprintf(data + len, sizeof(data) - len, "\r\n");
+	}
+	time_get_monotonic(&end);
+	time_timespec_to_us(&start, &start_us);
+	time_timespec_to_us(&end, &end_us);
+	printf("\n    snprintf:      %.1f ns/message\n",
+	       (double)(end_us - start_us) * 1000. / (100 * BENCH_ITERATIONS));
+	CU_ASSERT_EQUAL(len, str.len);
+}
+
+
+static void test_rtsp_parser_bench(void)
+{
+	int count;
+	char *data;
+	size_t len = 0;
+	size_t cap = 4096;
+	struct rtsp_message msg;
+	struct timespec start, end;
+	uint64_t start_us, end_us;
+	size_t seg_lens[] = {1, 16, 128, 1024, 4096};
+
+	memset(&msg, 0, sizeof(msg));
+
+	/* Large header: request line and many extension headers */
+	data = malloc(cap);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data);
+	len += snprintf(data + len,
+			cap - len,
+			"GET_PARAMETER rtsp://10.0.0.1/live RTSP/1.0\r\n"
+			"CSeq: 42\r\n");
+	for (int i = 0; len < cap - 200; i++) {
+		len += snprintf(data + len,
+				cap - len,
+				"X-bench-header-%02d: "
+				"abcdefghijklmnopqrstuvwxyz\r\n",
+				i);
+	}
+	len += snprintf(data + len, cap - len, "\r\n");
+
+	for (size_t i = 0; i < SIZEOF_ARRAY(seg_lens); i++) {
+		time_get_monotonic(&start);
+		for (int j = 0; j < BENCH_ITERATIONS; j++) {
+			count = feed_segmented(data, len, seg_lens[i], &msg);
+			CU_ASSERT_EQUAL(count, 1);
+			rtsp_message_clear(&msg);
+		}
+		time_get_monotonic(&end);
+		time_timespec_to_us(&start, &start_us);
+		time_timespec_to_us(&end, &end_us);
+		printf("\n    header %zu bytes, segments of %4zu bytes: "
+		       "%.2f ns/byte",
+		       len,
+		       seg_lens[i],
+		       (double)(end_us - start_us) * 1000. /
+			       ((double)len * BENCH_ITERATIONS));
+	}
+	printf("\n");
+
+	free(data);
+}
+
+
+CU_TestInfo g_rtsp_test_parser[] = {
+	{FN("rtsp-parser-segmented"), &test_rtsp_parser_segmented},
+	{FN("rtsp-parser-line-terminators"),
+	 &test_rtsp_parser_line_terminators},
+	{FN("rtsp-parser-in-place"), &test_rtsp_parser_in_place},
+	{FN("rtsp-parser-fields"), &test_rtsp_parser_fields},
+	{FN("rtsp-parser-content-length"), &test_rtsp_parser_content_length},
+	{FN("rtsp-parser-methods"), &test_rtsp_parser_methods},
+	{FN("rtsp-parser-date"), &test_rtsp_parser_date},
+	{FN("rtsp-parser-compaction"), &test_rtsp_parser_compaction},
+	{FN("rtsp-parser-interleaved"), &test_rtsp_parser_interleaved},
+	{FN("rtsp-parser-interleaved-split"),
+	 &test_rtsp_parser_interleaved_split},
+	{FN("rtsp-parser-transport-ipv6"), &test_rtsp_parser_transport_ipv6},
+	{FN("rtsp-parser-write"), &test_rtsp_parser_write},
+	{FN("rtsp-parser-write-lines"), &test_rtsp_parser_write_lines},
+	{FN("rtsp-parser-write-grow"), &test_rtsp_parser_write_grow},
+	{FN("rtsp-parser-write-bench"), &test_rtsp_parser_write_bench},
+	{FN("rtsp-parser-bench"), &test_rtsp_parser_bench},
+
+	CU_TEST_INFO_NULL,
+};
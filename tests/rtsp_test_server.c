@@ -0,0 +1,810 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_server_priv.h"
+#include "rtsp_test.h"
+
+
+static int s_request_timeout_count;
+
+
+static const char s_options_req[] = "OPTIONS * RTSP/1.0\r\n"
+				    "CSeq: 2\r\n"
+				    "\r\n";
+
+
+static void request_timeout_cb(struct rtsp_server *server,
+			       void *request_ctx,
+			       enum rtsp_method_type method,
+			       void *userdata)
+{
+	s_request_timeout_count++;
+}
+
+
+/* Server without listening socket, for the internal structures tests */
+static struct rtsp_server *test_server_new(struct pomp_loop *loop)
+{
+	int res;
+	struct rtsp_server *server;
+
+	server = calloc(1, sizeof(*server));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(server);
+	server->loop = loop;
+	server->max_msg_size = RTSP_DEFAULT_MAX_MSG_SIZE;
+	server->cbs.request_timeout = &request_timeout_cb;
+	list_init(&server->pending_requests);
+	list_init(&server->sessions);
+	rtsp_twheel_init(&server->timers, RTSP_SERVER_TIMER_TICK_MS);
+
+	res = rtsp_server_reply_queue_init(server);
+	CU_ASSERT_EQUAL(res, 0);
+
+	return server;
+}
+
+
+static void test_server_destroy(struct rtsp_server *server)
+{
+	CU_ASSERT_EQUAL(server->pending_request_count, 0);
+	CU_ASSERT_EQUAL(server->session_count, 0);
+
+	rtsp_server_reply_queue_clear(server);
+	for (unsigned int i = 0; i < server->buf_pool.count; i++)
+		pomp_buffer_unref(server->buf_pool.bufs[i]);
+	rtsp_map_clear(&server->session_map);
+	free(server->request_slab.slots);
+	free(server);
+}
+
+
+/* Connection context without pomp connection, for the demux tests */
+static struct rtsp_server_conn *test_conn_new(struct rtsp_server *server)
+{
+	struct rtsp_server_conn *conn;
+
+	conn = calloc(1, sizeof(*conn));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(conn);
+	conn->server = server;
+	conn->request_buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL(conn->request_buf);
+
+	return conn;
+}
+
+
+static void test_conn_destroy(struct rtsp_server_conn *conn)
+{
+	for (size_t i = 0; i < SIZEOF_ARRAY(conn->channel_media); i++)
+		CU_ASSERT_PTR_NULL(conn->channel_media[i]);
+
+	rtsp_message_parser_ctx_clear(&conn->parser_ctx);
+	pomp_buffer_unref(conn->request_buf);
+	free(conn);
+}
+
+
+/* Append an interleaved packet, possibly truncated to its first
+ * append_len bytes of payload */
+static void test_conn_append_interleaved(struct rtsp_server_conn *conn,
+					 uint8_t channel,
+					 const uint8_t *payload,
+					 uint16_t len,
+					 uint16_t append_len)
+{
+	int res;
+	uint8_t header[RTSP_INTERLEAVED_HEADER_LEN];
+
+	rtsp_interleaved_header_write(channel, len, header);
+	res = rtsp_message_parser_append_data(
+		&conn->parser_ctx, conn->request_buf, header, sizeof(header));
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_message_parser_append_data(
+		&conn->parser_ctx, conn->request_buf, payload, append_len);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+
+static void test_rtsp_server_reply_expired(void)
+{
+	int res;
+	int media = 0;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct rtsp_server_pending_request *request;
+	struct rtsp_server_pending_request *found;
+	void *request_ctx;
+	void *other_ctx;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+	s_request_timeout_count = 0;
+
+	request = rtsp_server_pending_request_add(server, NULL, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+	request_ctx = rtsp_server_pending_request_ctx(request);
+
+	/* The application posts its reply, but the request times out
+	 * before the reply is processed on the loop */
+	res = rtsp_server_post_reply_to_setup(server,
+					      request_ctx,
+					      &media,
+					      RTSP_STATUS_CODE_OK,
+					      5000,
+					      5001,
+					      0,
+					      0,
+					      NULL,
+					      0,
+					      NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	rtsp_server_pending_request_timer_cb(&request->timer, server);
+	CU_ASSERT_EQUAL(s_request_timeout_count, 1);
+	found = rtsp_server_pending_request_find(server, request_ctx);
+	CU_ASSERT_PTR_NULL(found);
+
+	/* Another request is added in the meantime */
+	request = rtsp_server_pending_request_add(server, NULL, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+	other_ctx = rtsp_server_pending_request_ctx(request);
+	CU_ASSERT_PTR_NOT_EQUAL(other_ctx, request_ctx);
+
+	/* The late reply is dropped: neither the media context nor the new
+	 * request are touched */
+	res = pomp_loop_wait_and_process(loop, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(media, 0);
+	found = rtsp_server_pending_request_find(server, other_ctx);
+	CU_ASSERT_PTR_EQUAL(found, request);
+
+	res = rtsp_server_pending_request_remove(server, request);
+	CU_ASSERT_EQUAL(res, 0);
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_server_reply_unknown_media(void)
+{
+	int res;
+	int media = 0;
+	struct rtsp_range range;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct rtsp_server_pending_request *request;
+	struct rtsp_server_pending_request *found;
+	void *request_ctx;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+	memset(&range, 0, sizeof(range));
+
+	/* The media context is not one of the request medias: it must not
+	 * be dereferenced, and the request is answered with an error */
+	request = rtsp_server_pending_request_add(server, NULL, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+	request_ctx = rtsp_server_pending_request_ctx(request);
+	res = rtsp_server_reply_to_setup(server,
+					 request_ctx,
+					 &media,
+					 RTSP_STATUS_CODE_OK,
+					 5000,
+					 5001,
+					 0,
+					 0,
+					 NULL,
+					 0,
+					 NULL);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	found = rtsp_server_pending_request_find(server, request_ctx);
+	CU_ASSERT_PTR_NULL(found);
+
+	request = rtsp_server_pending_request_add(server, NULL, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+	request_ctx = rtsp_server_pending_request_ctx(request);
+	res = rtsp_server_reply_to_play(server,
+					request_ctx,
+					&media,
+					RTSP_STATUS_CODE_OK,
+					&range,
+					1.f,
+					0,
+					0,
+					0,
+					0,
+					NULL,
+					0);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	found = rtsp_server_pending_request_find(server, request_ctx);
+	CU_ASSERT_PTR_NULL(found);
+
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_server_request_handle_reuse(void)
+{
+	int res;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct rtsp_server_pending_request *request;
+	struct rtsp_server_pending_request *found;
+	void *request_ctx;
+	void *other_ctx = NULL;
+	size_t count = 0;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+
+	request = rtsp_server_pending_request_add(server, NULL, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+	request_ctx = rtsp_server_pending_request_ctx(request);
+	res = rtsp_server_pending_request_remove(server, request);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* The free slots are reused in FIFO order: the slot of the removed
+	 * request comes back only once all the other slots have been used */
+	do {
+		if (other_ctx != NULL) {
+			res = rtsp_server_pending_request_remove(server,
+								 request);
+			CU_ASSERT_EQUAL(res, 0);
+		}
+		request = rtsp_server_pending_request_add(server, NULL, 0);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+		other_ctx = rtsp_server_pending_request_ctx(request);
+		count++;
+	} while (((uintptr_t)other_ctx &
+		  RTSP_SERVER_PENDING_REQUEST_INDEX_MASK) !=
+		 ((uintptr_t)request_ctx &
+		  RTSP_SERVER_PENDING_REQUEST_INDEX_MASK));
+	CU_ASSERT_EQUAL(count, server->request_slab.count);
+
+	/* Same slot, new generation: the stale handle is rejected */
+	CU_ASSERT_PTR_NOT_EQUAL(other_ctx, request_ctx);
+	found = rtsp_server_pending_request_find(server, request_ctx);
+	CU_ASSERT_PTR_NULL(found);
+	found = rtsp_server_pending_request_find(server, other_ctx);
+	CU_ASSERT_PTR_EQUAL(found, request);
+
+	res = rtsp_server_pending_request_remove(server, request);
+	CU_ASSERT_EQUAL(res, 0);
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_server_session_id_invalid(void)
+{
+	int res;
+	unsigned int index = 0;
+	static const char *const invalid[] = {
+		"",
+		"0123456789abcde",
+		"0123456789abcdeg",
+		"0123456789ABCDEF",
+		"0123456789abcdef0",
+		"0123456789abcdef;timeout=60",
+		"0123456789abcdef ",
+	};
+
+	res = rtsp_server_session_id_get_shard("0123456789abcdef", &index);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(index, 0x01);
+
+	/* Only the exact format of the server session identifiers */
+	for (size_t i = 0; i < SIZEOF_ARRAY(invalid); i++) {
+		res = rtsp_server_session_id_get_shard(invalid[i], &index);
+		CU_ASSERT_EQUAL(res, -EINVAL);
+	}
+}
+
+
+static void test_rtsp_server_session_id_shard(void)
+{
+	int res;
+	unsigned int index;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct rtsp_server_session *session;
+	struct rtsp_server_group group = {
+		.shards = NULL,
+		.shard_count = RTSP_SERVER_GROUP_MAX_SHARDS,
+	};
+	static const unsigned int shards[] = {
+		0, 1, 0x7f, RTSP_SERVER_GROUP_MAX_SHARDS - 1};
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+	server->group = &group;
+
+	/* The shard tagged in the identifier of a session is found back
+	 * from its string */
+	for (size_t i = 0; i < SIZEOF_ARRAY(shards); i++) {
+		server->shard_index = shards[i];
+		session = rtsp_server_session_add(server, 0, "rtsp://h/s");
+		CU_ASSERT_PTR_NOT_NULL_FATAL(session);
+		CU_ASSERT_EQUAL(strlen(session->session_id),
+				RTSP_SERVER_SESSION_ID_LENGTH);
+		res = rtsp_server_session_id_get_shard(session->session_id,
+						       &index);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_EQUAL(index, shards[i]);
+		CU_ASSERT_PTR_EQUAL(
+			rtsp_server_session_find(server, session->session_id),
+			session);
+		res = rtsp_server_session_remove(server, session);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_server_conn_interleaved(void)
+{
+	int res;
+	size_t off;
+	size_t len;
+	uint8_t payload[100];
+	struct rtsp_server_conn *conn;
+	struct rtsp_server_session_media medias[2];
+	struct rtsp_channel_pair pair;
+	struct rtsp_interleaved_info info;
+	struct rtsp_message msg;
+	const uint8_t channels[] = {0, 3, 1, 5};
+	struct rtsp_server_session_media *const expected[] = {
+		&medias[0], &medias[1], &medias[0], NULL};
+
+	memset(medias, 0, sizeof(medias));
+	memset(&msg, 0, sizeof(msg));
+	for (size_t i = 0; i < sizeof(payload); i++)
+		payload[i] = i;
+	conn = test_conn_new(NULL);
+
+	pair.rtp = 0;
+	pair.rtcp = 1;
+	res = rtsp_server_conn_channels_bind(conn, &medias[0], &pair);
+	CU_ASSERT_EQUAL(res, 0);
+	pair.rtp = pair.rtcp = 0;
+	res = rtsp_server_conn_channels_bind(conn, &medias[1], &pair);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(medias[1].channel_pair.rtp, 2);
+	CU_ASSERT_EQUAL(medias[1].channel_pair.rtcp, 3);
+
+	/* Packets are demuxed to the medias bound to their channel, the
+	 * last one is incomplete */
+	for (size_t i = 0; i < SIZEOF_ARRAY(channels); i++) {
+		test_conn_append_interleaved(conn,
+					     channels[i],
+					     payload,
+					     sizeof(payload),
+					     sizeof(payload));
+	}
+	test_conn_append_interleaved(
+		conn, 0, payload, sizeof(payload), sizeof(payload) - 10);
+	off = 0;
+	for (size_t i = 0; i < SIZEOF_ARRAY(channels); i++) {
+		res = rtsp_get_next_interleaved(conn->request_buf,
+						&conn->parser_ctx,
+						off,
+						&info,
+						&len);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+		CU_ASSERT_EQUAL(info.channel, channels[i]);
+		CU_ASSERT_EQUAL(info.len, sizeof(payload));
+		CU_ASSERT_EQUAL(memcmp(info.data, payload, sizeof(payload)), 0);
+		CU_ASSERT_PTR_EQUAL(conn->channel_media[info.channel],
+				    expected[i]);
+		off += len;
+	}
+	res = rtsp_get_next_interleaved(
+		conn->request_buf, &conn->parser_ctx, off, &info, &len);
+	CU_ASSERT_EQUAL(res, -EAGAIN);
+	res = rtsp_message_parser_append_data(&conn->parser_ctx,
+					      conn->request_buf,
+					      payload + sizeof(payload) - 10,
+					      10);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_get_next_interleaved(
+		conn->request_buf, &conn->parser_ctx, off, &info, &len);
+	CU_ASSERT_EQUAL(res, 0);
+	off += len;
+	rtsp_message_parser_consume(&conn->parser_ctx, conn->request_buf, off);
+
+	/* No fast path while an RTSP request is being received, even for
+	 * the interleaved packet that follows it */
+	res = rtsp_message_parser_append_data(&conn->parser_ctx,
+					      conn->request_buf,
+					      s_options_req,
+					      10);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_get_next_message(
+		conn->request_buf, &msg, &conn->parser_ctx);
+	CU_ASSERT_EQUAL(res, -EAGAIN);
+	res = rtsp_message_parser_append_data(&conn->parser_ctx,
+					      conn->request_buf,
+					      s_options_req + 10,
+					      strlen(s_options_req) - 10);
+	CU_ASSERT_EQUAL(res, 0);
+	test_conn_append_interleaved(
+		conn, 2, payload, sizeof(payload), sizeof(payload));
+	res = rtsp_get_next_interleaved(conn->request_buf,
+					&conn->parser_ctx,
+					strlen(s_options_req),
+					&info,
+					&len);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = rtsp_get_next_message(
+		conn->request_buf, &msg, &conn->parser_ctx);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	CU_ASSERT_EQUAL(msg.type, RTSP_MESSAGE_TYPE_REQUEST);
+	CU_ASSERT_EQUAL(msg.header.req.method, RTSP_METHOD_TYPE_OPTIONS);
+	rtsp_message_parser_consume(
+		&conn->parser_ctx, conn->request_buf, msg.total_len);
+
+	/* Back to the fast path after the request */
+	res = rtsp_get_next_interleaved(
+		conn->request_buf, &conn->parser_ctx, 0, &info, &len);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	CU_ASSERT_EQUAL(info.channel, 2);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[info.channel], &medias[1]);
+	rtsp_message_parser_consume(&conn->parser_ctx, conn->request_buf, len);
+
+	/* Unbound medias no longer receive their packets */
+	rtsp_server_conn_channels_unbind(&medias[1]);
+	CU_ASSERT_PTR_NULL(medias[1].conn);
+	CU_ASSERT_PTR_NULL(conn->channel_media[2]);
+	CU_ASSERT_PTR_NULL(conn->channel_media[3]);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[0], &medias[0]);
+	rtsp_server_conn_channels_unbind(&medias[0]);
+
+	rtsp_message_clear(&msg);
+	test_conn_destroy(conn);
+}
+
+
+static void test_rtsp_server_conn_channels(void)
+{
+	int res;
+	size_t count;
+	struct rtsp_server_conn *conn;
+	struct rtsp_server_session_media *medias;
+	struct rtsp_server_session_media other;
+	struct rtsp_channel_pair pair;
+
+	count = SIZEOF_ARRAY(conn->channel_media) / 2;
+	medias = calloc(count, sizeof(*medias));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(medias);
+	memset(&other, 0, sizeof(other));
+	conn = test_conn_new(NULL);
+
+	/* The next available pairs are used until all channels are */
+	for (size_t i = 0; i < count; i++) {
+		pair.rtp = pair.rtcp = 0;
+		res = rtsp_server_conn_channels_bind(conn, &medias[i], &pair);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_EQUAL(pair.rtp, 2 * i);
+		CU_ASSERT_EQUAL(pair.rtcp, 2 * i + 1);
+		CU_ASSERT_PTR_EQUAL(medias[i].conn, conn);
+	}
+	pair.rtp = pair.rtcp = 0;
+	res = rtsp_server_conn_channels_bind(conn, &other, &pair);
+	CU_ASSERT_EQUAL(res, -ENOSPC);
+	CU_ASSERT_PTR_NULL(other.conn);
+
+	/* A media can only be bound once */
+	res = rtsp_server_conn_channels_bind(conn, &medias[0], &pair);
+	CU_ASSERT_EQUAL(res, -EBUSY);
+
+	/* Freed pair: reused by the next bind, explicit pairs are refused
+	 * if any of their channels is used */
+	rtsp_server_conn_channels_unbind(&medias[5]);
+	CU_ASSERT_PTR_NULL(medias[5].conn);
+	rtsp_server_conn_channels_unbind(&medias[5]);
+	pair.rtp = 11;
+	pair.rtcp = 12;
+	res = rtsp_server_conn_channels_bind(conn, &other, &pair);
+	CU_ASSERT_EQUAL(res, -EEXIST);
+	pair.rtp = 9;
+	pair.rtcp = 10;
+	res = rtsp_server_conn_channels_bind(conn, &other, &pair);
+	CU_ASSERT_EQUAL(res, -EEXIST);
+	CU_ASSERT_PTR_NULL(other.conn);
+	pair.rtp = pair.rtcp = 0;
+	res = rtsp_server_conn_channels_bind(conn, &other, &pair);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(pair.rtp, 10);
+	CU_ASSERT_EQUAL(pair.rtcp, 11);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[10], &other);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[11], &other);
+
+	/* Explicit pair, not necessarily aligned */
+	rtsp_server_conn_channels_unbind(&other);
+	rtsp_server_conn_channels_unbind(&medias[6]);
+	pair.rtp = 11;
+	pair.rtcp = 12;
+	res = rtsp_server_conn_channels_bind(conn, &other, &pair);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_NULL(conn->channel_media[10]);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[12], &other);
+	rtsp_server_conn_channels_unbind(&other);
+
+	for (size_t i = 0; i < count; i++)
+		rtsp_server_conn_channels_unbind(&medias[i]);
+	test_conn_destroy(conn);
+	free(medias);
+}
+
+
+static void test_rtsp_server_setup_bind_failed(void)
+{
+	int res;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct rtsp_server_conn *conn;
+	struct rtsp_server_session *session;
+	struct rtsp_server_session_media *media[2];
+	struct rtsp_server_pending_request *request;
+	struct rtsp_server_pending_request_media *req_media;
+	struct rtsp_channel_pair pair;
+	void *request_ctx;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+	conn = test_conn_new(server);
+	session = rtsp_server_session_add(server, 0, "rtsp://h/s");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(session);
+
+	media[0] = rtsp_server_session_media_add(
+		server, session, "rtsp://h/s/track0", "s/track0");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(media[0]);
+	pair.rtp = 2;
+	pair.rtcp = 3;
+	res = rtsp_server_conn_channels_bind(conn, media[0], &pair);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* SETUP of a second media on the same channels: the media is
+	 * removed from the request and from the session */
+	request = rtsp_server_pending_request_add(server, NULL, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(request);
+	request_ctx = rtsp_server_pending_request_ctx(request);
+	media[1] = rtsp_server_session_media_add(
+		server, session, "rtsp://h/s/track1", "s/track1");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(media[1]);
+	req_media = rtsp_server_pending_request_media_add(
+		server, request, media[1]);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(req_media);
+	res = rtsp_server_conn_channels_bind(conn, media[1], &pair);
+	CU_ASSERT_EQUAL(res, -EEXIST);
+	res = rtsp_server_pending_request_media_remove(
+		server, request, req_media);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_server_session_media_remove(server, session, media[1]);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(request->media_count, 0);
+	CU_ASSERT_TRUE(list_is_empty(&request->medias));
+	CU_ASSERT_EQUAL(session->media_count, 1);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[2], media[0]);
+	CU_ASSERT_PTR_EQUAL(conn->channel_media[3], media[0]);
+
+	/* A late reply for the removed media is refused */
+	res = rtsp_server_reply_to_setup(server,
+					 request_ctx,
+					 media[1],
+					 RTSP_STATUS_CODE_OK,
+					 0,
+					 0,
+					 0,
+					 0,
+					 NULL,
+					 0,
+					 NULL);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	request = rtsp_server_pending_request_find(server, request_ctx);
+	CU_ASSERT_PTR_NULL(request);
+
+	/* Removing the session unbinds the remaining media */
+	res = rtsp_server_session_remove(server, session);
+	CU_ASSERT_EQUAL(res, 0);
+	test_conn_destroy(conn);
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_server_play_rebind(void)
+{
+	int res;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct rtsp_server_conn *conn[2];
+	struct rtsp_server_session *session;
+	struct rtsp_server_session_media *media[3];
+	struct rtsp_server_session_media other;
+	struct rtsp_channel_pair pair;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+	conn[0] = test_conn_new(server);
+	conn[1] = test_conn_new(server);
+	memset(&other, 0, sizeof(other));
+	session = rtsp_server_session_add(server, 0, "rtsp://h/s");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(session);
+
+	/* Two interleaved medias and one without interleaved channels */
+	media[0] = rtsp_server_session_media_add(
+		server, session, "rtsp://h/s/track0", "s/track0");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(media[0]);
+	media[1] = rtsp_server_session_media_add(
+		server, session, "rtsp://h/s/track1", "s/track1");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(media[1]);
+	media[2] = rtsp_server_session_media_add(
+		server, session, "rtsp://h/s/track2", "s/track2");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(media[2]);
+	pair.rtp = 4;
+	pair.rtcp = 5;
+	res = rtsp_server_conn_channels_bind(conn[0], media[0], &pair);
+	CU_ASSERT_EQUAL(res, 0);
+	pair.rtp = 0;
+	pair.rtcp = 1;
+	res = rtsp_server_conn_channels_bind(conn[0], media[1], &pair);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Nothing to move while the medias are bound */
+	res = rtsp_server_conn_channels_rebind(conn[1], session);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(media[0]->conn, conn[0]);
+
+	/* Connection closed: the channels are kept in the medias */
+	rtsp_server_conn_channels_unbind(media[0]);
+	rtsp_server_conn_channels_unbind(media[1]);
+	test_conn_destroy(conn[0]);
+
+	/* Channels used on the new connection: none of the medias is
+	 * moved */
+	pair.rtp = 0;
+	pair.rtcp = 1;
+	res = rtsp_server_conn_channels_bind(conn[1], &other, &pair);
+	CU_ASSERT_EQUAL(res, 0);
+	res = rtsp_server_conn_channels_rebind(conn[1], session);
+	CU_ASSERT_EQUAL(res, -EEXIST);
+	CU_ASSERT_PTR_NULL(media[0]->conn);
+	CU_ASSERT_PTR_NULL(media[1]->conn);
+	CU_ASSERT_PTR_NULL(conn[1]->channel_media[4]);
+	rtsp_server_conn_channels_unbind(&other);
+
+	/* PLAY on the new connection: the medias are moved on the same
+	 * channels */
+	res = rtsp_server_conn_channels_rebind(conn[1], session);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(media[0]->conn, conn[1]);
+	CU_ASSERT_PTR_EQUAL(media[1]->conn, conn[1]);
+	CU_ASSERT_PTR_NULL(media[2]->conn);
+	CU_ASSERT_PTR_EQUAL(conn[1]->channel_media[4], media[0]);
+	CU_ASSERT_PTR_EQUAL(conn[1]->channel_media[5], media[0]);
+	CU_ASSERT_PTR_EQUAL(conn[1]->channel_media[0], media[1]);
+	CU_ASSERT_PTR_EQUAL(conn[1]->channel_media[1], media[1]);
+	CU_ASSERT_PTR_NULL(conn[1]->channel_media[2]);
+
+	res = rtsp_server_session_remove(server, session);
+	CU_ASSERT_EQUAL(res, 0);
+	test_conn_destroy(conn[1]);
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+static void test_rtsp_server_buffer_pool(void)
+{
+	int res;
+	struct pomp_loop *loop;
+	struct rtsp_server *server;
+	struct pomp_buffer *buf[RTSP_SERVER_BUFFER_POOL_SIZE + 1];
+	struct pomp_buffer *first;
+	struct rtsp_string str;
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	server = test_server_new(loop);
+
+	/* A buffer given back is reused for the next message */
+	res = rtsp_server_buffer_get(server, &buf[0], &str);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	CU_ASSERT_EQUAL(server->buf_pool.allocs, 1);
+	first = buf[0];
+	rtsp_server_buffer_put(server, buf[0]);
+	CU_ASSERT_EQUAL(server->buf_pool.count, 1);
+	res = rtsp_server_buffer_get(server, &buf[0], &str);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(buf[0], first);
+	CU_ASSERT_EQUAL(server->buf_pool.allocs, 1);
+	CU_ASSERT_EQUAL(server->buf_pool.reuses, 1);
+	CU_ASSERT_EQUAL(server->buf_pool.count, 0);
+
+	/* Not reused while still referenced by a write queue */
+	pomp_buffer_ref(first);
+	rtsp_server_buffer_put(server, buf[0]);
+	res = rtsp_server_buffer_get(server, &buf[1], &str);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	CU_ASSERT_PTR_NOT_EQUAL(buf[1], first);
+	CU_ASSERT_EQUAL(server->buf_pool.allocs, 2);
+	CU_ASSERT_EQUAL(server->buf_pool.count, 1);
+	pomp_buffer_unref(first);
+	rtsp_server_buffer_put(server, buf[1]);
+
+	/* Steady state: only reuses */
+	for (int i = 0; i < 10; i++) {
+		res = rtsp_server_buffer_get(server, &buf[0], &str);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+		rtsp_server_buffer_put(server, buf[0]);
+	}
+	CU_ASSERT_EQUAL(server->buf_pool.allocs, 2);
+	CU_ASSERT_EQUAL(server->buf_pool.reuses, 11);
+
+	/* The pool keeps at most RTSP_SERVER_BUFFER_POOL_SIZE buffers */
+	for (size_t i = 0; i < SIZEOF_ARRAY(buf); i++) {
+		res = rtsp_server_buffer_get(server, &buf[i], &str);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	for (size_t i = 0; i < SIZEOF_ARRAY(buf); i++)
+		rtsp_server_buffer_put(server, buf[i]);
+	CU_ASSERT_EQUAL(server->buf_pool.count, RTSP_SERVER_BUFFER_POOL_SIZE);
+
+	test_server_destroy(server);
+	pomp_loop_destroy(loop);
+}
+
+
+CU_TestInfo g_rtsp_test_server[] = {
+	{FN("rtsp-server-reply-expired"), &test_rtsp_server_reply_expired},
+	{FN("rtsp-server-reply-unknown-media"),
+	 &test_rtsp_server_reply_unknown_media},
+	{FN("rtsp-server-request-handle-reuse"),
+	 &test_rtsp_server_request_handle_reuse},
+	{FN("rtsp-server-session-id-invalid"),
+	 &test_rtsp_server_session_id_invalid},
+	{FN("rtsp-server-session-id-shard"),
+	 &test_rtsp_server_session_id_shard},
+	{FN("rtsp-server-conn-interleaved"),
+	 &test_rtsp_server_conn_interleaved},
+	{FN("rtsp-server-conn-channels"), &test_rtsp_server_conn_channels},
+	{FN("rtsp-server-setup-bind-failed"),
+	 &test_rtsp_server_setup_bind_failed},
+	{FN("rtsp-server-play-rebind"), &test_rtsp_server_play_rebind},
+	{FN("rtsp-server-buffer-pool"), &test_rtsp_server_buffer_pool},
+
+	CU_TEST_INFO_NULL,
+};
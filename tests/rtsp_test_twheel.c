@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2017 Parrot Drones SAS
+ * Copyright (c) 2017 Aurelien Barre
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rtsp_priv.h"
+#include "rtsp_test.h"
+
+
+#define TEST_TICK_MS 100
+
+
+struct test_timer {
+	struct rtsp_twheel_timer timer;
+	struct rtsp_twheel *wheel;
+	unsigned int fired;
+	uint64_t fired_ms;
+	/* Timers set or cancelled by the callback */
+	uint32_t rearm_ms;
+	struct test_timer *cancel;
+};
+
+
+static uint64_t s_now_ms;
+
+
+static void timer_cb(struct rtsp_twheel_timer *timer, void *userdata)
+{
+	struct test_timer *t = userdata;
+
+	t->fired++;
+	t->fired_ms = s_now_ms;
+	if (t->rearm_ms > 0)
+		rtsp_twheel_timer_set(t->wheel, timer, s_now_ms, t->rearm_ms);
+	if (t->cancel != NULL)
+		rtsp_twheel_timer_cancel(t->wheel, &t->cancel->timer);
+}
+
+
+static void test_timer_init(struct test_timer *t, struct rtsp_twheel *wheel)
+{
+	memset(t, 0, sizeof(*t));
+	t->wheel = wheel;
+	rtsp_twheel_timer_init(&t->timer, &timer_cb, t);
+}
+
+
+static void test_advance(struct rtsp_twheel *wheel, uint64_t now_ms)
+{
+	s_now_ms = now_ms;
+	rtsp_twheel_advance(wheel, now_ms);
+}
+
+
+static void test_rtsp_twheel_cascade(void)
+{
+	int res;
+	uint64_t expiry;
+	struct rtsp_twheel wheel;
+	struct test_timer t[3];
+	/* Level 1, level 2 and beyond the wheel range */
+	const uint32_t delays[3] = {10000, 500000, 30000000};
+
+	rtsp_twheel_init(&wheel, TEST_TICK_MS);
+	res = rtsp_twheel_next_expiry(&wheel, &expiry);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	for (int i = 0; i < 3; i++) {
+		test_timer_init(&t[i], &wheel);
+		rtsp_twheel_timer_set(&wheel, &t[i].timer, 0, delays[i]);
+	}
+	CU_ASSERT_EQUAL(wheel.count, 3);
+
+	/* The next wake up is the cascade of the first level 1 slot, the
+	 * exact expiration once in the first level */
+	res = rtsp_twheel_next_expiry(&wheel, &expiry);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(expiry, 64 * TEST_TICK_MS);
+	test_advance(&wheel, expiry);
+	res = rtsp_twheel_next_expiry(&wheel, &expiry);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(expiry, delays[0]);
+
+	/* Each timer fires at its expiration, not before */
+	for (int i = 0; i < 3; i++) {
+		test_advance(&wheel, delays[i] - 1);
+		CU_ASSERT_EQUAL(t[i].fired, 0);
+		test_advance(&wheel, delays[i]);
+		CU_ASSERT_EQUAL(t[i].fired, 1);
+		CU_ASSERT_FALSE(t[i].timer.armed);
+	}
+	CU_ASSERT_EQUAL(wheel.count, 0);
+	res = rtsp_twheel_next_expiry(&wheel, &expiry);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	/* Late advance: all the expired timers fire at once */
+	for (int i = 0; i < 3; i++) {
+		t[i].fired = 0;
+		rtsp_twheel_timer_set(
+			&wheel, &t[i].timer, delays[2], delays[i]);
+	}
+	test_advance(&wheel, 2 * (uint64_t)delays[2]);
+	for (int i = 0; i < 3; i++)
+		CU_ASSERT_EQUAL(t[i].fired, 1);
+	CU_ASSERT_EQUAL(wheel.count, 0);
+}
+
+
+static void test_rtsp_twheel_cancel(void)
+{
+	int res;
+	uint64_t expiry;
+	struct rtsp_twheel wheel;
+	struct test_timer t[3];
+
+	rtsp_twheel_init(&wheel, TEST_TICK_MS);
+	for (int i = 0; i < 3; i++)
+		test_timer_init(&t[i], &wheel);
+
+	/* Cancelling a timer not armed does nothing */
+	rtsp_twheel_timer_cancel(&wheel, &t[0].timer);
+	CU_ASSERT_EQUAL(wheel.count, 0);
+
+	rtsp_twheel_timer_set(&wheel, &t[0].timer, 0, 1000);
+	rtsp_twheel_timer_set(&wheel, &t[1].timer, 0, 20000);
+	CU_ASSERT_EQUAL(wheel.count, 2);
+	rtsp_twheel_timer_cancel(&wheel, &t[0].timer);
+	CU_ASSERT_FALSE(t[0].timer.armed);
+	CU_ASSERT_EQUAL(wheel.count, 1);
+	test_advance(&wheel, 1000);
+	CU_ASSERT_EQUAL(t[0].fired, 0);
+
+	/* Cancelled from the callback of a timer of the same slot */
+	rtsp_twheel_timer_set(&wheel, &t[2].timer, 1000, 1000);
+	rtsp_twheel_timer_set(&wheel, &t[0].timer, 1000, 1000);
+	t[2].cancel = &t[0];
+	test_advance(&wheel, 2000);
+	CU_ASSERT_EQUAL(t[2].fired, 1);
+	CU_ASSERT_EQUAL(t[0].fired, 0);
+	CU_ASSERT_EQUAL(wheel.count, 1);
+
+	/* Cancelled in a higher level */
+	rtsp_twheel_timer_cancel(&wheel, &t[1].timer);
+	CU_ASSERT_EQUAL(wheel.count, 0);
+	res = rtsp_twheel_next_expiry(&wheel, &expiry);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+	test_advance(&wheel, 30000);
+	CU_ASSERT_EQUAL(t[1].fired, 0);
+}
+
+
+static void test_rtsp_twheel_rearm(void)
+{
+	int res;
+	uint64_t expiry;
+	struct rtsp_twheel wheel;
+	struct test_timer t;
+
+	rtsp_twheel_init(&wheel, TEST_TICK_MS);
+	test_timer_init(&t, &wheel);
+
+	/* Setting an armed timer again replaces its expiration */
+	rtsp_twheel_timer_set(&wheel, &t.timer, 0, 1000);
+	test_advance(&wheel, 500);
+	rtsp_twheel_timer_set(&wheel, &t.timer, 500, 1000);
+	CU_ASSERT_EQUAL(wheel.count, 1);
+	res = rtsp_twheel_next_expiry(&wheel, &expiry);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(expiry, 1500);
+	test_advance(&wheel, 1000);
+	CU_ASSERT_EQUAL(t.fired, 0);
+	test_advance(&wheel, 1500);
+	CU_ASSERT_EQUAL(t.fired, 1);
+
+	/* The delay is rounded up to the next tick */
+	rtsp_twheel_timer_set(&wheel, &t.timer, 1550, 10);
+	test_advance(&wheel, 1599);
+	CU_ASSERT_EQUAL(t.fired, 1);
+	test_advance(&wheel, 1600);
+	CU_ASSERT_EQUAL(t.fired, 2);
+
+	/* Set again from its callback: fires once per period */
+	t.fired = 0;
+	t.rearm_ms = 300;
+	rtsp_twheel_timer_set(&wheel, &t.timer, 1600, 300);
+	for (uint64_t now = 1600; now <= 4600; now += TEST_TICK_MS)
+		test_advance(&wheel, now);
+	CU_ASSERT_EQUAL(t.fired, 10);
+	CU_ASSERT_EQUAL(t.fired_ms, 4600);
+	CU_ASSERT_TRUE(t.timer.armed);
+	CU_ASSERT_EQUAL(wheel.count, 1);
+
+	rtsp_twheel_timer_cancel(&wheel, &t.timer);
+	CU_ASSERT_EQUAL(wheel.count, 0);
+}
+
+
+CU_TestInfo g_rtsp_test_twheel[] = {
+	{FN("rtsp-twheel-cascade"), &test_rtsp_twheel_cascade},
+	{FN("rtsp-twheel-cancel"), &test_rtsp_twheel_cancel},
+	{FN("rtsp-twheel-rearm"), &test_rtsp_twheel_rearm},
+
+	CU_TEST_INFO_NULL,
+};